@@ -18,6 +18,10 @@ public:
     void setProfilingEnabled(bool enabled) { setValue("profilingEnabled", enabled); };
     int profilingGranularityShift() const { return value("profilingGranularityShift", 1).toInt(); };
     void setProfilingGranularityShift(int granularityShift) { setValue("profilingGranularityShift", granularityShift); };
+    int jitHitThreshold() const { return value("jitHitThreshold", 0).toInt(); };
+    void setJitHitThreshold(int hitThreshold) { setValue("jitHitThreshold", hitThreshold); };
+    int historyCheckpoints() const { return value("historyCheckpoints", 100).toInt(); };
+    void setHistoryCheckpoints(int checkpoints) { setValue("historyCheckpoints", checkpoints); };
     QStringList recentFiles() const { return value("recentFiles", 1).toStringList(); };
     void setRecentFiles(QStringList recentFiles) { setValue("recentFiles", recentFiles); };
 };
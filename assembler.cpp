@@ -4,6 +4,7 @@
 #include <QRegularExpression>
 
 #include "assembler.h"
+#include "processorcore.h"
 
 
 //
@@ -26,6 +27,7 @@ Assembler::Assembler(QObject *parent)
     _includedFilePaths.clear();
     _assembleState = AssembleState::NotStarted;
     assemblerBreakpointProvider = nullptr;
+    _bankedMemory = nullptr;
 }
 
 void Assembler::setAssemblerBreakpointProvider(IAssemblerBreakpointProvider *provider)
@@ -75,6 +77,16 @@ void Assembler::setMemory(uint8_t *newMemory)
     _memory = newMemory;
 }
 
+BankedMemory *Assembler::bankedMemory() const
+{
+    return _bankedMemory;
+}
+
+void Assembler::setBankedMemory(BankedMemory *newBankedMemory)
+{
+    _bankedMemory = newBankedMemory;
+}
+
 const uint16_t Assembler::defaultLocationCounter() const
 {
     return _defaultLocationCounter;
@@ -261,8 +273,36 @@ void Assembler::resetLabelsAndBreakpoints()
         {"__outstr_inline", InternalJSRs::__JSR_outstr_inline},
         {"__get_elapsed_cycles", InternalJSRs::__JSR_get_elapsed_cycles},
         {"__clear_elapsed_cycles", InternalJSRs::__JSR_clear_elapsed_cycles},
+        {"__irq_default_handler", InternalJSRs::__JSR_irq_default_handler},
+        {"__nmi_default_handler", InternalJSRs::__JSR_nmi_default_handler},
+        {"__wait_interrupt", InternalJSRs::__JSR_wait_interrupt},
 
         {"__BRKV", InternalVECs::__VEC_BRKV},
+        {"__IRQV", InternalVECs::__VEC_IRQV},
+        {"__NMIV", InternalVECs::__VEC_NMIV},
+
+        {"__CONOUT", InternalDevices::__DEV_conout},
+        {"__CONIN", InternalDevices::__DEV_conin},
+        {"__CONKEY", InternalDevices::__DEV_conkey},
+        {"__CYCLES", InternalDevices::__DEV_cycles},
+        {"__TIMEMS", InternalDevices::__DEV_time_ms},
+        {"__FILEIN", InternalDevices::__DEV_filein},
+        {"__FILESTATUS", InternalDevices::__DEV_filestatus},
+        {"__T1CL", InternalDevices::__DEV_t1cl},
+        {"__T1CH", InternalDevices::__DEV_t1ch},
+        {"__T1LL", InternalDevices::__DEV_t1ll},
+        {"__T1LH", InternalDevices::__DEV_t1lh},
+        {"__T2CL", InternalDevices::__DEV_t2cl},
+        {"__T2CH", InternalDevices::__DEV_t2ch},
+        {"__ACR", InternalDevices::__DEV_acr},
+        {"__IFR", InternalDevices::__DEV_ifr},
+        {"__IER", InternalDevices::__DEV_ier},
+        {"__BANK0", InternalDevices::__DEV_bank0},
+        {"__BANK1", InternalDevices::__DEV_bank1},
+        {"__BANK2", InternalDevices::__DEV_bank2},
+        {"__BANK3", InternalDevices::__DEV_bank3},
+        {"__BANK4", InternalDevices::__DEV_bank4},
+        {"__BANK5", InternalDevices::__DEV_bank5},
 
         {NULL, -1}
     };
@@ -271,6 +311,7 @@ void Assembler::resetLabelsAndBreakpoints()
         _codeLabels.values[internal->label] = internal->intValue;
 
     assemblerBreakpointProvider->clearBreakpoints();
+    assemblerBreakpointProvider->clearWatchpoints();
 }
 
 void Assembler::restart(bool assemblePass2 /*= false*/)
@@ -311,6 +352,9 @@ void Assembler::assemblePass()
     setLocationCounter(_defaultLocationCounter);
 
     _locationCounterRange.init();
+    // there is banked memory only if this pass's `.banks` lays it out again
+    if (_bankedMemory != nullptr)
+        _bankedMemory->setLayout(BankedMemory::Layout());
 
     Operation operation;
     AddressingMode mode;
@@ -329,7 +373,9 @@ void Assembler::assemblePass()
                                          .arg(Assembly::AddressingModeValueToString(mode)));
             uint8_t bytes = instructionInfo->bytes;
             Q_ASSERT(_locationCounter + bytes <= 0x10000);
-            addInstructionsCodeFileLineNumber(CodeFileLineNumber(_locationCounter, currentFile.filename, currentFile.lineNumber));
+            // code in other banks shares its addresses with the default banks', whose lines the addresses map to
+            if (_bankedMemory == nullptr || _bankedMemory->defaultBankAt(_locationCounter))
+                addInstructionsCodeFileLineNumber(CodeFileLineNumber(_locationCounter, currentFile.filename, currentFile.lineNumber));
             uint8_t *address = reinterpret_cast<uint8_t *>(_instructions) + _locationCounter;
             Instruction *instruction = reinterpret_cast<Instruction *>(address);
             *instruction = Instruction(instructionInfo->opcodeByte, intValue);
@@ -350,6 +396,9 @@ void Assembler::assemblePass()
             setCurrentCodeLineNumber(currentFile.lineNumber + 1);
         assembleNextStatement(operation, mode, intValue, hasOperation, eof);
     }
+    // the program starts with each window showing its own bank
+    if (_bankedMemory != nullptr)
+        _bankedMemory->selectDefaultBanks();
 
     for (int i = 1; i < _instructionsCodeFileLineNumbers.size(); i++)
         Q_ASSERT(_instructionsCodeFileLineNumbers.at(i)._locationCounter > _instructionsCodeFileLineNumbers.at(i - 1)._locationCounter);
@@ -637,7 +686,62 @@ void Assembler::assembleDirective()
     else if (directive == ".break")
     {
         getNextToken();
-        assemblerBreakpointProvider->addBreakpoint(currentFile.filename, currentFile.lineNumber);
+        // a condition can refer to labels defined later, so it is compiled on pass 2
+        BreakpointCondition condition;
+        if (!currentToken.isEmpty() && _assembleState != Pass1)
+            compileBreakpointCondition(condition);
+        assemblerBreakpointProvider->addBreakpoint(currentFile.filename, currentFile.lineNumber, condition);
+    }
+    else if (directive == ".watch")
+    {
+        getNextToken();
+        bool ok;
+        if (tokenIsString())
+        {
+            if (tokenToString(&ok).toLower() != "stack")
+                throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+            assemblerBreakpointProvider->addWatchpoint(0, 0, ProcessorCore::WatchStackOverflow | ProcessorCore::WatchStackUnderflow);
+            return;
+        }
+        ExpressionValue lowest = getTokensExpressionValueAsInt();
+        if (!lowest.ok)
+            throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+        ExpressionValue highest = lowest;
+        uint8_t kinds = ProcessorCore::WatchWrite;
+        if (currentToken == ",")
+        {
+            getNextToken();
+            if (!tokenIsString())
+            {
+                highest = getTokensExpressionValueAsInt();
+                if (!highest.ok)
+                    throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+                if (currentToken == ",")
+                    getNextToken();
+            }
+            if (tokenIsString())
+            {
+                kinds = 0;
+                for (const QChar &ch : tokenToString(&ok).toLower())
+                    if (ch == 'r')
+                        kinds |= ProcessorCore::WatchRead;
+                    else if (ch == 'w')
+                        kinds |= ProcessorCore::WatchWrite;
+                    else if (ch == 'c')
+                        kinds |= ProcessorCore::WatchChange;
+                    else
+                        throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+                getNextToken();
+            }
+        }
+        if (!currentToken.isEmpty())
+            throw AssemblerError(QString("Unexpected token at end of statement: %1").arg(currentToken));
+        if (_assembleState != Pass1)
+        {
+            if (lowest.intValue < 0 || highest.intValue > 0xffff || lowest.intValue > highest.intValue)
+                throw AssemblerError(QString("Bad address range for directive: %1").arg(directive));
+            assemblerBreakpointProvider->addWatchpoint(lowest.intValue, highest.intValue, kinds);
+        }
     }
     else if (directive == ".org")
     {
@@ -653,6 +757,58 @@ void Assembler::assembleDirective()
             setLocationCounter(intValue);
         }
     }
+    else if (directive == ".banks")
+    {
+        // .banks <first window address>, <window size>, <windows>, <banks>
+        if (_bankedMemory == nullptr)
+            throw AssemblerError(QString("No banked memory for directive: %1").arg(directive));
+        int values[4];
+        for (int i = 0; i < 4; i++)
+        {
+            getNextToken();
+            ExpressionValue value = getTokensExpressionValueAsInt();
+            if (!value.ok || value.isUndefined)
+                throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+            values[i] = value.intValue;
+            if (i < 3 && currentToken != ",")
+                throw AssemblerError(QString("Missing value for directive: %1").arg(directive));
+        }
+        BankedMemory::Layout layout;
+        layout.firstWindow = values[0];
+        layout.windowSize = values[1];
+        layout.windows = values[2];
+        layout.banks = values[3];
+        if (values[0] < 0 || values[0] > 0xffff || values[1] < 0 || values[1] > 0xffff || layout.windows <= 0 || !layout.valid())
+            throw AssemblerError(QString("Bad banked memory layout for directive: %1").arg(directive));
+        _bankedMemory->setLayout(layout);
+    }
+    else if (directive == ".bank")
+    {
+        // .bank <window address>, <bank>: what follows in that window goes in the bank
+        if (_bankedMemory == nullptr || !_bankedMemory->mapped())
+            throw AssemblerError(QString("No banked memory for directive: %1").arg(directive));
+        getNextToken();
+        ExpressionValue address = getTokensExpressionValueAsInt();
+        if (!address.ok || address.isUndefined)
+            throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+        if (currentToken != ",")
+            throw AssemblerError(QString("Missing value for directive: %1").arg(directive));
+        getNextToken();
+        ExpressionValue bank = getTokensExpressionValueAsInt();
+        if (!bank.ok || bank.isUndefined)
+            throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+        const int window = address.intValue >= 0 && address.intValue <= 0xffff ? _bankedMemory->windowAt(address.intValue) : -1;
+        if (window < 0)
+            throw AssemblerError(QString("Address not in a bank window for directive: %1").arg(directive));
+        try
+        {
+            _bankedMemory->selectBank(window, bank.intValue);
+        }
+        catch (const ExecutionError &e)
+        {
+            throw AssemblerError(QString(e.what()));
+        }
+    }
     else if (directive == ".macro")
     {
         if (!macroExpansionStateStack.isEmpty())
@@ -871,7 +1027,7 @@ bool Assembler::getNextLine()
     currentLine.line.clear();
     if (!getNextCurrentLine())
         return false;
-    currentLine.lineStream.setString(&currentLine.line, QIODeviceBase::ReadOnly);
+    currentLine.lineStream.setString(&currentLine.line, QIODevice::ReadOnly);
     return true;
 }
 
@@ -1178,6 +1334,143 @@ Assembler::ExpressionValue Assembler::getTokensExpressionValueAsInt(bool allowFo
     return value;
 }
 
+void Assembler::compileBreakpointCondition(BreakpointCondition &condition)
+{
+    // As `getTokensExpressionValueAsInt()`, but for the rest of the line, and emitting `BreakpointCondition` code
+    // in place of evaluating: registers A, X, Y, S, P and PC are operands alongside numbers and labels,
+    // `(expr)` is the word at address expr (as for indirect addressing) and `?expr` the byte there, `[...]` groups,
+    // and there are comparisons and logical operators below the arithmetic ones
+    using Op = BreakpointCondition::Op;
+    enum Operator { NotAnOperator = -1, OpenParen, CloseParen, OpenBracket, CloseBracket, LogicalOr, LogicalAnd,
+                    Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+                    BitOr, BitAnd, ShiftLeft, ShiftRight, Plus, Minus, Multiply, Divide, UnaryLow, UnaryHigh, UnaryNot, UnaryByte, };
+    struct OperatorInfo { Operator _operator; bool isUnary; int precedence; QString string; Op op; };
+    static const OperatorInfo operatorsInfo[]
+    {
+        { OpenParen, false, 0, "(", Op::MemoryWord, },
+        { CloseParen, false, 0, ")", Op::MemoryWord, },
+        { OpenBracket, false, 0, "[", Op::PushConstant, },
+        { CloseBracket, false, 0, "]", Op::PushConstant, },
+        { LogicalOr, false, 1, "||", Op::LogicalOr, },
+        { LogicalAnd, false, 2, "&&", Op::LogicalAnd, },
+        { Equal, false, 5, "==", Op::Equal, },
+        { NotEqual, false, 5, "!=", Op::NotEqual, },
+        { Less, false, 6, "<", Op::Less, },
+        { LessEqual, false, 6, "<=", Op::LessEqual, },
+        { Greater, false, 6, ">", Op::Greater, },
+        { GreaterEqual, false, 6, ">=", Op::GreaterEqual, },
+        { BitOr, false, 10, "|", Op::BitOr, },
+        { BitAnd, false, 20, "&", Op::BitAnd, },
+        { ShiftLeft, false, 30, "<<", Op::ShiftLeft, },
+        { ShiftRight, false, 30, ">>", Op::ShiftRight, },
+        { Plus, false, 40, "+", Op::Plus, },
+        { Minus, false, 40, "-", Op::Minus, },
+        { Multiply, false, 50, "*", Op::Multiply, },
+        { Divide, false, 50, "/", Op::Divide, },
+        { UnaryLow, true, 100, "<", Op::UnaryLow, },
+        { UnaryHigh, true, 100, ">", Op::UnaryHigh, },
+        { UnaryNot, true, 100, "!", Op::LogicalNot, },
+        { UnaryByte, true, 100, "?", Op::MemoryByte, },
+    };
+    static_assert(OpenParen == 0, "Operators::OpenParen must have a value of 0");
+    auto findOperator = [](const QString &_operator, bool isUnary) -> Operator {
+        for (int i = 0; i < sizeof(operatorsInfo) / sizeof(operatorsInfo[0]); i++)
+            if (operatorsInfo[i].string == _operator && operatorsInfo[i].isUnary == isUnary)
+            {
+                Q_ASSERT(operatorsInfo[i]._operator == i);
+                return static_cast<Operator>(i);
+            }
+        return NotAnOperator;
+    };
+    // `getNextToken()` returns these operators' characters one at a time
+    auto appendIfNextChar = [this](char ch) {
+        QTextStream &currentLineStream(currentLine.lineStream);
+        qint64 pos = currentLineStream.pos();
+        char nextChar = '\0';
+        currentLineStream >> nextChar;
+        if (currentLineStream.status() == QTextStream::Ok && nextChar == ch)
+            currentToken.append(nextChar);
+        else if (currentLineStream.status() == QTextStream::Ok)
+            currentLineStream.seek(pos);
+    };
+    auto badCondition = [this]() {
+        return AssemblerError(QString("Bad breakpoint condition at: %1").arg(currentToken));
+    };
+    static const QMap<QString, Op> registers
+    {
+        { "A", Op::PushAccumulator }, { "X", Op::PushXregister }, { "Y", Op::PushYregister },
+        { "S", Op::PushStackRegister }, { "P", Op::PushStatusFlags }, { "PC", Op::PushProgramCounter },
+    };
+    QStack<Operator> operatorStack;
+    condition.clear();
+
+    bool wantOperator = false;
+    while (!currentToken.isEmpty())
+    {
+        if (!wantOperator)
+        {
+            Operator _operator = findOperator(currentToken, true);
+            if (_operator == NotAnOperator && (currentToken == "(" || currentToken == "["))
+                _operator = findOperator(currentToken, false);
+            if (_operator != NotAnOperator)
+                operatorStack.push(_operator);
+            else if (registers.contains(currentToken.toUpper()))
+            {
+                condition.append(registers.value(currentToken.toUpper()));
+                wantOperator = true;
+            }
+            else
+            {
+                ExpressionValue value = tokenValueAsInt();
+                if (!value.isValid())
+                    throw AssemblerError(QString("Bad value: %1").arg(currentToken));
+                condition.append(Op::PushConstant, value.intValue);
+                wantOperator = true;
+            }
+        }
+        else
+        {
+            if (currentToken == "=" || currentToken == "!" || currentToken == "<" || currentToken == ">")
+                appendIfNextChar('=');
+            else if (currentToken == "&" || currentToken == "|")
+                appendIfNextChar(currentToken.at(0).toLatin1());
+            Operator _operator = findOperator(currentToken, false);
+            if (_operator == NotAnOperator || _operator == OpenParen || _operator == OpenBracket)
+                throw badCondition();
+
+            Operator openOperator = _operator == CloseParen ? OpenParen : _operator == CloseBracket ? OpenBracket : NotAnOperator;
+            while (!operatorStack.isEmpty() && operatorStack.top() != OpenParen && operatorStack.top() != OpenBracket
+                   && (openOperator != NotAnOperator || operatorsInfo[operatorStack.top()].precedence >= operatorsInfo[_operator].precedence))
+                condition.append(operatorsInfo[operatorStack.pop()].op);
+            if (openOperator != NotAnOperator)
+            {
+                if (operatorStack.isEmpty() || operatorStack.pop() != openOperator)
+                    throw badCondition();
+                if (openOperator == OpenParen)
+                    condition.append(Op::MemoryWord);
+            }
+            else
+            {
+                operatorStack.push(_operator);
+                wantOperator = false;
+            }
+        }
+        getNextToken(wantOperator);
+    }
+
+    if (!wantOperator)
+        throw badCondition();
+    while (!operatorStack.isEmpty())
+    {
+        Operator _operator = operatorStack.pop();
+        if (_operator == OpenParen || _operator == OpenBracket)
+            throw badCondition();
+        condition.append(operatorsInfo[_operator].op);
+    }
+    if (!condition.isValid())
+        throw badCondition();
+}
+
 bool Assembler::tokenIsDirective() const
 {
     if (!currentToken.startsWith('.'))
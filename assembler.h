@@ -8,6 +8,8 @@
 #include <QTextStream>
 
 #include "assembly.h"
+#include "bankedmemory.h"
+#include "breakpointcondition.h"
 
 using Operation = Assembly::Operation;
 using AddressingMode = Assembly::AddressingMode;
@@ -16,6 +18,7 @@ using Instruction = Assembly::Instruction;
 using InstructionInfo = Assembly::InstructionInfo;
 using InternalJSRs = Assembly::InternalJSRs;
 using InternalVECs = Assembly::InternalVECs;
+using InternalDevices = Assembly::InternalDevices;
 
 
 class IAssemblerBreakpointProvider;
@@ -125,6 +128,9 @@ public:
 
     uint8_t *memory() const;
     void setMemory(uint8_t *newMemory);
+    // where `.banks` lays out banked memory and `.bank` selects the bank code goes in; nullptr for none
+    BankedMemory *bankedMemory() const;
+    void setBankedMemory(BankedMemory *newBankedMemory);
 
     const MacroDefinitions &macroDefinitions() const;
     QStringList macroNames() const;
@@ -164,6 +170,7 @@ private:
     LocationCounterRange _locationCounterRange;
 
     uint8_t *_memory;
+    BankedMemory *_bankedMemory;
     Instruction *_instructions;
     QList<CodeFileLineNumber> _instructionsCodeFileLineNumbers;
     IAssemblerBreakpointProvider *assemblerBreakpointProvider;
@@ -209,6 +216,7 @@ private:
     QString peekNextToken(bool wantOperator = false);
     bool getNextToken(bool wantOperator = false, bool macroDefinition = false);
     ExpressionValue getTokensExpressionValueAsInt(bool allowForIndirectAddressing = false, bool *indirectAddressingMetCloseParen = nullptr);
+    void compileBreakpointCondition(BreakpointCondition &condition);
     bool tokenIsDirective() const;
     bool tokenIsMacro() const;
     bool tokenStartsExpression() const;
@@ -239,7 +247,9 @@ class IAssemblerBreakpointProvider
 public:
     virtual ~IAssemblerBreakpointProvider() = default;
     virtual void clearBreakpoints() = 0;
-    virtual void addBreakpoint(const QString &filename, int lineNumber) = 0;
+    virtual void addBreakpoint(const QString &filename, int lineNumber, const BreakpointCondition &condition) = 0;
+    virtual void clearWatchpoints() = 0;
+    virtual void addWatchpoint(uint16_t lowest, uint16_t highest, uint8_t kinds) = 0;
 };
 
 #endif // ASSEMBLER_H
@@ -1,34 +1,19 @@
 #ifndef ASSEMBLY_H
 #define ASSEMBLY_H
 
-#include <QMetaEnum>
 #include <QObject>
 
+#include "instructionset.h"
+
 //
 // Assembly Class
 //
-class Assembly : public QObject
+// The Qt side of `InstructionSet`: names as `QString`s, addressing mode flags and directives for the assembler
+//
+class Assembly : public QObject, public InstructionSet
 {
     Q_OBJECT
 public:
-    enum Operation : uint8_t
-    {
-        LDA, LDX, LDY, STA, STX, STY,
-        TAX, TAY, TXA, TYA,
-        TSX, TXS, PHA, PHP, PLA, PLP,
-        AND, EOR, ORA, BIT,
-        ADC, SBC, CMP, CPX, CPY,
-        INC, INX, INY, DEC, DEX, DEY,
-        ASL, LSR, ROL, ROR,
-        JMP, JSR, RTS,
-        BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS,
-        CLC, CLD, CLI, CLV, SEC, SED, SEI,
-        BRK, NOP, RTI
-    };
-    Q_ENUM(Operation)
-    static constexpr int TotalOperations = RTI + 1;
-    static_assert(TotalOperations == 56);
-
     static const QList<Operation>& branchJumpOperations()
     {
         static const QList<Operation> list =
@@ -38,21 +23,18 @@ public:
         };
         return list;
     }
-    static QMetaEnum OperationsMetaEnum()
-    {
-        return QMetaEnum::fromType<Operation>();
-    }
+
     static Operation OperationKeyToValue(const char *key)
     {
-        return static_cast<Operation>(OperationsMetaEnum().keyToValue(key));
+        return operationFromName(key);
     }
     static bool OperationValueIsValid(Operation value)
     {
-        return value >= 0 && value < OperationsMetaEnum().keyCount();
+        return value >= 0 && value < TotalOperations;
     }
     static const char *OperationValueToKey(Operation value)
     {
-        return OperationsMetaEnum().valueToKey(value);
+        return operationName(value);
     }
     static QString OperationValueToString(Operation value)
     {
@@ -60,35 +42,17 @@ public:
         return key ? QString(key) : QString::number(value, 16);
     }
 
-    enum AddressingMode : uint8_t
-    {
-        Implied = 0,            // CLC | RTS
-        Accumulator = 1,        // LSR A | ROR A
-        Immediate = 2,          // LDA #10 | LDX #<LABEL | LDY #>LABEL
-        ZeroPage = 3,           // LDA $00 | ASL ANSWER
-        ZeroPageX = 4,          // STY $10,X | AND TEMP,X
-        ZeroPageY = 5,          // LDX $10,Y | STX TEMP,Y
-        Relative = 6,           // BEQ LABEL | BNE *+4
-        Absolute = 7,           // JMP $1234 | JSR WIBBLE
-        AbsoluteX = 8,          // STA $3000,X | ROR CRC,X
-        AbsoluteY = 9,          // AND $4000,Y | STA MEM,Y
-        Indirect = 10,          // JMP ($FFFC) | JMP (TARGET)
-        IndexedIndirectX = 11,  // LDA ($40,X) | STA (MEM,X)
-        IndirectIndexedY = 12,  // LDA ($40),Y | STA (DST),Y
-    };
-    Q_ENUM(AddressingMode)
-
     static AddressingMode AddressingModeKeyToValue(const char *key)
     {
-        return static_cast<AddressingMode>(QMetaEnum::fromType<AddressingMode>().keyToValue(key));
+        return addressingModeFromName(key);
     }
     static bool AddressingModeValueIsValid(AddressingMode value)
     {
-        return value >= 0 && value < QMetaEnum::fromType<AddressingMode>().keyCount();
+        return value >= 0 && value < TotalAddressingModes;
     }
     static const char *AddressingModeValueToKey(AddressingMode value)
     {
-        return QMetaEnum::fromType<AddressingMode>().valueToKey(value);
+        return addressingModeName(value);
     }
     static QString AddressingModeValueToString(AddressingMode value)
     {
@@ -129,53 +93,15 @@ public:
     {
         static const QStringList list =
         {
-            ".byte", ".word", ".include", ".break", ".org", ".macro", ".endmacro"
+            ".byte", ".word", ".include", ".break", ".watch", ".org", ".banks", ".bank", ".macro", ".endmacro"
         };
         return list;
     }
 
-    struct InstructionInfo
-    {
-        uint8_t opcodeByte;
-        uint8_t bytes;
-        uint8_t cycles;
-        Operation operation;
-        AddressingMode addrMode;
-
-        bool isValid() const { return bytes != 0; }
-    };
-    static constexpr int TotalInstructions = 256;
-
     static void initInstructionInfo();
-    static const InstructionInfo &getInstructionInfo(uint8_t opcodeByte) { return instructionsInfo[opcodeByte]; }
-    static const InstructionInfo *findInstructionInfo(Operation operation, AddressingMode addrMode);
-
-    struct __attribute__((packed)) Instruction
-    {
-        uint8_t opcodeByte;
-        uint16_t operand;
-        Instruction(uint8_t _opcodeByte, uint16_t _operand)
-        {
-            opcodeByte = _opcodeByte;
-            operand = _operand;
-        }
-
-        const InstructionInfo &getInstructionInfo() const { return instructionsInfo[opcodeByte]; }
-    };
-
-    enum InternalJSRs { __JSR_terminate = 0x0000,
-                        __JSR_brk_handler = 0xfffe, __JSR_brk_default_handler = 0xfffc, __JSR_outch = 0xfffa, __JSR_get_time = 0xfff8,
-                        __JSR_get_time_ms = 0xfff6, __JSR_get_elapsed_time = 0xfff4, __JSR_clear_elapsed_time = 0xfff2, __JSR_process_events = 0xfff0,
-                        __JSR_inch = 0xffee, __JSR_inkey = 0xffec,  __JSR_wait = 0xffea, __JSR_open_file = 0xffe8,
-                        __JSR_close_file = 0xffe6, __JSR_rewind_file = 0xffe4, __JSR_read_file = 0xffe2, __JSR_outstr_fast = 0xffe0,
-                        __JSR_outstr_inline = 0xffde, __JSR_get_elapsed_cycles = 0xffdc, __JSR_clear_elapsed_cycles = 0xffda,
-                        };
-    enum InternalVECs { __VEC_BRKV = 0x0202, };
 
 private:
     static OperationMode operationsModes[TotalOperations];
-    static const InstructionInfo _instructionsInfo[];
-    static InstructionInfo instructionsInfo[TotalInstructions];
 };
 
 
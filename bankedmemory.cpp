@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "bankedmemory.h"
+#include "processorcore.h"
+
+
+//
+// BankedMemory Class
+//
+
+bool BankedMemory::Layout::valid() const
+{
+    if (windows == 0)
+        return true;
+    if ((windowSize != 0x2000 && windowSize != 0x4000) || firstWindow % windowSize != 0 || windows < 0 || windows > 0x10000 / windowSize)
+        return false;
+    if (firstWindow < windowSize || firstWindow + windows * windowSize > 0x10000 - windowSize)
+        return false;
+    return banks >= windows && banks <= MaxBanks;
+}
+
+BankedMemory::BankedMemory(ProcessorCore *core)
+    : core(core)
+{
+    windowPages = 0;
+}
+
+void BankedMemory::setLayout(const Layout &layout)
+{
+    _layout = layout.windows != 0 ? layout : Layout();
+    windowPages = _layout.windowSize >> 8;
+    _selectedBanks.resize(_layout.windows);
+    for (int window = 0; window < _layout.windows; window++)
+        _selectedBanks[window] = window;
+    std::shared_ptr<Page> zeroPage(std::make_shared<Page>());
+    zeroPage->fill(0);
+    pages.assign(_layout.banks * windowPages, zeroPage);
+    lastImage.reset();
+    if (mapped())
+        core->mapRam(_layout.firstWindow >> 8, (windowAddress(_layout.windows) >> 8) - 1);
+}
+
+int BankedMemory::windowAt(uint16_t address) const
+{
+    if (!mapped() || address < _layout.firstWindow || address >= windowAddress(_layout.windows))
+        return -1;
+    return (address - _layout.firstWindow) / _layout.windowSize;
+}
+
+void BankedMemory::selectBank(int window, int bank)
+{
+    if (bank == _selectedBanks[window])
+        return;
+    if (bank < 0 || bank >= _layout.banks)
+        throw ExecutionError("Bank out of range: " + std::to_string(bank));
+    const int other = windowShowing(bank);
+    if (other >= 0)
+        throw ExecutionError("Bank " + std::to_string(bank) + " is already selected in window " + std::to_string(other));
+    copyOut(window);
+    _selectedBanks[window] = bank;
+    copyIn(window);
+    lastImage.reset();
+    const uint8_t firstPage = windowAddress(window) >> 8;
+    core->memoryPagesChanged(firstPage, firstPage + windowPages - 1);
+}
+
+void BankedMemory::selectDefaultBanks()
+{
+    bool selected = true;
+    while (selected)
+    {
+        selected = false;
+        int waiting = -1;
+        for (int window = 0; window < _layout.windows; window++)
+            if (_selectedBanks[window] != window)
+            {
+                if (windowShowing(window) < 0)
+                {
+                    selectBank(window, window);
+                    selected = true;
+                }
+                else
+                    waiting = window;
+            }
+        // windows showing one another's banks in a ring: one steps aside to a bank no window shows
+        if (!selected && waiting >= 0)
+        {
+            int spare = 0;
+            while (windowShowing(spare) >= 0)
+                spare++;
+            selectBank(waiting, spare);
+            selected = true;
+        }
+    }
+}
+
+bool BankedMemory::defaultBankAt(uint16_t address) const
+{
+    const int window = windowAt(address);
+    return window < 0 || _selectedBanks[window] == window;
+}
+
+std::shared_ptr<const BankedMemory::Image> BankedMemory::save()
+{
+    if (!mapped())
+        return nullptr;
+    if (lastImage == nullptr)
+    {
+        std::shared_ptr<Image> image(std::make_shared<Image>());
+        image->layout = _layout;
+        image->selectedBanks = _selectedBanks;
+        image->pages.assign(pages.begin(), pages.end());
+        lastImage = image;
+    }
+    return lastImage;
+}
+
+void BankedMemory::restore(const std::shared_ptr<const Image> &image)
+{
+    if (image == nullptr)
+    {
+        if (mapped())
+            setLayout(Layout());
+        return;
+    }
+    if (image == lastImage)
+        return;
+    if (!(image->layout == _layout))
+        setLayout(image->layout);
+    _selectedBanks = image->selectedBanks;
+    // the image's pages are never written: `copyOut()` replaces a page it shares
+    pages.resize(image->pages.size());
+    std::transform(image->pages.begin(), image->pages.end(), pages.begin(),
+                   [](const std::shared_ptr<const Page> &page) { return std::const_pointer_cast<Page>(page); });
+    lastImage = image;
+}
+
+int BankedMemory::windowShowing(int bank) const
+{
+    auto it = std::find(_selectedBanks.begin(), _selectedBanks.end(), bank);
+    return it != _selectedBanks.end() ? static_cast<int>(it - _selectedBanks.begin()) : -1;
+}
+
+void BankedMemory::copyOut(int window)
+{
+    const uint8_t *memory = core->memory() + windowAddress(window);
+    std::shared_ptr<Page> *bankPages = &pages[_selectedBanks[window] * windowPages];
+    for (int page = 0; page < windowPages; page++, memory += 0x100)
+    {
+        std::shared_ptr<Page> &stored(bankPages[page]);
+        if (stored.use_count() == 1)
+            std::memcpy(stored->data(), memory, stored->size());
+        else if (std::memcmp(stored->data(), memory, stored->size()) != 0)
+        {
+            stored = std::make_shared<Page>();
+            std::memcpy(stored->data(), memory, stored->size());
+        }
+    }
+}
+
+void BankedMemory::copyIn(int window)
+{
+    uint8_t *memory = core->memory() + windowAddress(window);
+    const std::shared_ptr<Page> *bankPages = &pages[_selectedBanks[window] * windowPages];
+    for (int page = 0; page < windowPages; page++, memory += 0x100)
+        std::memcpy(memory, bankPages[page]->data(), bankPages[page]->size());
+}
@@ -0,0 +1,88 @@
+#ifndef BANKEDMEMORY_H
+#define BANKEDMEMORY_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ProcessorCore;
+
+//
+// BankedMemory Class
+//
+// A backing store of banks, each the size of a window, and windows in a `ProcessorCore`'s address space which each
+// show one of them, the bank selected for it (by default window n shows bank n); for data beyond the 64K
+// Windows are 8K or 16K, aligned, and lie between the first and the last such block of the address space, so zero
+// page, the stack, the vectors and the device and trap pages are never banked; up to 256 banks of 16K is 4MB
+// The core's memory is the one flat array the execution loops and the JIT read directly, so the window holds the
+// selected bank's bytes themselves: selecting another copies the window out to the bank it showed and the new bank
+// in, invalidating the decoded instructions of just the window's pages; there is no cost to memory accesses
+// The store is kept in pages shared with save states, copied on write, and unwritten banks share one zero page;
+// a page copied out unchanged stays shared, so scanning through banks only ever copies them in
+// A window cannot show a bank another window shows
+//
+class BankedMemory
+{
+public:
+    using Page = std::array<uint8_t, 0x100>;
+    static constexpr int MaxBanks = 0x100;
+
+    struct Layout
+    {
+        uint16_t firstWindow = 0;   // the address of window 0, the others following on
+        uint16_t windowSize = 0;    // 0x2000 or 0x4000
+        int windows = 0;            // 0 for no banked memory
+        int banks = 0;              // at least `windows`, at most `MaxBanks`
+
+        bool operator==(const Layout &other) const
+        {
+            return firstWindow == other.firstWindow && windowSize == other.windowSize && windows == other.windows && banks == other.banks;
+        }
+        bool valid() const;
+    };
+
+    // what a save state keeps: the store and which bank each window shows, the windows' contents being in the
+    // save state's memory
+    struct Image
+    {
+        Layout layout;
+        std::vector<uint8_t> selectedBanks;
+        std::vector<std::shared_ptr<const Page>> pages;
+    };
+
+    explicit BankedMemory(ProcessorCore *core);
+
+    const Layout &layout() const { return _layout; }
+    // the banks shown keep what their windows hold now, every other bank starting zeroed; the windows' pages become RAM
+    void setLayout(const Layout &layout);
+    bool mapped() const { return _layout.windows != 0; }
+    // the window holding `address`; -1 for none
+    int windowAt(uint16_t address) const;
+    uint16_t windowAddress(int window) const { return _layout.firstWindow + window * _layout.windowSize; }
+
+    uint8_t selectedBank(int window) const { return _selectedBanks[window]; }
+    // throws `ExecutionError` for a bank out of range or shown in another window
+    void selectBank(int window, int bank);
+    // window n showing bank n
+    void selectDefaultBanks();
+    bool defaultBankAt(uint16_t address) const;
+
+    std::shared_ptr<const Image> save();
+    // nullptr for no banked memory
+    void restore(const std::shared_ptr<const Image> &image);
+
+private:
+    ProcessorCore *core;
+    Layout _layout;
+    int windowPages;
+    std::vector<uint8_t> _selectedBanks;
+    std::vector<std::shared_ptr<Page>> pages;   // by bank, then page of the bank
+    std::shared_ptr<const Image> lastImage;     // saved or restored, while the store and selection are as it has them
+
+    int windowShowing(int bank) const;
+    void copyOut(int window);
+    void copyIn(int window);
+};
+
+#endif // BANKEDMEMORY_H
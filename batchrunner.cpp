@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "batchrunner.h"
+#include "stdiocorehost.h"
+
+//
+// BatchHost Class
+//
+// A run's host: console input from its `Run::input`, console output and messages kept in its `Result`; the user
+// file is the `StdioCoreHost`'s, its own to each run
+//
+class BatchHost : public StdioCoreHost
+{
+public:
+    BatchHost(const std::string &input, BatchRunner::Result &result) : input(input), result(result) { inputNext = 0; }
+
+    void sendMessage(const char *message, int len) override { result.messages.append(message, len).append(1, '\n'); }
+    void outputChar(char ch) override { result.output += ch; }
+    void outputString(const char *str, int len) override { result.output.append(str, len); }
+    // there is no one to wait for, and the input is all there
+    char inputChar(int /*timeout*/, bool justWait) override
+    {
+        if (justWait)
+            return '\0';
+        return inputNext < input.size() ? input[inputNext++] : '\003';
+    }
+    void processEvents() override {}
+
+private:
+    const std::string &input;
+    size_t inputNext;
+    BatchRunner::Result &result;
+};
+
+
+//
+// BatchRunner Class
+//
+
+struct BatchRunner::Worker
+{
+    ProcessorCore core;
+    std::mutex queueMutex;
+    std::deque<size_t> queue;                   // indexes into the runs
+    std::mutex runMutex;                        // between the worker and the time limit's watchdog
+    bool running = false, timedOut = false;
+    std::chrono::steady_clock::time_point runStart;
+};
+
+BatchRunner::BatchRunner(const std::shared_ptr<const ProcessorCore::SaveState> &image)
+    : image(image)
+{
+    _threads = 0;
+    _jitHitThreshold = 0;
+    _timeLimit = 0;
+}
+
+std::vector<BatchRunner::Result> BatchRunner::run(const std::vector<Run> &runs)
+{
+    std::vector<Result> results(runs.size());
+    if (runs.empty())
+        return results;
+    int threads = _threads > 0 ? _threads : std::max<int>(std::thread::hardware_concurrency(), 1);
+    threads = std::min<size_t>(threads, runs.size());
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back(new Worker);
+        // as `ProcessorModel`'s core, whose save state the image is
+        workers.back()->core.mapHostDevices();
+        workers.back()->core.setJitHitThreshold(_jitHitThreshold);
+    }
+    for (size_t run = 0; run < runs.size(); run++)
+        workers[run % threads]->queue.push_back(run);
+
+    std::vector<std::thread> pool;
+    for (int i = 0; i < threads; i++)
+        pool.emplace_back(&BatchRunner::work, this, std::ref(workers), i, std::cref(runs), std::ref(results));
+
+    // stops each run which goes over the time limit, from another thread as `ProcessorCore::stop()` allows
+    std::atomic<bool> finished(false);
+    std::thread watchdog;
+    if (_timeLimit > 0)
+        watchdog = std::thread([this, &workers, &finished]() {
+            const auto timeLimit = std::chrono::duration<double>(_timeLimit);
+            while (!finished)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                for (const std::unique_ptr<Worker> &worker : workers)
+                {
+                    std::lock_guard<std::mutex> lock(worker->runMutex);
+                    if (worker->running && std::chrono::steady_clock::now() - worker->runStart > timeLimit)
+                    {
+                        worker->timedOut = true;
+                        worker->core.stop();
+                    }
+                }
+            }
+        });
+
+    for (std::thread &thread : pool)
+        thread.join();
+    finished = true;
+    if (watchdog.joinable())
+        watchdog.join();
+    return results;
+}
+
+void BatchRunner::work(std::vector<std::unique_ptr<Worker>> &workers, int index, const std::vector<Run> &runs, std::vector<Result> &results)
+{
+    size_t run;
+    while (nextRun(workers, index, run))
+        runOne(*workers[index], runs[run], results[run]);
+}
+
+bool BatchRunner::nextRun(std::vector<std::unique_ptr<Worker>> &workers, int index, size_t &run)
+{
+    // no runs are added once started, so finding every queue empty means done
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        Worker &worker(*workers[(index + i) % workers.size()]);
+        std::lock_guard<std::mutex> lock(worker.queueMutex);
+        if (worker.queue.empty())
+            continue;
+        if (i == 0)
+        {
+            run = worker.queue.front();
+            worker.queue.pop_front();
+        }
+        else
+        {
+            run = worker.queue.back();
+            worker.queue.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void BatchRunner::runOne(Worker &worker, const Run &run, Result &result)
+{
+    result.name = run.name;
+    BatchHost host(run.input, result);
+    ProcessorCore &core(worker.core);
+    core.setHost(&host);
+    {
+        std::lock_guard<std::mutex> lock(worker.runMutex);
+        core.restoreState(image);
+        core.restartRun();
+        worker.running = true;
+        worker.timedOut = false;
+        worker.runStart = std::chrono::steady_clock::now();
+    }
+    try
+    {
+        core.run();
+        result.ok = true;
+    }
+    catch (const ExecutionError &e)
+    {
+        result.error = e.what();
+    }
+    {
+        std::lock_guard<std::mutex> lock(worker.runMutex);
+        worker.running = false;
+        result.hostSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - worker.runStart).count();
+        if (worker.timedOut)
+        {
+            result.ok = false;
+            result.error = "Time limit exceeded";
+        }
+    }
+    result.instructions = core.instructionCount();
+    result.cycles = core.totalElapsedCycles();
+    core.setHost(nullptr);
+}
+
+/*static*/ void BatchRunner::writeCsv(std::ostream &out, const std::vector<Result> &results)
+{
+    auto quoted = [](const std::string &field) {
+        std::string quoted("\"");
+        for (char ch : field)
+            quoted += ch == '"' ? std::string("\"\"") : std::string(1, ch);
+        return quoted + "\"";
+    };
+    // FNV-1a, to tell at a glance which runs' output is the same
+    auto hash = [](const std::string &output) {
+        uint64_t hash = 0xcbf29ce484222325;
+        for (unsigned char ch : output)
+            hash = (hash ^ ch) * 0x100000001b3;
+        return hash;
+    };
+
+    out << "run,status,instructions,cycles,host_ms,output_bytes,output_hash,error\n";
+    for (const Result &result : results)
+    {
+        char hashText[17];
+        std::snprintf(hashText, sizeof(hashText), "%016llx", static_cast<unsigned long long>(hash(result.output)));
+        out << quoted(result.name) << ',' << (result.ok ? "ok" : "error") << ','
+            << result.instructions << ',' << result.cycles << ',' << result.hostSeconds * 1000.0 << ','
+            << result.output.size() << ',' << hashText << ',' << quoted(result.error) << '\n';
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "processorcore.h"
+
+//
+// BatchRunner Class
+//
+// Runs one program many times over, each run with its own console input and output and user file, on a pool of
+// threads with a `ProcessorCore` each, with its host devices mapped
+// Every run starts from the one program image, a save state taken just after `ProcessorCore::startRun()`; its pages
+// are shared, read-only, by all the cores, and restoring it for a thread's next run copies back just the pages the
+// last one wrote, so the decoded instructions (and JIT code) of the pages it did not write carry over
+// Each thread takes runs from the front of its own queue and, when that is empty, steals from the back of another's
+//
+class BatchRunner
+{
+public:
+    struct Run
+    {
+        std::string name;
+        std::string input;          // the console input; after it the program reads end of input, as Ctrl-C
+    };
+    struct Result
+    {
+        std::string name;
+        bool ok = false;
+        std::string error;          // the `ExecutionError`, or that the run went over `timeLimit()`
+        uint64_t instructions = 0, cycles = 0;
+        double hostSeconds = 0;
+        std::string output;         // the console output
+        std::string messages;       // `IProcessorCoreHost::sendMessage()`s, a line each
+    };
+
+    explicit BatchRunner(const std::shared_ptr<const ProcessorCore::SaveState> &image);
+
+    // 0 for one per hardware thread
+    int threads() const { return _threads; }
+    void setThreads(int threads) { _threads = threads; }
+    int jitHitThreshold() const { return _jitHitThreshold; }
+    void setJitHitThreshold(int hitThreshold) { _jitHitThreshold = hitThreshold; }
+    // in seconds of host time for each run, 0 for none
+    double timeLimit() const { return _timeLimit; }
+    void setTimeLimit(double seconds) { _timeLimit = seconds; }
+
+    // the results in the order of `runs`
+    std::vector<Result> run(const std::vector<Run> &runs);
+
+    static void writeCsv(std::ostream &out, const std::vector<Result> &results);
+
+private:
+    struct Worker;
+
+    std::shared_ptr<const ProcessorCore::SaveState> image;
+    int _threads;
+    int _jitHitThreshold;
+    double _timeLimit;
+
+    void work(std::vector<std::unique_ptr<Worker>> &workers, int index, const std::vector<Run> &runs, std::vector<Result> &results);
+    bool nextRun(std::vector<std::unique_ptr<Worker>> &workers, int index, size_t &run);
+    void runOne(Worker &worker, const Run &run, Result &result);
+};
+
+#endif // BATCHRUNNER_H
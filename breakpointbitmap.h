@@ -0,0 +1,73 @@
+#ifndef BREAKPOINTBITMAP_H
+#define BREAKPOINTBITMAP_H
+
+#include <atomic>
+#include <cstdint>
+
+//
+// BreakpointBitmap Class
+//
+// The instruction addresses to break at, one bit per address of the 64K address space (8 KB)
+// It is rebuilt on one thread while a run reads it on another, so the words are atomic; the relaxed loads
+// `contains()` makes cost no more than plain ones
+//
+class BreakpointBitmap
+{
+public:
+    static constexpr int WordCount = 0x10000 / 64;
+
+    BreakpointBitmap()
+    {
+        for (std::atomic<uint64_t> &word : words)
+            word.store(0, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+    }
+
+    bool empty() const { return _count.load(std::memory_order_relaxed) == 0; }
+    int count() const { return _count.load(std::memory_order_relaxed); }
+
+    bool contains(uint16_t address) const
+    {
+        return (words[address >> 6].load(std::memory_order_relaxed) >> (address & 63)) & 1;
+    }
+
+    // whether any address from `lowest` up to but not including `highest` is set
+    bool containsInRange(uint16_t lowest, int highest) const
+    {
+        for (int address = lowest; address < highest; address = (address | 63) + 1)
+        {
+            uint64_t word = words[address >> 6].load(std::memory_order_relaxed) >> (address & 63);
+            int bits = highest - address;
+            if (bits < 64)
+                word &= (uint64_t(1) << bits) - 1;
+            if (word != 0)
+                return true;
+        }
+        return false;
+    }
+
+    // replaces the whole set, writing only the words which change
+    template<class Addresses>
+    void assign(const Addresses &addresses)
+    {
+        uint64_t newWords[WordCount] = {};
+        int count = 0;
+        for (uint16_t address : addresses)
+        {
+            uint64_t bit = uint64_t(1) << (address & 63);
+            if ((newWords[address >> 6] & bit) == 0)
+                count++;
+            newWords[address >> 6] |= bit;
+        }
+        for (int i = 0; i < WordCount; i++)
+            if (words[i].load(std::memory_order_relaxed) != newWords[i])
+                words[i].store(newWords[i], std::memory_order_relaxed);
+        _count.store(count, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> words[WordCount];
+    std::atomic<int> _count;
+};
+
+#endif // BREAKPOINTBITMAP_H
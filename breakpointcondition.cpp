@@ -0,0 +1,84 @@
+#include "breakpointcondition.h"
+
+
+//
+// BreakpointCondition Class
+//
+
+void BreakpointCondition::append(Op op, int operand /*= 0*/)
+{
+    code.push_back({ op, operand });
+    if (op <= PushProgramCounter)
+        depth++;
+    else if (op <= LogicalNot)
+        valid = valid && depth >= 1;
+    else
+    {
+        valid = valid && depth >= 2;
+        depth--;
+    }
+    if (depth > MaxStackDepth)
+        valid = false;
+}
+
+bool BreakpointCondition::holds(const CpuState &state) const
+{
+    // code which does not compile to a single value is never evaluated, the breakpoint just breaks
+    if (!isValid())
+        return true;
+    int stack[MaxStackDepth];
+    int top = -1;
+    for (const Code &instruction : code)
+    {
+        int right;
+        switch (instruction.op)
+        {
+        case PushConstant:          stack[++top] = instruction.operand; continue;
+        case PushAccumulator:       stack[++top] = state.accumulator; continue;
+        case PushXregister:         stack[++top] = state.xregister; continue;
+        case PushYregister:         stack[++top] = state.yregister; continue;
+        case PushStackRegister:     stack[++top] = state.stackRegister; continue;
+        case PushStatusFlags:       stack[++top] = state.statusFlags; continue;
+        case PushProgramCounter:    stack[++top] = state.programCounter; continue;
+
+        case MemoryByte:
+            stack[top] = state.memory[static_cast<uint16_t>(stack[top])];
+            continue;
+        case MemoryWord:
+            stack[top] = state.memory[static_cast<uint16_t>(stack[top])] | (state.memory[static_cast<uint16_t>(stack[top] + 1)] << 8);
+            continue;
+        case UnaryLow:      stack[top] = static_cast<uint8_t>(stack[top]); continue;
+        case UnaryHigh:     stack[top] = static_cast<uint8_t>(stack[top] >> 8); continue;
+        case LogicalNot:    stack[top] = !stack[top]; continue;
+        default: break;
+        }
+
+        right = stack[top--];
+        int &left(stack[top]);
+        // the arithmetic wraps round in 32 bits, as any values can be written; unlike the assembler there is no one
+        // to warn, so division by zero, and a shift by a count outside 0 to 31, give 0
+        const uint32_t leftBits = left, rightBits = right;
+        const bool shiftInRange = right >= 0 && right < 32;
+        switch (instruction.op)
+        {
+        case Multiply:      left = static_cast<int>(leftBits * rightBits); break;
+        case Divide:        left = right == 0 ? 0 : right == -1 ? static_cast<int>(0u - leftBits) : left / right; break;
+        case Plus:          left = static_cast<int>(leftBits + rightBits); break;
+        case Minus:         left = static_cast<int>(leftBits - rightBits); break;
+        case ShiftLeft:     left = shiftInRange ? static_cast<int>(leftBits << right) : 0; break;
+        case ShiftRight:    left = shiftInRange ? left >> right : 0; break;
+        case BitAnd:        left &= right; break;
+        case BitOr:         left |= right; break;
+        case Equal:         left = left == right; break;
+        case NotEqual:      left = left != right; break;
+        case Less:          left = left < right; break;
+        case LessEqual:     left = left <= right; break;
+        case Greater:       left = left > right; break;
+        case GreaterEqual:  left = left >= right; break;
+        case LogicalAnd:    left = left && right; break;
+        case LogicalOr:     left = left || right; break;
+        default: break;
+        }
+    }
+    return stack[top] != 0;
+}
@@ -0,0 +1,56 @@
+#ifndef BREAKPOINTCONDITION_H
+#define BREAKPOINTCONDITION_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cpustate.h"
+
+//
+// BreakpointCondition Class
+//
+// A condition on a breakpoint, such as `X == 0 && (ptr) > $C000`, compiled once (see `Assembler`'s `.break`)
+// to postfix code which `holds()` evaluates against the registers and memory each time the breakpoint is reached
+// Values are ints, as for assembler expressions; comparisons and logical operators give 0 or 1
+//
+class BreakpointCondition
+{
+public:
+    enum Op : uint8_t
+    {
+        PushConstant,
+        PushAccumulator, PushXregister, PushYregister, PushStackRegister, PushStatusFlags, PushProgramCounter,
+        MemoryByte, MemoryWord,
+        UnaryLow, UnaryHigh, LogicalNot,
+        Multiply, Divide, Plus, Minus, ShiftLeft, ShiftRight, BitAnd, BitOr,
+        Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+        LogicalAnd, LogicalOr,
+    };
+    static constexpr int MaxStackDepth = 32;
+
+    BreakpointCondition() { clear(); }
+
+    bool empty() const { return code.empty(); }
+    void clear() { code.clear(); depth = 0; valid = true; }
+    void append(Op op, int operand = 0);
+    // whether the code appended leaves exactly one value, and never needs more than `MaxStackDepth`
+    bool isValid() const { return valid && depth == 1; }
+
+    bool holds(const CpuState &state) const;
+
+private:
+    struct Code
+    {
+        Op op;
+        int operand;
+    };
+    std::vector<Code> code;
+    int depth;
+    bool valid;
+};
+
+// by instruction address; a breakpoint with no entry always breaks
+using BreakpointConditions = std::unordered_map<uint16_t, BreakpointCondition>;
+
+#endif // BREAKPOINTCONDITION_H
@@ -0,0 +1,29 @@
+#ifndef CPUSTATE_H
+#define CPUSTATE_H
+
+#include <cstdint>
+
+//
+// CpuState Struct
+//
+// All the state of one 6502: registers, cycle/instruction counters and the 64K address space
+// Plain data, so instances are cheap to create, copy and compare
+//
+struct alignas(64) CpuState
+{
+    uint8_t accumulator, xregister, yregister;
+    uint8_t stackRegister;
+    uint8_t statusFlags;
+    uint16_t programCounter;
+
+    uint32_t elapsedCycles;         // since start of run or last `__JSR_clear_elapsed_cycles`
+    uint64_t clearedElapsedCycles;  // cycles accumulated by `__JSR_clear_elapsed_cycles`
+    uint64_t instructionCount;      // since start of run
+
+    uint64_t totalElapsedCycles() const { return clearedElapsedCycles + elapsedCycles; }
+
+    static constexpr unsigned int MemorySize = 64 * 1024;
+    alignas(64) uint8_t memory[MemorySize];
+};
+
+#endif // CPUSTATE_H
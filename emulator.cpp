@@ -22,9 +22,11 @@ Emulator::Emulator(QObject *parent)
     _instructions = _processorModel->instructions();
     processorBreakpointProvider = new ProcessorBreakpointProvider(this);
     _processorModel->setProcessorBreakpointProvider(processorBreakpointProvider);
+    _processorModel->core()->setBreakpoints(&breakpointBitmap);
 
     _assembler = new Assembler(this);
     _assembler->setMemory(_memory);
+    _assembler->setBankedMemory(&_processorModel->core()->bankedMemory());
     _assembler->setInstructions(_instructions);
     assemblerBreakpointProvider = new AssemblerBreakpointProvider(this);
     _assembler->setAssemblerBreakpointProvider(assemblerBreakpointProvider);
@@ -107,6 +109,22 @@ void Emulator::insertIntoBreakpoints(const Breakpoint &breakpoint)
     _breakpoints.insert(i, breakpoint);
 }
 
+void Emulator::rebuildBreakpointBitmap()
+{
+    // an instruction address of 0 is a breakpoint not (or no longer) mapped to any instruction
+    QList<uint16_t> instructionAddresses;
+    std::shared_ptr<BreakpointConditions> conditions(new BreakpointConditions);
+    for (const Breakpoint &breakpoint : _breakpoints)
+        if (breakpoint.instructionAddress != 0)
+        {
+            instructionAddresses.append(breakpoint.instructionAddress);
+            if (!breakpoint.condition.empty())
+                conditions->emplace(breakpoint.instructionAddress, breakpoint.condition);
+        }
+    breakpointBitmap.assign(instructionAddresses);
+    _processorModel->core()->setBreakpointConditions(conditions->empty() ? nullptr : std::move(conditions));
+}
+
 const Emulator::Breakpoint *Emulator::findBreakpoint(const QString &filename, int lineNumber) const
 {
     for (const Breakpoint &breakpoint : _breakpoints)
@@ -115,11 +133,18 @@ const Emulator::Breakpoint *Emulator::findBreakpoint(const QString &filename, in
     return nullptr;
 }
 
-void Emulator::addBreakpoint(const QString &filename, int lineNumber)
+void Emulator::addBreakpoint(const QString &filename, int lineNumber, const BreakpointCondition &condition /*= BreakpointCondition()*/)
 {
-    if (findBreakpoint(filename, lineNumber))
-        return;
-    insertIntoBreakpoints(Breakpoint(filename, lineNumber, mapFileLineNumberToInstructionAddress(filename, lineNumber)));
+    // adding again just replaces the condition, as for the assembler's pass 2
+    for (Breakpoint &breakpoint : _breakpoints)
+        if (breakpoint.filename == filename && breakpoint.lineNumber == lineNumber)
+        {
+            breakpoint.condition = condition;
+            rebuildBreakpointBitmap();
+            return;
+        }
+    insertIntoBreakpoints(Breakpoint(filename, lineNumber, mapFileLineNumberToInstructionAddress(filename, lineNumber), condition));
+    rebuildBreakpointBitmap();
     emit breakpointChanged(filename, lineNumber);
 }
 
@@ -134,6 +159,7 @@ void Emulator::toggleBreakpoint(const QString &filename, int lineNumber)
         }
     if (!found)
         insertIntoBreakpoints(Breakpoint(filename, lineNumber, mapFileLineNumberToInstructionAddress(filename, lineNumber)));
+    rebuildBreakpointBitmap();
     emit breakpointChanged(filename, lineNumber);
 }
 
@@ -142,14 +168,19 @@ void Emulator::clearBreakpoints()
     if (!_breakpoints.isEmpty())
     {
         _breakpoints.clear();
+        rebuildBreakpointBitmap();
         emit breakpointChanged("", -1);
     }
 }
 
 bool Emulator::breakpointAtInstructionAddress(uint16_t instructionAddress) const
 {
-    int i = findBreakpointInstructionAddressIndex(instructionAddress);
-    return i < _breakpoints.size() && _breakpoints.at(i).instructionAddress == instructionAddress;
+    return breakpointBitmap.contains(instructionAddress);
+}
+
+bool Emulator::breakpointInInstructionAddressRange(uint16_t lowest, int highest) const
+{
+    return breakpointBitmap.containsInRange(lowest, highest);
 }
 
 QList<int> Emulator::breakpointLineNumbers(const QString &filename) const
@@ -165,6 +196,7 @@ void Emulator::setRuntimeBreakpoints(const QString &filename, const QList<int> &
 {
     if (lineNumbers.isEmpty() && _breakpoints.isEmpty())
         return;
+    QList<Breakpoint> previousBreakpoints(_breakpoints);
     _breakpoints.clear();
     for (int i = 0; i < lineNumbers.size(); i++)
     {
@@ -177,8 +209,16 @@ void Emulator::setRuntimeBreakpoints(const QString &filename, const QList<int> &
         mapInstructionAddressToFileLineNumber(instructionAddress, newFilename, newLineNumber);
         if (newLineNumber >= 0 && newFilename == filename)
             if (!findBreakpoint(filename, newLineNumber))
-                insertIntoBreakpoints(Breakpoint(filename, newLineNumber, instructionAddress));
+            {
+                // a breakpoint kept at the same line keeps its condition
+                BreakpointCondition condition;
+                for (const Breakpoint &breakpoint : previousBreakpoints)
+                    if (breakpoint.filename == filename && breakpoint.lineNumber == newLineNumber)
+                        condition = breakpoint.condition;
+                insertIntoBreakpoints(Breakpoint(filename, newLineNumber, instructionAddress, condition));
+            }
     }
+    rebuildBreakpointBitmap();
     emit breakpointChanged("", -1);
 }
 
@@ -186,6 +226,28 @@ void Emulator::clearBreakpointInstructionAddresses()
 {
     for (Breakpoint &breakpoint : _breakpoints)
         breakpoint.instructionAddress = 0;
+    rebuildBreakpointBitmap();
+}
+
+void Emulator::addWatchpoint(uint16_t lowest, uint16_t highest, uint8_t kinds)
+{
+    ProcessorCore *core = _processorModel->core();
+    const uint8_t stackKinds = ProcessorCore::WatchStackOverflow | ProcessorCore::WatchStackUnderflow;
+    if (kinds & stackKinds)
+        core->setStackWatches(core->stackWatches() | (kinds & stackKinds));
+    if (kinds & ~stackKinds)
+    {
+        std::vector<ProcessorCore::Watchpoint> watchpoints(core->watchpoints());
+        watchpoints.push_back({ lowest, highest, static_cast<uint8_t>(kinds & ~stackKinds) });
+        core->setWatchpoints(watchpoints);
+    }
+}
+
+void Emulator::clearWatchpoints()
+{
+    ProcessorCore *core = _processorModel->core();
+    core->setWatchpoints({});
+    core->setStackWatches(0);
 }
 
 
@@ -204,6 +266,18 @@ void Emulator::startProfiling()
     _processorModel->startProfiling();
 }
 
+TraceFormatter::Symbols Emulator::traceSymbols() const
+{
+    // the labels profiling goes by, which name code rather than data
+    TraceFormatter::Symbols symbols;
+    QStringList allScopeLabels = assembler()->allScopeLabels();
+    const QMap<QString, Assembler::ExpressionValue> &labelValues(assembler()->codeLabels().values);
+    for (auto it = labelValues.constBegin(); it != labelValues.constEnd(); ++it)
+        if ((it.key().contains('.') || allScopeLabels.contains(it.key())) && it.value().isValid())
+            symbols.emplace(static_cast<uint16_t>(it.value().intValue), it.key().toStdString());
+    return symbols;
+}
+
 void Emulator::getProfilingStatistics(QList<ProfilingLabelHitCount> &labelHitCounts)
 {
     labelHitCounts.clear();
@@ -350,23 +424,33 @@ void AssemblerBreakpointProvider::clearBreakpoints() /*override*/
     _emulator->clearBreakpoints();
 }
 
-void AssemblerBreakpointProvider::addBreakpoint(const QString &filename, int lineNumber) /*override*/
+void AssemblerBreakpointProvider::addBreakpoint(const QString &filename, int lineNumber, const BreakpointCondition &condition) /*override*/
 {
-    _emulator->addBreakpoint(filename, lineNumber);
+    _emulator->addBreakpoint(filename, lineNumber, condition);
+}
+
+void AssemblerBreakpointProvider::clearWatchpoints() /*override*/
+{
+    _emulator->clearWatchpoints();
+}
+
+void AssemblerBreakpointProvider::addWatchpoint(uint16_t lowest, uint16_t highest, uint8_t kinds) /*override*/
+{
+    _emulator->addWatchpoint(lowest, highest, kinds);
 }
 
 
 //
 // ProcessorBreakpointProvider Class
 //
-bool ProcessorBreakpointProvider::breakpointAt(uint16_t instructionAddress) const /*override*/
+uint16_t ProcessorBreakpointProvider::lastInstructionAddressAtSameFileLineNumber(uint16_t instructionAddress) const
 {
-    return _emulator->breakpointAtInstructionAddress(instructionAddress) != 0;
+    return _emulator->lastInstructionAddressAtSameFileLineNumber(instructionAddress);
 }
 
-uint16_t ProcessorBreakpointProvider::lastInstructionAddressAtSameFileLineNumber(uint16_t instructionAddress) const
+TraceFormatter::Symbols ProcessorBreakpointProvider::traceSymbols() const
 {
-    return _emulator->lastInstructionAddressAtSameFileLineNumber(instructionAddress);
+    return _emulator->traceSymbols();
 }
 
 
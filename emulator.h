@@ -28,13 +28,15 @@ public:
         QString filename;
         int lineNumber = -1;
         uint16_t instructionAddress = 0;
+        BreakpointCondition condition;     // empty for always
 
         Breakpoint() {}
-        Breakpoint(const QString &_filename, int _lineNumber, uint16_t _instructionAddress)
+        Breakpoint(const QString &_filename, int _lineNumber, uint16_t _instructionAddress, const BreakpointCondition &_condition = BreakpointCondition())
         {
             filename = _filename;
             lineNumber = _lineNumber;
             instructionAddress = _instructionAddress;
+            condition = _condition;
         }
     };
 
@@ -48,14 +50,18 @@ public:
     uint16_t lastInstructionAddressAtSameFileLineNumber(uint16_t instructionAddress) const;
 
     const Breakpoint *findBreakpoint(const QString &filename, int lineNumber) const;
-    void addBreakpoint(const QString &filename, int lineNumber);
+    void addBreakpoint(const QString &filename, int lineNumber, const BreakpointCondition &condition = BreakpointCondition());
     void toggleBreakpoint(const QString &filename, int lineNumber);
     void clearBreakpoints();
     bool breakpointAtInstructionAddress(uint16_t instructionAddress) const;
+    bool breakpointInInstructionAddressRange(uint16_t lowest, int highest) const;
     QList<int> breakpointLineNumbers(const QString &filename) const;
     void setRuntimeBreakpoints(const QString &filename, const QList<int> &lineNumbers);
     void clearBreakpointInstructionAddresses();
 
+    void addWatchpoint(uint16_t lowest, uint16_t highest, uint8_t kinds);
+    void clearWatchpoints();
+
     struct ProfilingLabelHitCount
     {
         uint16_t address;
@@ -68,6 +74,8 @@ public:
     void startProfiling();
     void getProfilingStatistics(QList<ProfilingLabelHitCount> &labelHitCounts);
 
+    TraceFormatter::Symbols traceSymbols() const;
+
     QList<int> foldableBlocks(const QString &filename) const;
 
 signals:
@@ -76,6 +84,7 @@ signals:
 private:
     int findBreakpointInstructionAddressIndex(uint16_t instructionAddress) const;
     void insertIntoBreakpoints(const Breakpoint &breakpoint);
+    void rebuildBreakpointBitmap();
 
 public:
     QString wordCompletion(const QString &word) const;
@@ -86,6 +95,7 @@ private:
     uint8_t *_memory;
     Instruction *_instructions;
     QList<Breakpoint> _breakpoints;
+    BreakpointBitmap breakpointBitmap;  // `_breakpoints`' instruction addresses, as tested by the core while running
     IProcessorBreakpointProvider *processorBreakpointProvider;
 
     Assembler *_assembler;
@@ -109,7 +119,9 @@ private:
     Emulator *_emulator;
     Emulator *emulator() const { return _emulator; }
     void clearBreakpoints() override;
-    void addBreakpoint(const QString &filename, int lineNumber) override;
+    void addBreakpoint(const QString &filename, int lineNumber, const BreakpointCondition &condition) override;
+    void clearWatchpoints() override;
+    void addWatchpoint(uint16_t lowest, uint16_t highest, uint8_t kinds) override;
 };
 
 
@@ -124,8 +136,8 @@ public:
 private:
     Emulator *_emulator;
     Emulator *emulator() const { return _emulator; }
-    bool breakpointAt(uint16_t instructionAddress) const override;
     uint16_t lastInstructionAddressAtSameFileLineNumber(uint16_t instructionAddress) const override;
+    TraceFormatter::Symbols traceSymbols() const override;
 };
 
 
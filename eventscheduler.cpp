@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "eventscheduler.h"
+
+
+//
+// EventScheduler Class
+//
+
+EventScheduler::EventScheduler()
+{
+    nextSequence = 1;
+    scheduledCount = 0;
+    _nextEventCycle = NoEvent;
+}
+
+int EventScheduler::addEvent(EventHandler handler)
+{
+    events.push_back(Event{ std::move(handler), NoEvent, 0 });
+    return static_cast<int>(events.size()) - 1;
+}
+
+void EventScheduler::schedule(int event, uint64_t cycle)
+{
+    Event &scheduling(events[event]);
+    if (scheduling.sequence == 0)
+        scheduledCount++;
+    scheduling.cycle = cycle;
+    scheduling.sequence = nextSequence++;
+
+    // rebuilt without the stale entries once they are the most of it, so rescheduling does not grow it without end
+    if (heap.size() >= 32 && heap.size() > 2 * static_cast<size_t>(scheduledCount))
+    {
+        heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Entry &entry) { return stale(entry); }), heap.end());
+        std::make_heap(heap.begin(), heap.end());
+    }
+    heap.push_back(Entry{ cycle, scheduling.sequence, event });
+    std::push_heap(heap.begin(), heap.end());
+    dropStaleTop();
+}
+
+void EventScheduler::cancel(int event)
+{
+    if (events[event].sequence == 0)
+        return;
+    events[event].sequence = 0;
+    scheduledCount--;
+    dropStaleTop();
+}
+
+void EventScheduler::clear()
+{
+    for (Event &event : events)
+        event.sequence = 0;
+    heap.clear();
+    scheduledCount = 0;
+    _nextEventCycle = NoEvent;
+}
+
+std::vector<EventScheduler::ScheduledEvent> EventScheduler::schedule() const
+{
+    std::vector<ScheduledEvent> schedule;
+    schedule.reserve(events.size());
+    for (const Event &event : events)
+        schedule.push_back(ScheduledEvent{ event.cycle, event.sequence });
+    return schedule;
+}
+
+void EventScheduler::setSchedule(const std::vector<ScheduledEvent> &schedule)
+{
+    // the sequences go on from the schedule's, so events scheduled from now on come after those at the same cycle
+    heap.clear();
+    scheduledCount = 0;
+    for (size_t event = 0; event < events.size(); event++)
+    {
+        const ScheduledEvent scheduling(event < schedule.size() ? schedule[event] : ScheduledEvent{ NoEvent, 0 });
+        events[event].cycle = scheduling.cycle;
+        events[event].sequence = scheduling.sequence;
+        if (scheduling.sequence == 0)
+            continue;
+        heap.push_back(Entry{ scheduling.cycle, scheduling.sequence, static_cast<int>(event) });
+        nextSequence = std::max(nextSequence, scheduling.sequence + 1);
+        scheduledCount++;
+    }
+    std::make_heap(heap.begin(), heap.end());
+    dropStaleTop();
+}
+
+void EventScheduler::runDue(uint64_t cycle)
+{
+    while (_nextEventCycle <= cycle)
+    {
+        const int event = heap.front().event;
+        events[event].sequence = 0;
+        scheduledCount--;
+        popHeap();
+        dropStaleTop();
+        events[event].handler();
+    }
+}
+
+void EventScheduler::popHeap()
+{
+    std::pop_heap(heap.begin(), heap.end());
+    heap.pop_back();
+}
+
+void EventScheduler::dropStaleTop()
+{
+    while (!heap.empty() && stale(heap.front()))
+        popHeap();
+    _nextEventCycle = heap.empty() ? NoEvent : heap.front().cycle;
+}
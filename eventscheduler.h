@@ -0,0 +1,82 @@
+#ifndef EVENTSCHEDULER_H
+#define EVENTSCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//
+// EventScheduler Class
+//
+// Events at given cycles of a `ProcessorCore`'s run (its `totalElapsedCycles()`), for devices such as timers
+// They are kept in a min-heap keyed on the cycle, so the execution loops need only compare the cycle count with
+// `nextEventCycle()` to know whether one is due
+// An event is added once, with its handler, then scheduled, moved and cancelled any number of times; it is scheduled
+// at most once at a time, and its handler may schedule it again
+// Moved and cancelled events' heap entries are left where they are, stale, and dropped as they come to the top
+// A save state keeps the `schedule()`, the events' cycles and order, and not the handlers, which stay as added
+//
+class EventScheduler
+{
+public:
+    using EventHandler = std::function<void()>;
+    static constexpr uint64_t NoEvent = UINT64_MAX;
+    // an event's place in the schedule; `sequence` 0 when not scheduled
+    struct ScheduledEvent
+    {
+        uint64_t cycle;
+        uint64_t sequence;
+    };
+
+    EventScheduler();
+
+    // returns the event's id, for `schedule()` and `cancel()`
+    int addEvent(EventHandler handler);
+    void schedule(int event, uint64_t cycle);
+    void cancel(int event);
+    bool scheduled(int event) const { return events[event].sequence != 0; }
+    uint64_t scheduledCycle(int event) const { return scheduled(event) ? events[event].cycle : NoEvent; }
+    // cancels every event, keeping them added
+    void clear();
+    // by event id; events added since the schedule was taken are cancelled
+    std::vector<ScheduledEvent> schedule() const;
+    void setSchedule(const std::vector<ScheduledEvent> &schedule);
+
+    // `NoEvent` for none; by reference, for compiled code to test
+    const uint64_t &nextEventCycle() const { return _nextEventCycle; }
+    bool empty() const { return _nextEventCycle == NoEvent; }
+    // runs the handlers of the events due by `cycle`, in cycle order, those at the same cycle in the order scheduled
+    void runDue(uint64_t cycle);
+
+private:
+    struct Event
+    {
+        EventHandler handler;
+        uint64_t cycle;
+        uint64_t sequence;      // of the live heap entry; 0 when not scheduled
+    };
+    struct Entry
+    {
+        uint64_t cycle;
+        uint64_t sequence;
+        int event;
+
+        // for `std::push_heap()`, which keeps the greatest at the top
+        bool operator<(const Entry &other) const
+        {
+            return cycle != other.cycle ? cycle > other.cycle : sequence > other.sequence;
+        }
+    };
+
+    std::vector<Event> events;
+    std::vector<Entry> heap;
+    uint64_t nextSequence;
+    int scheduledCount;
+    uint64_t _nextEventCycle;
+
+    bool stale(const Entry &entry) const { return events[entry.event].sequence != entry.sequence; }
+    void popHeap();
+    void dropStaleTop();
+};
+
+#endif // EVENTSCHEDULER_H
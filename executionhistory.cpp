@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <limits>
+
+#include "executionhistory.h"
+
+
+//
+// ExecutionHistory Class
+//
+
+ExecutionHistory::ExecutionHistory(ProcessorCore *core)
+{
+    _core = core;
+    realHost = nullptr;
+    _checkpointInterval = 10000;
+    _maxCheckpoints = 100;
+    _maxJournalWrites = 0x40000;
+    _recording = replaying = false;
+    nextCheckpoint = std::numeric_limits<uint64_t>::max();
+    writesNext = writesCount = 0;
+    inputsFirst = nextInput = 0;
+}
+
+ExecutionHistory::~ExecutionHistory()
+{
+    stopRecording();
+}
+
+void ExecutionHistory::setMaxJournalWrites(size_t writes)
+{
+    _maxJournalWrites = std::max<size_t>(writes, 1);
+    if (_recording)
+    {
+        this->writes.assign(_maxJournalWrites, JournalWrite());
+        writesNext = writesCount = 0;
+    }
+}
+
+void ExecutionHistory::startRecording(const FileState &file)
+{
+    stopRecording();
+    realHost = _core->host();
+    _core->setHost(this);
+    _core->setHistory(this);
+    _recording = true;
+    writes.assign(_maxJournalWrites, JournalWrite());
+    writesNext = writesCount = 0;
+    inputsFirst = nextInput = 0;
+    this->file = file;
+    checkpoint();
+}
+
+void ExecutionHistory::stopRecording()
+{
+    if (!_recording)
+        return;
+    _core->setHost(realHost);
+    _core->setHistory(nullptr);
+    _recording = false;
+    nextCheckpoint = std::numeric_limits<uint64_t>::max();
+    checkpoints.clear();
+    writes.clear();
+    writes.shrink_to_fit();
+    writesNext = writesCount = 0;
+    inputs.clear();
+}
+
+void ExecutionHistory::externalChange()
+{
+    if (!_recording)
+        return;
+    // the change's own writes are stamped with the instruction not yet executed, and are not its
+    const uint64_t now = _core->instructionCount();
+    while (writesCount > 0 && writes[(writesNext + writes.size() - 1) % writes.size()].instruction >= now)
+    {
+        writesNext = (writesNext + writes.size() - 1) % writes.size();
+        writesCount--;
+    }
+    checkpoint();
+}
+
+uint64_t ExecutionHistory::earliestInstruction() const
+{
+    return checkpoints.empty() ? _core->instructionCount() : checkpoints.front().instruction;
+}
+
+bool ExecutionHistory::travelTo(uint64_t instruction)
+{
+    if (!_recording || instruction < earliestInstruction() || instruction > _core->instructionCount())
+        return false;
+    size_t index = checkpoints.size() - 1;
+    while (checkpoints[index].instruction > instruction)
+        index--;
+    restoreCheckpoint(checkpoints[index]);
+    replayTo(instruction, []() {});
+    forgetAfter(index, instruction);
+    return true;
+}
+
+bool ExecutionHistory::reverseContinue()
+{
+    if (!canGoBack())
+        return false;
+    // replays each checkpoint's stretch, latest first, for the last breakpoint hit in it
+    const uint64_t now = _core->instructionCount();
+    for (size_t index = checkpoints.size(); index-- > 0; )
+    {
+        const uint64_t end = index + 1 < checkpoints.size() ? std::min(checkpoints[index + 1].instruction, now) : now;
+        if (checkpoints[index].instruction >= end)
+            continue;
+        restoreCheckpoint(checkpoints[index]);
+        uint64_t hit = end;
+        replayTo(end, [this, &hit]() {
+            if (_core->breakpointHitAt(_core->programCounter()))
+                hit = _core->instructionCount();
+        });
+        if (hit < end)
+            return travelTo(hit);
+    }
+    return travelTo(earliestInstruction());
+}
+
+const ExecutionHistory::JournalWrite *ExecutionHistory::lastWriteTo(uint16_t address) const
+{
+    const uint64_t earliest = earliestInstruction();
+    for (size_t i = 1; i <= writesCount; i++)
+    {
+        const JournalWrite &write(writes[(writesNext + writes.size() - i) % writes.size()]);
+        if (write.instruction < earliest)
+            break;
+        if (write.address == address)
+            return &write;
+    }
+    return nullptr;
+}
+
+void ExecutionHistory::checkpoint()
+{
+    Checkpoint checkpoint{ _core->saveState(), _core->instructionCount(), nextInput, file };
+    if (!checkpoints.empty() && checkpoints.back().instruction == checkpoint.instruction)
+        checkpoints.back() = checkpoint;
+    else
+        checkpoints.push_back(checkpoint);
+    while (checkpoints.size() > static_cast<size_t>(std::max(_maxCheckpoints, 1)))
+    {
+        checkpoints.pop_front();
+        for (; inputsFirst < checkpoints.front().input; inputsFirst++)
+            inputs.pop_front();
+    }
+    nextCheckpoint = checkpoint.instruction + std::max(_checkpointInterval, 1);
+}
+
+void ExecutionHistory::journalWrite(uint64_t instruction, uint16_t address, uint8_t oldValue)
+{
+    writes[writesNext] = JournalWrite{ instruction, address, oldValue };
+    writesNext = (writesNext + 1) % writes.size();
+    if (writesCount < writes.size())
+        writesCount++;
+}
+
+void ExecutionHistory::journalInput(char ch, bool ok)
+{
+    inputs.push_back(Input{ ch, ok });
+    nextInput++;
+}
+
+ExecutionHistory::Input ExecutionHistory::replayInput()
+{
+    if (nextInput - inputsFirst >= inputs.size())
+        return Input{ '\0', false };
+    return inputs[nextInput++ - inputsFirst];
+}
+
+void ExecutionHistory::restoreCheckpoint(const Checkpoint &checkpoint)
+{
+    _core->restoreState(checkpoint.state);
+    nextInput = checkpoint.input;
+    file = checkpoint.file;
+}
+
+template<class Visitor>
+void ExecutionHistory::replayTo(uint64_t instruction, Visitor &&visitor)
+{
+    // the recorded run executed all of these without an `ExecutionError`, so re-executing them does too
+    const bool stopped = _core->stopped();
+    replaying = true;
+    while (_core->instructionCount() < instruction)
+    {
+        visitor();
+        _core->step();
+    }
+    replaying = false;
+    _core->setStopped(stopped);
+    _core->clearWatchHit();
+}
+
+void ExecutionHistory::forgetAfter(size_t checkpointIndex, uint64_t instruction)
+{
+    checkpoints.erase(checkpoints.begin() + checkpointIndex + 1, checkpoints.end());
+    while (writesCount > 0 && writes[(writesNext + writes.size() - 1) % writes.size()].instruction >= instruction)
+    {
+        writesNext = (writesNext + writes.size() - 1) % writes.size();
+        writesCount--;
+    }
+    inputs.resize(nextInput - inputsFirst);
+    nextCheckpoint = checkpoints.back().instruction + std::max(_checkpointInterval, 1);
+}
+
+
+/*override*/ void ExecutionHistory::sendMessage(const char *message, int len)
+{
+    if (!replaying && realHost != nullptr)
+        realHost->sendMessage(message, len);
+}
+
+/*override*/ void ExecutionHistory::outputChar(char ch)
+{
+    if (!replaying && realHost != nullptr)
+        realHost->outputChar(ch);
+}
+
+/*override*/ void ExecutionHistory::outputString(const char *str, int len)
+{
+    if (!replaying && realHost != nullptr)
+        realHost->outputString(str, len);
+}
+
+/*override*/ char ExecutionHistory::inputChar(int timeout, bool justWait)
+{
+    if (replaying)
+        return replayInput().ch;
+    char ch = realHost != nullptr ? realHost->inputChar(timeout, justWait) : '\0';
+    journalInput(ch, true);
+    return ch;
+}
+
+/*override*/ void ExecutionHistory::processEvents()
+{
+    if (!replaying && realHost != nullptr)
+        realHost->processEvents();
+}
+
+/*override*/ void ExecutionHistory::openFile(const char *filename)
+{
+    if (!replaying && realHost != nullptr)
+        realHost->openFile(filename);
+    file.name = filename;
+    file.open = true;
+    file.position = 0;
+}
+
+/*override*/ void ExecutionHistory::closeFile()
+{
+    if (!replaying && realHost != nullptr)
+        realHost->closeFile();
+    file.open = false;
+    file.position = 0;
+}
+
+/*override*/ void ExecutionHistory::rewindFile()
+{
+    if (!replaying && realHost != nullptr)
+        realHost->rewindFile();
+    file.position = 0;
+}
+
+/*override*/ bool ExecutionHistory::readFile(char &ch)
+{
+    bool ok;
+    if (replaying)
+    {
+        Input input(replayInput());
+        ch = input.ch;
+        ok = input.ok;
+    }
+    else
+    {
+        ch = '\0';
+        ok = realHost != nullptr && realHost->readFile(ch);
+        journalInput(ch, ok);
+    }
+    if (ok)
+        file.position++;
+    return ok;
+}
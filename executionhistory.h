@@ -0,0 +1,133 @@
+#ifndef EXECUTIONHISTORY_H
+#define EXECUTIONHISTORY_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "processorcore.h"
+
+//
+// ExecutionHistory Class
+//
+// Reverse execution for a `ProcessorCore`, run a step or basic block at a time with `UiObserver`
+// While recording it takes a save state (a checkpoint) every `checkpointInterval()` instructions, journals every
+// memory write with the value it overwrote, and stands in as the core's host, passing everything on to the real
+// host and journaling what the program is given (console input, file reads)
+// Going back to an instruction restores the checkpoint before it and re-executes up to it, with the program's input
+// taken from the journal and its output dropped; the history after it is then forgotten, as execution goes on from there
+// The history is bounded: the oldest checkpoint and its input are dropped beyond `maxCheckpoints()`, the oldest
+// journaled writes beyond `maxJournalWrites()`
+// The checkpoints keep the events, interrupt lines and host devices, and while recording the core's basic blocks stop
+// where an event falls due, so interrupts come at just the instructions they came at before
+// Neither the clock nor the state of any other `IMemoryDevice`s is journaled
+//
+class ExecutionHistory : public IProcessorCoreHost
+{
+public:
+    struct JournalWrite
+    {
+        uint64_t instruction;   // the count of the instruction which wrote, as `ProcessorCore::currentInstructionIndex()`
+        uint16_t address;
+        uint8_t oldValue;
+    };
+    struct FileState
+    {
+        std::string name;
+        bool open = false;
+        int64_t position = 0;
+    };
+
+    explicit ExecutionHistory(ProcessorCore *core);
+    ~ExecutionHistory();
+
+    int checkpointInterval() const { return _checkpointInterval; }
+    void setCheckpointInterval(int instructions) { _checkpointInterval = instructions; }
+    int maxCheckpoints() const { return _maxCheckpoints; }
+    void setMaxCheckpoints(int checkpoints) { _maxCheckpoints = checkpoints; }
+    size_t maxJournalWrites() const { return _maxJournalWrites; }
+    void setMaxJournalWrites(size_t writes);
+
+    bool recording() const { return _recording; }
+    // starts a new history from the core's state now, with the user file as `file`
+    void startRecording(const FileState &file);
+    void stopRecording();
+
+    // to be called after each `step()`/`runBasicBlock()`; just the one test when not recording
+    void executed() { if (_core->instructionCount() >= nextCheckpoint) checkpoint(); }
+    // registers or memory have been changed other than by execution; the history goes on from the state as it now is
+    void externalChange();
+
+    uint64_t earliestInstruction() const;
+    bool canGoBack() const { return _recording && _core->instructionCount() > earliestInstruction(); }
+    // these return false, leaving the core as it was, when the history does not go back far enough
+    bool travelTo(uint64_t instruction);
+    bool stepBack() { return canGoBack() && travelTo(_core->instructionCount() - 1); }
+    // back to the last instruction before now at a breakpoint whose condition holds, else as far back as there is
+    bool reverseContinue();
+    // the last journaled write to `address` before now, nullptr for none
+    const JournalWrite *lastWriteTo(uint16_t address) const;
+
+    // the user file as the program left it, after a travel the host must reopen it to match
+    const FileState &fileState() const { return file; }
+
+    // `ProcessorCore`'s hook, before each write
+    void memoryWritten(uint64_t instruction, uint16_t address, uint8_t oldValue)
+    {
+        if (!replaying)
+            journalWrite(instruction, address, oldValue);
+    }
+
+    // IProcessorCoreHost interface: to the real host while recording, from the journal while replaying
+    void sendMessage(const char *message, int len) override;
+    void outputChar(char ch) override;
+    void outputString(const char *str, int len) override;
+    char inputChar(int timeout, bool justWait) override;
+    void processEvents() override;
+    void openFile(const char *filename) override;
+    void closeFile() override;
+    void rewindFile() override;
+    bool readFile(char &ch) override;
+
+private:
+    struct Checkpoint
+    {
+        std::shared_ptr<const ProcessorCore::SaveState> state;
+        uint64_t instruction;
+        uint64_t input;         // the sequence number of the next input
+        FileState file;
+    };
+    struct Input
+    {
+        char ch;
+        bool ok;                // `readFile()`'s result
+    };
+
+    ProcessorCore *_core;
+    IProcessorCoreHost *realHost;
+    int _checkpointInterval;
+    int _maxCheckpoints;
+    size_t _maxJournalWrites;
+    bool _recording;
+    bool replaying;
+    uint64_t nextCheckpoint;
+    std::deque<Checkpoint> checkpoints;
+    std::vector<JournalWrite> writes;   // a ring of the last `_maxJournalWrites`
+    size_t writesNext, writesCount;
+    std::deque<Input> inputs;
+    uint64_t inputsFirst;               // the sequence number of `inputs.front()`
+    uint64_t nextInput;
+    FileState file;
+
+    void checkpoint();
+    void journalWrite(uint64_t instruction, uint16_t address, uint8_t oldValue);
+    void journalInput(char ch, bool ok);
+    Input replayInput();
+    void restoreCheckpoint(const Checkpoint &checkpoint);
+    template<class Visitor> void replayTo(uint64_t instruction, Visitor &&visitor);
+    void forgetAfter(size_t checkpointIndex, uint64_t instruction);
+};
+
+#endif // EXECUTIONHISTORY_H
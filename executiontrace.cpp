@@ -0,0 +1,252 @@
+#include <cstdio>
+#include <cstring>
+
+#include "executiontrace.h"
+
+using AddressingMode = InstructionSet::AddressingMode;
+using InstructionInfo = InstructionSet::InstructionInfo;
+
+// the bytes of operand the trace stream keeps for `opcode`
+static int operandBytes(uint8_t opcode)
+{
+    const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(opcode));
+    return instructionInfo.bytes > 1 ? instructionInfo.bytes - 1 : 0;
+}
+
+
+//
+// TraceWriter Class
+//
+
+TraceWriter::TraceWriter(std::ostream &out, int startAddress /*= -1*/, int stopAddress /*= -1*/)
+    : out(out)
+{
+    _startAddress = startAddress;
+    _stopAddress = stopAddress;
+    _tracing = _startAddress < 0;
+    _recordCount = 0;
+    std::memset(&previous, 0, sizeof(previous));
+    nextProgramCounter = 0;
+    out.write(Magic, sizeof(Magic));
+}
+
+void TraceWriter::record(const TraceRecord &record)
+{
+    if (_tracing)
+    {
+        if (record.programCounter == _stopAddress)
+        {
+            _tracing = false;
+            return;
+        }
+        uint8_t fields = 0;
+        if (record.programCounter != nextProgramCounter)
+            fields |= ProgramCounter;
+        if (record.accumulator != previous.accumulator)
+            fields |= Accumulator;
+        if (record.xregister != previous.xregister)
+            fields |= XRegister;
+        if (record.yregister != previous.yregister)
+            fields |= YRegister;
+        if (record.statusFlags != previous.statusFlags)
+            fields |= StatusFlags;
+        if (record.stackRegister != previous.stackRegister)
+            fields |= StackRegister;
+        if (record.cycles - previous.cycles > 0xff)
+            fields |= Cycles;
+        write(record, fields);
+    }
+    else if (record.programCounter == _startAddress)
+    {
+        _tracing = true;
+        write(record, 0xff);
+    }
+}
+
+void TraceWriter::write(const TraceRecord &record, uint8_t fields)
+{
+    uint8_t bytes[16];
+    int length = 0;
+    bytes[length++] = fields;
+    if (fields & ProgramCounter)
+    {
+        bytes[length++] = static_cast<uint8_t>(record.programCounter);
+        bytes[length++] = static_cast<uint8_t>(record.programCounter >> 8);
+    }
+    bytes[length++] = record.opcode;
+    const int operandLength = operandBytes(record.opcode);
+    for (int i = 0; i < operandLength; i++)
+        bytes[length++] = static_cast<uint8_t>(record.operand >> (8 * i));
+    if (fields & Accumulator)
+        bytes[length++] = record.accumulator;
+    if (fields & XRegister)
+        bytes[length++] = record.xregister;
+    if (fields & YRegister)
+        bytes[length++] = record.yregister;
+    if (fields & StatusFlags)
+        bytes[length++] = record.statusFlags;
+    if (fields & StackRegister)
+        bytes[length++] = record.stackRegister;
+    if (fields & Cycles)
+        for (int i = 0; i < 4; i++)
+            bytes[length++] = static_cast<uint8_t>(record.cycles >> (8 * i));
+    else
+        bytes[length++] = static_cast<uint8_t>(record.cycles - previous.cycles);
+    out.write(reinterpret_cast<const char *>(bytes), length);
+
+    previous = record;
+    nextProgramCounter = record.programCounter + 1 + operandLength;
+    _recordCount++;
+}
+
+
+//
+// TraceReader Class
+//
+
+TraceReader::TraceReader(std::istream &in)
+    : in(in)
+{
+    char magic[sizeof(TraceWriter::Magic)];
+    _valid = in.read(magic, sizeof(magic)) && std::memcmp(magic, TraceWriter::Magic, sizeof(magic)) == 0;
+    _started = false;
+    std::memset(&previous, 0, sizeof(previous));
+    nextProgramCounter = 0;
+    chunk.resize(ChunkSize + MaxRecordSize);
+    chunkNext = chunkEnd = 0;
+}
+
+bool TraceReader::fillChunk()
+{
+    // keeps what is left of the last chunk, so no record is split between chunks, and zeroes a record's worth past
+    // the end, so a record cut short decodes without reading beyond it
+    std::memmove(chunk.data(), chunk.data() + chunkNext, chunkEnd - chunkNext);
+    chunkEnd -= chunkNext;
+    chunkNext = 0;
+    if (in)
+    {
+        in.read(reinterpret_cast<char *>(chunk.data() + chunkEnd), ChunkSize - chunkEnd);
+        chunkEnd += in.gcount();
+    }
+    std::memset(chunk.data() + chunkEnd, 0, MaxRecordSize);
+    return chunkEnd > 0;
+}
+
+bool TraceReader::read(TraceRecord &record)
+{
+    if (!_valid)
+        return false;
+    if (chunkEnd - chunkNext < MaxRecordSize && !fillChunk())
+        return false;
+    const uint8_t *bytes = chunk.data() + chunkNext;
+    auto readByte = [&bytes]() { return *bytes++; };
+    const int fields = readByte();
+    record = previous;
+    if (fields & TraceWriter::ProgramCounter)
+    {
+        record.programCounter = readByte();
+        record.programCounter |= readByte() << 8;
+    }
+    else
+        record.programCounter = nextProgramCounter;
+    record.opcode = readByte();
+    record.operand = 0;
+    const int operandLength = operandBytes(record.opcode);
+    for (int i = 0; i < operandLength; i++)
+        record.operand |= readByte() << (8 * i);
+    if (fields & TraceWriter::Accumulator)
+        record.accumulator = readByte();
+    if (fields & TraceWriter::XRegister)
+        record.xregister = readByte();
+    if (fields & TraceWriter::YRegister)
+        record.yregister = readByte();
+    if (fields & TraceWriter::StatusFlags)
+        record.statusFlags = readByte();
+    if (fields & TraceWriter::StackRegister)
+        record.stackRegister = readByte();
+    if (fields & TraceWriter::Cycles)
+    {
+        record.cycles = 0;
+        for (int i = 0; i < 4; i++)
+            record.cycles |= static_cast<uint32_t>(readByte()) << (8 * i);
+    }
+    else
+        record.cycles = previous.cycles + readByte();
+    // a record cut short is the end of a trace whose writer did not finish
+    if (bytes > chunk.data() + chunkEnd)
+    {
+        chunkNext = chunkEnd;
+        return false;
+    }
+    chunkNext = bytes - chunk.data();
+
+    _started = (fields & TraceWriter::Start) != 0;
+    previous = record;
+    nextProgramCounter = record.programCounter + 1 + operandLength;
+    return true;
+}
+
+
+//
+// TraceFormatter Class
+//
+
+std::string TraceFormatter::symbolize(uint16_t address) const
+{
+    Symbols::const_iterator it = symbols.upper_bound(address);
+    if (it == symbols.begin())
+        return std::string();
+    --it;
+    if (it->first == address)
+        return it->second;
+    return it->second + "+" + std::to_string(address - it->first);
+}
+
+std::string TraceFormatter::format(const TraceRecord &record) const
+{
+    const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(record.opcode));
+    const uint8_t byte = static_cast<uint8_t>(record.operand);
+    const uint16_t word = record.operand;
+    char operand[32];
+    int target = -1;
+    switch (instructionInfo.isValid() ? instructionInfo.addrMode : AddressingMode::Implied)
+    {
+    case AddressingMode::Accumulator: std::snprintf(operand, sizeof(operand), "A"); break;
+    case AddressingMode::Immediate: std::snprintf(operand, sizeof(operand), "#$%02X", byte); break;
+    case AddressingMode::ZeroPage: std::snprintf(operand, sizeof(operand), "$%02X", byte); break;
+    case AddressingMode::ZeroPageX: std::snprintf(operand, sizeof(operand), "$%02X,X", byte); break;
+    case AddressingMode::ZeroPageY: std::snprintf(operand, sizeof(operand), "$%02X,Y", byte); break;
+    case AddressingMode::Relative:
+        target = static_cast<uint16_t>(record.programCounter + 2 + static_cast<int8_t>(byte));
+        std::snprintf(operand, sizeof(operand), "$%04X", target);
+        break;
+    case AddressingMode::Absolute: target = word; std::snprintf(operand, sizeof(operand), "$%04X", word); break;
+    case AddressingMode::AbsoluteX: std::snprintf(operand, sizeof(operand), "$%04X,X", word); break;
+    case AddressingMode::AbsoluteY: std::snprintf(operand, sizeof(operand), "$%04X,Y", word); break;
+    case AddressingMode::Indirect: std::snprintf(operand, sizeof(operand), "($%04X)", word); break;
+    case AddressingMode::IndexedIndirectX: std::snprintf(operand, sizeof(operand), "($%02X,X)", byte); break;
+    case AddressingMode::IndirectIndexedY: std::snprintf(operand, sizeof(operand), "($%02X),Y", byte); break;
+    default: operand[0] = '\0'; break;
+    }
+    std::string instruction(instructionInfo.isValid() ? InstructionSet::operationName(instructionInfo.operation) : "???");
+    if (operand[0] != '\0')
+        instruction += std::string(" ") + operand;
+    if (target >= 0)
+    {
+        Symbols::const_iterator it = symbols.find(target);
+        if (it != symbols.end())
+            instruction += " <" + it->second + ">";
+    }
+
+    static const char flagNames[] = "NV-BDIZC";
+    char flags[9];
+    for (int bit = 0; bit < 8; bit++)
+        flags[bit] = (record.statusFlags & (0x80 >> bit)) ? flagNames[bit] : flagNames[bit] == '-' ? '-' : flagNames[bit] + ('a' - 'A');
+    flags[8] = '\0';
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "%10u  %04X  %-20s %-24s A=%02X X=%02X Y=%02X S=%02X P=%s",
+                  record.cycles, record.programCounter, symbolize(record.programCounter).c_str(), instruction.c_str(),
+                  record.accumulator, record.xregister, record.yregister, record.stackRegister, flags);
+    return line;
+}
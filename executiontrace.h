@@ -0,0 +1,124 @@
+#ifndef EXECUTIONTRACE_H
+#define EXECUTIONTRACE_H
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "instructionset.h"
+
+//
+// TraceRecord Struct
+//
+// One executed instruction, as `ProcessorCore` traces it: where it is and the registers before it executes
+//
+struct TraceRecord
+{
+    uint32_t cycles;            // the low 32 bits of `CpuState::totalElapsedCycles()`
+    uint16_t programCounter;
+    uint16_t operand;           // the two bytes after the opcode, whatever the instruction's length
+    uint8_t opcode;
+    uint8_t accumulator, xregister, yregister;
+    uint8_t statusFlags, stackRegister;
+    uint8_t unused[2];
+};
+static_assert(sizeof(TraceRecord) == 16, "TraceRecord is meant to be 16 bytes");
+
+
+//
+// TraceWriter Class
+//
+// Writes a full trace to a stream, as `ProcessorCore::setTraceWriter()` hands it each record
+// Tracing starts at `startAddress()` and stops on reaching `stopAddress()`, then starts again the next time round,
+// or goes from the first record to the last when they are -1
+// The stream is binary: the `Magic` header, then each record as a byte of `Fields` saying which fields follow,
+// and those which changed since the record before; the program counter only when it does not follow on from the
+// instruction before, the cycles as a one-byte difference where they can be
+//
+class TraceWriter
+{
+public:
+    static constexpr char Magic[8] = { '6', '5', '0', '2', 'T', 'R', 'C', '1' };
+    enum Fields : uint8_t
+    {
+        ProgramCounter = 0x01, Accumulator = 0x02, XRegister = 0x04, YRegister = 0x08,
+        StatusFlags = 0x10, StackRegister = 0x20, Cycles = 0x40,    // else a byte of difference
+        Start = 0x80,                                               // the first record after a start
+    };
+
+    explicit TraceWriter(std::ostream &out, int startAddress = -1, int stopAddress = -1);
+
+    int startAddress() const { return _startAddress; }
+    int stopAddress() const { return _stopAddress; }
+    bool tracing() const { return _tracing; }
+    uint64_t recordCount() const { return _recordCount; }
+
+    void record(const TraceRecord &record);
+
+private:
+    std::ostream &out;
+    int _startAddress, _stopAddress;
+    bool _tracing;
+    uint64_t _recordCount;
+    TraceRecord previous;
+    uint16_t nextProgramCounter;
+
+    void write(const TraceRecord &record, uint8_t fields);
+};
+
+
+//
+// TraceReader Class
+//
+// Reads back what a `TraceWriter` wrote, a chunk of the stream at a time
+//
+class TraceReader
+{
+public:
+    explicit TraceReader(std::istream &in);
+
+    // false for a stream which is not a trace
+    bool valid() const { return _valid; }
+    // false at the end of the trace
+    bool read(TraceRecord &record);
+    // whether the last record read started a stretch of tracing
+    bool started() const { return _started; }
+
+private:
+    static constexpr size_t ChunkSize = 0x100000;
+    static constexpr size_t MaxRecordSize = 16;
+    std::istream &in;
+    bool _valid, _started;
+    TraceRecord previous;
+    uint16_t nextProgramCounter;
+    std::vector<uint8_t> chunk;
+    size_t chunkNext, chunkEnd;
+
+    bool fillChunk();
+};
+
+
+//
+// TraceFormatter Class
+//
+// Turns trace records into a line of text each, with addresses symbolized from a label table
+//
+class TraceFormatter
+{
+public:
+    using Symbols = std::map<uint16_t, std::string>;
+
+    explicit TraceFormatter(const Symbols &symbols = Symbols()) : symbols(symbols) {}
+
+    std::string format(const TraceRecord &record) const;
+    // the nearest symbol at or before `address`, as "label" or "label+offset"; an empty string for none
+    std::string symbolize(uint16_t address) const;
+
+private:
+    Symbols symbols;
+};
+
+#endif // EXECUTIONTRACE_H
@@ -0,0 +1,257 @@
+#include <algorithm>
+
+#include "fuzzer.h"
+
+// AFL's buckets of hit counts: 1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+, a bit each
+static uint8_t hitCountBucket(uint8_t count)
+{
+    if (count <= 3)
+        return 1 << (count - 1);
+    if (count < 8)
+        return 0x08;
+    if (count < 16)
+        return 0x10;
+    if (count < 32)
+        return 0x20;
+    return count < 128 ? 0x40 : 0x80;
+}
+
+// bytes a mutation puts in, for routines which parse text or numbers
+static const uint8_t interestingBytes[] =
+{
+    0x00, 0x01, 0x7f, 0x80, 0xff, '\r', '\n', ' ', '+', '-', '.', ',', '/', ':', '$', '%', '#',
+    '0', '1', '2', '5', '9', 'A', 'F', 'Z', 'a', 'z',
+};
+
+
+//
+// Fuzzer Class
+//
+
+Fuzzer::Fuzzer(const std::shared_ptr<const ProcessorCore::SaveState> &image)
+    : image(image)
+{
+    _inputTarget = ConsoleInput;
+    _inputAddress = 0;
+    _maxInputLength = 64;
+    _maxCycles = 1000000;
+    _executions = 0;
+    _edgesCovered = 0;
+    corpusNext = 0;
+    edgeCounts.assign(EdgeMapSize, 0);
+    edgeExecution.assign(EdgeMapSize, 0);
+    edgeBuckets.assign(EdgeMapSize, 0);
+    input = nullptr;
+    inputNext = 0;
+    // as `ProcessorModel`'s core, whose save state the image is; CONIN and FILEIN read the input through the host
+    core.mapHostDevices();
+    core.setHost(this);
+    core.setStackWatches(ProcessorCore::WatchStackOverflow | ProcessorCore::WatchStackUnderflow);
+}
+
+/*static*/ const char *Fuzzer::crashKindName(CrashKind kind)
+{
+    switch (kind)
+    {
+    case ErrorCrash: return "error";
+    case RunawayCrash: return "runaway";
+    case StackWrapCrash: return "stackwrap";
+    }
+    return "";
+}
+
+void Fuzzer::addSeedInput(const Input &input)
+{
+    if (!execute(input))
+        _corpus.push_back(input);
+}
+
+bool Fuzzer::execute(const Input &input)
+{
+    // the fork server's reset: only the pages the last execution wrote are copied back
+    _executions++;
+    edgesHit.clear();
+    core.restoreState(image);
+    core.restartRun();
+    core.clearWatchHit();
+    this->input = &input;
+    inputNext = 0;
+    if (_inputTarget == MemoryInput)
+        for (int i = 0; i < _maxInputLength; i++)
+            core.setMemoryByteAt(_inputAddress + i, i < static_cast<int>(input.size()) ? input[i] : 0);
+
+    uint16_t previousBlock = 0;
+    try
+    {
+        while (!core.stopped())
+        {
+            const uint16_t block = core.programCounter();
+            hitEdge((previousBlock >> 1) ^ block);
+            previousBlock = block;
+            core.runBasicBlock();
+            if (core.watchHit().hit)
+            {
+                crashed(StackWrapCrash, core.watchHit().kind == ProcessorCore::WatchStackOverflow ? "Stack overflow" : "Stack underflow", input);
+                break;
+            }
+            if (core.totalElapsedCycles() >= _maxCycles)
+            {
+                crashed(RunawayCrash, "Over " + std::to_string(_maxCycles) + " cycles", input);
+                break;
+            }
+        }
+    }
+    catch (const ExecutionError &e)
+    {
+        crashed(ErrorCrash, e.what(), input);
+    }
+    this->input = nullptr;
+
+    if (!newCoverage())
+        return false;
+    _corpus.push_back(input);
+    return true;
+}
+
+void Fuzzer::fuzz(uint64_t executions)
+{
+    if (_corpus.empty())
+        addSeedInput(Input());
+    const uint64_t endExecutions = _executions + executions;
+    while (_executions < endExecutions)
+    {
+        // each corpus entry in turn, mutated a number of times, splicing with others as it goes
+        const Input parent(_corpus[corpusNext++ % _corpus.size()]);
+        for (int i = 0; i < 64 && _executions < endExecutions; i++)
+            execute(mutate(parent));
+    }
+}
+
+void Fuzzer::hitEdge(uint16_t edge)
+{
+    if (edgeExecution[edge] != _executions)
+    {
+        edgeExecution[edge] = _executions;
+        edgeCounts[edge] = 1;
+        edgesHit.push_back(edge);
+    }
+    else if (edgeCounts[edge] != 0xff)
+        edgeCounts[edge]++;
+}
+
+bool Fuzzer::newCoverage()
+{
+    bool found = false;
+    for (uint16_t edge : edgesHit)
+    {
+        const uint8_t bucket = hitCountBucket(edgeCounts[edge]);
+        if (edgeBuckets[edge] & bucket)
+            continue;
+        if (edgeBuckets[edge] == 0)
+            _edgesCovered++;
+        edgeBuckets[edge] |= bucket;
+        found = true;
+    }
+    return found;
+}
+
+void Fuzzer::crashed(CrashKind kind, const std::string &message, const Input &input)
+{
+    if (!crashKeys.insert(std::make_pair(static_cast<int>(kind), core.programCounter())).second)
+        return;
+    _crashes.push_back(Crash{ kind, core.programCounter(), message, input });
+    if (crashHandler)
+        crashHandler(_crashes.back());
+}
+
+Fuzzer::Input Fuzzer::mutate(const Input &parent)
+{
+    Input input(parent);
+    auto below = [this](size_t n) { return static_cast<size_t>(random() % n); };
+    const int mutations = 1 + below(8);
+    for (int i = 0; i < mutations; i++)
+    {
+        const size_t size = input.size();
+        const bool full = static_cast<int>(size) >= _maxInputLength;
+        switch (size == 0 ? 3 : below(8))
+        {
+        case 0: input[below(size)] ^= 1 << below(8); break;
+        case 1: input[below(size)] = static_cast<uint8_t>(random()); break;
+        case 2: input[below(size)] = interestingBytes[below(sizeof(interestingBytes))]; break;
+        case 3:
+            if (!full)
+                input.insert(input.begin() + below(size + 1), interestingBytes[below(sizeof(interestingBytes))]);
+            break;
+        case 4: input.erase(input.begin() + below(size)); break;
+        case 5: input[below(size)] += static_cast<uint8_t>(below(35)) - 17; break;
+        case 6:
+        {
+            // a run of the input repeated, for routines which go wrong on long inputs
+            const size_t from = below(size), length = 1 + below(std::min<size_t>(size - from, 8));
+            const Input run(input.begin() + from, input.begin() + from + length);
+            input.insert(input.begin() + below(size + 1), run.begin(), run.end());
+            break;
+        }
+        case 7:
+        {
+            // the front of this input and the back of another
+            const Input &other(_corpus[below(_corpus.size())]);
+            input.resize(below(size + 1));
+            if (!other.empty())
+                input.insert(input.end(), other.begin() + below(other.size()), other.end());
+            break;
+        }
+        }
+    }
+    if (static_cast<int>(input.size()) > _maxInputLength)
+        input.resize(_maxInputLength);
+    return input;
+}
+
+
+/*override*/ void Fuzzer::sendMessage(const char * /*message*/, int /*len*/)
+{
+}
+
+/*override*/ void Fuzzer::outputChar(char /*ch*/)
+{
+}
+
+/*override*/ void Fuzzer::outputString(const char * /*str*/, int /*len*/)
+{
+}
+
+/*override*/ char Fuzzer::inputChar(int /*timeout*/, bool justWait)
+{
+    if (justWait || _inputTarget != ConsoleInput)
+        return justWait ? '\0' : '\003';
+    return input != nullptr && inputNext < input->size() ? static_cast<char>((*input)[inputNext++]) : '\003';
+}
+
+/*override*/ void Fuzzer::processEvents()
+{
+}
+
+/*override*/ void Fuzzer::openFile(const char * /*filename*/)
+{
+    if (_inputTarget == FileInput)
+        inputNext = 0;
+}
+
+/*override*/ void Fuzzer::closeFile()
+{
+}
+
+/*override*/ void Fuzzer::rewindFile()
+{
+    if (_inputTarget == FileInput)
+        inputNext = 0;
+}
+
+/*override*/ bool Fuzzer::readFile(char &ch)
+{
+    if (_inputTarget != FileInput || input == nullptr || inputNext >= input->size())
+        return false;
+    ch = static_cast<char>((*input)[inputNext++]);
+    return true;
+}
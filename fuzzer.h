@@ -0,0 +1,116 @@
+#ifndef FUZZER_H
+#define FUZZER_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "processorcore.h"
+
+//
+// Fuzzer Class
+//
+// Coverage-guided fuzzing of a routine, in process: each execution restores the image, a save state taken just after
+// `ProcessorCore::startRun()` at the routine's entry, gives it an input, and runs it a basic block at a time until
+// its RTS (which returns to `__JSR_terminate`)
+// The input goes into a memory region (zero-filled after it), or is what the routine reads from `__inch` or the
+// CONIN/CONKEY registers, or from `__read_file` or FILEIN whatever file it opens; end of input reads as Ctrl-C, as for
+// `StdioCoreHost`
+// Coverage is the edges between basic blocks, hashed into 64K counters with their hit counts bucketed as AFL does;
+// an input which reaches a new edge, or an edge a new number of times, goes into the corpus for mutating further
+// A crash is an `ExecutionError`, a run going over `maxCycles()`, or the stack wrapping; each kind at each program
+// counter is kept once, with the input which found it
+// As the host it stands in for, it sees to the routine's console and file I/O itself
+//
+class Fuzzer : public IProcessorCoreHost
+{
+public:
+    using Input = std::vector<uint8_t>;
+    enum InputTarget { MemoryInput, ConsoleInput, FileInput };
+    enum CrashKind { ErrorCrash, RunawayCrash, StackWrapCrash };
+    struct Crash
+    {
+        CrashKind kind;
+        uint16_t programCounter;
+        std::string message;
+        Input input;
+    };
+    using CrashHandler = std::function<void(const Crash &crash)>;
+
+    explicit Fuzzer(const std::shared_ptr<const ProcessorCore::SaveState> &image);
+
+    InputTarget inputTarget() const { return _inputTarget; }
+    uint16_t inputAddress() const { return _inputAddress; }
+    // `address` for `MemoryInput`, where `maxInputLength()` bytes are written
+    void setInputTarget(InputTarget target, uint16_t address = 0) { _inputTarget = target; _inputAddress = address; }
+    int maxInputLength() const { return _maxInputLength; }
+    void setMaxInputLength(int length) { _maxInputLength = length; }
+    uint64_t maxCycles() const { return _maxCycles; }
+    void setMaxCycles(uint64_t cycles) { _maxCycles = cycles; }
+    void setRandomSeed(uint64_t seed) { random.seed(seed); }
+    // called on each new crash, say to save a reproducer
+    void setCrashHandler(const CrashHandler &handler) { crashHandler = handler; }
+
+    void addSeedInput(const Input &input);
+    // executes `input`, returning whether it found new coverage (it is then added to the corpus)
+    bool execute(const Input &input);
+    // mutates the corpus, the seed inputs or else a single empty input to start with, for `executions` executions
+    void fuzz(uint64_t executions);
+
+    uint64_t executions() const { return _executions; }
+    int edgesCovered() const { return _edgesCovered; }
+    const std::vector<Input> &corpus() const { return _corpus; }
+    const std::vector<Crash> &crashes() const { return _crashes; }
+    static const char *crashKindName(CrashKind kind);
+
+    // IProcessorCoreHost interface: the input, and nowhere for the output to go
+    void sendMessage(const char *message, int len) override;
+    void outputChar(char ch) override;
+    void outputString(const char *str, int len) override;
+    char inputChar(int timeout, bool justWait) override;
+    void processEvents() override;
+    void openFile(const char *filename) override;
+    void closeFile() override;
+    void rewindFile() override;
+    bool readFile(char &ch) override;
+
+private:
+    static constexpr int EdgeMapSize = 0x10000;
+
+    ProcessorCore core;
+    std::shared_ptr<const ProcessorCore::SaveState> image;
+    InputTarget _inputTarget;
+    uint16_t _inputAddress;
+    int _maxInputLength;
+    uint64_t _maxCycles;
+    std::mt19937_64 random;
+    CrashHandler crashHandler;
+
+    std::vector<Input> _corpus;
+    std::vector<Crash> _crashes;
+    std::set<std::pair<int, uint16_t>> crashKeys;
+    uint64_t _executions;
+    int _edgesCovered;
+    size_t corpusNext;
+
+    // this execution's edges: `edgeExecution` marks those hit in it, so the counts need no clearing between executions
+    std::vector<uint8_t> edgeCounts;
+    std::vector<uint64_t> edgeExecution;
+    std::vector<uint16_t> edgesHit;
+    std::vector<uint8_t> edgeBuckets;   // the buckets of hit counts seen so far for each edge
+
+    const Input *input;
+    size_t inputNext;
+
+    void hitEdge(uint16_t edge);
+    bool newCoverage();
+    void crashed(CrashKind kind, const std::string &message, const Input &input);
+    Input mutate(const Input &input);
+};
+
+#endif // FUZZER_H
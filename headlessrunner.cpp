@@ -0,0 +1,495 @@
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "appsettings.h"
+#include "batchrunner.h"
+#include "fuzzer.h"
+#include "headlessrunner.h"
+#include "lockstepcores.h"
+#include "staticrecompiler.h"
+
+//
+// HeadlessRunner Class
+//
+
+HeadlessRunner::HeadlessRunner(QObject *parent)
+    : QObject{parent}
+{
+    codeFile = nullptr;
+    codeStream = nullptr;
+    executionError = false;
+    runElapsedNsecs = 0;
+
+    _emulator = new Emulator(this);
+
+    stdinNotifier = nullptr;
+    if (stdinFile.open(0, QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+#ifndef Q_OS_WIN
+        stdinNotifier = new QSocketNotifier(stdinFile.handle(), QSocketNotifier::Read, this);
+        stdinNotifier->setEnabled(false);
+        connect(stdinNotifier, &QSocketNotifier::activated, this, &HeadlessRunner::stdinActivated);
+#endif
+    }
+
+    connect(assembler(), &Assembler::sendMessageToConsole, this, &HeadlessRunner::sendMessageToConsole);
+
+    connect(processorModel(), &ProcessorModel::sendMessageToConsole, this, &HeadlessRunner::sendMessageToConsole);
+    connect(processorModel(), &ProcessorModel::sendStringToConsole, this, &HeadlessRunner::sendStringToConsole);
+    connect(processorModel(), &ProcessorModel::sendCharToConsole, this, &HeadlessRunner::sendCharToConsole);
+    // emitted on the model's run thread, so these are queued to this one, where `stdinNotifier` lives
+    connect(processorModel(), &ProcessorModel::requestCharFromConsole, this, &HeadlessRunner::requestCharFromConsole);
+    connect(processorModel(), &ProcessorModel::endRequestCharFromConsole, this, &HeadlessRunner::endRequestCharFromConsole);
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    delete codeStream;
+}
+
+bool HeadlessRunner::assembleFile(const QString &filename, const QStringList &includeDirectories)
+{
+    codeFile = new QFile(filename, this);
+    if (!codeFile->open(QFile::ReadOnly | QFile::Text))
+    {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(filename), qPrintable(codeFile->errorString()));
+        return false;
+    }
+    codeStream = new QTextStream(codeFile);
+
+    QStringList directories(includeDirectories);
+    directories.prepend(QFileInfo(filename).absolutePath());
+    assembler()->setCodeIncludeDirectories(directories);
+    assembler()->setCode(codeStream);
+    assembler()->assemble();
+    return !assembler()->needsAssembling();
+}
+
+bool HeadlessRunner::turboRun()
+{
+    executionError = false;
+    processorModel()->setStartNewRun(true);
+    processorModel()->setProgramCounter(emulator()->runStartAddress());
+
+    QElapsedTimer timer;
+    timer.start();
+    // the run is on the model's thread, while this one's event loop serves its console I/O
+    QEventLoop loop;
+    connect(processorModel(), &ProcessorModel::runFinished, &loop, &QEventLoop::quit);
+    processorModel()->turboRun();
+    if (processorModel()->isRunning())
+        loop.exec();
+    runElapsedNsecs = timer.nsecsElapsed();
+
+    std::fflush(stdout);
+    return !executionError;
+}
+
+bool HeadlessRunner::recompile(const QString &filename, const QString &sourceFilename)
+{
+    // the generated program holds just the 64K image
+    if (processorModel()->core()->bankedMemory().mapped())
+    {
+        std::fprintf(stderr, "%s: Cannot recompile a program with banked memory\n", qPrintable(sourceFilename));
+        return false;
+    }
+    std::vector<uint16_t> instructionAddresses;
+    for (const Assembler::CodeFileLineNumber &cfln : assembler()->instructionsCodeFileLineNumbers())
+        instructionAddresses.push_back(cfln._locationCounter);
+    StaticRecompiler recompiler(assembler()->memory(), instructionAddresses, emulator()->runStartAddress());
+    // nor the host devices, with the interrupts their timers raise
+    if (recompiler.usesHostDevices())
+    {
+        std::fprintf(stderr, "%s: Cannot recompile a program using the host devices or interrupts\n", qPrintable(sourceFilename));
+        return false;
+    }
+    recompiler.setClassName(StaticRecompiler::classNameFor(QFileInfo(sourceFilename).completeBaseName().toStdString()));
+    recompiler.setSourceName(QFileInfo(sourceFilename).fileName().toStdString());
+
+    std::ofstream out(filename.toStdString());
+    if (out)
+        recompiler.generate(out);
+    if (!out)
+    {
+        std::fprintf(stderr, "%s: Cannot write file\n", qPrintable(filename));
+        return false;
+    }
+    std::fprintf(stderr, "%s: %d basic blocks recompiled as class %s\n",
+                 qPrintable(filename), recompiler.blockCount(), recompiler.className().c_str());
+    return true;
+}
+
+bool HeadlessRunner::parseAddress(const QString &text, int &address) const
+{
+    // a code label, else a number as `$hex`, `0xhex` or decimal
+    address = -1;
+    if (text.isEmpty())
+        return true;
+    Assembler::ExpressionValue value(assembler()->codeLabelValue(text));
+    if (value.isValid())
+        address = value.intValue;
+    else
+    {
+        bool ok;
+        int number = text.startsWith('$') ? text.mid(1).toInt(&ok, 16) : text.toInt(&ok, 0);
+        if (ok && number >= 0 && number <= 0xffff)
+            address = number;
+    }
+    if (address < 0)
+        std::fprintf(stderr, "%s: Not a label or address\n", qPrintable(text));
+    return address >= 0;
+}
+
+bool HeadlessRunner::startTrace(const QString &filename, const QString &startAddress, const QString &stopAddress)
+{
+    int start, stop;
+    if (!parseAddress(startAddress, start) || !parseAddress(stopAddress, stop))
+        return false;
+    traceStream.open(filename.toStdString(), std::ios::binary);
+    if (!traceStream)
+    {
+        std::fprintf(stderr, "%s: Cannot write file\n", qPrintable(filename));
+        return false;
+    }
+    traceWriter.reset(new TraceWriter(traceStream, start, stop));
+    processorModel()->core()->setTraceWriter(traceWriter.get());
+    return true;
+}
+
+void HeadlessRunner::endTrace()
+{
+    if (traceWriter == nullptr)
+        return;
+    processorModel()->core()->setTraceWriter(nullptr);
+    std::fprintf(stderr, "Traced instructions: %llu\n", static_cast<unsigned long long>(traceWriter->recordCount()));
+    traceWriter.reset();
+    traceStream.close();
+}
+
+bool HeadlessRunner::formatTrace(const QString &filename)
+{
+    std::ifstream in(filename.toStdString(), std::ios::binary);
+    TraceReader reader(in);
+    if (!reader.valid())
+    {
+        std::fprintf(stderr, "%s: Not a trace file\n", qPrintable(filename));
+        return false;
+    }
+    TraceFormatter formatter(emulator()->traceSymbols());
+    TraceRecord record;
+    while (reader.read(record))
+    {
+        if (reader.started())
+            std::printf("--- trace started\n");
+        std::printf("%s\n", formatter.format(record).c_str());
+    }
+    return true;
+}
+
+bool HeadlessRunner::batchRun(const QString &csvFilename, const QStringList &inputFilenames, int runs, int threads,
+                              double timeLimit, const QString &outputDirectory)
+{
+    // each input file is a run, with the file as its console input; else `runs` runs with none
+    std::vector<BatchRunner::Run> batchRuns;
+    for (const QString &inputFilename : inputFilenames)
+    {
+        QFile inputFile(inputFilename);
+        if (!inputFile.open(QFile::ReadOnly))
+        {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(inputFilename), qPrintable(inputFile.errorString()));
+            return false;
+        }
+        const QByteArray input(inputFile.readAll());
+        batchRuns.push_back(BatchRunner::Run{ QFileInfo(inputFilename).fileName().toStdString(), input.toStdString() });
+    }
+    if (inputFilenames.isEmpty())
+        for (int run = 1; run <= runs; run++)
+            batchRuns.push_back(BatchRunner::Run{ QString("run%1").arg(run).toStdString(), std::string() });
+
+    // the image all the runs start from, as `ProcessorModel` would start a TurboRun
+    processorModel()->restart();
+    processorModel()->setProgramCounter(emulator()->runStartAddress());
+    processorModel()->core()->startRun();
+    BatchRunner batchRunner(processorModel()->core()->saveState());
+    batchRunner.setThreads(threads);
+    batchRunner.setJitHitThreshold(settings().jitHitThreshold());
+    batchRunner.setTimeLimit(timeLimit);
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::vector<BatchRunner::Result> results(batchRunner.run(batchRuns));
+    runElapsedNsecs = timer.nsecsElapsed();
+
+    std::ofstream csv(csvFilename.toStdString());
+    if (csv)
+        BatchRunner::writeCsv(csv, results);
+    if (!csv)
+    {
+        std::fprintf(stderr, "%s: Cannot write file\n", qPrintable(csvFilename));
+        return false;
+    }
+    bool ok = true;
+    for (const BatchRunner::Result &result : results)
+    {
+        ok = ok && result.ok;
+        if (!outputDirectory.isEmpty())
+        {
+            QFile outputFile(QDir(outputDirectory).filePath(QString::fromStdString(result.name) + ".out"));
+            if (!outputFile.open(QFile::WriteOnly) || outputFile.write(result.output.data(), result.output.size()) < 0)
+            {
+                std::fprintf(stderr, "%s: %s\n", qPrintable(outputFile.fileName()), qPrintable(outputFile.errorString()));
+                return false;
+            }
+        }
+    }
+    uint64_t instructions = 0;
+    for (const BatchRunner::Result &result : results)
+        instructions += result.instructions;
+    std::fprintf(stderr, "Runs: %zu\nInstructions: %llu\nHost time: %.3f ms (%.2f MIPS)\n",
+                 results.size(), static_cast<unsigned long long>(instructions), runElapsedNsecs / 1000000.0,
+                 runElapsedNsecs > 0 ? instructions * 1000.0 / runElapsedNsecs : 0.0);
+    return ok;
+}
+
+bool HeadlessRunner::fuzz(const QString &entryAddress, const QString &inputTarget, int maxInputLength, quint64 executions,
+                          quint64 maxCycles, const QStringList &seedFilenames, const QString &crashDirectory)
+{
+    int entry, inputAddress = 0;
+    if (!parseAddress(entryAddress, entry) || entry < 0)
+        return false;
+    Fuzzer::InputTarget target;
+    if (inputTarget == "console")
+        target = Fuzzer::ConsoleInput;
+    else if (inputTarget == "file")
+        target = Fuzzer::FileInput;
+    else if (inputTarget.startsWith("memory:"))
+    {
+        target = Fuzzer::MemoryInput;
+        if (!parseAddress(inputTarget.mid(7), inputAddress) || inputAddress < 0)
+            return false;
+    }
+    else
+    {
+        std::fprintf(stderr, "%s: Not console, file or memory:<address>\n", qPrintable(inputTarget));
+        return false;
+    }
+
+    // the image every execution starts from: the routine's entry, returning to `__JSR_terminate`
+    processorModel()->restart();
+    processorModel()->setProgramCounter(entry);
+    processorModel()->core()->startRun();
+    Fuzzer fuzzer(processorModel()->core()->saveState());
+    fuzzer.setInputTarget(target, inputAddress);
+    fuzzer.setMaxInputLength(maxInputLength);
+    fuzzer.setMaxCycles(maxCycles);
+    fuzzer.setRandomSeed(QDateTime::currentMSecsSinceEpoch());
+    bool crashesSaved = true;
+    fuzzer.setCrashHandler([this, &crashDirectory, &crashesSaved](const Fuzzer::Crash &crash) {
+        QString filename, sourceFilename;
+        if (!crashDirectory.isEmpty())
+        {
+            filename = QDir(crashDirectory).filePath(QString("crash-%1-%2.bin").arg(Fuzzer::crashKindName(crash.kind))
+                                                     .arg(crash.programCounter, 4, 16, QChar('0')));
+            QFile crashFile(filename);
+            if (!crashFile.open(QFile::WriteOnly) || crashFile.write(reinterpret_cast<const char *>(crash.input.data()), crash.input.size()) < 0)
+            {
+                std::fprintf(stderr, "%s: %s\n", qPrintable(filename), qPrintable(crashFile.errorString()));
+                crashesSaved = false;
+            }
+        }
+        int lineNumber = -1;
+        emulator()->mapInstructionAddressToFileLineNumber(crash.programCounter, sourceFilename, lineNumber);
+        std::fprintf(stderr, "Crash (%s) at $%04X%s: %s%s\n", Fuzzer::crashKindName(crash.kind), crash.programCounter,
+                     lineNumber >= 0 ? qPrintable(QString(" (%1:%2)").arg(QFileInfo(sourceFilename).fileName()).arg(lineNumber + 1)) : "",
+                     crash.message.c_str(), filename.isEmpty() ? "" : qPrintable(" -> " + filename));
+    });
+
+    for (const QString &seedFilename : seedFilenames)
+    {
+        QFile seedFile(seedFilename);
+        if (!seedFile.open(QFile::ReadOnly))
+        {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(seedFilename), qPrintable(seedFile.errorString()));
+            return false;
+        }
+        const QByteArray seed(seedFile.readAll());
+        fuzzer.addSeedInput(Fuzzer::Input(seed.begin(), seed.end()));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    fuzzer.fuzz(executions);
+    runElapsedNsecs = timer.nsecsElapsed();
+    std::fprintf(stderr, "Executions: %llu (%.0f/s)\nEdges: %d\nCorpus: %zu\nCrashes: %zu\n",
+                 static_cast<unsigned long long>(fuzzer.executions()),
+                 runElapsedNsecs > 0 ? fuzzer.executions() * 1e9 / runElapsedNsecs : 0.0,
+                 fuzzer.edgesCovered(), fuzzer.corpus().size(), fuzzer.crashes().size());
+    return crashesSaved && fuzzer.crashes().empty();
+}
+
+bool HeadlessRunner::lockstepRun(const QString &entryAddress, const QString &inputAddress, const QStringList &inputFilenames, bool check)
+{
+    int entry, address;
+    if (!parseAddress(entryAddress, entry) || entry < 0 || !parseAddress(inputAddress, address) || address < 0)
+        return false;
+    QList<QByteArray> inputs;
+    for (const QString &inputFilename : inputFilenames)
+    {
+        QFile inputFile(inputFilename);
+        if (!inputFile.open(QFile::ReadOnly))
+        {
+            std::fprintf(stderr, "%s: %s\n", qPrintable(inputFilename), qPrintable(inputFile.errorString()));
+            return false;
+        }
+        inputs.append(inputFile.readAll().left(0x10000 - address));
+    }
+
+    // the image every lane starts from, as for `fuzz()`
+    processorModel()->restart();
+    processorModel()->setProgramCounter(entry);
+    processorModel()->core()->startRun();
+    const std::shared_ptr<const ProcessorCore::SaveState> image(processorModel()->core()->saveState());
+
+    bool ok = true;
+    uint64_t instructions = 0, instructionsIssued = 0, lockstepInstructions = 0;
+    runElapsedNsecs = 0;
+    for (int first = 0; first < inputs.size(); first += LockstepCores::MaxLanes)
+    {
+        LockstepCores lanes(image, std::min(int(inputs.size()) - first, LockstepCores::MaxLanes));
+        for (int lane = 0; lane < lanes.lanes(); lane++)
+        {
+            const QByteArray &input(inputs.at(first + lane));
+            for (int i = 0; i < input.size(); i++)
+                lanes.setMemoryByteAt(lane, address + i, input.at(i));
+        }
+        QElapsedTimer timer;
+        timer.start();
+        lanes.run();
+        runElapsedNsecs += timer.nsecsElapsed();
+        instructionsIssued += lanes.instructionsIssued();
+        lockstepInstructions += lanes.lockstepInstructions();
+
+        for (int lane = 0; lane < lanes.lanes(); lane++)
+        {
+            instructions += lanes.instructionCount(lane);
+            std::printf("%s: A=$%02X X=$%02X Y=$%02X P=$%02X S=$%02X, %llu cycles, %llu instructions%s%s\n",
+                        qPrintable(inputFilenames.at(first + lane)), lanes.accumulator(lane), lanes.xregister(lane),
+                        lanes.yregister(lane), lanes.statusFlags(lane), lanes.stackRegister(lane),
+                        static_cast<unsigned long long>(lanes.totalElapsedCycles(lane)),
+                        static_cast<unsigned long long>(lanes.instructionCount(lane)),
+                        lanes.error(lane).empty() ? "" : ": ", lanes.error(lane).c_str());
+            if (!lanes.error(lane).empty())
+                ok = false;
+            if (!check)
+                continue;
+
+            // the same run alone, a step at a time, must end as the lane did
+            const QByteArray &input(inputs.at(first + lane));
+            ProcessorCore core;
+            core.setCrashTraceSize(0);
+            core.restoreState(lanes.image());
+            core.restartRun();
+            for (int i = 0; i < input.size(); i++)
+                core.setMemoryByteAt(address + i, input.at(i));
+            std::string error;
+            try
+            {
+                while (!core.stopped())
+                    core.step();
+            }
+            catch (const ExecutionError &e)
+            {
+                error = e.what();
+            }
+            QStringList differences;
+            if (lanes.accumulator(lane) != core.accumulator() || lanes.xregister(lane) != core.xregister()
+                || lanes.yregister(lane) != core.yregister() || lanes.stackRegister(lane) != core.stackRegister()
+                || lanes.statusFlags(lane) != core.statusFlags() || lanes.programCounter(lane) != core.programCounter())
+                differences << "registers";
+            if (lanes.totalElapsedCycles(lane) != core.totalElapsedCycles() || lanes.instructionCount(lane) != core.instructionCount())
+                differences << "cycles";
+            for (int memoryAddress = 0; memoryAddress < 0x10000; memoryAddress++)
+                if (lanes.memoryByteAt(lane, memoryAddress) != core.memoryByteAt(memoryAddress))
+                {
+                    differences << QString::asprintf("memory at $%04X", memoryAddress);
+                    break;
+                }
+            if (lanes.error(lane) != error)
+                differences << "error";
+            if (!differences.isEmpty())
+            {
+                std::fprintf(stderr, "%s: Lane differs from a run alone in %s\n", qPrintable(inputFilenames.at(first + lane)),
+                             qPrintable(differences.join(", ")));
+                ok = false;
+            }
+        }
+    }
+    std::fprintf(stderr, "Runs: %lld\nInstructions: %llu\nLanes per instruction: %.2f\nHost time: %.3f ms (%.2f MIPS)\n",
+                 static_cast<long long>(inputs.size()), static_cast<unsigned long long>(instructions),
+                 instructionsIssued > 0 ? double(lockstepInstructions) / instructionsIssued : 0.0, runElapsedNsecs / 1000000.0,
+                 runElapsedNsecs > 0 ? instructions * 1000.0 / runElapsedNsecs : 0.0);
+    return ok;
+}
+
+void HeadlessRunner::printRunStatistics() const
+{
+    unsigned long long instructions = processorModel()->runInstructionCount();
+    unsigned long long cycles = processorModel()->runCycleCount();
+    double mips = runElapsedNsecs > 0 ? instructions * 1000.0 / runElapsedNsecs : 0.0;
+    std::fprintf(stderr, "Instructions: %llu\nCycles: %llu\nHost time: %.3f ms (%.2f MIPS)\n",
+                 instructions, cycles, runElapsedNsecs / 1000000.0, mips);
+}
+
+
+/*slot*/ void HeadlessRunner::sendMessageToConsole(const QString &message, Qt::GlobalColor colour /*= Qt::transparent*/)
+{
+    // `ProcessorModel` reports execution errors in red
+    if (colour == Qt::red)
+        executionError = true;
+    std::fflush(stdout);
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+/*slot*/ void HeadlessRunner::sendStringToConsole(const QString &str)
+{
+    const QByteArray bytes(str.toLatin1());
+    std::fwrite(bytes.constData(), 1, bytes.size(), stdout);
+}
+
+/*slot*/ void HeadlessRunner::sendCharToConsole(char ch)
+{
+    std::fputc(ch, stdout);
+}
+
+/*slot*/ void HeadlessRunner::requestCharFromConsole()
+{
+    std::fflush(stdout);
+    if (stdinNotifier != nullptr)
+        stdinNotifier->setEnabled(true);
+    else
+        stdinActivated();
+}
+
+/*slot*/ void HeadlessRunner::endRequestCharFromConsole()
+{
+    if (stdinNotifier != nullptr)
+        stdinNotifier->setEnabled(false);
+}
+
+/*slot*/ void HeadlessRunner::stdinActivated()
+{
+    if (stdinNotifier != nullptr)
+        stdinNotifier->setEnabled(false);
+    char ch;
+    if (!stdinFile.isOpen() || !stdinFile.getChar(&ch))
+        ch = '\003';  // end of input stops the run, as Ctrl-C does
+    emit processorModel()->receivedCharFromConsole(ch);
+}
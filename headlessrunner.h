@@ -0,0 +1,63 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QFile>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTextStream>
+
+#include <fstream>
+#include <memory>
+
+#include "emulator.h"
+
+//
+// HeadlessRunner Class
+//
+class HeadlessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HeadlessRunner(QObject *parent = nullptr);
+    ~HeadlessRunner();
+
+    Emulator *emulator() const { return _emulator; }
+    ProcessorModel *processorModel() const { return emulator()->processorModel(); }
+    Assembler *assembler() const { return emulator()->assembler(); }
+
+    bool assembleFile(const QString &filename, const QStringList &includeDirectories);
+    bool turboRun();
+    bool recompile(const QString &filename, const QString &sourceFilename);
+    bool startTrace(const QString &filename, const QString &startAddress, const QString &stopAddress);
+    void endTrace();
+    bool formatTrace(const QString &filename);
+    bool batchRun(const QString &csvFilename, const QStringList &inputFilenames, int runs, int threads,
+                  double timeLimit, const QString &outputDirectory);
+    bool fuzz(const QString &entryAddress, const QString &inputTarget, int maxInputLength, quint64 executions,
+              quint64 maxCycles, const QStringList &seedFilenames, const QString &crashDirectory);
+    bool lockstepRun(const QString &entryAddress, const QString &inputAddress, const QStringList &inputFilenames, bool check);
+    void printRunStatistics() const;
+
+private slots:
+    void sendMessageToConsole(const QString &message, Qt::GlobalColor colour = Qt::transparent);
+    void sendStringToConsole(const QString &str);
+    void sendCharToConsole(char ch);
+    void requestCharFromConsole();
+    void endRequestCharFromConsole();
+    void stdinActivated();
+
+private:
+    Emulator *_emulator;
+    QFile *codeFile;
+    QTextStream *codeStream;
+    QFile stdinFile;
+    QSocketNotifier *stdinNotifier;
+    bool executionError;
+    qint64 runElapsedNsecs;
+    std::ofstream traceStream;
+    std::unique_ptr<TraceWriter> traceWriter;
+
+    bool parseAddress(const QString &text, int &address) const;
+};
+
+#endif // HEADLESSRUNNER_H
@@ -0,0 +1,244 @@
+#include <algorithm>
+
+#include "hostdevices.h"
+
+
+//
+// HostDevices Class
+//
+
+HostDevices::HostDevices(ProcessorCore *core)
+{
+    this->core = core;
+    latchedCycles = latchedTimeMs = 0;
+    fileStatus = 0;
+    t1Event = core->events().addEvent([this]() { t1RunOut(); });
+    t2Event = core->events().addEvent([this]() { t2RunOut(); });
+    inputPollEvent = core->events().addEvent([this]() { pollInput(); });
+    reset();
+}
+
+void HostDevices::reset()
+{
+    t1Latch = 0;
+    t2LatchLow = 0;
+    t1Start = t2Start = 0;
+    t1Count = t2Count = 0;
+    auxiliaryControl = 0;
+    interruptFlags = interruptEnable = 0;
+    pendingInput = -1;
+    core->events().cancel(t1Event);
+    core->events().cancel(t2Event);
+    core->events().cancel(inputPollEvent);
+    core->setIrq(IrqSource, false);
+}
+
+HostDevicesState HostDevices::state() const
+{
+    return HostDevicesState{ latchedCycles, latchedTimeMs, fileStatus, t1Latch, t2LatchLow, t1Start, t2Start, t1Count, t2Count,
+                             auxiliaryControl, interruptFlags, interruptEnable, pendingInput };
+}
+
+void HostDevices::setState(const HostDevicesState &state)
+{
+    latchedCycles = state.latchedCycles;
+    latchedTimeMs = state.latchedTimeMs;
+    fileStatus = state.fileStatus;
+    t1Latch = state.t1Latch;
+    t2LatchLow = state.t2LatchLow;
+    t1Start = state.t1Start;
+    t2Start = state.t2Start;
+    t1Count = state.t1Count;
+    t2Count = state.t2Count;
+    auxiliaryControl = state.auxiliaryControl;
+    interruptFlags = state.interruptFlags;
+    interruptEnable = state.interruptEnable;
+    pendingInput = state.pendingInput;
+}
+
+uint8_t HostDevices::inputChar(int timeout)
+{
+    IProcessorCoreHost *host = core->host();
+    char result = host != nullptr ? host->inputChar(timeout, false) : '\0';
+    if (result == '\003' || result == '\033')  // Ctrl-C or Escape
+        core->stop();
+    return static_cast<uint8_t>(result);
+}
+
+uint16_t HostDevices::counter(uint64_t start, uint16_t count) const
+{
+    // on past 0 to $FFFF and down, as a 6522's does
+    return static_cast<uint16_t>(count - (core->totalElapsedCycles() - start));
+}
+
+void HostDevices::startTimer(int event, uint64_t &start, uint16_t &count, uint16_t newCount)
+{
+    start = core->totalElapsedCycles();
+    count = newCount;
+    core->events().schedule(event, start + std::max<uint16_t>(count, 1));
+}
+
+void HostDevices::t1RunOut()
+{
+    // from when it was due rather than when the loops got to it, so the period stays exact
+    if (auxiliaryControl & T1FreeRunning)
+    {
+        t1Start += std::max<uint16_t>(t1Count, 1);
+        t1Count = t1Latch;
+        core->events().schedule(t1Event, t1Start + std::max<uint16_t>(t1Count, 1));
+    }
+    setInterruptFlags(T1Interrupt);
+}
+
+void HostDevices::t2RunOut()
+{
+    setInterruptFlags(T2Interrupt);
+}
+
+void HostDevices::pollInput()
+{
+    // the wait for an interrupt is a wait for the input, so it lets the host wait a little too
+    if (pendingInput < 0)
+    {
+        const uint8_t ch = inputChar(core->waitingForInterrupt() ? 10 : 0);
+        if (ch != 0)
+        {
+            pendingInput = ch;
+            setInterruptFlags(InputReadyInterrupt);
+        }
+    }
+    core->events().schedule(inputPollEvent, core->totalElapsedCycles() + InputPollCycles);
+}
+
+void HostDevices::setInterruptFlags(uint8_t flags)
+{
+    interruptFlags |= flags;
+    updateIrq();
+}
+
+void HostDevices::clearInterruptFlags(uint8_t flags)
+{
+    interruptFlags &= ~flags;
+    updateIrq();
+}
+
+void HostDevices::updateIrq()
+{
+    core->setIrq(IrqSource, (interruptFlags & interruptEnable) != 0);
+}
+
+/*override*/ uint8_t HostDevices::readByte(uint16_t address)
+{
+    IProcessorCoreHost *host = core->host();
+    uint8_t reg = static_cast<uint8_t>(address);
+    switch (reg)
+    {
+    case ConIn: case ConKey:
+        if (pendingInput >= 0)
+        {
+            const uint8_t ch = pendingInput;
+            pendingInput = -1;
+            clearInterruptFlags(InputReadyInterrupt);
+            return ch;
+        }
+        return inputChar(reg == ConIn ? -1 : 0);
+
+    case Cycles: latchedCycles = core->elapsedCycles(); return static_cast<uint8_t>(latchedCycles);
+    case Cycles + 1: case Cycles + 2: case Cycles + 3:
+        return static_cast<uint8_t>(latchedCycles >> (8 * (reg - Cycles)));
+    case TimeMs: latchedTimeMs = core->elapsedTimeMilliseconds(); return static_cast<uint8_t>(latchedTimeMs);
+    case TimeMs + 1: case TimeMs + 2: case TimeMs + 3:
+        return static_cast<uint8_t>(latchedTimeMs >> (8 * (reg - TimeMs)));
+
+    case FileIn: {
+        char ch;
+        if (host != nullptr && host->readFile(ch))
+        {
+            fileStatus &= ~FileEnd;
+            return static_cast<uint8_t>(ch);
+        }
+        fileStatus |= FileEnd;
+        return 0;
+    }
+    case FileStatus: return fileStatus;
+
+    case T1CounterLow: clearInterruptFlags(T1Interrupt); return static_cast<uint8_t>(counter(t1Start, t1Count));
+    case T1CounterHigh: return static_cast<uint8_t>(counter(t1Start, t1Count) >> 8);
+    case T1LatchLow: return static_cast<uint8_t>(t1Latch);
+    case T1LatchHigh: return static_cast<uint8_t>(t1Latch >> 8);
+    case T2CounterLow: clearInterruptFlags(T2Interrupt); return static_cast<uint8_t>(counter(t2Start, t2Count));
+    case T2CounterHigh: return static_cast<uint8_t>(counter(t2Start, t2Count) >> 8);
+    case AuxiliaryControl: return auxiliaryControl;
+    case InterruptFlags: return interruptFlags | ((interruptFlags & interruptEnable) != 0 ? AnyInterrupt : 0);
+    case InterruptEnable: return interruptEnable | AnyInterrupt;
+
+    default:
+        if (reg >= Bank0 && reg < Bank0 + core->bankedMemory().layout().windows)
+            return core->bankedMemory().selectedBank(reg - Bank0);
+        return 0;
+    }
+}
+
+/*override*/ void HostDevices::writeByte(uint16_t address, uint8_t value)
+{
+    IProcessorCoreHost *host = core->host();
+    switch (static_cast<uint8_t>(address))
+    {
+    case ConOut:
+        if (host != nullptr)
+            host->outputChar(static_cast<char>(value));
+        break;
+    case FileStatus:
+        if (host == nullptr)
+            break;
+        if (value == FileRewind)
+            host->rewindFile();
+        else if (value == FileClose)
+            host->closeFile();
+        fileStatus &= ~FileEnd;
+        break;
+
+    case T1CounterLow: case T1LatchLow:
+        t1Latch = (t1Latch & 0xff00) | value;
+        break;
+    case T1CounterHigh:
+        t1Latch = (t1Latch & 0x00ff) | (value << 8);
+        startTimer(t1Event, t1Start, t1Count, t1Latch);
+        clearInterruptFlags(T1Interrupt);
+        break;
+    case T1LatchHigh:
+        t1Latch = (t1Latch & 0x00ff) | (value << 8);
+        clearInterruptFlags(T1Interrupt);
+        break;
+    case T2CounterLow:
+        t2LatchLow = value;
+        break;
+    case T2CounterHigh:
+        startTimer(t2Event, t2Start, t2Count, t2LatchLow | (value << 8));
+        clearInterruptFlags(T2Interrupt);
+        break;
+    case AuxiliaryControl:
+        auxiliaryControl = value;
+        break;
+    case InterruptFlags:
+        clearInterruptFlags(value & ~AnyInterrupt);
+        break;
+    case InterruptEnable:
+        if (value & AnyInterrupt)
+            interruptEnable |= value & ~AnyInterrupt;
+        else
+            interruptEnable &= ~value;
+        if (!(interruptEnable & InputReadyInterrupt))
+            core->events().cancel(inputPollEvent);
+        else if (!core->events().scheduled(inputPollEvent))
+            core->events().schedule(inputPollEvent, core->totalElapsedCycles() + InputPollCycles);
+        updateIrq();
+        break;
+    default: {
+        const int window = static_cast<uint8_t>(address) - Bank0;
+        if (window >= 0 && window < core->bankedMemory().layout().windows)
+            core->bankedMemory().selectBank(window, value);
+        break;
+    }
+    }
+}
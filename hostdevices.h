@@ -0,0 +1,114 @@
+#ifndef HOSTDEVICES_H
+#define HOSTDEVICES_H
+
+#include <cstdint>
+
+#include "processorcore.h"
+
+//
+// HostDevicesState Struct
+//
+// What a `ProcessorCore::SaveState` keeps of its `HostDevices`: the registers, timers and pending input, the timers'
+// and the poll's events being in the core's own schedule
+//
+struct HostDevicesState
+{
+    uint32_t latchedCycles, latchedTimeMs;
+    uint8_t fileStatus;
+    uint16_t t1Latch;
+    uint8_t t2LatchLow;
+    uint64_t t1Start, t2Start;
+    uint16_t t1Count, t2Count;
+    uint8_t auxiliaryControl;
+    uint8_t interruptFlags, interruptEnable;
+    int pendingInput;
+};
+
+//
+// HostDevices Class
+//
+// Memory-mapped console, timer and file input, for programs which poll with LDA/STA rather than `JSR` to an
+// internal routine; mapped by `ProcessorCore::mapHostDevices()`, at `InstructionSet::__DEV_page` by default
+// Registers, as offsets in its page:
+//   +0  CONOUT      write outputs a character
+//   +1  CONIN       read waits for a character; Ctrl-C or Escape stops the run
+//   +2  CONKEY      read gives a character if one is ready, else 0
+//   +4  CYCLES      4 bytes, elapsed cycles, latched by reading +4
+//   +8  TIMEMS      4 bytes, elapsed milliseconds, latched by reading +8
+//   +12 FILEIN      read gives the next character of the open file
+//   +13 FILESTATUS  read gives bit 0 set at end of file; write 1 rewinds, 2 closes the file
+// and, at +16 plus the register numbers of a 6522 VIA, its interval timers and interrupt registers:
+//   +20 T1CL/+21 T1CH  T1's count; writing T1CH loads it from the latches and starts it; reading T1CL acknowledges
+//   +22 T1LL/+23 T1LH  T1's latches, reloaded from each time it runs out with ACR bit 6 set (free-running)
+//   +24 T2CL/+25 T2CH  T2, one-shot, the same way, writing T2CL setting its low latch
+//   +27 ACR            bit 6 as above
+//   +29 IFR            T1 (bit 6), T2 (bit 5) run out and console input ready (bit 1); bit 7 any of them enabled;
+//                      write 1s to acknowledge
+//   +30 IER            the IFR bits which raise IRQ; write bit 7 set to enable bits, clear to disable them
+// and, with the core's `bankedMemory()` mapped:
+//   +32 BANK0..        a register for each window, up to +37 BANK5: write selects the bank the window shows,
+//                      read gives it
+// The timers count down once a cycle, running out the count's number of cycles after starting, as events of the
+// core's `events()`; while console input ready is enabled the console is polled every `InputPollCycles`, the
+// character read being kept for CONIN/CONKEY
+// Other registers read as 0 and ignore writes
+//
+class HostDevices : public IMemoryDevice
+{
+public:
+    enum Registers : uint8_t
+    {
+        ConOut = 0x00, ConIn = 0x01, ConKey = 0x02,
+        Cycles = 0x04, TimeMs = 0x08,
+        FileIn = 0x0c, FileStatus = 0x0d,
+        T1CounterLow = 0x14, T1CounterHigh = 0x15, T1LatchLow = 0x16, T1LatchHigh = 0x17,
+        T2CounterLow = 0x18, T2CounterHigh = 0x19, AuxiliaryControl = 0x1b,
+        InterruptFlags = 0x1d, InterruptEnable = 0x1e,
+        Bank0 = 0x20,
+    };
+    enum FileStatusBits : uint8_t { FileEnd = 0x01 };
+    enum FileCommands : uint8_t { FileRewind = 1, FileClose = 2 };
+    enum InterruptBits : uint8_t { InputReadyInterrupt = 0x02, T2Interrupt = 0x20, T1Interrupt = 0x40, AnyInterrupt = 0x80 };
+    enum AuxiliaryControlBits : uint8_t { T1FreeRunning = 0x40 };
+    // its bit of `ProcessorCore::irqSources()`
+    static constexpr uint32_t IrqSource = 0x01;
+    static constexpr uint32_t InputPollCycles = 10000;
+
+    explicit HostDevices(ProcessorCore *core);
+
+    // as at the start of a run: the timers stopped and interrupts disabled
+    void reset();
+    // the core restores the events and its IRQ line along with these
+    HostDevicesState state() const;
+    void setState(const HostDevicesState &state);
+
+    uint8_t readByte(uint16_t address) override;
+    void writeByte(uint16_t address, uint8_t value) override;
+
+private:
+    ProcessorCore *core;
+    uint32_t latchedCycles;
+    uint32_t latchedTimeMs;
+    uint8_t fileStatus;
+
+    uint16_t t1Latch;
+    uint8_t t2LatchLow;
+    uint64_t t1Start, t2Start;      // the cycle each counted down from its count
+    uint16_t t1Count, t2Count;
+    uint8_t auxiliaryControl;
+    uint8_t interruptFlags, interruptEnable;
+    int t1Event, t2Event, inputPollEvent;
+    int pendingInput;               // read by the poll, for CONIN/CONKEY; -1 for none
+
+    uint8_t inputChar(int timeout);
+    uint16_t counter(uint64_t start, uint16_t count) const;
+    void startTimer(int event, uint64_t &start, uint16_t &count, uint16_t newCount);
+    void t1RunOut();
+    void t2RunOut();
+    void pollInput();
+    void setInterruptFlags(uint8_t flags);
+    void clearInterruptFlags(uint8_t flags);
+    void updateIrq();
+};
+
+#endif // HOSTDEVICES_H
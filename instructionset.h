@@ -0,0 +1,350 @@
+#ifndef INSTRUCTIONSET_H
+#define INSTRUCTIONSET_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+//
+// InstructionSet Class
+//
+// Plain C++ (no Qt) description of the 6502 instruction set, shared by the assembler and the emulator core
+//
+struct InstructionSet
+{
+    enum Operation : uint8_t
+    {
+        LDA, LDX, LDY, STA, STX, STY,
+        TAX, TAY, TXA, TYA,
+        TSX, TXS, PHA, PHP, PLA, PLP,
+        AND, EOR, ORA, BIT,
+        ADC, SBC, CMP, CPX, CPY,
+        INC, INX, INY, DEC, DEX, DEY,
+        ASL, LSR, ROL, ROR,
+        JMP, JSR, RTS,
+        BCC, BCS, BEQ, BMI, BNE, BPL, BVC, BVS,
+        CLC, CLD, CLI, CLV, SEC, SED, SEI,
+        BRK, NOP, RTI
+    };
+    static constexpr int TotalOperations = RTI + 1;
+    static_assert(TotalOperations == 56);
+
+    static constexpr const char *operationNames[TotalOperations]
+    {
+        "LDA", "LDX", "LDY", "STA", "STX", "STY",
+        "TAX", "TAY", "TXA", "TYA",
+        "TSX", "TXS", "PHA", "PHP", "PLA", "PLP",
+        "AND", "EOR", "ORA", "BIT",
+        "ADC", "SBC", "CMP", "CPX", "CPY",
+        "INC", "INX", "INY", "DEC", "DEX", "DEY",
+        "ASL", "LSR", "ROL", "ROR",
+        "JMP", "JSR", "RTS",
+        "BCC", "BCS", "BEQ", "BMI", "BNE", "BPL", "BVC", "BVS",
+        "CLC", "CLD", "CLI", "CLV", "SEC", "SED", "SEI",
+        "BRK", "NOP", "RTI"
+    };
+
+    enum AddressingMode : uint8_t
+    {
+        Implied = 0,            // CLC | RTS
+        Accumulator = 1,        // LSR A | ROR A
+        Immediate = 2,          // LDA #10 | LDX #<LABEL | LDY #>LABEL
+        ZeroPage = 3,           // LDA $00 | ASL ANSWER
+        ZeroPageX = 4,          // STY $10,X | AND TEMP,X
+        ZeroPageY = 5,          // LDX $10,Y | STX TEMP,Y
+        Relative = 6,           // BEQ LABEL | BNE *+4
+        Absolute = 7,           // JMP $1234 | JSR WIBBLE
+        AbsoluteX = 8,          // STA $3000,X | ROR CRC,X
+        AbsoluteY = 9,          // AND $4000,Y | STA MEM,Y
+        Indirect = 10,          // JMP ($FFFC) | JMP (TARGET)
+        IndexedIndirectX = 11,  // LDA ($40,X) | STA (MEM,X)
+        IndirectIndexedY = 12,  // LDA ($40),Y | STA (DST),Y
+    };
+    static constexpr int TotalAddressingModes = IndirectIndexedY + 1;
+
+    static constexpr const char *addressingModeNames[TotalAddressingModes]
+    {
+        "Implied", "Accumulator", "Immediate", "ZeroPage", "ZeroPageX", "ZeroPageY", "Relative",
+        "Absolute", "AbsoluteX", "AbsoluteY", "Indirect", "IndexedIndirectX", "IndirectIndexedY"
+    };
+
+    static const char *operationName(Operation operation)
+    {
+        return operation < TotalOperations ? operationNames[operation] : nullptr;
+    }
+    static Operation operationFromName(const char *name)
+    {
+        for (int i = 0; i < TotalOperations; i++)
+            if (std::strcmp(operationNames[i], name) == 0)
+                return static_cast<Operation>(i);
+        return static_cast<Operation>(-1);
+    }
+    static const char *addressingModeName(AddressingMode mode)
+    {
+        return mode < TotalAddressingModes ? addressingModeNames[mode] : nullptr;
+    }
+    static AddressingMode addressingModeFromName(const char *name)
+    {
+        for (int i = 0; i < TotalAddressingModes; i++)
+            if (std::strcmp(addressingModeNames[i], name) == 0)
+                return static_cast<AddressingMode>(i);
+        return static_cast<AddressingMode>(-1);
+    }
+
+    struct InstructionInfo
+    {
+        uint8_t opcodeByte;
+        uint8_t bytes;
+        uint8_t cycles;
+        Operation operation;
+        AddressingMode addrMode;
+
+        constexpr bool isValid() const { return bytes != 0; }
+    };
+    static constexpr int TotalInstructions = 256;
+    static constexpr int TotalLegalInstructions = 151;
+
+    // the legal opcodes, and all 256 opcodes indexed by opcode byte (invalid ones have `bytes == 0`)
+    // both are `constexpr`, defined below
+    static const InstructionInfo legalInstructionsInfo[TotalLegalInstructions];
+    static const std::array<InstructionInfo, TotalInstructions> instructionsInfo;
+
+    static constexpr const InstructionInfo &getInstructionInfo(uint8_t opcodeByte) { return instructionsInfo[opcodeByte]; }
+    static constexpr const InstructionInfo *findInstructionInfo(Operation operation, AddressingMode addrMode)
+    {
+        for (int i = 0; i < TotalInstructions; i++)
+            if (instructionsInfo[i].isValid() && instructionsInfo[i].operation == operation && instructionsInfo[i].addrMode == addrMode)
+                return &instructionsInfo[i];
+        return nullptr;
+    }
+
+    struct __attribute__((packed)) Instruction
+    {
+        uint8_t opcodeByte;
+        uint16_t operand;
+        Instruction(uint8_t _opcodeByte, uint16_t _operand)
+        {
+            opcodeByte = _opcodeByte;
+            operand = _operand;
+        }
+
+        const InstructionInfo &getInstructionInfo() const { return instructionsInfo[opcodeByte]; }
+    };
+
+    enum InternalJSRs { __JSR_terminate = 0x0000,
+                        __JSR_brk_handler = 0xfffe, __JSR_brk_default_handler = 0xfffc, __JSR_outch = 0xfffa, __JSR_get_time = 0xfff8,
+                        __JSR_get_time_ms = 0xfff6, __JSR_get_elapsed_time = 0xfff4, __JSR_clear_elapsed_time = 0xfff2, __JSR_process_events = 0xfff0,
+                        __JSR_inch = 0xffee, __JSR_inkey = 0xffec,  __JSR_wait = 0xffea, __JSR_open_file = 0xffe8,
+                        __JSR_close_file = 0xffe6, __JSR_rewind_file = 0xffe4, __JSR_read_file = 0xffe2, __JSR_outstr_fast = 0xffe0,
+                        __JSR_outstr_inline = 0xffde, __JSR_get_elapsed_cycles = 0xffdc, __JSR_clear_elapsed_cycles = 0xffda,
+                        __JSR_irq_default_handler = 0xffd8, __JSR_nmi_default_handler = 0xffd6, __JSR_wait_interrupt = 0xffd4,
+                        };
+    enum InternalVECs { __VEC_BRKV = 0x0202, __VEC_IRQV = 0x0204, __VEC_NMIV = 0x0206, };
+    // the registers of `HostDevices`, when mapped at its default page
+    enum InternalDevices { __DEV_page = 0xfe00,
+                           __DEV_conout = 0xfe00, __DEV_conin = 0xfe01, __DEV_conkey = 0xfe02,
+                           __DEV_cycles = 0xfe04, __DEV_time_ms = 0xfe08, __DEV_filein = 0xfe0c, __DEV_filestatus = 0xfe0d,
+                           __DEV_t1cl = 0xfe14, __DEV_t1ch = 0xfe15, __DEV_t1ll = 0xfe16, __DEV_t1lh = 0xfe17,
+                           __DEV_t2cl = 0xfe18, __DEV_t2ch = 0xfe19, __DEV_acr = 0xfe1b, __DEV_ifr = 0xfe1d, __DEV_ier = 0xfe1e,
+                           __DEV_bank0 = 0xfe20, __DEV_bank1 = 0xfe21, __DEV_bank2 = 0xfe22, __DEV_bank3 = 0xfe23,
+                           __DEV_bank4 = 0xfe24, __DEV_bank5 = 0xfe25,
+                           };
+};
+
+inline constexpr InstructionSet::InstructionInfo InstructionSet::legalInstructionsInfo[]
+{
+    { 0x69, 2, 2, ADC, Immediate },
+    { 0x65, 2, 3, ADC, ZeroPage },
+    { 0x75, 2, 4, ADC, ZeroPageX },
+    { 0x6d, 3, 4, ADC, Absolute },
+    { 0x7d, 3, 4, ADC, AbsoluteX },
+    { 0x79, 3, 4, ADC, AbsoluteY },
+    { 0x61, 2, 6, ADC, IndexedIndirectX },
+    { 0x71, 2, 5, ADC, IndirectIndexedY },
+
+    { 0x29, 2, 2, AND, Immediate },
+    { 0x25, 2, 3, AND, ZeroPage },
+    { 0x35, 2, 4, AND, ZeroPageX },
+    { 0x2d, 3, 4, AND, Absolute },
+    { 0x3d, 3, 4, AND, AbsoluteX },
+    { 0x39, 3, 4, AND, AbsoluteY },
+    { 0x21, 2, 6, AND, IndexedIndirectX },
+    { 0x31, 2, 5, AND, IndirectIndexedY },
+
+    { 0x0a, 1, 2, ASL, Accumulator },
+    { 0x06, 2, 5, ASL, ZeroPage },
+    { 0x16, 2, 6, ASL, ZeroPageX },
+    { 0x0e, 3, 6, ASL, Absolute },
+    { 0x1e, 3, 7, ASL, AbsoluteX },
+
+    { 0x90, 2, 2, BCC, Relative },
+    { 0xb0, 2, 2, BCS, Relative },
+    { 0xf0, 2, 2, BEQ, Relative },
+    { 0x30, 2, 2, BMI, Relative },
+    { 0xd0, 2, 2, BNE, Relative },
+    { 0x10, 2, 2, BPL, Relative },
+    { 0x50, 2, 2, BVC, Relative },
+    { 0x70, 2, 2, BVS, Relative },
+
+    { 0x24, 2, 3, BIT, ZeroPage },
+    { 0x2c, 3, 4, BIT, Absolute },
+
+    { 0x00, 1, 7, BRK, Implied },
+    { 0x18, 1, 2, CLC, Implied },
+    { 0xd8, 1, 2, CLD, Implied },
+    { 0x58, 1, 2, CLI, Implied },
+    { 0xb8, 1, 2, CLV, Implied },
+
+    { 0xc9, 2, 2, CMP, Immediate },
+    { 0xc5, 2, 3, CMP, ZeroPage },
+    { 0xd5, 2, 4, CMP, ZeroPageX },
+    { 0xcd, 3, 4, CMP, Absolute },
+    { 0xdd, 3, 4, CMP, AbsoluteX },
+    { 0xd9, 3, 4, CMP, AbsoluteY },
+    { 0xc1, 2, 6, CMP, IndexedIndirectX },
+    { 0xd1, 2, 5, CMP, IndirectIndexedY },
+
+    { 0xe0, 2, 2, CPX, Immediate },
+    { 0xe4, 2, 3, CPX, ZeroPage },
+    { 0xec, 3, 4, CPX, Absolute },
+
+    { 0xc0, 2, 2, CPY, Immediate },
+    { 0xc4, 2, 3, CPY, ZeroPage },
+    { 0xcc, 3, 4, CPY, Absolute },
+
+    { 0xc6, 2, 5, DEC, ZeroPage },
+    { 0xd6, 2, 6, DEC, ZeroPageX },
+    { 0xce, 3, 6, DEC, Absolute },
+    { 0xde, 3, 7, DEC, AbsoluteX },
+
+    { 0xca, 1, 2, DEX, Implied },
+    { 0x88, 1, 2, DEY, Implied },
+
+    { 0x49, 2, 2, EOR, Immediate },
+    { 0x45, 2, 3, EOR, ZeroPage },
+    { 0x55, 2, 4, EOR, ZeroPageX },
+    { 0x4d, 3, 4, EOR, Absolute },
+    { 0x5d, 3, 4, EOR, AbsoluteX },
+    { 0x59, 3, 4, EOR, AbsoluteY },
+    { 0x41, 2, 6, EOR, IndexedIndirectX },
+    { 0x51, 2, 5, EOR, IndirectIndexedY },
+
+    { 0xe6, 2, 5, INC, ZeroPage },
+    { 0xf6, 2, 6, INC, ZeroPageX },
+    { 0xee, 3, 6, INC, Absolute },
+    { 0xfe, 3, 7, INC, AbsoluteX },
+
+    { 0xe8, 1, 2, INX, Implied },
+    { 0xc8, 1, 2, INY, Implied },
+
+    { 0x4c, 3, 3, JMP, Absolute },
+    { 0x6c, 3, 5, JMP, Indirect },
+    { 0x20, 3, 6, JSR, Absolute },
+
+    { 0xa9, 2, 2, LDA, Immediate },
+    { 0xa5, 2, 3, LDA, ZeroPage },
+    { 0xb5, 2, 4, LDA, ZeroPageX },
+    { 0xad, 3, 4, LDA, Absolute },
+    { 0xbd, 3, 4, LDA, AbsoluteX },
+    { 0xb9, 3, 4, LDA, AbsoluteY },
+    { 0xa1, 2, 6, LDA, IndexedIndirectX },
+    { 0xb1, 2, 5, LDA, IndirectIndexedY },
+
+    { 0xa2, 2, 2, LDX, Immediate },
+    { 0xa6, 2, 3, LDX, ZeroPage },
+    { 0xb6, 2, 4, LDX, ZeroPageY },
+    { 0xae, 3, 4, LDX, Absolute },
+    { 0xbe, 3, 4, LDX, AbsoluteY },
+
+    { 0xa0, 2, 2, LDY, Immediate },
+    { 0xa4, 2, 3, LDY, ZeroPage },
+    { 0xb4, 2, 4, LDY, ZeroPageX },
+    { 0xac, 3, 4, LDY, Absolute },
+    { 0xbc, 3, 4, LDY, AbsoluteX },
+
+    { 0x4a, 1, 2, LSR, Accumulator },
+    { 0x46, 2, 5, LSR, ZeroPage },
+    { 0x56, 2, 6, LSR, ZeroPageX },
+    { 0x4e, 3, 6, LSR, Absolute },
+    { 0x5e, 3, 7, LSR, AbsoluteX },
+
+    { 0xea, 1, 2, NOP, Implied },
+
+    { 0x09, 2, 2, ORA, Immediate },
+    { 0x05, 2, 3, ORA, ZeroPage },
+    { 0x15, 2, 4, ORA, ZeroPageX },
+    { 0x0d, 3, 4, ORA, Absolute },
+    { 0x1d, 3, 4, ORA, AbsoluteX },
+    { 0x19, 3, 4, ORA, AbsoluteY },
+    { 0x01, 2, 6, ORA, IndexedIndirectX },
+    { 0x11, 2, 5, ORA, IndirectIndexedY },
+
+    { 0x48, 1, 3, PHA, Implied },
+    { 0x08, 1, 3, PHP, Implied },
+    { 0x68, 1, 4, PLA, Implied },
+    { 0x28, 1, 4, PLP, Implied },
+
+    { 0x2a, 1, 2, ROL, Accumulator },
+    { 0x26, 2, 5, ROL, ZeroPage },
+    { 0x36, 2, 6, ROL, ZeroPageX },
+    { 0x2e, 3, 6, ROL, Absolute },
+    { 0x3e, 3, 7, ROL, AbsoluteX },
+
+    { 0x6a, 1, 2, ROR, Accumulator },
+    { 0x66, 2, 5, ROR, ZeroPage },
+    { 0x76, 2, 6, ROR, ZeroPageX },
+    { 0x6e, 3, 6, ROR, Absolute },
+    { 0x7e, 3, 7, ROR, AbsoluteX },
+
+    { 0x40, 1, 6, RTI, Implied },
+    { 0x60, 1, 6, RTS, Implied },
+
+    { 0xe9, 2, 2, SBC, Immediate },
+    { 0xe5, 2, 3, SBC, ZeroPage },
+    { 0xf5, 2, 4, SBC, ZeroPageX },
+    { 0xed, 3, 4, SBC, Absolute },
+    { 0xfd, 3, 4, SBC, AbsoluteX },
+    { 0xf9, 3, 4, SBC, AbsoluteY },
+    { 0xe1, 2, 6, SBC, IndexedIndirectX },
+    { 0xf1, 2, 5, SBC, IndirectIndexedY },
+
+    { 0x38, 1, 2, SEC, Implied },
+    { 0xf8, 1, 2, SED, Implied },
+    { 0x78, 1, 2, SEI, Implied },
+
+    { 0x85, 2, 3, STA, ZeroPage },
+    { 0x95, 2, 4, STA, ZeroPageX },
+    { 0x8d, 3, 4, STA, Absolute },
+    { 0x9d, 3, 5, STA, AbsoluteX },
+    { 0x99, 3, 5, STA, AbsoluteY },
+    { 0x81, 2, 6, STA, IndexedIndirectX },
+    { 0x91, 2, 6, STA, IndirectIndexedY },
+
+    { 0x86, 2, 3, STX, ZeroPage },
+    { 0x96, 2, 4, STX, ZeroPageY },
+    { 0x8e, 3, 4, STX, Absolute },
+
+    { 0x84, 2, 3, STY, ZeroPage },
+    { 0x94, 2, 4, STY, ZeroPageX },
+    { 0x8c, 3, 4, STY, Absolute },
+
+    { 0xaa, 1, 2, TAX, Implied },
+    { 0xa8, 1, 2, TAY, Implied },
+    { 0xba, 1, 2, TSX, Implied },
+    { 0x8a, 1, 2, TXA, Implied },
+    { 0x9a, 1, 2, TXS, Implied },
+    { 0x98, 1, 2, TYA, Implied },
+};
+
+inline constexpr std::array<InstructionSet::InstructionInfo, InstructionSet::TotalInstructions> InstructionSet::instructionsInfo = []()
+{
+    std::array<InstructionInfo, TotalInstructions> instructionsInfo{};
+    for (int i = 0; i < TotalInstructions; i++)
+        instructionsInfo[i].opcodeByte = i;
+    for (const InstructionInfo &info : legalInstructionsInfo)
+        instructionsInfo[info.opcodeByte] = info;
+    return instructionsInfo;
+}();
+
+
+#endif // INSTRUCTIONSET_H
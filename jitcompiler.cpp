@@ -0,0 +1,818 @@
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+#include "jitcompiler.h"
+
+// native code generation: x86-64 System V (Linux) only
+#if defined(PROCESSORCORE_JIT) && defined(__x86_64__) && defined(__linux__)
+#define USE_JIT 1
+#include <sys/mman.h>
+#else
+#define USE_JIT 0
+#endif
+
+using Operation = ProcessorCore::Operation;
+using AddressingMode = ProcessorCore::AddressingMode;
+using InstructionInfo = ProcessorCore::InstructionInfo;
+using StatusFlags = ProcessorCore::StatusFlags;
+
+// N and Z for each result byte, for compiled code to look up
+static constexpr std::array<uint8_t, 0x100> nzFlags = []() {
+    std::array<uint8_t, 0x100> flags {};
+    for (int value = 0; value < 0x100; value++)
+        flags[value] = ProcessorCore::nzStatusFlags(value);
+    return flags;
+}();
+
+#if USE_JIT
+
+//
+// X64Emitter Class
+//
+// Just the x86-64 instruction forms `JitCompiler` needs, all memory operands as [base + index + disp32]
+//
+namespace {
+
+enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+enum AluOp { ADD = 0, OR = 1, AND = 4, SUB = 5, XOR = 6, CMP = 7 };
+enum Condition { CondB = 0x2, CondAE = 0x3, CondE = 0x4, CondNE = 0x5 };
+
+struct Mem
+{
+    int base, index;
+    int32_t disp;
+    Mem(int base, int32_t disp) : base(base), index(-1), disp(disp) {}
+    Mem(int base, int index, int32_t disp) : base(base), index(index), disp(disp) {}
+};
+
+class X64Emitter
+{
+public:
+    std::vector<uint8_t> code;
+
+    size_t size() const { return code.size(); }
+    void byte(uint8_t value) { code.push_back(value); }
+    void word(uint16_t value) { byte(value); byte(value >> 8); }
+    void dword(uint32_t value) { word(value); word(value >> 16); }
+    void qword(uint64_t value) { dword(value); dword(value >> 32); }
+
+    void movRI(int dst, uint32_t imm) { rex(false, 0, 0, dst); byte(0xb8 + (dst & 7)); dword(imm); }
+    void movRI64(int dst, uint64_t imm) { rex(true, 0, 0, dst); byte(0xb8 + (dst & 7)); qword(imm); }
+    void movRR(int dst, int src, bool wide = false) { rex(wide, src, 0, dst); byte(0x89); modrmReg(src, dst); }
+    void aluRR(AluOp op, int dst, int src) { rex(false, src, 0, dst); byte(op << 3 | 0x01); modrmReg(src, dst); }
+    void aluRI(AluOp op, int dst, uint32_t imm, bool wide = false) { rex(wide, 0, 0, dst); byte(0x81); modrmReg(op, dst); dword(imm); }
+    void testRR(int dst, int src) { rex(false, src, 0, dst); byte(0x85); modrmReg(src, dst); }
+    void notR(int dst) { rex(false, 0, 0, dst); byte(0xf7); modrmReg(2, dst); }
+    void shlRI(int dst, uint8_t count) { rex(false, 0, 0, dst); byte(0xc1); modrmReg(4, dst); byte(count); }
+    void shrRI(int dst, uint8_t count) { rex(false, 0, 0, dst); byte(0xc1); modrmReg(5, dst); byte(count); }
+    void setcc(Condition cond, int dst) { rex(false, 0, 0, dst, dst >= RSP); byte(0x0f); byte(0x90 + cond); modrmReg(0, dst); }
+    void movzxRR8(int dst, int src) { rex(false, dst, 0, src, src >= RSP); byte(0x0f); byte(0xb6); modrmReg(dst, src); }
+
+    void movRM(int dst, const Mem &m, bool wide = false) { rexMem(wide, dst, m); byte(0x8b); mem(dst, m); }
+    void aluRM(AluOp op, int dst, const Mem &m, bool wide = false) { rexMem(wide, dst, m); byte(op << 3 | 0x03); mem(dst, m); }
+    void movzxRM8(int dst, const Mem &m) { rexMem(false, dst, m); byte(0x0f); byte(0xb6); mem(dst, m); }
+    void movM8R(const Mem &m, int src) { rexMem(false, src, m, src >= RSP); byte(0x88); mem(src, m); }
+    void movM16I(const Mem &m, uint16_t imm) { byte(0x66); rexMem(false, 0, m); byte(0xc7); mem(0, m); word(imm); }
+    void movM16R(const Mem &m, int src) { byte(0x66); rexMem(false, src, m); byte(0x89); mem(src, m); }
+    void aluMI(AluOp op, const Mem &m, uint32_t imm, bool wide = false) { rexMem(wide, 0, m); byte(0x81); mem(op, m); dword(imm); }
+    void aluM8I(AluOp op, const Mem &m, uint8_t imm) { rexMem(false, 0, m); byte(0x80); mem(op, m); byte(imm); }
+
+    void push(int reg) { rex(false, 0, 0, reg); byte(0x50 + (reg & 7)); }
+    void pop(int reg) { rex(false, 0, 0, reg); byte(0x58 + (reg & 7)); }
+    void callR(int reg) { rex(false, 0, 0, reg); byte(0xff); modrmReg(2, reg); }
+    void ret() { byte(0xc3); }
+
+    // jumps return the position of their rel32, for `patch()`
+    size_t jcc(Condition cond) { byte(0x0f); byte(0x80 + cond); dword(0); return size() - 4; }
+    size_t jmp() { byte(0xe9); dword(0); return size() - 4; }
+    void patch(size_t rel32, size_t target)
+    {
+        int32_t rel = static_cast<int32_t>(target - (rel32 + 4));
+        std::memcpy(code.data() + rel32, &rel, sizeof(rel));
+    }
+
+private:
+    void rex(bool wide, int reg, int index, int base, bool byteRegs = false)
+    {
+        uint8_t prefix = 0x40 | (wide ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((index & 8) ? 0x02 : 0) | ((base & 8) ? 0x01 : 0);
+        if (prefix != 0x40 || byteRegs)
+            byte(prefix);
+    }
+    void rexMem(bool wide, int reg, const Mem &m, bool byteRegs = false) { rex(wide, reg, m.index < 0 ? 0 : m.index, m.base, byteRegs); }
+    void modrmReg(int reg, int rm) { byte(0xc0 | (reg & 7) << 3 | (rm & 7)); }
+    void mem(int reg, const Mem &m)
+    {
+        if (m.index < 0)
+        {
+            byte(0x80 | (reg & 7) << 3 | (m.base & 7));
+            if ((m.base & 7) == RSP)
+                byte(0x24);
+        }
+        else
+        {
+            byte(0x84 | (reg & 7) << 3);
+            byte((m.index & 7) << 3 | (m.base & 7));
+        }
+        dword(m.disp);
+    }
+};
+
+//
+// Register allocation in compiled code
+// A, X, Y and P live zero-extended in callee-saved registers, so helper calls need not spill them
+//
+constexpr int StateReg = R15, NZFlagsReg = R14;
+constexpr int AReg = RBX, XReg = RBP, YReg = R12, PReg = R13;
+
+constexpr int32_t MemoryOffset = offsetof(CpuState, memory);
+const Mem programCounterMem(StateReg, offsetof(CpuState, programCounter));
+const Mem stackRegisterMem(StateReg, offsetof(CpuState, stackRegister));
+const Mem elapsedCyclesMem(StateReg, offsetof(CpuState, elapsedCycles));
+const Mem clearedElapsedCyclesMem(StateReg, offsetof(CpuState, clearedElapsedCycles));
+const Mem instructionCountMem(StateReg, offsetof(CpuState, instructionCount));
+
+//
+// BlockTranslator Class
+//
+// Translates one basic block
+// Every exit back to `JitCompiler::run()` stores the 6502 PC and adds the cycles/instructions
+// executed up to that point, all known at translation time; only page crossings and taken branches
+// add cycles at run time
+//
+class BlockTranslator
+{
+public:
+    BlockTranslator(ProcessorCore *core, const bool *tracking, const uint8_t *pageFlags, uint8_t devicePage, const bool *stopped,
+                    const uint64_t *nextEventCycle, const uint32_t *irqSources)
+        : core(core), tracking(tracking), pageFlags(pageFlags), devicePage(devicePage), stopped(stopped),
+          nextEventCycle(nextEventCycle), irqSources(irqSources) {}
+
+    bool translate(const ProcessorCore::BasicBlock &block, int (*setMemoryByte)(ProcessorCore *, uint32_t, uint32_t));
+    const std::vector<uint8_t> &code() const { return e.code; }
+
+private:
+    ProcessorCore *core;
+    const bool *tracking;
+    const uint8_t *pageFlags;
+    uint8_t devicePage;     // `ProcessorCore::DevicePage`, or 0 when the core has no devices to check for
+    const bool *stopped;
+    const uint64_t *nextEventCycle;
+    const uint32_t *irqSources;
+    int (*setMemoryByte)(ProcessorCore *, uint32_t, uint32_t);
+
+    X64Emitter e;
+    size_t bodyStart;
+    uint16_t blockStartAddress;
+    std::vector<size_t> epilogueJumps;
+    struct ExitStub { size_t rel32; uint16_t programCounter; int instructions; uint32_t cycles; bool interpretNext; };
+    std::vector<ExitStub> exitStubs;
+
+    // state of the instruction being translated
+    uint16_t address, nextAddress;
+    int instructionsBefore;
+    uint32_t cyclesBefore, cyclesAfter;
+
+    bool translateInstruction(const InstructionInfo &info, uint16_t operand);
+    void emitExit(uint16_t programCounter, int instructions, uint32_t cycles, bool interpretNext = false);
+    void emitLoopToStart(int instructions, uint32_t cycles);
+    void emitInterruptDisableClearedExit();
+    void emitSetNZ(int reg);
+    void emitDevicePageExit();
+    void emitAddressToEax(AddressingMode mode, uint16_t operand, bool pageCrossPenalty);
+    void emitReadToEax(AddressingMode mode, uint16_t operand, bool pageCrossPenalty);
+    void emitWriteEcxToEax(bool checkSelfModifying);
+    void emitPushEcx(bool checkSelfModifying);
+    void emitAddPageCrossPenalty(int baseReg);
+};
+
+bool BlockTranslator::translate(const ProcessorCore::BasicBlock &block, int (*setMemoryByte)(ProcessorCore *, uint32_t, uint32_t))
+{
+    // an instruction wrapping round the end of memory is left out of its block, for the interpreter
+    if (block.instructions.empty())
+        return false;
+    this->setMemoryByte = setMemoryByte;
+    blockStartAddress = block.startAddress;
+
+    // prologue: 6 pushes plus the return address leaves rsp 16-byte aligned after `sub rsp, 8`
+    for (int reg : { RBX, RBP, R12, R13, R14, R15 })
+        e.push(reg);
+    e.aluRI(SUB, RSP, 8, true);
+    e.movRR(StateReg, RDI, true);
+    e.movRR(NZFlagsReg, RSI, true);
+    e.movzxRM8(AReg, Mem(StateReg, offsetof(CpuState, accumulator)));
+    e.movzxRM8(XReg, Mem(StateReg, offsetof(CpuState, xregister)));
+    e.movzxRM8(YReg, Mem(StateReg, offsetof(CpuState, yregister)));
+    e.movzxRM8(PReg, Mem(StateReg, offsetof(CpuState, statusFlags)));
+    bodyStart = e.size();
+
+    address = block.startAddress;
+    instructionsBefore = 0;
+    cyclesBefore = 0;
+    bool ended = false;
+    for (const ProcessorCore::DecodedInstruction &decoded : block.instructions)
+    {
+        const InstructionInfo &info(InstructionSet::getInstructionInfo(decoded.handlerIndex));
+        nextAddress = address + info.bytes;
+        cyclesAfter = cyclesBefore + info.cycles;
+        if (!translateInstruction(info, decoded.operand))
+        {
+            // leave this instruction to the interpreter
+            if (instructionsBefore == 0)
+                return false;
+            emitExit(address, instructionsBefore, cyclesBefore, true);
+            ended = true;
+            break;
+        }
+        instructionsBefore++;
+        cyclesBefore = cyclesAfter;
+        address = nextAddress;
+        if (info.operation == Operation::JMP || info.operation == Operation::JSR || info.operation == Operation::RTS
+            || info.addrMode == AddressingMode::Relative)
+        {
+            ended = true;
+            break;
+        }
+    }
+    if (!ended)
+        emitExit(address, instructionsBefore, cyclesBefore);
+
+    for (const ExitStub &stub : exitStubs)
+    {
+        e.patch(stub.rel32, e.size());
+        emitExit(stub.programCounter, stub.instructions, stub.cycles, stub.interpretNext);
+    }
+
+    for (size_t jump : epilogueJumps)
+        e.patch(jump, e.size());
+    e.movM8R(Mem(StateReg, offsetof(CpuState, accumulator)), AReg);
+    e.movM8R(Mem(StateReg, offsetof(CpuState, xregister)), XReg);
+    e.movM8R(Mem(StateReg, offsetof(CpuState, yregister)), YReg);
+    e.movM8R(Mem(StateReg, offsetof(CpuState, statusFlags)), PReg);
+    e.aluRI(ADD, RSP, 8, true);
+    for (int reg : { R15, R14, R13, R12, RBP, RBX })
+        e.pop(reg);
+    e.ret();
+    return true;
+}
+
+void BlockTranslator::emitExit(uint16_t programCounter, int instructions, uint32_t cycles, bool interpretNext /*= false*/)
+{
+    // returns whether `JitCompiler::run()` is to interpret the instruction at `programCounter`
+    e.movRI(RAX, interpretNext);
+    e.movM16I(programCounterMem, programCounter);
+    if (cycles != 0)
+        e.aluMI(ADD, elapsedCyclesMem, cycles);
+    if (instructions != 0)
+        e.aluMI(ADD, instructionCountMem, instructions, true);
+    epilogueJumps.push_back(e.jmp());
+}
+
+void BlockTranslator::emitLoopToStart(int instructions, uint32_t cycles)
+{
+    // a block which jumps back to its own start loops without leaving native code, unless the run has been stopped
+    // or an event is due
+    e.aluMI(ADD, elapsedCyclesMem, cycles);
+    e.aluMI(ADD, instructionCountMem, instructions, true);
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(stopped));
+    e.aluM8I(CMP, Mem(RSI, 0), 0);
+    exitStubs.push_back({ e.jcc(CondNE), blockStartAddress, 0, 0, false });
+    e.movRM(RAX, elapsedCyclesMem);
+    e.aluRM(ADD, RAX, clearedElapsedCyclesMem, true);
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(nextEventCycle));
+    e.aluRM(CMP, RAX, Mem(RSI, 0), true);
+    exitStubs.push_back({ e.jcc(CondAE), blockStartAddress, 0, 0, false });
+    e.patch(e.jmp(), bodyStart);
+}
+
+void BlockTranslator::emitInterruptDisableClearedExit()
+{
+    // with an IRQ asserted, back to `JitCompiler::run()` after the instruction, to take it
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(irqSources));
+    e.aluMI(CMP, Mem(RSI, 0), 0);
+    exitStubs.push_back({ e.jcc(CondNE), nextAddress, instructionsBefore + 1, cyclesAfter, false });
+}
+
+void BlockTranslator::emitSetNZ(int reg)
+{
+    e.aluRI(AND, PReg, ~(StatusFlags::Negative | StatusFlags::Zero) & 0xff);
+    e.movzxRM8(RDX, Mem(NZFlagsReg, reg, 0));
+    e.aluRR(OR, PReg, RDX);
+}
+
+void BlockTranslator::emitAddPageCrossPenalty(int baseReg)
+{
+    // baseReg ^= eax; if ((baseReg & 0xff00) != 0) elapsedCycles++
+    e.aluRR(XOR, baseReg, RAX);
+    e.aluRI(AND, baseReg, 0xff00);
+    size_t skip = e.jcc(CondE);
+    e.aluMI(ADD, elapsedCyclesMem, 1);
+    e.patch(skip, e.size());
+}
+
+void BlockTranslator::emitDevicePageExit()
+{
+    // an address computed at run time which lands in a device page leaves the whole instruction to the interpreter
+    if (devicePage == 0)
+        return;
+    e.movRR(RDX, RAX);
+    e.shrRI(RDX, 8);
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(pageFlags));
+    e.movzxRM8(RDX, Mem(RSI, RDX, 0));
+    e.aluRI(AND, RDX, devicePage);
+    exitStubs.push_back({ e.jcc(CondNE), address, instructionsBefore, cyclesBefore, true });
+}
+
+void BlockTranslator::emitAddressToEax(AddressingMode mode, uint16_t operand, bool pageCrossPenalty)
+{
+    switch (mode)
+    {
+    case AddressingMode::ZeroPage: case AddressingMode::Absolute:
+        e.movRI(RAX, operand);
+        break;
+    case AddressingMode::ZeroPageX: case AddressingMode::ZeroPageY:
+        e.movRR(RAX, mode == AddressingMode::ZeroPageX ? XReg : YReg);
+        e.aluRI(ADD, RAX, operand);
+        e.aluRI(AND, RAX, 0xff);
+        emitDevicePageExit();
+        break;
+    case AddressingMode::AbsoluteX: case AddressingMode::AbsoluteY:
+        e.movRR(RAX, mode == AddressingMode::AbsoluteX ? XReg : YReg);
+        e.aluRI(ADD, RAX, operand);
+        e.aluRI(AND, RAX, 0xffff);
+        emitDevicePageExit();
+        if (pageCrossPenalty)
+        {
+            e.movRI(RCX, operand);
+            emitAddPageCrossPenalty(RCX);
+        }
+        break;
+    case AddressingMode::IndexedIndirectX:
+        e.movRR(RCX, XReg);
+        e.aluRI(ADD, RCX, operand);
+        e.aluRI(AND, RCX, 0xff);
+        e.movzxRM8(RAX, Mem(StateReg, RCX, MemoryOffset));
+        e.aluRI(ADD, RCX, 1);
+        e.aluRI(AND, RCX, 0xff);
+        e.movzxRM8(RCX, Mem(StateReg, RCX, MemoryOffset));
+        e.shlRI(RCX, 8);
+        e.aluRR(OR, RAX, RCX);
+        emitDevicePageExit();
+        break;
+    case AddressingMode::IndirectIndexedY:
+        e.movzxRM8(RCX, Mem(StateReg, MemoryOffset + operand));
+        e.movzxRM8(RDX, Mem(StateReg, MemoryOffset + static_cast<uint8_t>(operand + 1)));
+        e.shlRI(RDX, 8);
+        e.aluRR(OR, RCX, RDX);
+        e.movRR(RAX, RCX);
+        e.aluRR(ADD, RAX, YReg);
+        e.aluRI(AND, RAX, 0xffff);
+        emitDevicePageExit();
+        if (pageCrossPenalty)
+            emitAddPageCrossPenalty(RCX);
+        break;
+    default:
+        break;
+    }
+}
+
+void BlockTranslator::emitReadToEax(AddressingMode mode, uint16_t operand, bool pageCrossPenalty)
+{
+    if (mode == AddressingMode::Immediate)
+        e.movRI(RAX, operand);
+    else if (mode == AddressingMode::ZeroPage || mode == AddressingMode::Absolute)
+        e.movzxRM8(RAX, Mem(StateReg, MemoryOffset + operand));
+    else
+    {
+        emitAddressToEax(mode, operand, pageCrossPenalty);
+        e.movzxRM8(RAX, Mem(StateReg, RAX, MemoryOffset));
+    }
+}
+
+void BlockTranslator::emitWriteEcxToEax(bool checkSelfModifying)
+{
+    // straight into memory unless the page has flags (code, ...) or `ProcessorCore::MemoryWrites` is tracking
+    e.movRR(RDX, RAX);
+    e.shrRI(RDX, 8);
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(pageFlags));
+    e.aluM8I(CMP, Mem(RSI, RDX, 0), 0);
+    size_t slow1 = e.jcc(CondNE);
+    e.movRI64(RSI, reinterpret_cast<uint64_t>(tracking));
+    e.aluM8I(CMP, Mem(RSI, 0), 0);
+    size_t slow2 = e.jcc(CondNE);
+    e.movM8R(Mem(StateReg, RAX, MemoryOffset), RCX);
+    size_t done = e.jmp();
+
+    e.patch(slow1, e.size());
+    e.patch(slow2, e.size());
+    e.movRR(RDX, RCX);
+    e.movRR(RSI, RAX);
+    e.movRI64(RDI, reinterpret_cast<uint64_t>(core));
+    e.movRI64(RAX, reinterpret_cast<uint64_t>(setMemoryByte));
+    e.callR(RAX);
+    if (checkSelfModifying)
+    {
+        // this block has been overwritten: leave after the writing instruction
+        e.testRR(RAX, RAX);
+        exitStubs.push_back({ e.jcc(CondNE), nextAddress, instructionsBefore + 1, cyclesAfter, false });
+    }
+    e.patch(done, e.size());
+}
+
+void BlockTranslator::emitPushEcx(bool checkSelfModifying)
+{
+    e.movzxRM8(RAX, stackRegisterMem);
+    e.aluRI(ADD, RAX, ProcessorCore::StackBottom);
+    e.aluM8I(SUB, stackRegisterMem, 1);
+    emitWriteEcxToEax(checkSelfModifying);
+}
+
+bool BlockTranslator::translateInstruction(const InstructionInfo &info, uint16_t operand)
+{
+    if (!info.isValid())
+        return false;
+    const Operation operation(info.operation);
+    const AddressingMode mode(info.addrMode);
+    const bool pageCrossPenalty = ProcessorCore::operationHasPageCrossPenalty(operation, mode);
+    if ((mode == AddressingMode::ZeroPage || mode == AddressingMode::Absolute) && (pageFlags[operand >> 8] & devicePage)
+        && operation != Operation::JMP && operation != Operation::JSR)
+        return false;
+
+    switch (operation)
+    {
+    case Operation::LDA: case Operation::LDX: case Operation::LDY:
+    {
+        const int reg = operation == Operation::LDA ? AReg : operation == Operation::LDX ? XReg : YReg;
+        emitReadToEax(mode, operand, pageCrossPenalty);
+        e.movRR(reg, RAX);
+        emitSetNZ(reg);
+        break;
+    }
+    case Operation::STA: case Operation::STX: case Operation::STY:
+        emitAddressToEax(mode, operand, false);
+        e.movRR(RCX, operation == Operation::STA ? AReg : operation == Operation::STX ? XReg : YReg);
+        emitWriteEcxToEax(true);
+        break;
+
+    case Operation::TAX: e.movRR(XReg, AReg); emitSetNZ(XReg); break;
+    case Operation::TAY: e.movRR(YReg, AReg); emitSetNZ(YReg); break;
+    case Operation::TXA: e.movRR(AReg, XReg); emitSetNZ(AReg); break;
+    case Operation::TYA: e.movRR(AReg, YReg); emitSetNZ(AReg); break;
+    case Operation::TSX: e.movzxRM8(XReg, stackRegisterMem); emitSetNZ(XReg); break;
+    case Operation::TXS: e.movM8R(stackRegisterMem, XReg); break;
+
+    case Operation::PHA: case Operation::PHP:
+        e.movRR(RCX, operation == Operation::PHA ? AReg : PReg);
+        if (operation == Operation::PHP)
+            e.aluRI(OR, RCX, StatusFlags::Break);
+        emitPushEcx(true);
+        break;
+    case Operation::PLA: case Operation::PLP:
+        e.aluM8I(ADD, stackRegisterMem, 1);
+        e.movzxRM8(RAX, stackRegisterMem);
+        if (operation == Operation::PLA)
+        {
+            e.movzxRM8(AReg, Mem(StateReg, RAX, MemoryOffset + ProcessorCore::StackBottom));
+            emitSetNZ(AReg);
+        }
+        else
+        {
+            e.movzxRM8(PReg, Mem(StateReg, RAX, MemoryOffset + ProcessorCore::StackBottom));
+            e.aluRI(AND, PReg, ~StatusFlags::Break & 0xff);
+            emitInterruptDisableClearedExit();
+        }
+        break;
+
+    case Operation::AND: case Operation::EOR: case Operation::ORA:
+        emitReadToEax(mode, operand, pageCrossPenalty);
+        e.aluRR(operation == Operation::AND ? AND : operation == Operation::EOR ? XOR : OR, AReg, RAX);
+        emitSetNZ(AReg);
+        break;
+    case Operation::BIT:
+        emitReadToEax(mode, operand, false);
+        e.aluRI(AND, PReg, ~(StatusFlags::Negative | StatusFlags::Overflow | StatusFlags::Zero) & 0xff);
+        e.movRR(RCX, RAX);
+        e.aluRI(AND, RCX, StatusFlags::Negative | StatusFlags::Overflow);
+        e.aluRR(OR, PReg, RCX);
+        e.testRR(AReg, RAX);
+        e.setcc(CondE, RCX);
+        e.movzxRR8(RCX, RCX);
+        e.shlRI(RCX, 1);
+        e.aluRR(OR, PReg, RCX);
+        break;
+
+    case Operation::ADC: case Operation::SBC:
+        // SBC is ADC of the operand's complement, which also gives the same overflow calculation
+        emitReadToEax(mode, operand, pageCrossPenalty);
+        if (operation == Operation::SBC)
+            e.aluRI(XOR, RAX, 0xff);
+        e.movRR(RCX, PReg);
+        e.aluRI(AND, RCX, StatusFlags::Carry);
+        e.aluRR(ADD, RCX, RAX);
+        e.aluRR(ADD, RCX, AReg);
+        // V = ~(A ^ M) & (A ^ R) & 0x80
+        e.movRR(RDX, AReg);
+        e.aluRR(XOR, RDX, RAX);
+        e.notR(RDX);
+        e.movRR(RSI, AReg);
+        e.aluRR(XOR, RSI, RCX);
+        e.aluRR(AND, RDX, RSI);
+        e.aluRI(AND, RDX, 0x80);
+        e.shrRI(RDX, 1);
+        e.aluRI(AND, PReg, ~(StatusFlags::Overflow | StatusFlags::Carry) & 0xff);
+        e.aluRR(OR, PReg, RDX);
+        // C = sum > 0xff
+        e.movRR(RDX, RCX);
+        e.shrRI(RDX, 8);
+        e.aluRR(OR, PReg, RDX);
+        e.movzxRR8(AReg, RCX);
+        emitSetNZ(AReg);
+        break;
+    case Operation::CMP: case Operation::CPX: case Operation::CPY:
+    {
+        const int reg = operation == Operation::CMP ? AReg : operation == Operation::CPX ? XReg : YReg;
+        emitReadToEax(mode, operand, pageCrossPenalty);
+        e.aluRI(AND, PReg, ~(StatusFlags::Negative | StatusFlags::Zero | StatusFlags::Carry) & 0xff);
+        e.aluRR(CMP, reg, RAX);
+        e.setcc(CondAE, RCX);
+        e.movzxRR8(RCX, RCX);
+        e.aluRR(OR, PReg, RCX);
+        e.movRR(RCX, reg);
+        e.aluRR(SUB, RCX, RAX);
+        e.movzxRR8(RCX, RCX);
+        emitSetNZ(RCX);
+        break;
+    }
+
+    case Operation::INC: case Operation::DEC:
+        emitAddressToEax(mode, operand, false);
+        e.movzxRM8(RCX, Mem(StateReg, RAX, MemoryOffset));
+        e.aluRI(operation == Operation::INC ? ADD : SUB, RCX, 1);
+        e.aluRI(AND, RCX, 0xff);
+        emitSetNZ(RCX);
+        emitWriteEcxToEax(true);
+        break;
+    case Operation::INX: case Operation::INY: case Operation::DEX: case Operation::DEY:
+    {
+        const int reg = operation == Operation::INX || operation == Operation::DEX ? XReg : YReg;
+        e.aluRI(operation == Operation::INX || operation == Operation::INY ? ADD : SUB, reg, 1);
+        e.aluRI(AND, reg, 0xff);
+        emitSetNZ(reg);
+        break;
+    }
+
+    case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+    {
+        if (mode == AddressingMode::Accumulator)
+            e.movRR(RCX, AReg);
+        else
+        {
+            emitAddressToEax(mode, operand, false);
+            e.movzxRM8(RCX, Mem(StateReg, RAX, MemoryOffset));
+        }
+        const bool left = operation == Operation::ASL || operation == Operation::ROL;
+        // esi = old carry, in the bit it rotates into
+        if (operation == Operation::ROL || operation == Operation::ROR)
+        {
+            e.movRR(RSI, PReg);
+            e.aluRI(AND, RSI, StatusFlags::Carry);
+            if (operation == Operation::ROR)
+                e.shlRI(RSI, 7);
+        }
+        // edx = new carry
+        e.movRR(RDX, RCX);
+        if (left)
+            e.shrRI(RDX, 7);
+        else
+            e.aluRI(AND, RDX, 0x01);
+        e.aluRI(AND, PReg, ~(StatusFlags::Negative | StatusFlags::Zero | StatusFlags::Carry) & 0xff);
+        e.aluRR(OR, PReg, RDX);
+        if (left)
+        {
+            e.shlRI(RCX, 1);
+            e.aluRI(AND, RCX, 0xff);
+        }
+        else
+            e.shrRI(RCX, 1);
+        if (operation == Operation::ROL || operation == Operation::ROR)
+            e.aluRR(OR, RCX, RSI);
+        emitSetNZ(RCX);
+        if (mode == AddressingMode::Accumulator)
+            e.movRR(AReg, RCX);
+        else
+            emitWriteEcxToEax(true);
+        break;
+    }
+
+    case Operation::CLC: e.aluRI(AND, PReg, ~StatusFlags::Carry & 0xff); break;
+    case Operation::SEC: e.aluRI(OR, PReg, StatusFlags::Carry); break;
+    case Operation::CLI: e.aluRI(AND, PReg, ~StatusFlags::InterruptDisable & 0xff); emitInterruptDisableClearedExit(); break;
+    case Operation::SEI: e.aluRI(OR, PReg, StatusFlags::InterruptDisable); break;
+    case Operation::CLV: e.aluRI(AND, PReg, ~StatusFlags::Overflow & 0xff); break;
+    case Operation::NOP: break;
+
+    case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+    case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+    {
+        const uint8_t flagBit = (operation == Operation::BCC || operation == Operation::BCS) ? StatusFlags::Carry
+                                : (operation == Operation::BEQ || operation == Operation::BNE) ? StatusFlags::Zero
+                                : (operation == Operation::BMI || operation == Operation::BPL) ? StatusFlags::Negative
+                                : StatusFlags::Overflow;
+        const bool branchIfSet = operation == Operation::BCS || operation == Operation::BEQ || operation == Operation::BMI || operation == Operation::BVS;
+        const uint16_t target = operand;
+        if (ProcessorCore::isInternalJSRAddress(target))
+            return false;
+        e.movRR(RCX, PReg);
+        e.aluRI(AND, RCX, flagBit);
+        size_t notTaken = e.jcc(branchIfSet ? CondE : CondNE);
+        const uint32_t takenCycles = cyclesAfter + 1 + ((target & 0xff00) != (nextAddress & 0xff00) ? 1 : 0);
+        if (target == blockStartAddress)
+            emitLoopToStart(instructionsBefore + 1, takenCycles);
+        else
+            emitExit(target, instructionsBefore + 1, takenCycles);
+        e.patch(notTaken, e.size());
+        emitExit(nextAddress, instructionsBefore + 1, cyclesAfter);
+        break;
+    }
+    case Operation::JMP:
+        if (mode != AddressingMode::Absolute || ProcessorCore::isInternalJSRAddress(operand))
+            return false;
+        if (operand == blockStartAddress)
+            emitLoopToStart(instructionsBefore + 1, cyclesAfter);
+        else
+            emitExit(operand, instructionsBefore + 1, cyclesAfter);
+        break;
+    case Operation::JSR:
+    {
+        if (ProcessorCore::isInternalJSRAddress(operand))
+            return false;
+        // the block ends here anyway, so the pushes need no self-modifying check
+        const uint16_t returnAddress = nextAddress - 1;
+        e.movRI(RCX, returnAddress >> 8);
+        emitPushEcx(false);
+        e.movRI(RCX, returnAddress & 0xff);
+        emitPushEcx(false);
+        emitExit(operand, instructionsBefore + 1, cyclesAfter);
+        break;
+    }
+    case Operation::RTS:
+    {
+        // peek at the return address: returning to `__JSR_terminate` or into the trap page is left to the interpreter
+        e.movzxRM8(RCX, stackRegisterMem);
+        e.aluRI(ADD, RCX, 1);
+        e.aluRI(AND, RCX, 0xff);
+        e.movzxRM8(RAX, Mem(StateReg, RCX, MemoryOffset + ProcessorCore::StackBottom));
+        e.aluRI(ADD, RCX, 1);
+        e.aluRI(AND, RCX, 0xff);
+        e.movzxRM8(RCX, Mem(StateReg, RCX, MemoryOffset + ProcessorCore::StackBottom));
+        e.shlRI(RCX, 8);
+        e.aluRR(OR, RAX, RCX);
+        e.aluRI(ADD, RAX, 1);
+        e.aluRI(AND, RAX, 0xffff);
+        e.testRR(RAX, RAX);
+        exitStubs.push_back({ e.jcc(CondE), address, instructionsBefore, cyclesBefore, true });
+        e.aluRI(CMP, RAX, ProcessorCore::TrapPage);
+        exitStubs.push_back({ e.jcc(CondAE), address, instructionsBefore, cyclesBefore, true });
+        e.aluM8I(ADD, stackRegisterMem, 2);
+        e.movM16R(programCounterMem, RAX);
+        e.aluMI(ADD, elapsedCyclesMem, cyclesAfter);
+        e.aluMI(ADD, instructionCountMem, instructionsBefore + 1, true);
+        e.movRI(RAX, 0);
+        epilogueJumps.push_back(e.jmp());
+        break;
+    }
+
+    default:
+        // CLD/SED (unimplemented), BRK, RTI, illegal opcodes
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+#endif // USE_JIT
+
+
+//
+// JitCompiler Class
+//
+
+JitCompiler::JitCompiler(ProcessorCore *core)
+{
+    this->core = core;
+    _hitThreshold = 0;
+    _compiledBlockCount = 0;
+    codeBuffer = nullptr;
+    codeBufferUsed = 0;
+#if USE_JIT
+    void *buffer = mmap(nullptr, CodeBufferSize, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer != MAP_FAILED)
+        codeBuffer = static_cast<uint8_t *>(buffer);
+#endif
+}
+
+JitCompiler::~JitCompiler()
+{
+    clearCode();
+#if USE_JIT
+    if (codeBuffer != nullptr)
+        munmap(codeBuffer, CodeBufferSize);
+#endif
+}
+
+/*static*/ bool JitCompiler::isSupported()
+{
+    return USE_JIT != 0;
+}
+
+void JitCompiler::clearCode()
+{
+    for (auto &it : core->basicBlocks)
+    {
+        it.second->compiledCode = nullptr;
+        it.second->hits = 0;
+    }
+    codeBufferUsed = 0;
+    _compiledBlockCount = 0;
+}
+
+/*static*/ int JitCompiler::setMemoryByte(ProcessorCore *core, uint32_t address, uint32_t value)
+{
+    core->writeDataByteAt(address, value);
+    return core->invalidatedExecutingBasicBlock != nullptr;
+}
+
+const void *JitCompiler::installCode(const std::vector<uint8_t> &code)
+{
+#if USE_JIT
+    if (codeBuffer == nullptr || code.size() > CodeBufferSize)
+        return nullptr;
+    if (codeBufferUsed + code.size() > CodeBufferSize)
+        clearCode();
+    uint8_t *installed = codeBuffer + codeBufferUsed;
+    mprotect(codeBuffer, CodeBufferSize, PROT_READ | PROT_WRITE);
+    std::memcpy(installed, code.data(), code.size());
+    mprotect(codeBuffer, CodeBufferSize, PROT_READ | PROT_EXEC);
+    codeBufferUsed = (codeBufferUsed + code.size() + 15) & ~static_cast<size_t>(15);
+    _compiledBlockCount++;
+    return installed;
+#else
+    (void)code;
+    return nullptr;
+#endif
+}
+
+const void *JitCompiler::compile(const ProcessorCore::BasicBlock &block)
+{
+#if USE_JIT
+    // compiled code tests the stopped flag with a plain byte load
+    static_assert(sizeof(std::atomic<bool>) == sizeof(bool) && std::atomic<bool>::is_always_lock_free);
+    const uint8_t devicePage = core->hasDevices() ? ProcessorCore::DevicePage : 0;
+    BlockTranslator translator(core, &core->_memoryWrites.tracking, core->pageFlags, devicePage, reinterpret_cast<const bool *>(&core->_stopped),
+                               &core->_events.nextEventCycle(), &core->_irqSources);
+    if (!translator.translate(block, &JitCompiler::setMemoryByte))
+        return nullptr;
+    return installCode(translator.code());
+#else
+    (void)block;
+    return nullptr;
+#endif
+}
+
+void JitCompiler::run()
+{
+    // each compiled block returns here, with the state in `CpuState`, to look up the next one
+    // so whatever stops the run (internal JSRs, `setStopped()`) is seen between blocks
+    CpuState &state(core->_state);
+    while (!core->_stopped)
+    {
+        if (core->eventsDue())
+        {
+            // as the interpreter's loops would, with the flags lazy
+            core->unpackStatusFlags();
+            core->runDueEvents();
+            continue;
+        }
+        ProcessorCore::BasicBlock &block(core->findBasicBlock(state.programCounter));
+        if (block.compiledCode == nullptr && ++block.hits >= static_cast<uint32_t>(_hitThreshold))
+        {
+            block.compiledCode = compile(block);
+            block.hits = 0;
+        }
+        if (block.compiledCode != nullptr)
+        {
+            core->traceInstruction(state.statusFlags);
+            core->executingBasicBlock = &block;
+            bool interpretNext = reinterpret_cast<CompiledCode>(const_cast<void *>(block.compiledCode))(&state, nzFlags.data());
+            core->executingBasicBlock = nullptr;
+            core->invalidatedExecutingBasicBlock.reset();
+            if (core->_irqSources != 0)
+                core->interruptMayBeTaken();
+            if (interpretNext && !core->_stopped)
+                core->step();
+        }
+        else
+            core->runBasicBlock();
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef JITCOMPILER_H
+#define JITCOMPILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "processorcore.h"
+
+//
+// JitCompiler Class
+//
+// Translates hot `ProcessorCore::BasicBlock`s into native x86-64 code for `ProcessorCore::run()`
+// A block is compiled once it has been entered `hitThreshold()` times; until then, and for anything
+// the translation does not handle (internal JSRs, BRK, RTI, JMP (ind), illegal opcodes), the interpreter runs it
+// Only available on x86-64 Linux: elsewhere `isSupported()` is false and `run()` is never used
+//
+class JitCompiler
+{
+public:
+    explicit JitCompiler(ProcessorCore *core);
+    ~JitCompiler();
+
+    static bool isSupported();
+
+    int hitThreshold() const { return _hitThreshold; }
+    void setHitThreshold(int hitThreshold) { _hitThreshold = hitThreshold; }
+    int compiledBlockCount() const { return _compiledBlockCount; }
+
+    void run();
+
+private:
+    using CompiledCode = int (*)(CpuState *state, const uint8_t *nzFlags);
+
+    ProcessorCore *core;
+    int _hitThreshold;
+    int _compiledBlockCount;
+    uint8_t *codeBuffer;
+    size_t codeBufferUsed;
+    static constexpr size_t CodeBufferSize = 4 * 1024 * 1024;
+
+    const void *compile(const ProcessorCore::BasicBlock &block);
+    const void *installCode(const std::vector<uint8_t> &code);
+    void clearCode();
+    static int setMemoryByte(ProcessorCore *core, uint32_t address, uint32_t value);
+};
+
+#endif // JITCOMPILER_H
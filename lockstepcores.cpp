@@ -0,0 +1,688 @@
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "lockstepcores.h"
+
+using Operation = ProcessorCore::Operation;
+using AddressingMode = ProcessorCore::AddressingMode;
+using InstructionInfo = ProcessorCore::InstructionInfo;
+using LazyStatusFlags = ProcessorCore::LazyStatusFlags;
+using StatusFlags = ProcessorCore::StatusFlags;
+
+// `value` where `mask` is all 1s, else `old`: how the lanes not running keep what they have, without a branch
+static inline uint8_t blend(uint8_t mask, uint8_t value, uint8_t old)
+{
+    return (value & mask) | (old & ~mask);
+}
+
+template<Operation operation> using OperationConstant = std::integral_constant<Operation, operation>;
+template<uint8_t flagBit> using FlagConstant = std::integral_constant<uint8_t, flagBit>;
+
+
+//
+// LockstepCores Class
+//
+
+LockstepCores::LockstepCores(const std::shared_ptr<const ProcessorCore::SaveState> &image, int lanes /*= MaxLanes*/)
+    : _image(image), imageState(new CpuState), memory(new LaneBytes[CpuState::MemorySize])
+{
+    _lanes = std::clamp(lanes, 1, MaxLanes);
+    // the lanes' device page is plain RAM, so the scalar lanes' cores map no host devices, nor restore their state
+    if (image->devices != nullptr)
+    {
+        std::shared_ptr<ProcessorCore::SaveState> plainImage(std::make_shared<ProcessorCore::SaveState>(*image));
+        plainImage->devices.reset();
+        _image = plainImage;
+    }
+    std::memcpy(imageState.get(), image->registers, sizeof(image->registers));
+    for (int page = 0; page < 0x100; page++)
+        std::memcpy(imageState->memory + (page << 8), image->pages[page]->data(), image->pages[page]->size());
+    std::fill(std::begin(hosts), std::end(hosts), nullptr);
+    std::fill(std::begin(writtenPages), std::end(writtenPages), true);
+    restart();
+}
+
+LockstepCores::~LockstepCores() /*= default*/
+{
+}
+
+void LockstepCores::setHost(int lane, IProcessorCoreHost *host)
+{
+    hosts[lane] = host;
+    if (cores[lane] != nullptr)
+        cores[lane]->setHost(host);
+}
+
+void LockstepCores::restart()
+{
+    for (int page = 0; page < 0x100; page++)
+        if (writtenPages[page])
+        {
+            for (int address = page << 8; address < (page + 1) << 8; address++)
+                std::fill(std::begin(memory[address].lane), std::end(memory[address].lane), imageState->memory[address]);
+            writtenPages[page] = false;
+        }
+
+    const LazyStatusFlags lazyFlags(ProcessorCore::unpackLazyStatusFlags(imageState->statusFlags));
+    for (int lane = 0; lane < MaxLanes; lane++)
+    {
+        accumulators.lane[lane] = imageState->accumulator;
+        xregisters.lane[lane] = imageState->xregister;
+        yregisters.lane[lane] = imageState->yregister;
+        stackRegisters.lane[lane] = imageState->stackRegister;
+        statusFlagsBits.lane[lane] = imageState->statusFlags;
+        negatives.lane[lane] = lazyFlags.negative;
+        zeros.lane[lane] = lazyFlags.zero;
+        carries.lane[lane] = lazyFlags.carry;
+        overflows.lane[lane] = lazyFlags.overflow;
+        programCounters[lane] = imageState->programCounter;
+        elapsedCycles[lane] = imageState->elapsedCycles;
+        instructionCounts[lane] = imageState->instructionCount;
+        laneStates[lane] = lane < _lanes ? LockstepLane : UnusedLane;
+        errors[lane].clear();
+    }
+    _instructionsIssued = _lockstepInstructions = 0;
+}
+
+void LockstepCores::run()
+{
+    while (chooseGroup())
+        runGroup();
+    for (int lane = 0; lane < _lanes; lane++)
+        if (laneStates[lane] == ScalarLane)
+            try
+            {
+                cores[lane]->run();
+            }
+            catch (const ExecutionError &e)
+            {
+                errors[lane] = e.what();
+            }
+}
+
+uint8_t LockstepCores::accumulator(int lane) const
+{
+    return scalar(lane) ? cores[lane]->accumulator() : accumulators.lane[lane];
+}
+
+void LockstepCores::setAccumulator(int lane, uint8_t value)
+{
+    accumulators.lane[lane] = value;
+}
+
+uint8_t LockstepCores::xregister(int lane) const
+{
+    return scalar(lane) ? cores[lane]->xregister() : xregisters.lane[lane];
+}
+
+void LockstepCores::setXregister(int lane, uint8_t value)
+{
+    xregisters.lane[lane] = value;
+}
+
+uint8_t LockstepCores::yregister(int lane) const
+{
+    return scalar(lane) ? cores[lane]->yregister() : yregisters.lane[lane];
+}
+
+void LockstepCores::setYregister(int lane, uint8_t value)
+{
+    yregisters.lane[lane] = value;
+}
+
+uint8_t LockstepCores::stackRegister(int lane) const
+{
+    return scalar(lane) ? cores[lane]->stackRegister() : stackRegisters.lane[lane];
+}
+
+uint8_t LockstepCores::statusFlags(int lane) const
+{
+    return scalar(lane) ? cores[lane]->statusFlags() : ProcessorCore::packLazyStatusFlags(statusFlagsBits.lane[lane], laneLazyStatusFlags(lane));
+}
+
+uint16_t LockstepCores::programCounter(int lane) const
+{
+    return scalar(lane) ? cores[lane]->programCounter() : programCounters[lane];
+}
+
+uint64_t LockstepCores::totalElapsedCycles(int lane) const
+{
+    return scalar(lane) ? cores[lane]->totalElapsedCycles() : imageState->clearedElapsedCycles + elapsedCycles[lane];
+}
+
+uint64_t LockstepCores::instructionCount(int lane) const
+{
+    return scalar(lane) ? cores[lane]->instructionCount() : instructionCounts[lane];
+}
+
+uint8_t LockstepCores::memoryByteAt(int lane, uint16_t address) const
+{
+    return scalar(lane) ? cores[lane]->memoryByteAt(address) : memory[address].lane[lane];
+}
+
+void LockstepCores::setMemoryByteAt(int lane, uint16_t address, uint8_t value)
+{
+    memory[address].lane[lane] = value;
+    writtenPages[address >> 8] = true;
+}
+
+
+//
+// Groups
+// The lanes at the lowest program counter run as a group until a jump, branch, call or return, or until they reach
+// where other lanes wait, when the group is chosen again; lanes which go scalar leave the group where they are
+//
+
+bool LockstepCores::chooseGroup()
+{
+    int lowest = 0x10000;
+    for (int lane = 0; lane < _lanes; lane++)
+        if (laneStates[lane] == LockstepLane)
+            lowest = std::min<int>(lowest, programCounters[lane]);
+    if (lowest > 0xffff)
+        return false;
+
+    group = 0;
+    nextWaitingProgramCounter = 0x10000;
+    for (int lane = 0; lane < MaxLanes; lane++)
+    {
+        const bool running = laneStates[lane] == LockstepLane && programCounters[lane] == lowest;
+        if (running)
+            group |= 1u << lane;
+        else if (laneStates[lane] == LockstepLane)
+            nextWaitingProgramCounter = std::min<int>(nextWaitingProgramCounter, programCounters[lane]);
+        groupMask.lane[lane] = running ? 0xff : 0x00;
+    }
+    firstLane = __builtin_ctz(group);
+    return true;
+}
+
+void LockstepCores::leaveGroup(uint32_t lanes, uint16_t programCounter, LaneState state)
+{
+    for (int lane = 0; lane < MaxLanes; lane++)
+        if (lanes & (1u << lane))
+        {
+            programCounters[lane] = programCounter;
+            laneStates[lane] = state;
+            groupMask.lane[lane] = 0x00;
+            if (state == ScalarLane)
+                goScalar(lane);
+        }
+    group &= ~lanes;
+    if (group != 0)
+        firstLane = __builtin_ctz(group);
+}
+
+void LockstepCores::goScalar(int lane)
+{
+    if (cores[lane] == nullptr)
+    {
+        cores[lane].reset(new ProcessorCore(hosts[lane]));
+        cores[lane]->setCrashTraceSize(0);
+    }
+    ProcessorCore &core(*cores[lane]);
+    core.restoreState(_image);
+    for (int page = 0; page < 0x100; page++)
+        if (writtenPages[page])
+            for (int address = page << 8; address < (page + 1) << 8; address++)
+                core.setMemoryByteAt(address, memory[address].lane[lane]);
+
+    CpuState &state(core.state());
+    state.accumulator = accumulators.lane[lane];
+    state.xregister = xregisters.lane[lane];
+    state.yregister = yregisters.lane[lane];
+    state.stackRegister = stackRegisters.lane[lane];
+    state.statusFlags = ProcessorCore::packLazyStatusFlags(statusFlagsBits.lane[lane], laneLazyStatusFlags(lane));
+    state.programCounter = programCounters[lane];
+    state.elapsedCycles = elapsedCycles[lane];
+    state.instructionCount = instructionCounts[lane];
+    core.restartRun();
+}
+
+uint32_t LockstepCores::lanesWithOtherCode(uint16_t address, int bytes) const
+{
+    uint32_t lanes = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        const LaneBytes &row(memory[static_cast<uint16_t>(address + i)]);
+        for (int lane = 0; lane < MaxLanes; lane++)
+            if (row.lane[lane] != row.lane[firstLane])
+                lanes |= 1u << lane;
+    }
+    return lanes & group;
+}
+
+void LockstepCores::readLanes(const uint16_t *addresses, bool sameAddress, uint8_t *values) const
+{
+    if (sameAddress)
+        std::memcpy(values, memory[addresses[0]].lane, MaxLanes);
+    else
+        for (int lane = 0; lane < MaxLanes; lane++)
+            values[lane] = memory[addresses[lane]].lane[lane];
+}
+
+void LockstepCores::writeLanes(const uint16_t *addresses, bool sameAddress, const uint8_t *values)
+{
+    if (sameAddress)
+    {
+        LaneBytes &row(memory[addresses[0]]);
+        for (int lane = 0; lane < MaxLanes; lane++)
+            row.lane[lane] = blend(groupMask.lane[lane], values[lane], row.lane[lane]);
+        writtenPages[addresses[0] >> 8] = true;
+    }
+    else
+        for (int lane = 0; lane < MaxLanes; lane++)
+            if (group & (1u << lane))
+            {
+                memory[addresses[lane]].lane[lane] = values[lane];
+                writtenPages[addresses[lane] >> 8] = true;
+            }
+}
+
+void LockstepCores::pushLanes(const uint8_t *values)
+{
+    for (int lane = 0; lane < MaxLanes; lane++)
+    {
+        uint8_t &byte(memory[ProcessorCore::StackBottom + stackRegisters.lane[lane]].lane[lane]);
+        byte = blend(groupMask.lane[lane], values[lane], byte);
+        stackRegisters.lane[lane] -= groupMask.lane[lane] & 1;
+    }
+    writtenPages[ProcessorCore::StackBottom >> 8] = true;
+}
+
+void LockstepCores::pullLanes(uint8_t *values)
+{
+    for (int lane = 0; lane < MaxLanes; lane++)
+    {
+        stackRegisters.lane[lane] += groupMask.lane[lane] & 1;
+        values[lane] = memory[ProcessorCore::StackBottom + stackRegisters.lane[lane]].lane[lane];
+    }
+}
+
+
+//
+// Execution
+// Each instruction is done for all the lanes, the group's and the others alike, with the others' results blended
+// away, as straight-line loops over the lanes vectorize where branching on each lane would not
+// Cycles are counted as `ProcessorCore` counts them, including page crossings and taken branches for each lane
+//
+
+void LockstepCores::runGroup()
+{
+    alignas(32) uint16_t addresses[MaxLanes], targets[MaxLanes];
+    alignas(16) uint8_t values[MaxLanes], results[MaxLanes], extraCycles[MaxLanes], jumps[MaxLanes];
+
+    auto setLane = [this](LaneBytes &bytes, int lane, uint8_t value) {
+        bytes.lane[lane] = blend(groupMask.lane[lane], value, bytes.lane[lane]);
+    };
+    auto setNZ = [this, &setLane](int lane, uint8_t value) {
+        setLane(negatives, lane, value);
+        setLane(zeros, lane, value);
+    };
+    auto setLazyFlags = [&setLane, this](int lane, const LazyStatusFlags &lazyFlags) {
+        setLane(negatives, lane, lazyFlags.negative);
+        setLane(zeros, lane, lazyFlags.zero);
+        setLane(carries, lane, lazyFlags.carry);
+        setLane(overflows, lane, lazyFlags.overflow);
+    };
+    auto load = [&](LaneBytes &bytes) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            setLane(bytes, lane, values[lane]);
+            setNZ(lane, values[lane]);
+        }
+    };
+    auto transfer = [&](const LaneBytes &from, LaneBytes &to) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            setLane(to, lane, from.lane[lane]);
+            setNZ(lane, from.lane[lane]);
+        }
+    };
+    auto increment = [&](LaneBytes &bytes, uint8_t by) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            setLane(bytes, lane, bytes.lane[lane] + by);
+            setNZ(lane, bytes.lane[lane]);
+        }
+    };
+    auto compare = [&](const LaneBytes &bytes) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            LazyStatusFlags lazyFlags(laneLazyStatusFlags(lane));
+            ProcessorCore::compare(bytes.lane[lane], values[lane], lazyFlags);
+            setLazyFlags(lane, lazyFlags);
+        }
+    };
+    auto shift = [&](auto operation) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            LazyStatusFlags lazyFlags(laneLazyStatusFlags(lane));
+            results[lane] = ProcessorCore::shift<decltype(operation)::value>(values[lane], lazyFlags);
+            setLazyFlags(lane, lazyFlags);
+        }
+    };
+    auto branchIf = [&](auto flagBit, bool set) {
+        for (int lane = 0; lane < MaxLanes; lane++)
+            jumps[lane] = ProcessorCore::lazyStatusFlagOf<decltype(flagBit)::value>(laneLazyStatusFlags(lane)) == set;
+    };
+
+    // the counts common to the group's lanes are kept here, and added to the lanes only as they leave the group
+    uint32_t groupCycles = 0, groupInstructions = 0;
+    auto addGroupCounts = [&]() {
+        for (int lane = 0; lane < MaxLanes; lane++)
+        {
+            elapsedCycles[lane] += groupCycles & -static_cast<uint32_t>(groupMask.lane[lane] & 1);
+            instructionCounts[lane] += groupInstructions & -static_cast<uint32_t>(groupMask.lane[lane] & 1);
+        }
+        _instructionsIssued += groupInstructions;
+        _lockstepInstructions += static_cast<uint64_t>(groupInstructions) * __builtin_popcount(group);
+        groupCycles = groupInstructions = 0;
+    };
+    auto leave = [&](uint32_t lanes, uint16_t programCounter, LaneState state) {
+        addGroupCounts();
+        leaveGroup(lanes, programCounter, state);
+    };
+
+    uint16_t programCounter = programCounters[firstLane];
+    for (;;)
+    {
+        if (programCounter == nextWaitingProgramCounter)
+        {
+            leave(group, programCounter, LockstepLane);
+            return;
+        }
+
+        const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(memory[programCounter].lane[firstLane]));
+        const int bytes = instructionInfo.isValid() ? instructionInfo.bytes : 1;
+        if (writtenPages[programCounter >> 8] || writtenPages[static_cast<uint16_t>(programCounter + bytes - 1) >> 8])
+            if (uint32_t otherCode = lanesWithOtherCode(programCounter, bytes))
+                leave(otherCode, programCounter, ScalarLane);
+        const Operation operation(instructionInfo.operation);
+        const AddressingMode mode(instructionInfo.addrMode);
+        if (!instructionInfo.isValid() || operation == Operation::BRK || operation == Operation::RTI
+            || operation == Operation::CLD || operation == Operation::SED)
+        {
+            leave(group, programCounter, ScalarLane);
+            return;
+        }
+
+        const uint16_t nextProgramCounter = programCounter + bytes;
+        uint16_t operand = 0;
+        if (bytes >= 2)
+            operand = memory[static_cast<uint16_t>(programCounter + 1)].lane[firstLane];
+        if (bytes == 3)
+            operand |= memory[static_cast<uint16_t>(programCounter + 2)].lane[firstLane] << 8;
+        const bool pageCrossPenalty = ProcessorCore::operationHasPageCrossPenalty(operation, mode);
+
+        // the argument's address and value in each lane, as `ProcessorCore::executeOpcode()` has them
+        bool sameAddress = false;
+        switch (mode)
+        {
+        case AddressingMode::Accumulator:
+            std::memcpy(values, accumulators.lane, MaxLanes);
+            break;
+        case AddressingMode::Immediate:
+            std::fill(std::begin(values), std::end(values), static_cast<uint8_t>(operand));
+            break;
+        case AddressingMode::Relative:
+            operand = nextProgramCounter + static_cast<int8_t>(operand);
+            [[fallthrough]];
+        case AddressingMode::ZeroPage: case AddressingMode::Absolute:
+            std::fill(std::begin(addresses), std::end(addresses), operand);
+            sameAddress = true;
+            break;
+        case AddressingMode::ZeroPageX: case AddressingMode::ZeroPageY:
+        {
+            const LaneBytes &index(mode == AddressingMode::ZeroPageX ? xregisters : yregisters);
+            for (int lane = 0; lane < MaxLanes; lane++)
+                addresses[lane] = static_cast<uint8_t>(operand + index.lane[lane]);
+            break;
+        }
+        case AddressingMode::AbsoluteX: case AddressingMode::AbsoluteY:
+        {
+            const LaneBytes &index(mode == AddressingMode::AbsoluteX ? xregisters : yregisters);
+            for (int lane = 0; lane < MaxLanes; lane++)
+                addresses[lane] = operand + index.lane[lane];
+            if (pageCrossPenalty)
+                for (int lane = 0; lane < MaxLanes; lane++)
+                    extraCycles[lane] = ((addresses[lane] ^ operand) & 0xff00) != 0;
+            break;
+        }
+        case AddressingMode::Indirect:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                addresses[lane] = memory[operand].lane[lane] | memory[static_cast<uint16_t>(operand + 1)].lane[lane] << 8;
+            break;
+        case AddressingMode::IndexedIndirectX:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                const uint8_t zeroPage = operand + xregisters.lane[lane];
+                addresses[lane] = memory[zeroPage].lane[lane] | memory[static_cast<uint8_t>(zeroPage + 1)].lane[lane] << 8;
+            }
+            break;
+        case AddressingMode::IndirectIndexedY:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                const uint16_t base = memory[static_cast<uint8_t>(operand)].lane[lane] | memory[static_cast<uint8_t>(operand + 1)].lane[lane] << 8;
+                addresses[lane] = base + yregisters.lane[lane];
+                extraCycles[lane] = ((addresses[lane] ^ base) & 0xff00) != 0;
+            }
+            break;
+        default:
+            break;
+        }
+        if (mode != AddressingMode::Implied && mode != AddressingMode::Accumulator && mode != AddressingMode::Immediate
+            && mode != AddressingMode::Relative)
+            switch (operation)
+            {
+            case Operation::STA: case Operation::STX: case Operation::STY: case Operation::JMP: case Operation::JSR:
+                break;
+            default:
+                readLanes(addresses, sameAddress, values);
+                break;
+            }
+
+        // jumps, branches, calls and returns: where each lane goes, and which lanes go there at all
+        bool transfersControl = true;
+        switch (operation)
+        {
+        case Operation::JMP: case Operation::JSR:
+            std::memcpy(targets, addresses, sizeof(targets));
+            std::fill(std::begin(jumps), std::end(jumps), 1);
+            break;
+        case Operation::RTS:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                const uint8_t stackRegister = stackRegisters.lane[lane];
+                targets[lane] = (memory[ProcessorCore::StackBottom + static_cast<uint8_t>(stackRegister + 1)].lane[lane]
+                                 | memory[ProcessorCore::StackBottom + static_cast<uint8_t>(stackRegister + 2)].lane[lane] << 8) + 1;
+            }
+            std::fill(std::begin(jumps), std::end(jumps), 1);
+            break;
+        case Operation::BCC: branchIf(FlagConstant<StatusFlags::Carry>(), false); break;
+        case Operation::BCS: branchIf(FlagConstant<StatusFlags::Carry>(), true); break;
+        case Operation::BNE: branchIf(FlagConstant<StatusFlags::Zero>(), false); break;
+        case Operation::BEQ: branchIf(FlagConstant<StatusFlags::Zero>(), true); break;
+        case Operation::BPL: branchIf(FlagConstant<StatusFlags::Negative>(), false); break;
+        case Operation::BMI: branchIf(FlagConstant<StatusFlags::Negative>(), true); break;
+        case Operation::BVC: branchIf(FlagConstant<StatusFlags::Overflow>(), false); break;
+        case Operation::BVS: branchIf(FlagConstant<StatusFlags::Overflow>(), true); break;
+        default:
+            transfersControl = false;
+            break;
+        }
+        if (transfersControl)
+        {
+            if (mode == AddressingMode::Relative)
+                for (int lane = 0; lane < MaxLanes; lane++)
+                {
+                    targets[lane] = operand;
+                    extraCycles[lane] = jumps[lane] ? 1 + ((operand & 0xff00) != (nextProgramCounter & 0xff00)) : 0;
+                }
+            // the traps are the scalar cores'
+            uint32_t trapping = 0;
+            for (int lane = 0; lane < MaxLanes; lane++)
+                if (jumps[lane] && targets[lane] >= ProcessorCore::TrapPage)
+                    trapping |= 1u << lane;
+            if (trapping & group)
+                leave(trapping & group, programCounter, ScalarLane);
+            if (group == 0)
+                return;
+        }
+
+        switch (operation)
+        {
+        case Operation::LDA: load(accumulators); break;
+        case Operation::LDX: load(xregisters); break;
+        case Operation::LDY: load(yregisters); break;
+        case Operation::STA: writeLanes(addresses, sameAddress, accumulators.lane); break;
+        case Operation::STX: writeLanes(addresses, sameAddress, xregisters.lane); break;
+        case Operation::STY: writeLanes(addresses, sameAddress, yregisters.lane); break;
+
+        case Operation::TAX: transfer(accumulators, xregisters); break;
+        case Operation::TAY: transfer(accumulators, yregisters); break;
+        case Operation::TXA: transfer(xregisters, accumulators); break;
+        case Operation::TYA: transfer(yregisters, accumulators); break;
+
+        case Operation::TSX: transfer(stackRegisters, xregisters); break;
+        case Operation::TXS:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                setLane(stackRegisters, lane, xregisters.lane[lane]);
+            break;
+        case Operation::PHA: pushLanes(accumulators.lane); break;
+        case Operation::PHP:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                values[lane] = ProcessorCore::packLazyStatusFlags(statusFlagsBits.lane[lane], laneLazyStatusFlags(lane)) | StatusFlags::Break;
+            pushLanes(values);
+            break;
+        case Operation::PLA:
+            pullLanes(values);
+            load(accumulators);
+            break;
+        case Operation::PLP:
+            pullLanes(values);
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                const uint8_t statusFlags = values[lane] & ~StatusFlags::Break;
+                setLane(statusFlagsBits, lane, statusFlags);
+                setLazyFlags(lane, ProcessorCore::unpackLazyStatusFlags(statusFlags));
+            }
+            break;
+
+        case Operation::AND: case Operation::EOR: case Operation::ORA:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                values[lane] = operation == Operation::AND ? accumulators.lane[lane] & values[lane]
+                               : operation == Operation::EOR ? accumulators.lane[lane] ^ values[lane]
+                               : accumulators.lane[lane] | values[lane];
+            load(accumulators);
+            break;
+        case Operation::BIT:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                LazyStatusFlags lazyFlags(laneLazyStatusFlags(lane));
+                ProcessorCore::bitTest(accumulators.lane[lane], values[lane], lazyFlags);
+                setLazyFlags(lane, lazyFlags);
+            }
+            break;
+
+        case Operation::ADC: case Operation::SBC:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                LazyStatusFlags lazyFlags(laneLazyStatusFlags(lane));
+                const uint8_t result = operation == Operation::ADC
+                        ? ProcessorCore::addWithCarry(accumulators.lane[lane], values[lane], lazyFlags)
+                        : ProcessorCore::subtractWithCarry(accumulators.lane[lane], values[lane], lazyFlags);
+                setLane(accumulators, lane, result);
+                setLazyFlags(lane, lazyFlags);
+            }
+            break;
+        case Operation::CMP: compare(accumulators); break;
+        case Operation::CPX: compare(xregisters); break;
+        case Operation::CPY: compare(yregisters); break;
+
+        case Operation::INC: case Operation::DEC:
+            for (int lane = 0; lane < MaxLanes; lane++)
+            {
+                results[lane] = values[lane] + (operation == Operation::INC ? 1 : -1);
+                setNZ(lane, results[lane]);
+            }
+            writeLanes(addresses, sameAddress, results);
+            break;
+        case Operation::INX: increment(xregisters, 1); break;
+        case Operation::INY: increment(yregisters, 1); break;
+        case Operation::DEX: increment(xregisters, -1); break;
+        case Operation::DEY: increment(yregisters, -1); break;
+
+        case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR:
+            if (operation == Operation::ASL)
+                shift(OperationConstant<Operation::ASL>());
+            else if (operation == Operation::LSR)
+                shift(OperationConstant<Operation::LSR>());
+            else if (operation == Operation::ROL)
+                shift(OperationConstant<Operation::ROL>());
+            else
+                shift(OperationConstant<Operation::ROR>());
+            if (mode == AddressingMode::Accumulator)
+                for (int lane = 0; lane < MaxLanes; lane++)
+                    setLane(accumulators, lane, results[lane]);
+            else
+                writeLanes(addresses, sameAddress, results);
+            break;
+
+        case Operation::JSR:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                values[lane] = static_cast<uint16_t>(nextProgramCounter - 1) >> 8;
+            pushLanes(values);
+            for (int lane = 0; lane < MaxLanes; lane++)
+                values[lane] = static_cast<uint8_t>(nextProgramCounter - 1);
+            pushLanes(values);
+            break;
+        case Operation::RTS:
+            pullLanes(values);
+            pullLanes(values);
+            break;
+
+        case Operation::CLC: case Operation::SEC:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                setLane(carries, lane, operation == Operation::SEC);
+            break;
+        case Operation::CLV:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                setLane(overflows, lane, 0);
+            break;
+        case Operation::CLI: case Operation::SEI:
+            for (int lane = 0; lane < MaxLanes; lane++)
+                setLane(statusFlagsBits, lane, operation == Operation::SEI ? statusFlagsBits.lane[lane] | StatusFlags::InterruptDisable
+                                                                           : statusFlagsBits.lane[lane] & ~StatusFlags::InterruptDisable);
+            break;
+        default:
+            break;
+        }
+
+        groupCycles += instructionInfo.cycles;
+        groupInstructions++;
+        if (pageCrossPenalty || mode == AddressingMode::Relative)
+            for (int lane = 0; lane < MaxLanes; lane++)
+                elapsedCycles[lane] += extraCycles[lane] & groupMask.lane[lane];
+
+        if (!transfersControl)
+        {
+            programCounter = nextProgramCounter;
+            continue;
+        }
+        // a jump to `__JSR_terminate` ends the lane, leaving its program counter after the instruction
+        uint32_t ended = 0;
+        for (int lane = 0; lane < MaxLanes; lane++)
+            if (group & (1u << lane))
+            {
+                programCounters[lane] = jumps[lane] ? targets[lane] : nextProgramCounter;
+                if (jumps[lane] && targets[lane] == InstructionSet::__JSR_terminate)
+                    ended |= 1u << lane;
+            }
+        if (ended)
+            leave(ended, nextProgramCounter, EndedLane);
+        addGroupCounts();
+        return;
+    }
+}
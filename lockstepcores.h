@@ -0,0 +1,112 @@
+#ifndef LOCKSTEPCORES_H
+#define LOCKSTEPCORES_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "processorcore.h"
+
+//
+// LockstepCores Class
+//
+// Up to `MaxLanes` instances ("lanes") of one program, each with its own registers and memory, run together: for
+// data-parallel work such as Monte Carlo runs, or a routine tried over every input
+// Registers, status flags and counters are arrays with an element per lane, and memory is an array of rows of a
+// byte per lane for each address, so one instruction runs for all the lanes at once in loops the compiler vectorizes
+// (SSE/AVX2 on x86-64)
+// Each lane has its own program counter; those lanes at the lowest one run together, the others waiting, so lanes
+// which branch apart run in turn and come back together where their paths meet
+// A lane goes scalar, onto a `ProcessorCore` of its own, to run what the lanes do not: traps (the internal JSRs,
+// with its own host), BRK and RTI, CLD, SED and illegal opcodes, and instructions whose bytes differ between lanes
+// The operations' arithmetic is `ProcessorCore`'s own, so each lane ends as a `ProcessorCore` run alone would
+// Every lane starts from the one image, a save state taken just after `ProcessorCore::startRun()`, in plain RAM
+//
+class LockstepCores
+{
+public:
+    static constexpr int MaxLanes = 16;
+
+    explicit LockstepCores(const std::shared_ptr<const ProcessorCore::SaveState> &image, int lanes = MaxLanes);
+    ~LockstepCores();
+
+    int lanes() const { return _lanes; }
+    // the image as the lanes run it, without host devices
+    const std::shared_ptr<const ProcessorCore::SaveState> &image() const { return _image; }
+    // for the lane once it goes scalar; nullptr for none
+    void setHost(int lane, IProcessorCoreHost *host);
+
+    // puts every lane back to the image, copying back just the pages written since
+    void restart();
+    // runs every lane to its end; an `ExecutionError` ends just its lane, see `error()`
+    void run();
+
+    // each lane's registers and memory, to give it its own input before `run()` and read its results after
+    uint8_t accumulator(int lane) const;
+    void setAccumulator(int lane, uint8_t value);
+    uint8_t xregister(int lane) const;
+    void setXregister(int lane, uint8_t value);
+    uint8_t yregister(int lane) const;
+    void setYregister(int lane, uint8_t value);
+    uint8_t stackRegister(int lane) const;
+    uint8_t statusFlags(int lane) const;
+    uint16_t programCounter(int lane) const;
+    uint64_t totalElapsedCycles(int lane) const;
+    uint64_t instructionCount(int lane) const;
+    uint8_t memoryByteAt(int lane, uint16_t address) const;
+    void setMemoryByteAt(int lane, uint16_t address, uint8_t value);
+
+    bool scalar(int lane) const { return laneStates[lane] == ScalarLane; }
+    const std::string &error(int lane) const { return errors[lane]; }
+    // instructions run in lockstep since `restart()`: as issued, and as the sum over the lanes which ran them
+    uint64_t instructionsIssued() const { return _instructionsIssued; }
+    uint64_t lockstepInstructions() const { return _lockstepInstructions; }
+
+private:
+    struct alignas(MaxLanes) LaneBytes
+    {
+        uint8_t lane[MaxLanes];
+    };
+    enum LaneState : uint8_t { LockstepLane, EndedLane, ScalarLane, UnusedLane };
+
+    std::shared_ptr<const ProcessorCore::SaveState> _image;
+    std::unique_ptr<CpuState> imageState;   // the image in full, to restart the lanes from
+    int _lanes;
+
+    LaneBytes accumulators, xregisters, yregisters, stackRegisters;
+    LaneBytes statusFlagsBits;              // all but N, Z, C and V, which are lazy as in `ProcessorCore`
+    LaneBytes negatives, zeros, carries, overflows;
+    alignas(32) uint16_t programCounters[MaxLanes];
+    alignas(32) uint32_t elapsedCycles[MaxLanes];
+    alignas(64) uint64_t instructionCounts[MaxLanes];
+    std::unique_ptr<LaneBytes[]> memory;    // by address
+    bool writtenPages[0x100];               // by any lane, since `restart()`
+    LaneState laneStates[MaxLanes];
+
+    std::unique_ptr<ProcessorCore> cores[MaxLanes];
+    IProcessorCoreHost *hosts[MaxLanes];
+    std::string errors[MaxLanes];
+    uint64_t _instructionsIssued, _lockstepInstructions;
+
+    // the lanes running together now, as a bit each and as a byte of all 1s each, and where the next lanes wait
+    uint32_t group;
+    LaneBytes groupMask;
+    int firstLane;
+    int nextWaitingProgramCounter;
+
+    bool chooseGroup();
+    void runGroup();
+    void leaveGroup(uint32_t lanes, uint16_t programCounter, LaneState state);
+    void goScalar(int lane);
+    uint32_t lanesWithOtherCode(uint16_t address, int bytes) const;
+    void readLanes(const uint16_t *addresses, bool sameAddress, uint8_t *values) const;
+    void writeLanes(const uint16_t *addresses, bool sameAddress, const uint8_t *values);
+    void pushLanes(const uint8_t *values);
+    void pullLanes(uint8_t *values);
+    ProcessorCore::LazyStatusFlags laneLazyStatusFlags(int lane) const
+    {
+        return ProcessorCore::LazyStatusFlags{ negatives.lane[lane], zeros.lane[lane], carries.lane[lane], overflows.lane[lane] };
+    }
+};
+
+#endif // LOCKSTEPCORES_H
@@ -55,6 +55,7 @@ MainWindow::MainWindow(QWidget *parent)
     findReplaceDialog = nullptr;
 
     profilingStatisticsWindow = nullptr;
+    runFinishPending = false;
 
     codeStream = nullptr;
     _haveDoneReset = false;
@@ -89,6 +90,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     connect(processorModel(), &ProcessorModel::isRunningChanged, this, &MainWindow::actionEnablement, processorModelConnectionType);
     connect(processorModel(), &ProcessorModel::stopRunChanged, this, &MainWindow::actionEnablement, processorModelConnectionType);
+    connect(processorModel(), &ProcessorModel::runFinished, this, &MainWindow::runFinished, processorModelConnectionType);
     connect(processorModel(), &ProcessorModel::currentInstructionAddressChanged, this, &MainWindow::currentInstructionAddressChanged, changedSignalsConnectionType);
 
     ui->codeEditor->setLineWrapMode(QPlainTextEdit::NoWrap);
@@ -134,6 +136,11 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->actionStepOut, &QAction::triggered, this, &MainWindow::stepOut);
     connect(ui->actionContinue, &QAction::triggered, this, &MainWindow::continueRun);
     connect(ui->actionReset, &QAction::triggered, this, &MainWindow::reset);
+    connect(ui->actionSaveState, &QAction::triggered, this, &MainWindow::saveState);
+    connect(ui->actionRestoreState, &QAction::triggered, this, &MainWindow::restoreState);
+    connect(ui->actionStepBack, &QAction::triggered, this, &MainWindow::stepBack);
+    connect(ui->actionReverseContinue, &QAction::triggered, this, &MainWindow::reverseContinue);
+    connect(ui->actionGoToLastWrite, &QAction::triggered, this, &MainWindow::goToLastWrite);
     connect(ui->actionSettings, &QAction::triggered, this, &MainWindow::showSettingsDialog);
     connect(ui->actionExit, &QAction::triggered, this, &MainWindow::close);
 
@@ -443,6 +450,7 @@ void MainWindow::assembleAndRun(ProcessorModel::RunMode runMode)
 
     QCoreApplication::processEvents();
 
+    runFinishPending = true;
     switch (runMode)
     {
     case ProcessorModel::NotRunning: break;
@@ -454,10 +462,19 @@ void MainWindow::assembleAndRun(ProcessorModel::RunMode runMode)
     case ProcessorModel::Continue: processorModel()->continueRun(); break;
     }
 
-    QCoreApplication::processEvents();
+    // the run goes on in the background, `runFinished()` follows it
+    // (a run which never started gets no `ProcessorModel::runFinished`, so it is finished here)
+    if (!processorModel()->isRunning())
+        runFinished();
+}
 
-    if (!stepOneStatementOnly)
-        setRunStopButton(true);
+/*slot*/ void MainWindow::runFinished()
+{
+    // once per run, from whichever of `assembleAndRun()` or the model's signal comes first
+    if (!runFinishPending)
+        return;
+    runFinishPending = false;
+    setRunStopButton(true);
 
     if (emulator()->profilingEnabled() && processorModel()->stopRun())
     {
@@ -494,6 +511,11 @@ void MainWindow::assembleAndRun(ProcessorModel::RunMode runMode)
 
     ui->btnTurboRun->defaultAction()->setEnabled(!processorModel()->isRunning());
     ui->btnReset->defaultAction()->setEnabled(!processorModel()->isRunning());
+    ui->actionSaveState->setEnabled(haveDoneReset() && !processorModel()->isRunning() && !processorModel()->stopRun());
+    ui->actionRestoreState->setEnabled(!processorModel()->isRunning() && processorModel()->hasSavedState());
+    ui->actionStepBack->setEnabled(!processorModel()->isRunning() && processorModel()->canStepBack());
+    ui->actionReverseContinue->setEnabled(!processorModel()->isRunning() && processorModel()->canStepBack());
+    ui->actionGoToLastWrite->setEnabled(!processorModel()->isRunning() && processorModel()->canStepBack());
 }
 
 /*slot*/ void MainWindow::debugMessage(const QString &message)
@@ -782,6 +804,39 @@ void MainWindow::assembleAndRun(ProcessorModel::RunMode runMode)
     assembleAndRun(ProcessorModel::StepOut);
 }
 
+/*slot*/ void MainWindow::saveState()
+{
+    processorModel()->saveState();
+    actionEnablement();
+}
+
+/*slot*/ void MainWindow::restoreState()
+{
+    processorModel()->restoreState();
+    actionEnablement();
+}
+
+/*slot*/ void MainWindow::stepBack()
+{
+    processorModel()->stepBack();
+    actionEnablement();
+}
+
+/*slot*/ void MainWindow::reverseContinue()
+{
+    processorModel()->reverseContinue();
+    actionEnablement();
+}
+
+/*slot*/ void MainWindow::goToLastWrite()
+{
+    // of the memory view's current cell
+    int address = processorModel()->memoryModel()->indexToAddress(ui->tvMemory->currentIndex());
+    if (address >= 0)
+        processorModel()->goToLastWrite(address);
+    actionEnablement();
+}
+
 
 /*slot*/ void MainWindow::codeEditorLineNumberClicked(int blockNumber)
 {
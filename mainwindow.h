@@ -70,6 +70,7 @@ private slots:
     void requestCharFromConsole();
     void endRequestCharFromConsole();
     void modelReset();
+    void runFinished();
     void reset();
     void assembleOnly();
     void turboRun();
@@ -78,6 +79,11 @@ private slots:
     void stepInto();
     void stepOver();
     void stepOut();
+    void saveState();
+    void restoreState();
+    void stepBack();
+    void reverseContinue();
+    void goToLastWrite();
     void codeEditorLineNumberClicked(int blockNumber);
     void breakpointChanged(const QString &filename, int lineNumber);
     void currentCodeLineNumberChanged(const QString &filename, int lineNumber);
@@ -91,6 +97,7 @@ private:
     FindDialog *findDialog;
     FindReplaceDialog *findReplaceDialog;
     ProfilingStatisticsWindow *profilingStatisticsWindow;
+    bool runFinishPending;      // from dispatching a run until `runFinished()` first handles it
     QByteArray codeBytes;
     QTextStream *codeStream;
     bool _haveDoneReset;
@@ -94,6 +94,9 @@ void MemoryViewItemDelegate::updateEditorGeometry(QWidget *editor, const QStyleO
 void MemoryViewItemDelegate::initStyleOption(QStyleOptionViewItem *option, const QModelIndex &index) const /*override*/
 {
     QStyledItemDelegate::initStyleOption(option, index);
+    QVariant foreground(index.data(Qt::ForegroundRole));
+    if (foreground.metaType() == QMetaType::fromType<Qt::GlobalColor>())
+        option->palette.setBrush(QPalette::Text, QBrush(foreground.value<Qt::GlobalColor>()));
     if (_fixedDigits > 0)
         option->displayAlignment = (option->displayAlignment & ~Qt::AlignHorizontal_Mask) | Qt::AlignHCenter;
     if (_isChr)
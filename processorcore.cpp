@@ -0,0 +1,1546 @@
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+#include "executionhistory.h"
+#include "hostdevices.h"
+#include "jitcompiler.h"
+#include "processorcore.h"
+
+// TurboRun dispatch: labels-as-values threading where the compiler has it, else a switch
+#if defined(PROCESSORCORE_COMPUTED_GOTO) && (defined(__GNUC__) || defined(__clang__))
+#define USE_COMPUTED_GOTO 1
+#else
+#define USE_COMPUTED_GOTO 0
+#endif
+
+using Operation = ProcessorCore::Operation;
+using AddressingMode = ProcessorCore::AddressingMode;
+using Instruction = ProcessorCore::Instruction;
+using InstructionInfo = ProcessorCore::InstructionInfo;
+using InternalJSRs = InstructionSet::InternalJSRs;
+
+
+//
+// ProcessorCore Class
+//
+
+ProcessorCore::ProcessorCore(IProcessorCoreHost *host /*= nullptr*/)
+    : _bankedMemory(this)
+{
+    _host = host;
+    std::memset(&_state, 0, sizeof(_state));
+    std::memset(_state.memory, 0xa5, memorySize());
+    _stopped = true;
+    currentInstructionCycles = 0;
+    decodedInstructions.reset(new DecodedInstruction[memorySize()]);
+    for (unsigned int address = 0; address < memorySize(); address++)
+        decodedInstructions[address].handlerIndex = UndecodedHandler;
+    std::memset(pageFlags, 0, sizeof(pageFlags));
+    std::fill(std::begin(pageDevices), std::end(pageDevices), nullptr);
+    devicePageCount = 0;
+    executingBasicBlock = nullptr;
+    executingBlockInstruction = 0;
+    _breakpoints = nullptr;
+    _stackWatches = 0;
+    _history = nullptr;
+    crashTraceNext = 0;
+    _traceWriter = nullptr;
+    setCrashTraceSize(64);
+    elapsedTimeStart = std::chrono::steady_clock::now();
+    interruptEvent = _events.addEvent([this]() { takeInterrupt(); });
+    _irqSources = 0;
+    nmiPending = false;
+    _waitingForInterrupt = false;
+    setInternalTraps();
+    reset();
+}
+
+ProcessorCore::~ProcessorCore()
+{
+}
+
+char *ProcessorCore::memoryStrPointer(uint16_t address, uint8_t *maxLen /*= nullptr*/)
+{
+    char *memoryAddress = memoryCharPointer(address);
+    if (maxLen != nullptr)
+    {
+        int len = std::strlen(memoryAddress);
+        *maxLen = len < 255 ? len : 254;
+    }
+    return memoryAddress;
+}
+
+void ProcessorCore::mapRam(uint8_t firstPage, uint8_t lastPage)
+{
+    for (int page = firstPage; page <= lastPage; page++)
+    {
+        if (pageFlags[page] & DevicePage)
+            devicePageCount--;
+        pageFlags[page] &= ~(RomPage | DevicePage);
+        pageDevices[page] = nullptr;
+    }
+    // decoded instructions, and the JIT's code, may have read through the old mapping
+    invalidateDecodedInstructions();
+}
+
+void ProcessorCore::mapRom(uint8_t firstPage, uint8_t lastPage)
+{
+    mapRam(firstPage, lastPage);
+    for (int page = firstPage; page <= lastPage; page++)
+        pageFlags[page] |= RomPage;
+}
+
+void ProcessorCore::mapDevice(uint8_t firstPage, uint8_t lastPage, IMemoryDevice *device)
+{
+    mapRam(firstPage, lastPage);
+    if (device == nullptr)
+        return;
+    for (int page = firstPage; page <= lastPage; page++)
+    {
+        pageFlags[page] |= DevicePage;
+        pageDevices[page] = device;
+        devicePageCount++;
+    }
+}
+
+void ProcessorCore::mapHostDevices(uint8_t page /*= InstructionSet::__DEV_page >> 8*/)
+{
+    if (hostDevices == nullptr)
+        hostDevices.reset(new HostDevices(this));
+    mapDevice(page, page, hostDevices.get());
+}
+
+void ProcessorCore::reset()
+{
+    _state.stackRegister = StackInitial;
+    _state.statusFlags = (0x00 & ~StatusFlags::Break);
+    _state.accumulator = 5;
+    _state.xregister = 10;
+    _state.yregister = 15;
+    setMemoryByteAt(InstructionSet::__VEC_BRKV, static_cast<uint8_t>(InstructionSet::__JSR_brk_default_handler));
+    setMemoryByteAt(InstructionSet::__VEC_BRKV + 1, static_cast<uint8_t>(InstructionSet::__JSR_brk_default_handler >> 8));
+    setMemoryByteAt(InstructionSet::__VEC_IRQV, static_cast<uint8_t>(InstructionSet::__JSR_irq_default_handler));
+    setMemoryByteAt(InstructionSet::__VEC_IRQV + 1, static_cast<uint8_t>(InstructionSet::__JSR_irq_default_handler >> 8));
+    setMemoryByteAt(InstructionSet::__VEC_NMIV, static_cast<uint8_t>(InstructionSet::__JSR_nmi_default_handler));
+    setMemoryByteAt(InstructionSet::__VEC_NMIV + 1, static_cast<uint8_t>(InstructionSet::__JSR_nmi_default_handler >> 8));
+}
+
+void ProcessorCore::startRun()
+{
+    // code may have been loaded via `memory()`
+    invalidateDecodedInstructions();
+    lastSaveState.reset();
+    _state.elapsedCycles = 0;
+    _state.clearedElapsedCycles = _state.instructionCount = 0;
+
+    _state.stackRegister = StackInitial;
+    uint16_t returnAddress = InstructionSet::__JSR_terminate - 1;
+    pushToStack(static_cast<uint8_t>(returnAddress >> 8));
+    pushToStack(static_cast<uint8_t>(returnAddress));
+    clearStatusFlag(StatusFlags::InterruptDisable);
+    restartRun();
+}
+
+void ProcessorCore::restartRun()
+{
+    elapsedTimeStart = std::chrono::steady_clock::now();
+    crashTraceNext = 0;
+    _events.clear();
+    _irqSources = 0;
+    nmiPending = _waitingForInterrupt = false;
+    if (hostDevices != nullptr)
+        hostDevices->reset();
+    _stopped = false;
+}
+
+
+void ProcessorCore::setProfilingRange(uint16_t lowest, uint16_t highest)
+{
+    _profiling.programCounterLow = lowest;
+    _profiling.programCounterHigh = highest;
+}
+
+void ProcessorCore::startProfiling()
+{
+    allocateProfilingHitCounts();
+    _profiling.on = _profiling.counts != NULL;
+}
+
+void ProcessorCore::allocateProfilingHitCounts()
+{
+    if (_profiling.counts != NULL)
+    {
+        delete[] _profiling.counts;
+        _profiling.counts = NULL;
+    }
+    if (_profiling.programCounterHigh == 0x0 || _profiling.programCounterLow == 0xffff)
+        return;
+    int size = _profiling.programCounterHigh - _profiling.programCounterLow;
+    size >>= _profiling.granularityShift;
+    size++;
+    assert(size > 0 && size < 0x8000);
+    _profiling.counts = new Profiling::HitCycleCounts[size];
+    std::memset(_profiling.counts, 0, size * sizeof(Profiling::HitCycleCounts));
+}
+
+void ProcessorCore::profilingHit(uint16_t programCounter, int instructionCycles)
+{
+    if (_profiling.counts == NULL || programCounter < _profiling.programCounterLow || programCounter >= _profiling.programCounterHigh)
+        return;
+    int index = programCounter - _profiling.programCounterLow;
+    index >>= _profiling.granularityShift;
+    _profiling.counts[index].hits++;
+    _profiling.counts[index].cycles += instructionCycles;
+}
+
+
+//
+// Per-opcode handlers
+// `executeOpcode<opcodeByte>()` is instantiated for all 256 opcodes from `InstructionSet::instructionsInfo[]`,
+// so each one does only what its addressing mode and operation need
+//
+
+static constexpr bool operationReadsArgument(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::STA: case Operation::STX: case Operation::STY:
+    case Operation::JMP: case Operation::JSR:
+        return false;
+    default:
+        return true;
+    }
+}
+
+/*static*/ constexpr bool ProcessorCore::opcodeMayStopRun(uint8_t opcodeByte)
+{
+    const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(opcodeByte));
+    if (!instructionInfo.isValid())
+        return false;
+    switch (instructionInfo.operation)
+    {
+    case Operation::JMP: case Operation::JSR: case Operation::RTS: case Operation::RTI: case Operation::BRK:
+    case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+    case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+template<class Observer, std::size_t... opcodeBytes>
+constexpr auto ProcessorCore::makeOpcodeHandlers(std::index_sequence<opcodeBytes...>) -> OpcodeHandlers
+{
+    return { &ProcessorCore::executeOpcode<opcodeBytes, Observer>..., &ProcessorCore::decodeAndExecute<Observer> };
+}
+
+template<class Observer>
+const ProcessorCore::OpcodeHandlers ProcessorCore::opcodeHandlers
+    = ProcessorCore::makeOpcodeHandlers<Observer>(std::make_index_sequence<InstructionSet::TotalInstructions>());
+
+void ProcessorCore::illegalOpcode(uint8_t opcodeByte)
+{
+    const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(opcodeByte));
+    char message[64];
+    std::snprintf(message, sizeof(message), "Illegal opcode: %02x %s %s", instructionInfo.opcodeByte,
+                  InstructionSet::operationName(instructionInfo.operation), InstructionSet::addressingModeName(instructionInfo.addrMode));
+    throw ExecutionError(message);
+}
+
+void ProcessorCore::unimplementedOperation(Operation operation)
+{
+    throw ExecutionError(std::string("Unimplemented operation: ") + InstructionSet::operationName(operation));
+}
+
+template<ProcessorCore::AddressingMode mode>
+inline uint16_t ProcessorCore::argumentAddress(uint16_t operand) const
+{
+    if constexpr (mode == AddressingMode::Relative || mode == AddressingMode::Absolute || mode == AddressingMode::ZeroPage)
+        return operand;
+    else if constexpr (mode == AddressingMode::AbsoluteX)
+        return operand + _state.xregister;
+    else if constexpr (mode == AddressingMode::AbsoluteY)
+        return operand + _state.yregister;
+    else if constexpr (mode == AddressingMode::ZeroPageX)
+        return static_cast<uint8_t>(operand + _state.xregister);
+    else if constexpr (mode == AddressingMode::ZeroPageY)
+        return static_cast<uint8_t>(operand + _state.yregister);
+    else if constexpr (mode == AddressingMode::Indirect)
+        return memoryWordAt(operand);
+    else if constexpr (mode == AddressingMode::IndexedIndirectX)
+        return memoryZPWordAt(operand + _state.xregister);
+    else if constexpr (mode == AddressingMode::IndirectIndexedY)
+        return memoryZPWordAt(operand) + _state.yregister;
+    else
+        return -1;
+}
+
+template<uint8_t opcodeByte, class Observer>
+inline void ProcessorCore::executeOpcode(const uint16_t operand)
+{
+    constexpr InstructionInfo instructionInfo(InstructionSet::getInstructionInfo(opcodeByte));
+    if constexpr (!instructionInfo.isValid())
+        illegalOpcode(opcodeByte);
+    else
+    {
+        constexpr Operation operation(instructionInfo.operation);
+        constexpr AddressingMode mode(instructionInfo.addrMode);
+
+        uint8_t argValue = -1;
+        uint16_t argAddress = -1;
+        if constexpr (mode == AddressingMode::Accumulator)
+            argValue = _state.accumulator;
+        else if constexpr (mode == AddressingMode::Immediate)
+            argValue = operand;
+        else if constexpr (mode != AddressingMode::Implied)
+        {
+            argAddress = argumentAddress<mode>(operand);
+            if constexpr (mode != AddressingMode::Relative && operationReadsArgument(operation))
+                argValue = readMemoryByte<Observer>(argAddress);
+        }
+
+        if constexpr (operationHasPageCrossPenalty(operation, mode))
+        {
+            uint16_t baseAddress;
+            if constexpr (mode == AddressingMode::IndirectIndexedY)
+                baseAddress = memoryZPWordAt(operand);
+            else
+                baseAddress = operand;
+            if ((argAddress & 0xff00) != (baseAddress & 0xff00))
+                _state.elapsedCycles++;
+        }
+
+        _state.programCounter += instructionInfo.bytes;
+        currentInstructionCycles = instructionInfo.cycles;
+
+        executeOperation<operation, mode, Observer>(argValue, argAddress);
+    }
+}
+
+template<class Observer>
+void ProcessorCore::decodeAndExecute(uint16_t /*operand*/)
+{
+    const DecodedInstruction &decoded(decodeInstruction(_state.programCounter));
+    (this->*opcodeHandlers<Observer>[decoded.handlerIndex])(decoded.operand);
+}
+
+template<ProcessorCore::Operation operation, ProcessorCore::AddressingMode mode, class Observer>
+inline void ProcessorCore::executeOperation(const uint8_t argValue, const uint16_t argAddress)
+{
+    uint8_t tempValue8;
+    uint16_t tempValue16;
+
+    // Operations ordered/grouped as per http://www.6502.org/users/obelisk/6502/instructions.html
+    if constexpr (operation == Operation::LDA)
+    {
+        _state.accumulator = argValue;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::LDX)
+    {
+        _state.xregister = argValue;
+        setLazyNZStatusFlags(_state.xregister);
+    }
+    else if constexpr (operation == Operation::LDY)
+    {
+        _state.yregister = argValue;
+        setLazyNZStatusFlags(_state.yregister);
+    }
+    else if constexpr (operation == Operation::STA)
+        writeMemoryByte<Observer>(argAddress, _state.accumulator);
+    else if constexpr (operation == Operation::STX)
+        writeMemoryByte<Observer>(argAddress, _state.xregister);
+    else if constexpr (operation == Operation::STY)
+        writeMemoryByte<Observer>(argAddress, _state.yregister);
+
+    else if constexpr (operation == Operation::TAX)
+    {
+        _state.xregister = _state.accumulator;
+        setLazyNZStatusFlags(_state.xregister);
+    }
+    else if constexpr (operation == Operation::TAY)
+    {
+        _state.yregister = _state.accumulator;
+        setLazyNZStatusFlags(_state.yregister);
+    }
+    else if constexpr (operation == Operation::TXA)
+    {
+        _state.accumulator = _state.xregister;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::TYA)
+    {
+        _state.accumulator = _state.yregister;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+
+    else if constexpr (operation == Operation::TSX)
+    {
+        _state.xregister = _state.stackRegister;
+        setLazyNZStatusFlags(_state.xregister);
+    }
+    else if constexpr (operation == Operation::TXS)
+        _state.stackRegister = _state.xregister;
+    else if constexpr (operation == Operation::PHA)
+        pushStackByte<Observer>(_state.accumulator);
+    else if constexpr (operation == Operation::PHP)
+        pushStackByte<Observer>(lazyPackedStatusFlags() | StatusFlags::Break);
+    else if constexpr (operation == Operation::PLA)
+    {
+        _state.accumulator = pullStackByte<Observer>();
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::PLP)
+    {
+        setStatusFlags(pullStackByte<Observer>());
+        unpackStatusFlags();
+        interruptMayBeTaken();
+    }
+
+    else if constexpr (operation == Operation::AND)
+    {
+        _state.accumulator &= argValue;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::EOR)
+    {
+        _state.accumulator ^= argValue;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::ORA)
+    {
+        _state.accumulator |= argValue;
+        setLazyNZStatusFlags(_state.accumulator);
+    }
+    else if constexpr (operation == Operation::BIT)
+        bitTest(_state.accumulator, argValue, lazyFlags);
+
+    else if constexpr (operation == Operation::ADC)
+        _state.accumulator = addWithCarry(_state.accumulator, argValue, lazyFlags);
+    else if constexpr (operation == Operation::SBC)
+        _state.accumulator = subtractWithCarry(_state.accumulator, argValue, lazyFlags);
+    else if constexpr (operation == Operation::CMP)
+        compare(_state.accumulator, argValue, lazyFlags);
+    else if constexpr (operation == Operation::CPX)
+        compare(_state.xregister, argValue, lazyFlags);
+    else if constexpr (operation == Operation::CPY)
+        compare(_state.yregister, argValue, lazyFlags);
+
+    else if constexpr (operation == Operation::INC)
+    {
+        tempValue8 = argValue + 1;
+        writeMemoryByte<Observer>(argAddress, tempValue8);
+        setLazyNZStatusFlags(tempValue8);
+    }
+    else if constexpr (operation == Operation::INX)
+    {
+        _state.xregister++;
+        setLazyNZStatusFlags(_state.xregister);
+    }
+    else if constexpr (operation == Operation::INY)
+    {
+        _state.yregister++;
+        setLazyNZStatusFlags(_state.yregister);
+    }
+    else if constexpr (operation == Operation::DEC)
+    {
+        tempValue8 = argValue - 1;
+        writeMemoryByte<Observer>(argAddress, tempValue8);
+        setLazyNZStatusFlags(tempValue8);
+    }
+    else if constexpr (operation == Operation::DEX)
+    {
+        _state.xregister--;
+        setLazyNZStatusFlags(_state.xregister);
+    }
+    else if constexpr (operation == Operation::DEY)
+    {
+        _state.yregister--;
+        setLazyNZStatusFlags(_state.yregister);
+    }
+
+    else if constexpr (operation == Operation::ASL || operation == Operation::LSR || operation == Operation::ROL || operation == Operation::ROR)
+    {
+        tempValue8 = shift<operation>(argValue, lazyFlags);
+        if constexpr (mode == AddressingMode::Accumulator)
+            _state.accumulator = tempValue8;
+        else
+            writeMemoryByte<Observer>(argAddress, tempValue8);
+    }
+
+    else if constexpr (operation == Operation::JMP)
+        jumpTo(argAddress);
+    else if constexpr (operation == Operation::JSR)
+    {
+        tempValue16 = _state.programCounter - 1;
+        pushStackByte<Observer>(static_cast<uint8_t>(tempValue16 >> 8));
+        pushStackByte<Observer>(static_cast<uint8_t>(tempValue16));
+        jumpTo(argAddress);
+    }
+    else if constexpr (operation == Operation::RTS)
+    {
+        tempValue16 = pullStackByte<Observer>();
+        tempValue16 |= pullStackByte<Observer>() << 8;
+        jumpTo(tempValue16 + 1);
+    }
+
+    else if constexpr (operation == Operation::BCC || operation == Operation::BCS || operation == Operation::BEQ || operation == Operation::BMI
+                       || operation == Operation::BNE || operation == Operation::BPL || operation == Operation::BVC || operation == Operation::BVS)
+    {
+        constexpr uint8_t flagBit = (operation == Operation::BCC || operation == Operation::BCS) ? StatusFlags::Carry
+                                    : (operation == Operation::BEQ || operation == Operation::BNE) ? StatusFlags::Zero
+                                    : (operation == Operation::BMI || operation == Operation::BPL) ? StatusFlags::Negative
+                                    : StatusFlags::Overflow;
+        constexpr bool branchIfSet = operation == Operation::BCS || operation == Operation::BEQ || operation == Operation::BMI || operation == Operation::BVS;
+        if (lazyStatusFlag<flagBit>() == branchIfSet)
+            branchTo(argAddress);
+    }
+
+    else if constexpr (operation == Operation::CLC)
+        lazyFlags.carry = 0;
+    else if constexpr (operation == Operation::CLD)
+        unimplementedOperation(operation);
+    else if constexpr (operation == Operation::CLI)
+    {
+        clearStatusFlag(StatusFlags::InterruptDisable);
+        interruptMayBeTaken();
+    }
+    else if constexpr (operation == Operation::CLV)
+        lazyFlags.overflow = 0;
+    else if constexpr (operation == Operation::SEC)
+        lazyFlags.carry = 1;
+    else if constexpr (operation == Operation::SED)
+        unimplementedOperation(operation);
+    else if constexpr (operation == Operation::SEI)
+        setStatusFlag(StatusFlags::InterruptDisable);
+
+    else if constexpr (operation == Operation::BRK)
+    {
+        tempValue16 = _state.programCounter + 1;
+        pushStackByte<Observer>(static_cast<uint8_t>(tempValue16 >> 8));
+        pushStackByte<Observer>(static_cast<uint8_t>(tempValue16));
+        pushStackByte<Observer>(lazyPackedStatusFlags() | StatusFlags::Break);
+        setStatusFlag(StatusFlags::InterruptDisable);
+        jumpTo(InstructionSet::__JSR_brk_handler);
+    }
+    else if constexpr (operation == Operation::NOP)
+        ;
+    else if constexpr (operation == Operation::RTI)
+    {
+        setStatusFlags(pullStackByte<Observer>());
+        unpackStatusFlags();
+        tempValue16 = pullStackByte<Observer>();
+        tempValue16 |= pullStackByte<Observer>() << 8;
+        jumpTo(tempValue16);
+        interruptMayBeTaken();
+    }
+    else
+        static_assert(operation != operation, "Unimplemented operation");
+}
+
+
+//
+// Predecoded instructions
+// `decodedInstructions[]` holds a `DecodedInstruction` for every address, filled in the first time the address executes
+// Pages holding decoded instructions are flagged `CodePage`, so that only writes to those pages need to invalidate
+//
+
+const ProcessorCore::DecodedInstruction &ProcessorCore::decodeInstruction(uint16_t address)
+{
+    const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(_state.memory[address]));
+    DecodedInstruction &decoded(decodedInstructions[address]);
+    decoded.handlerIndex = instructionInfo.opcodeByte;
+    decoded.bytes = instructionInfo.bytes;
+    decoded.cycles = instructionInfo.cycles;
+    switch (instructionInfo.bytes)
+    {
+    case 2: decoded.operand = memoryByteAt(address + 1); break;
+    case 3: decoded.operand = memoryWordAt(address + 1); break;
+    default: decoded.operand = 0; break;
+    }
+    if (instructionInfo.addrMode == AddressingMode::Relative)
+        decoded.operand = address + 2 + static_cast<int8_t>(decoded.operand);
+
+    pageFlags[address >> 8] |= CodePage;
+    pageFlags[static_cast<uint16_t>(address + 2) >> 8] |= CodePage;
+    return decoded;
+}
+
+void ProcessorCore::invalidateDecodedInstructionsAt(uint16_t address)
+{
+    // the written byte can belong to an instruction starting up to 2 bytes before it
+    for (int i = 0; i < 3; i++)
+        decodedInstructions[static_cast<uint16_t>(address - i)].handlerIndex = UndecodedHandler;
+
+    std::vector<BasicBlock *> &blocks(pageBasicBlocks[address >> 8]);
+    for (int i = blocks.size() - 1; i >= 0; i--)
+        if (address >= blocks[i]->startAddress && address < blocks[i]->endAddress)
+            removeBasicBlock(blocks[i]);
+}
+
+void ProcessorCore::memoryPagesChanged(uint8_t firstPage, uint8_t lastPage)
+{
+    for (int page = firstPage; page <= lastPage; page++)
+    {
+        pageFlags[page] &= ~CleanPage;
+        if (!(pageFlags[page] & CodePage))
+            continue;
+        // with those instructions starting up to 2 bytes before the page
+        for (int address = (page << 8) - 2; address < (page + 1) << 8; address++)
+            decodedInstructions[static_cast<uint16_t>(address)].handlerIndex = UndecodedHandler;
+        std::vector<BasicBlock *> &blocks(pageBasicBlocks[page]);
+        while (!blocks.empty())
+            removeBasicBlock(blocks.back());
+        pageFlags[page] &= ~CodePage;
+    }
+    if (_memoryWrites.tracking)
+    {
+        _memoryWrites.add(firstPage << 8);
+        _memoryWrites.add((lastPage << 8) | 0xff);
+    }
+}
+
+void ProcessorCore::invalidateDecodedInstructions()
+{
+    for (int page = 0; page < 0x100; page++)
+        if (pageFlags[page] & CodePage)
+        {
+            for (int address = page << 8; address < (page + 1) << 8; address++)
+                decodedInstructions[address].handlerIndex = UndecodedHandler;
+            pageFlags[page] &= ~CodePage;
+        }
+    while (!basicBlocks.empty())
+        removeBasicBlock(basicBlocks.begin()->second.get());
+}
+
+
+//
+// Save states
+// A page flagged `CleanPage` holds just what `lastSaveState` has for it, so a save can share that page and a restore
+// of a save which shares it need not copy it
+//
+
+std::shared_ptr<const ProcessorCore::SaveState> ProcessorCore::saveState()
+{
+    std::shared_ptr<SaveState> saveState(std::make_shared<SaveState>());
+    std::memcpy(saveState->registers, &_state, sizeof(saveState->registers));
+    for (int page = 0; page < 0x100; page++)
+    {
+        if (lastSaveState != nullptr && (pageFlags[page] & CleanPage))
+            saveState->pages[page] = lastSaveState->pages[page];
+        else
+        {
+            std::shared_ptr<SaveState::Page> copy(std::make_shared<SaveState::Page>());
+            std::memcpy(copy->data(), _state.memory + (page << 8), copy->size());
+            saveState->pages[page] = copy;
+            pageFlags[page] |= CleanPage;
+        }
+    }
+    saveState->banks = _bankedMemory.save();
+    saveState->events = _events.schedule();
+    saveState->irqSources = _irqSources;
+    saveState->nmiPending = nmiPending;
+    saveState->waitingForInterrupt = _waitingForInterrupt;
+    if (hostDevices != nullptr)
+        saveState->devices = std::make_shared<HostDevicesState>(hostDevices->state());
+    lastSaveState = saveState;
+    return saveState;
+}
+
+void ProcessorCore::restoreState(const std::shared_ptr<const SaveState> &saveState)
+{
+    if (saveState->devices != nullptr && hostDevices == nullptr)
+        throw ExecutionError("Save state has host devices, but the core has none mapped");
+    std::memcpy(&_state, saveState->registers, sizeof(saveState->registers));
+    bool codeChanged = false;
+    for (int page = 0; page < 0x100; page++)
+    {
+        if (lastSaveState != nullptr && (pageFlags[page] & CleanPage) && lastSaveState->pages[page] == saveState->pages[page])
+            continue;
+        std::memcpy(_state.memory + (page << 8), saveState->pages[page]->data(), saveState->pages[page]->size());
+        if (pageFlags[page] & CodePage)
+            codeChanged = true;
+        pageFlags[page] |= CleanPage;
+    }
+    _bankedMemory.restore(saveState->banks);
+    // the devices first, as a reset lowers their IRQ and cancels their events
+    if (hostDevices != nullptr)
+    {
+        if (saveState->devices != nullptr)
+            hostDevices->setState(*saveState->devices);
+        else
+            hostDevices->reset();
+    }
+    _events.setSchedule(saveState->events);
+    _irqSources = saveState->irqSources;
+    nmiPending = saveState->nmiPending;
+    _waitingForInterrupt = saveState->waitingForInterrupt;
+    lastSaveState = saveState;
+    if (codeChanged)
+        invalidateDecodedInstructions();
+}
+
+void ProcessorCore::journalMemoryWrite(uint16_t address)
+{
+    _history->memoryWritten(currentInstructionIndex(), address, _state.memory[address]);
+}
+
+
+//
+// Execution trace
+// The crash trace is a ring of records, written unconditionally (a 16-byte store, with no test) rather than test
+// whether to; with no crash trace they all go to the one record
+// Going a step at a time every instruction is recorded; the block, threaded and JIT loops record only the entry to
+// each basic block, where each jump, branch, call or return arrived, as every instruction costs them too much
+// A full trace goes to `traceWriter()` from `executeNextInstruction()`, which all the loops fall back to while it is set
+//
+
+void ProcessorCore::setCrashTraceSize(int records)
+{
+    int size = 1;
+    while (size < records)
+        size <<= 1;
+    _crashTraceSize = records > 0 ? size : 0;
+    crashTraceRecords.reset(new TraceRecord[size]());
+    crashTraceMask = size - 1;
+    crashTraceNext = 0;
+}
+
+void ProcessorCore::writeTrace()
+{
+    // the instruction just executed is still the latest record, even with no crash trace
+    _traceWriter->record(crashTraceRecords[(crashTraceNext - 1) & crashTraceMask]);
+}
+
+TraceRecord ProcessorCore::traceRecord() const
+{
+    TraceRecord record{};
+    record.cycles = static_cast<uint32_t>(_state.totalElapsedCycles());
+    record.programCounter = _state.programCounter;
+    record.operand = memoryWordAt(_state.programCounter + 1);
+    record.opcode = _state.memory[_state.programCounter];
+    record.accumulator = _state.accumulator;
+    record.xregister = _state.xregister;
+    record.yregister = _state.yregister;
+    record.statusFlags = _state.statusFlags;
+    record.stackRegister = _state.stackRegister;
+    return record;
+}
+
+std::vector<TraceRecord> ProcessorCore::crashTrace() const
+{
+    const uint64_t count = std::min<uint64_t>(crashTraceNext, _crashTraceSize);
+    std::vector<TraceRecord> records;
+    records.reserve(count);
+    for (uint64_t i = crashTraceNext - count; i < crashTraceNext; i++)
+        records.push_back(crashTraceRecords[i & crashTraceMask]);
+    return records;
+}
+
+
+//
+// Basic blocks
+// A `BasicBlock` is the straight-line run of decoded instructions from an address up to and including the next
+// control transfer, cached by start address with its instructions' cycles already summed
+// Only the last instruction can take extra cycles via `currentInstructionCycles` or stop the run, so
+// `runBasicBlock()` need do its accounting and checks just once per block
+//
+
+const ProcessorCore::BasicBlock &ProcessorCore::basicBlockAt(uint16_t address)
+{
+    return findBasicBlock(address);
+}
+
+ProcessorCore::BasicBlock &ProcessorCore::findBasicBlock(uint16_t address)
+{
+    auto it = basicBlocks.find(address);
+    if (it != basicBlocks.end())
+        return *it->second;
+    return buildBasicBlock(address);
+}
+
+ProcessorCore::BasicBlock &ProcessorCore::buildBasicBlock(uint16_t address)
+{
+    BasicBlock *block = new BasicBlock;
+    block->startAddress = address;
+    block->baseCycles = 0;
+    block->hits = 0;
+    block->compiledCode = nullptr;
+    int nextAddress = address;
+    while (block->instructions.size() < MaxBasicBlockInstructions)
+    {
+        const InstructionInfo &instructionInfo(InstructionSet::getInstructionInfo(_state.memory[nextAddress]));
+        // an instruction wrapping round the end of memory is left for `executeNextInstruction()`
+        if (nextAddress + instructionInfo.bytes > static_cast<int>(memorySize()))
+            break;
+        block->instructions.push_back(decodeInstruction(nextAddress));
+        block->baseCycles += instructionInfo.cycles;
+        nextAddress += instructionInfo.bytes;
+        if (!instructionInfo.isValid() || opcodeMayStopRun(instructionInfo.opcodeByte))
+            break;
+    }
+    block->endAddress = nextAddress;
+
+    basicBlocks[address].reset(block);
+    for (int page = block->startAddress >> 8; page <= (block->endAddress - 1) >> 8; page++)
+        pageBasicBlocks[page].push_back(block);
+    return *block;
+}
+
+void ProcessorCore::removeBasicBlock(BasicBlock *block)
+{
+    for (int page = block->startAddress >> 8; page <= (block->endAddress - 1) >> 8; page++)
+    {
+        std::vector<BasicBlock *> &blocks(pageBasicBlocks[page]);
+        blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+    }
+    auto it = basicBlocks.find(block->startAddress);
+    // code written by the executing block: it is kept alive to finish the instruction which wrote
+    if (block == executingBasicBlock)
+        invalidatedExecutingBasicBlock = std::move(it->second);
+    basicBlocks.erase(it);
+}
+
+uint32_t ProcessorCore::basicBlockCycles(const BasicBlock &block, int executed) const
+{
+    if (executed == static_cast<int>(block.instructions.size()))
+        return block.baseCycles;
+    uint32_t cycles = 0;
+    for (int i = 0; i < executed; i++)
+        cycles += block.instructions[i].cycles;
+    return cycles;
+}
+
+
+//
+// Watchpoints
+// Pages holding any watched address are flagged `WatchedPage`; while there are watchpoints the loops run with
+// an observer which `checksPages`, checking just the accesses to those pages against `_watchpoints`
+// The first hit is kept in `_watchHit`, and the loops stop after the instruction which made it
+//
+
+uint8_t ProcessorCore::readFlaggedPage(uint16_t address)
+{
+    const uint8_t flags = pageFlags[address >> 8];
+    uint8_t value = (flags & DevicePage) ? pageDevices[address >> 8]->readByte(address) : _state.memory[address];
+    if (flags & WatchedPage)
+        checkWatchpoints(address, WatchRead, value, value);
+    return value;
+}
+
+void ProcessorCore::writeFlaggedPage(uint16_t address, uint8_t value, bool checkingWatchpoints)
+{
+    const uint8_t flags = pageFlags[address >> 8];
+    if ((flags & WatchedPage) && checkingWatchpoints)
+        checkWatchpoints(address, WatchWrite, _state.memory[address], value);
+    if (flags & DevicePage)
+        pageDevices[address >> 8]->writeByte(address, value);
+    else if (!(flags & RomPage))
+    {
+        _state.memory[address] = value;
+        memoryChangedAt(address);
+    }
+}
+
+void ProcessorCore::setWatchpoints(const std::vector<Watchpoint> &watchpoints)
+{
+    _watchpoints = watchpoints;
+    for (int page = 0; page < 0x100; page++)
+        pageFlags[page] &= ~WatchedPage;
+    for (const Watchpoint &watchpoint : _watchpoints)
+        for (int page = watchpoint.lowest >> 8; page <= watchpoint.highest >> 8; page++)
+            pageFlags[page] |= WatchedPage;
+}
+
+void ProcessorCore::checkWatchpoints(uint16_t address, uint8_t access, uint8_t oldValue, uint8_t newValue)
+{
+    uint8_t kinds = access;
+    if (access == WatchWrite && newValue != oldValue)
+        kinds |= WatchChange;
+    for (const Watchpoint &watchpoint : _watchpoints)
+        if (address >= watchpoint.lowest && address <= watchpoint.highest && (watchpoint.kinds & kinds))
+        {
+            watchHitAt((watchpoint.kinds & kinds & WatchChange) ? WatchChange : static_cast<WatchKinds>(access), address, oldValue, newValue);
+            return;
+        }
+}
+
+void ProcessorCore::watchHitAt(uint8_t kind, uint16_t address, uint8_t oldValue, uint8_t newValue)
+{
+    if (_watchHit.hit)
+        return;
+    _watchHit.hit = true;
+    _watchHit.kind = kind;
+    _watchHit.address = address;
+    _watchHit.oldValue = oldValue;
+    _watchHit.newValue = newValue;
+}
+
+void ProcessorCore::setBreakpointConditions(std::shared_ptr<const BreakpointConditions> conditions)
+{
+    std::atomic_store(&_breakpointConditions, std::move(conditions));
+}
+
+bool ProcessorCore::breakpointConditionHolds(uint16_t address) const
+{
+    // only ever reached at a breakpoint, so the atomic load costs nothing on the way to one
+    std::shared_ptr<const BreakpointConditions> conditions(std::atomic_load(&_breakpointConditions));
+    if (conditions == nullptr)
+        return true;
+    auto it = conditions->find(address);
+    return it == conditions->end() || it->second.holds(_state);
+}
+
+
+//
+// Events and interrupts
+// The loops run the due events with the status flags packed, as the devices and the interrupts' traps see them
+// Raising an interrupt, or clearing InterruptDisable with one waiting, schedules `interruptEvent` for now, so taking
+// it costs the loops nothing more than the events' own test
+//
+
+void ProcessorCore::setIrq(uint32_t source, bool asserted)
+{
+    _irqSources = asserted ? _irqSources | source : _irqSources & ~source;
+    if (asserted)
+        interruptMayBeTaken();
+}
+
+void ProcessorCore::triggerNmi()
+{
+    nmiPending = true;
+    interruptMayBeTaken();
+}
+
+void ProcessorCore::runDueEvents()
+{
+    packStatusFlags();
+    _events.runDue(_state.totalElapsedCycles());
+    unpackStatusFlags();
+}
+
+void ProcessorCore::takeInterrupt()
+{
+    // a wait for an interrupt returns to its caller first, with the interrupt still to be taken
+    if (_waitingForInterrupt)
+        return;
+    if (nmiPending)
+    {
+        nmiPending = false;
+        enterInterrupt(memoryWordAt(InstructionSet::__VEC_NMIV));
+    }
+    else if (_irqSources != 0 && !(_state.statusFlags & StatusFlags::InterruptDisable))
+        enterInterrupt(InternalJSRs::__JSR_brk_handler);
+}
+
+void ProcessorCore::enterInterrupt(uint16_t instructionAddress)
+{
+    // as BRK, but for the Break flag, with the program counter of the instruction to return to
+    static constexpr uint32_t interruptCycles = 7;
+    pushToStack(static_cast<uint8_t>(_state.programCounter >> 8));
+    pushToStack(static_cast<uint8_t>(_state.programCounter));
+    pushToStack(_state.statusFlags & ~StatusFlags::Break);
+    setStatusFlag(StatusFlags::InterruptDisable);
+    currentInstructionCycles = interruptCycles;
+    jumpTo(instructionAddress);
+    _state.elapsedCycles += currentInstructionCycles;
+}
+
+//
+// ProcessorCore::LazyStatusFlagsScope Class
+// For the duration of `step()`/`run...()`, N, Z, C and V live in `lazyFlags` as the result byte and carry/overflow
+// sources they came from, so ALU operations need not merge them into `_state.statusFlags` one by one
+// They are packed back into `_state.statusFlags` for PHP, BRK and internal JSRs, and when execution returns
+//
+class ProcessorCore::LazyStatusFlagsScope
+{
+public:
+    explicit LazyStatusFlagsScope(ProcessorCore *core) : core(core) { core->unpackStatusFlags(); }
+    ~LazyStatusFlagsScope() { core->packStatusFlags(); }
+
+private:
+    ProcessorCore *core;
+};
+
+template<class Function>
+inline auto ProcessorCore::withObserver(Function &&function)
+{
+    // the one test of the observation policy per call, rather than one per memory access
+    if (watching() || hasDevices())
+    {
+        if (_memoryWrites.tracking)
+            return function(UiPagesObserver());
+        else
+            return function(NullPagesObserver());
+    }
+    else if (_memoryWrites.tracking)
+        return function(UiObserver());
+    else
+        return function(NullObserver());
+}
+
+template<class Observer>
+inline void ProcessorCore::executeNextInstruction()
+{
+    uint16_t instructionProgramCounter = _state.programCounter;
+    const DecodedInstruction &decoded(decodedInstructions[instructionProgramCounter]);
+    traceInstruction(lazyPackedStatusFlags());
+    (this->*opcodeHandlers<Observer>[decoded.handlerIndex])(decoded.operand);
+
+    _state.elapsedCycles += currentInstructionCycles;
+    _state.instructionCount++;
+    if (executesEachInstruction())
+    {
+        if (_profiling.on)
+            profilingHit(instructionProgramCounter, currentInstructionCycles);
+        if (_traceWriter != nullptr)
+            writeTrace();
+    }
+    if (eventsDue())
+        runDueEvents();
+}
+
+void ProcessorCore::step()
+{
+    LazyStatusFlagsScope lazyStatusFlagsScope(this);
+    withObserver([this](auto observer) { executeNextInstruction<decltype(observer)>(); });
+}
+
+uint64_t ProcessorCore::runCycles(uint64_t cycles)
+{
+    uint64_t startInstructionCount = _state.instructionCount;
+    uint64_t endCycles = _state.totalElapsedCycles() + cycles;
+    LazyStatusFlagsScope lazyStatusFlagsScope(this);
+    withObserver([this, endCycles](auto observer) {
+        while (!_stopped && !stopsForWatchHit<decltype(observer)>() && _state.totalElapsedCycles() < endCycles)
+            executeNextInstruction<decltype(observer)>();
+    });
+    return _state.instructionCount - startInstructionCount;
+}
+
+uint64_t ProcessorCore::runUntil(uint16_t address)
+{
+    uint64_t startInstructionCount = _state.instructionCount;
+    LazyStatusFlagsScope lazyStatusFlagsScope(this);
+    withObserver([this, address](auto observer) {
+        do
+            executeNextInstruction<decltype(observer)>();
+        while (!_stopped && !stopsForWatchHit<decltype(observer)>() && _state.programCounter != address);
+    });
+    return _state.instructionCount - startInstructionCount;
+}
+
+int ProcessorCore::runBasicBlock()
+{
+    LazyStatusFlagsScope lazyStatusFlagsScope(this);
+    return withObserver([this](auto observer) { return executeBasicBlock<decltype(observer)>(); });
+}
+
+template<class Observer>
+int ProcessorCore::executeBasicBlock()
+{
+    const BasicBlock &block(basicBlockAt(_state.programCounter));
+    const int count = block.instructions.size();
+    if (count == 0 || executesEachInstruction())
+    {
+        executeNextInstruction<Observer>();
+        return 1;
+    }
+
+    traceInstruction(lazyPackedStatusFlags());
+    int executed = 0;
+    // while the history records, the cycles are counted as each instruction goes, as the devices see them going a
+    // step at a time, and the block stops where an event falls due, so its replay, a step at a time, runs the same
+    uint32_t countedCycles = 0;
+    executingBasicBlock = &block;
+    try
+    {
+        do
+        {
+            const DecodedInstruction &decoded(block.instructions[executed]);
+            if constexpr (Observer::recordsMemoryWrites)
+                executingBlockInstruction = executed;
+            (this->*opcodeHandlers<Observer>[decoded.handlerIndex])(decoded.operand);
+            executed++;
+            if constexpr (Observer::recordsMemoryWrites)
+                if (_history != nullptr)
+                {
+                    _state.elapsedCycles += currentInstructionCycles;
+                    countedCycles += currentInstructionCycles;
+                    if (eventsDue())
+                        break;
+                }
+        } while (executed < count && !invalidatedExecutingBasicBlock && !stopsForWatchHit<Observer>());
+    }
+    catch (...)
+    {
+        // the instruction which threw is not counted, as per `executeNextInstruction()`
+        _state.elapsedCycles += basicBlockCycles(block, executed) - countedCycles;
+        _state.instructionCount += executed;
+        executingBasicBlock = nullptr;
+        invalidatedExecutingBasicBlock.reset();
+        throw;
+    }
+
+    _state.elapsedCycles += basicBlockCycles(block, executed) + currentInstructionCycles - block.instructions[executed - 1].cycles - countedCycles;
+    _state.instructionCount += executed;
+    executingBasicBlock = nullptr;
+    invalidatedExecutingBasicBlock.reset();
+    if (eventsDue())
+        runDueEvents();
+    return executed;
+}
+
+uint64_t ProcessorCore::run()
+{
+    uint64_t startInstructionCount = _state.instructionCount;
+    // the JIT keeps its own status flags, and interprets via `step()` and `runBasicBlock()`; its native code
+    // does not check watchpoints
+    if (_jit != nullptr && !executesEachInstruction() && !watching())
+        _jit->run();
+    else
+    {
+        LazyStatusFlagsScope lazyStatusFlagsScope(this);
+        if (executesEachInstruction())
+            withObserver([this](auto observer) {
+                while (!_stopped && !stopsForWatchHit<decltype(observer)>())
+                    executeNextInstruction<decltype(observer)>();
+            });
+        else
+            withObserver([this](auto observer) { runThreaded<decltype(observer)>(); });
+    }
+    return _state.instructionCount - startInstructionCount;
+}
+
+int ProcessorCore::jitHitThreshold() const
+{
+    return _jit != nullptr ? _jit->hitThreshold() : 0;
+}
+
+void ProcessorCore::setJitHitThreshold(int hitThreshold)
+{
+    if (hitThreshold <= 0 || !JitCompiler::isSupported())
+        _jit.reset();
+    else
+    {
+        if (_jit == nullptr)
+            _jit.reset(new JitCompiler(this));
+        _jit->setHitThreshold(hitThreshold);
+    }
+}
+
+#define FOR_EACH_OPCODE(X) \
+    X(0x00) X(0x01) X(0x02) X(0x03) X(0x04) X(0x05) X(0x06) X(0x07) X(0x08) X(0x09) X(0x0a) X(0x0b) X(0x0c) X(0x0d) X(0x0e) X(0x0f) \
+    X(0x10) X(0x11) X(0x12) X(0x13) X(0x14) X(0x15) X(0x16) X(0x17) X(0x18) X(0x19) X(0x1a) X(0x1b) X(0x1c) X(0x1d) X(0x1e) X(0x1f) \
+    X(0x20) X(0x21) X(0x22) X(0x23) X(0x24) X(0x25) X(0x26) X(0x27) X(0x28) X(0x29) X(0x2a) X(0x2b) X(0x2c) X(0x2d) X(0x2e) X(0x2f) \
+    X(0x30) X(0x31) X(0x32) X(0x33) X(0x34) X(0x35) X(0x36) X(0x37) X(0x38) X(0x39) X(0x3a) X(0x3b) X(0x3c) X(0x3d) X(0x3e) X(0x3f) \
+    X(0x40) X(0x41) X(0x42) X(0x43) X(0x44) X(0x45) X(0x46) X(0x47) X(0x48) X(0x49) X(0x4a) X(0x4b) X(0x4c) X(0x4d) X(0x4e) X(0x4f) \
+    X(0x50) X(0x51) X(0x52) X(0x53) X(0x54) X(0x55) X(0x56) X(0x57) X(0x58) X(0x59) X(0x5a) X(0x5b) X(0x5c) X(0x5d) X(0x5e) X(0x5f) \
+    X(0x60) X(0x61) X(0x62) X(0x63) X(0x64) X(0x65) X(0x66) X(0x67) X(0x68) X(0x69) X(0x6a) X(0x6b) X(0x6c) X(0x6d) X(0x6e) X(0x6f) \
+    X(0x70) X(0x71) X(0x72) X(0x73) X(0x74) X(0x75) X(0x76) X(0x77) X(0x78) X(0x79) X(0x7a) X(0x7b) X(0x7c) X(0x7d) X(0x7e) X(0x7f) \
+    X(0x80) X(0x81) X(0x82) X(0x83) X(0x84) X(0x85) X(0x86) X(0x87) X(0x88) X(0x89) X(0x8a) X(0x8b) X(0x8c) X(0x8d) X(0x8e) X(0x8f) \
+    X(0x90) X(0x91) X(0x92) X(0x93) X(0x94) X(0x95) X(0x96) X(0x97) X(0x98) X(0x99) X(0x9a) X(0x9b) X(0x9c) X(0x9d) X(0x9e) X(0x9f) \
+    X(0xa0) X(0xa1) X(0xa2) X(0xa3) X(0xa4) X(0xa5) X(0xa6) X(0xa7) X(0xa8) X(0xa9) X(0xaa) X(0xab) X(0xac) X(0xad) X(0xae) X(0xaf) \
+    X(0xb0) X(0xb1) X(0xb2) X(0xb3) X(0xb4) X(0xb5) X(0xb6) X(0xb7) X(0xb8) X(0xb9) X(0xba) X(0xbb) X(0xbc) X(0xbd) X(0xbe) X(0xbf) \
+    X(0xc0) X(0xc1) X(0xc2) X(0xc3) X(0xc4) X(0xc5) X(0xc6) X(0xc7) X(0xc8) X(0xc9) X(0xca) X(0xcb) X(0xcc) X(0xcd) X(0xce) X(0xcf) \
+    X(0xd0) X(0xd1) X(0xd2) X(0xd3) X(0xd4) X(0xd5) X(0xd6) X(0xd7) X(0xd8) X(0xd9) X(0xda) X(0xdb) X(0xdc) X(0xdd) X(0xde) X(0xdf) \
+    X(0xe0) X(0xe1) X(0xe2) X(0xe3) X(0xe4) X(0xe5) X(0xe6) X(0xe7) X(0xe8) X(0xe9) X(0xea) X(0xeb) X(0xec) X(0xed) X(0xee) X(0xef) \
+    X(0xf0) X(0xf1) X(0xf2) X(0xf3) X(0xf4) X(0xf5) X(0xf6) X(0xf7) X(0xf8) X(0xf9) X(0xfa) X(0xfb) X(0xfc) X(0xfd) X(0xfe) X(0xff)
+
+template<class Observer>
+void ProcessorCore::runThreaded()
+{
+    // only control transfers can reach an internal JSR, and so stop the run; a stop from another thread is noticed at
+    // them too, as every loop has one
+    // the opcode handlers are inlined into each dispatch point, with no per-instruction call or profiling check
+#if USE_COMPUTED_GOTO
+#define OPCODE_LABEL(opcodeByte) &&opcode_##opcodeByte,
+#define DISPATCH() \
+        decoded = &decodedInstructions[_state.programCounter]; \
+        goto *dispatchTable[decoded->handlerIndex]
+#define OPCODE_BODY(opcodeByte) \
+    opcode_##opcodeByte: \
+        executeOpcode<opcodeByte, Observer>(decoded->operand); \
+        _state.elapsedCycles += currentInstructionCycles; \
+        _state.instructionCount++; \
+        if constexpr (opcodeMayStopRun(opcodeByte)) \
+        { \
+            if (eventsDue()) \
+                runDueEvents(); \
+            if (_stopped) \
+                return; \
+            traceInstruction(lazyPackedStatusFlags()); \
+        } \
+        if constexpr (Observer::checksPages) \
+            if (_watchHit.hit) \
+                return; \
+        DISPATCH();
+
+    static void *const dispatchTable[TotalHandlers] = { FOR_EACH_OPCODE(OPCODE_LABEL) &&undecoded };
+    const DecodedInstruction *decoded;
+    if (_stopped)
+        return;
+    traceInstruction(lazyPackedStatusFlags());
+    DISPATCH();
+    FOR_EACH_OPCODE(OPCODE_BODY)
+undecoded:
+    decodeInstruction(_state.programCounter);
+    DISPATCH();
+
+#undef OPCODE_BODY
+#undef DISPATCH
+#undef OPCODE_LABEL
+#else
+    traceInstruction(lazyPackedStatusFlags());
+#define OPCODE_CASE(opcodeByte) \
+    case opcodeByte: \
+        executeOpcode<opcodeByte, Observer>(decoded.operand); \
+        if constexpr (opcodeMayStopRun(opcodeByte)) \
+        { \
+            _state.elapsedCycles += currentInstructionCycles; \
+            _state.instructionCount++; \
+            if (eventsDue()) \
+                runDueEvents(); \
+            traceInstruction(lazyPackedStatusFlags()); \
+            continue; \
+        } \
+        break;
+
+    while (!_stopped && !stopsForWatchHit<Observer>())
+    {
+        const DecodedInstruction &decoded(decodedInstructions[_state.programCounter]);
+        switch (decoded.handlerIndex)
+        {
+            FOR_EACH_OPCODE(OPCODE_CASE)
+        case UndecodedHandler:
+            decodeInstruction(_state.programCounter);
+            continue;
+        }
+        _state.elapsedCycles += currentInstructionCycles;
+        _state.instructionCount++;
+    }
+
+#undef OPCODE_CASE
+#endif
+}
+
+
+void ProcessorCore::setNZStatusFlags(uint8_t value)
+{
+    setStatusFlag(StatusFlags::Negative, value & 0x80);
+    setStatusFlag(StatusFlags::Zero, value == 0);
+}
+
+void ProcessorCore::branchTo(uint16_t instructionAddress)
+{
+    currentInstructionCycles++;
+    if ((instructionAddress &0xff00) != (_state.programCounter & 0xff00))
+        currentInstructionCycles++;
+    jumpTo(instructionAddress);
+}
+
+void ProcessorCore::jumpTo(uint16_t instructionAddress)
+{
+    if (instructionAddress < TrapPage && instructionAddress != InternalJSRs::__JSR_terminate)
+    {
+        _state.programCounter = instructionAddress;
+        return;
+    }
+    // the traps, and the host they call, see the real status flags
+    packStatusFlags();
+    jumpToTrap(instructionAddress);
+    unpackStatusFlags();
+}
+
+void ProcessorCore::jumpToTrap(uint16_t instructionAddress)
+{
+    if (instructionAddress == InternalJSRs::__JSR_terminate)
+    {
+        stop();
+        return;
+    }
+    const Trap &trap(traps[instructionAddress - TrapPage]);
+    if (trap.handler == nullptr)
+    {
+        _state.programCounter = instructionAddress;
+        return;
+    }
+    trap.handler(*this);
+    if (trap.returns)
+    {
+        static constexpr int rtsCycles = InstructionSet::findInstructionInfo(Operation::RTS, AddressingMode::Implied)->cycles;
+        currentInstructionCycles += rtsCycles;
+        _state.programCounter = (pullFromStack() | (pullFromStack() << 8)) + 1;
+    }
+}
+
+void ProcessorCore::setTrap(uint16_t address, TrapHandler handler)
+{
+    if (address < TrapPage)
+        throw std::out_of_range("Trap address not in trap page");
+    traps[address - TrapPage] = { std::move(handler), true };
+}
+
+void ProcessorCore::setInternalTraps()
+{
+    struct InternalTrap { uint16_t address; void (ProcessorCore::*routine)(); };
+    static constexpr InternalTrap internalTraps[]
+    {
+        { InternalJSRs::__JSR_outch, &ProcessorCore::jsr_outch },
+        { InternalJSRs::__JSR_get_time, &ProcessorCore::jsr_get_time },
+        { InternalJSRs::__JSR_get_time_ms, &ProcessorCore::jsr_get_time_ms },
+        { InternalJSRs::__JSR_get_elapsed_time, &ProcessorCore::jsr_get_elapsed_time },
+        { InternalJSRs::__JSR_clear_elapsed_time, &ProcessorCore::jsr_clear_elapsed_time },
+        { InternalJSRs::__JSR_process_events, &ProcessorCore::jsr_process_events },
+        { InternalJSRs::__JSR_inkey, &ProcessorCore::jsr_inkey },
+        { InternalJSRs::__JSR_wait, &ProcessorCore::jsr_wait },
+        { InternalJSRs::__JSR_open_file, &ProcessorCore::jsr_open_file },
+        { InternalJSRs::__JSR_close_file, &ProcessorCore::jsr_close_file },
+        { InternalJSRs::__JSR_rewind_file, &ProcessorCore::jsr_rewind_file },
+        { InternalJSRs::__JSR_read_file, &ProcessorCore::jsr_read_file },
+        { InternalJSRs::__JSR_outstr_fast, &ProcessorCore::jsr_outstr_fast },
+        { InternalJSRs::__JSR_outstr_inline, &ProcessorCore::jsr_outstr_inline },
+        { InternalJSRs::__JSR_get_elapsed_cycles, &ProcessorCore::jsr_get_elapsed_cycles },
+        { InternalJSRs::__JSR_clear_elapsed_cycles, &ProcessorCore::jsr_clear_elapsed_cycles },
+    };
+    for (const InternalTrap &internalTrap : internalTraps)
+        traps[internalTrap.address - TrapPage] = { [routine = internalTrap.routine](ProcessorCore &core) { (core.*routine)(); }, true };
+    traps[InternalJSRs::__JSR_inch - TrapPage] = { [](ProcessorCore &core) { core.jsr_inch(); }, true };
+    // the BRK handlers go on to the BRKV vector, or stop, rather than returning
+    traps[InternalJSRs::__JSR_brk_handler - TrapPage] = { [](ProcessorCore &core) { core.jsr_brk_handler(); }, false };
+    traps[InternalJSRs::__JSR_brk_default_handler - TrapPage] = { [](ProcessorCore &core) { core.jsr_brk_default_handler(); }, false };
+    traps[InternalJSRs::__JSR_irq_default_handler - TrapPage] = { [](ProcessorCore &core) { core.jsr_irq_default_handler(); }, false };
+    traps[InternalJSRs::__JSR_nmi_default_handler - TrapPage] = { [](ProcessorCore &core) { core.jsr_nmi_default_handler(); }, false };
+    traps[InternalJSRs::__JSR_wait_interrupt - TrapPage] = { [](ProcessorCore &core) { core.jsr_wait_interrupt(); }, true };
+}
+
+void ProcessorCore::setMemoryLongAt(uint16_t address, uint32_t value)
+{
+    setMemoryByteAt(address, static_cast<uint8_t>(value));
+    setMemoryByteAt(address + 1, static_cast<uint8_t>(value >> 8));
+    setMemoryByteAt(address + 2, static_cast<uint8_t>(value >> 16));
+    setMemoryByteAt(address + 3, static_cast<uint8_t>(value >> 24));
+}
+
+void ProcessorCore::jsr_brk_handler()
+{
+    // $FFFE, for BRK and IRQ both: an IRQ pushed the flags without Break
+    uint8_t flags = memoryByteAt(StackBottom + static_cast<uint8_t>(_state.stackRegister + 1));
+    if (!(flags & StatusFlags::Break))
+    {
+        jumpTo(memoryWordAt(InstructionSet::__VEC_IRQV));
+        return;
+    }
+    _state.xregister = _state.stackRegister;
+
+    uint16_t instructionAddress = memoryWordAt(InstructionSet::__VEC_BRKV);
+    jumpTo(instructionAddress);
+}
+
+void ProcessorCore::jsr_brk_default_handler()
+{
+    setStatusFlags(pullFromStack());
+    uint16_t rtiAddress = pullFromStack() | (pullFromStack() << 8);
+    uint8_t signatureByte = memoryByteAt(rtiAddress - 1);
+    (void)signatureByte;
+    uint8_t maxLen;
+    const char *memoryAddress = memoryStrPointer(rtiAddress, &maxLen);
+    if (_host != nullptr)
+        _host->sendMessage(memoryAddress, maxLen);
+
+    stop();
+}
+
+void ProcessorCore::jsr_outch()
+{
+    if (_host != nullptr)
+        _host->outputChar(_state.accumulator);
+}
+
+void ProcessorCore::jsr_get_time()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    uint32_t seconds = static_cast<uint32_t>(time(NULL));
+    setMemoryLongAt(address, seconds);
+}
+
+void ProcessorCore::jsr_get_time_ms()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    uint32_t milliseconds = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(sinceEpoch).count());
+    setMemoryLongAt(address, milliseconds);
+}
+
+uint32_t ProcessorCore::elapsedTimeMilliseconds() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - elapsedTimeStart;
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+void ProcessorCore::jsr_get_elapsed_time()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    setMemoryLongAt(address, elapsedTimeMilliseconds());
+}
+
+void ProcessorCore::jsr_clear_elapsed_time()
+{
+    elapsedTimeStart = std::chrono::steady_clock::now();
+}
+
+void ProcessorCore::jsr_process_events()
+{
+    if (_host != nullptr)
+        _host->processEvents();
+}
+
+void ProcessorCore::jsr_inch(int timeout /*= -1*/, bool justWait /*= false*/)
+{
+    char result = _host != nullptr ? _host->inputChar(timeout, justWait) : '\0';
+    if (result == '\003' || result == '\033')  // Ctrl-C or Escape
+        stop();
+    _state.accumulator = result;
+    setNZStatusFlags(_state.accumulator);
+}
+
+void ProcessorCore::jsr_inkey()
+{
+    uint16_t timeout = _state.accumulator | (_state.xregister << 8);
+    jsr_inch(timeout);
+}
+
+void ProcessorCore::jsr_wait()
+{
+    uint16_t timeout = _state.accumulator | (_state.xregister << 8);
+    jsr_inch(timeout, true);
+}
+
+void ProcessorCore::jsr_open_file()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    bool goodName = false;
+    char filename[256];
+    for (int i = 0; i < sizeof(filename) - 1; i++)
+    {
+        char ch = memoryByteAt(address + i);
+        filename[i] = ch;
+        if (ch == '\0')
+            goodName = true;
+        if (!std::isprint(ch))
+            break;
+    }
+    if (!goodName)
+        throw ExecutionError("Bad filename");
+    if (_host == nullptr)
+        throw ExecutionError("No file system");
+    _host->openFile(filename);
+}
+
+void ProcessorCore::jsr_close_file()
+{
+    if (_host != nullptr)
+        _host->closeFile();
+}
+
+void ProcessorCore::jsr_rewind_file()
+{
+    if (_host != nullptr)
+        _host->rewindFile();
+}
+
+void ProcessorCore::jsr_read_file()
+{
+    bool success = false;
+    char ch;
+    if (_host != nullptr && _host->readFile(ch))
+    {
+        _state.accumulator = ch;
+        setNZStatusFlags(_state.accumulator);
+        success = true;
+    }
+    setStatusFlag(StatusFlags::Carry, !success);
+}
+
+void ProcessorCore::jsr_outstr_fast()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    uint8_t maxLen;
+    const char *memoryAddress = memoryStrPointer(address, &maxLen);
+    if (_host != nullptr)
+        _host->outputString(memoryAddress, maxLen);
+}
+
+void ProcessorCore::jsr_outstr_inline()
+{
+    uint16_t rtsAddress = (pullFromStack() | (pullFromStack() << 8)) + 1;
+    uint8_t maxLen;
+    const char *memoryAddress = memoryStrPointer(rtsAddress, &maxLen);
+    if (_host != nullptr)
+        _host->outputString(memoryAddress, maxLen);
+    rtsAddress += maxLen + 1 - 1;
+    pushToStack(static_cast<uint8_t>(rtsAddress >> 8));
+    pushToStack(static_cast<uint8_t>(rtsAddress));
+}
+
+void ProcessorCore::jsr_get_elapsed_cycles()
+{
+    uint16_t address = _state.accumulator | (_state.xregister << 8);
+    setMemoryLongAt(address, _state.elapsedCycles);
+}
+
+void ProcessorCore::jsr_clear_elapsed_cycles()
+{
+    _state.clearedElapsedCycles += _state.elapsedCycles;
+    _state.elapsedCycles = 0;
+}
+
+void ProcessorCore::jsr_irq_default_handler()
+{
+    // returns as RTI, but leaving interrupts disabled, so that a source with no handler does not interrupt for ever
+    setStatusFlags(pullFromStack() | StatusFlags::InterruptDisable);
+    _state.programCounter = pullFromStack() | (pullFromStack() << 8);
+}
+
+void ProcessorCore::jsr_nmi_default_handler()
+{
+    setStatusFlags(pullFromStack());
+    _state.programCounter = pullFromStack() | (pullFromStack() << 8);
+    interruptMayBeTaken();
+}
+
+void ProcessorCore::jsr_wait_interrupt()
+{
+    // as WAI: sleeps, the cycles going by to each next event in turn, until an interrupt is asserted; it is taken
+    // once this returns, unless interrupts are disabled
+    _waitingForInterrupt = true;
+    while (_irqSources == 0 && !nmiPending && !_stopped)
+    {
+        if (_events.empty())
+        {
+            _waitingForInterrupt = false;
+            throw ExecutionError("Waiting for an interrupt, with no events to come");
+        }
+        const uint64_t cycles = _state.totalElapsedCycles();
+        if (_events.nextEventCycle() > cycles)
+            _state.elapsedCycles += _events.nextEventCycle() - cycles;
+        _events.runDue(_state.totalElapsedCycles());
+    }
+    _waitingForInterrupt = false;
+    interruptMayBeTaken();
+}
+
+
+//
+// ExecutionError Class
+//
+
+ExecutionError::ExecutionError(const std::string &msg)
+    : std::runtime_error(msg)
+{
+
+}
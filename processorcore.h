@@ -0,0 +1,715 @@
+#ifndef PROCESSORCORE_H
+#define PROCESSORCORE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bankedmemory.h"
+#include "breakpointbitmap.h"
+#include "breakpointcondition.h"
+#include "cpustate.h"
+#include "eventscheduler.h"
+#include "executiontrace.h"
+#include "instructionset.h"
+
+class HostDevices;
+struct HostDevicesState;
+class IMemoryDevice;
+class IProcessorCoreHost;
+class JitCompiler;
+class ExecutionHistory;
+
+//
+// ProcessorCore Class
+//
+// The 6502 execution engine, with no Qt dependency and no signals
+// `ProcessorModel` observes one of these for the UI; tools can create and run as many as they like
+//
+class ProcessorCore
+{
+public:
+    using Operation = InstructionSet::Operation;
+    using AddressingMode = InstructionSet::AddressingMode;
+    using Instruction = InstructionSet::Instruction;
+    using InstructionInfo = InstructionSet::InstructionInfo;
+
+    enum StatusFlags : uint8_t
+    {
+        Negative = 0x80,
+        Overflow = 0x40,
+        NotUsed = 0x20,
+        Break = 0x10,
+        Decimal = 0x08,
+        InterruptDisable = 0x04,
+        Zero = 0x02,
+        Carry = 0x01
+    };
+    static_assert(Carry == 0x01, "StatusFlags::Carry must have a value of 0x01");
+
+    // The operations' arithmetic on plain values, with N, Z, C and V kept lazily as the values they come from (see
+    // `LazyStatusFlagsScope`): the execution loops and `LockstepCores` share these, so the two agree exactly
+    struct LazyStatusFlags
+    {
+        uint8_t negative;   // bit 7
+        uint8_t zero;       // Z when 0
+        uint8_t carry;      // 0 or 1
+        uint8_t overflow;   // bit 7
+    };
+    static uint8_t packLazyStatusFlags(uint8_t statusFlags, const LazyStatusFlags &lazyFlags)
+    {
+        uint8_t flags = statusFlags & ~(StatusFlags::Negative | StatusFlags::Overflow | StatusFlags::Zero | StatusFlags::Carry);
+        flags |= lazyFlags.negative & StatusFlags::Negative;
+        flags |= (lazyFlags.overflow >> 1) & StatusFlags::Overflow;
+        if (lazyFlags.zero == 0)
+            flags |= StatusFlags::Zero;
+        flags |= lazyFlags.carry & StatusFlags::Carry;
+        return flags;
+    }
+    static LazyStatusFlags unpackLazyStatusFlags(uint8_t statusFlags)
+    {
+        return LazyStatusFlags{ statusFlags, static_cast<uint8_t>((statusFlags & StatusFlags::Zero) ? 0 : 1),
+                                static_cast<uint8_t>(statusFlags & StatusFlags::Carry), static_cast<uint8_t>(statusFlags << 1) };
+    }
+    template<uint8_t flagBit> static bool lazyStatusFlagOf(const LazyStatusFlags &lazyFlags)
+    {
+        if constexpr (flagBit == StatusFlags::Carry)
+            return lazyFlags.carry != 0;
+        else if constexpr (flagBit == StatusFlags::Zero)
+            return lazyFlags.zero == 0;
+        else if constexpr (flagBit == StatusFlags::Negative)
+            return (lazyFlags.negative & 0x80) != 0;
+        else
+            return (lazyFlags.overflow & 0x80) != 0;
+    }
+    static void setLazyNZStatusFlags(LazyStatusFlags &lazyFlags, uint8_t value) { lazyFlags.negative = lazyFlags.zero = value; }
+    // N and Z for a result byte, as the JIT and recompiled code set them
+    static constexpr uint8_t nzStatusFlags(uint8_t value)
+    {
+        return (value & StatusFlags::Negative) | (value == 0 ? StatusFlags::Zero : 0);
+    }
+    static uint8_t addWithCarry(uint8_t accumulator, uint8_t value, LazyStatusFlags &lazyFlags)
+    {
+        // sum = (A + M + C), C = sum > 0xff, V = (~(A ^ M) & (A ^ R) & 0x80) != 0
+        const uint16_t sum = accumulator + value + lazyFlags.carry;
+        lazyFlags.carry = sum >> 8;
+        lazyFlags.overflow = ~(accumulator ^ value) & (accumulator ^ sum);
+        setLazyNZStatusFlags(lazyFlags, sum);
+        return sum;
+    }
+    static uint8_t subtractWithCarry(uint8_t accumulator, uint8_t value, LazyStatusFlags &lazyFlags)
+    {
+        // sum = (A + ~M + C), C = sum > 0xff, V = ((A ^ M) & (A ^ R) & 0x80) != 0
+        const uint16_t sum = accumulator + (value ^ 0xff) + lazyFlags.carry;
+        lazyFlags.carry = sum >> 8;
+        lazyFlags.overflow = (accumulator ^ value) & (accumulator ^ sum);
+        setLazyNZStatusFlags(lazyFlags, sum);
+        return sum;
+    }
+    static void compare(uint8_t registerValue, uint8_t value, LazyStatusFlags &lazyFlags)
+    {
+        // (R - M)
+        const uint16_t difference = registerValue - value;
+        lazyFlags.carry = difference <= 0xff;
+        setLazyNZStatusFlags(lazyFlags, difference);
+    }
+    static void bitTest(uint8_t accumulator, uint8_t value, LazyStatusFlags &lazyFlags)
+    {
+        lazyFlags.zero = accumulator & value;
+        lazyFlags.overflow = value << 1;
+        lazyFlags.negative = value;
+    }
+    template<Operation operation> static uint8_t shift(uint8_t value, LazyStatusFlags &lazyFlags)
+    {
+        uint8_t result;
+        if constexpr (operation == Operation::ASL)
+            result = value << 1;
+        else if constexpr (operation == Operation::LSR)
+            result = value >> 1;
+        else if constexpr (operation == Operation::ROL)
+            result = (value << 1) | lazyFlags.carry;
+        else
+            result = (value >> 1) | (lazyFlags.carry << 7);
+        if constexpr (operation == Operation::ASL || operation == Operation::ROL)
+            lazyFlags.carry = value >> 7;
+        else
+            lazyFlags.carry = value & 0x01;
+        setLazyNZStatusFlags(lazyFlags, result);
+        return result;
+    }
+
+    static constexpr uint16_t StackBottom = 0x0100;
+    static constexpr uint8_t StackInitial = 0xfd;
+    static constexpr uint16_t TrapPage = 0xff00;
+    // whether a jump to `address` may run a trap: conservatively, the whole of `TrapPage`, where a host may add its own
+    static constexpr bool isInternalJSRAddress(uint16_t address)
+    {
+        return address == InstructionSet::__JSR_terminate || address >= TrapPage;
+    }
+    // whether an instruction takes a cycle more when its indexed address crosses a page, for the loops, the JIT and
+    // recompiled code to agree
+    static constexpr bool operationHasPageCrossPenalty(Operation operation, AddressingMode mode)
+    {
+        if (mode != AddressingMode::AbsoluteX && mode != AddressingMode::AbsoluteY && mode != AddressingMode::IndirectIndexedY)
+            return false;
+        switch (operation)
+        {
+        case Operation::ADC: case Operation::AND: case Operation::CMP:
+        case Operation::EOR: case Operation::LDA: case Operation::LDX:
+        case Operation::LDY: case Operation::ORA: case Operation::SBC:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    explicit ProcessorCore(IProcessorCoreHost *host = nullptr);
+    ~ProcessorCore();
+
+    IProcessorCoreHost *host() const { return _host; }
+    void setHost(IProcessorCoreHost *host) { _host = host; }
+
+    CpuState &state() { return _state; }
+    const CpuState &state() const { return _state; }
+
+    uint8_t accumulator() const { return _state.accumulator; }
+    void setAccumulator(uint8_t newAccumulator) { _state.accumulator = newAccumulator; }
+    uint8_t xregister() const { return _state.xregister; }
+    void setXregister(uint8_t newXregister) { _state.xregister = newXregister; }
+    uint8_t yregister() const { return _state.yregister; }
+    void setYregister(uint8_t newYregister) { _state.yregister = newYregister; }
+
+    uint8_t stackRegister() const { return _state.stackRegister; }
+    void setStackRegister(uint8_t newStackRegister) { _state.stackRegister = newStackRegister; }
+    uint8_t pullFromStack() { _state.stackRegister++; return memoryByteAt(StackBottom + _state.stackRegister); }
+    void pushToStack(uint8_t value) { setMemoryByteAt(StackBottom + _state.stackRegister, value); _state.stackRegister--; }
+    static bool isStackAddress(uint16_t address) { return address >= StackBottom && address < StackBottom + 0x0100; }
+
+    uint8_t statusFlags() const { return _state.statusFlags; }
+    void setStatusFlags(uint8_t newStatusFlags) { _state.statusFlags = newStatusFlags & ~StatusFlags::Break; }
+    uint8_t statusFlag(uint8_t flagBit) const { return _state.statusFlags & flagBit; }
+    void clearStatusFlag(uint8_t flagBit) { _state.statusFlags &= ~(flagBit & ~StatusFlags::Break); }
+    void setStatusFlag(uint8_t flagBit) { _state.statusFlags |= flagBit & ~StatusFlags::Break; }
+    void setStatusFlag(uint8_t flagBit, bool on) { if (on) setStatusFlag(flagBit); else clearStatusFlag(flagBit); }
+
+    uint16_t programCounter() const { return _state.programCounter; }
+    void setProgramCounter(uint16_t newProgramCounter) { _state.programCounter = newProgramCounter; }
+
+    uint8_t *memory() { return _state.memory; }
+    const uint8_t *memory() const { return _state.memory; }
+    static constexpr unsigned int memorySize() { return CpuState::MemorySize; }
+    // the host's view of memory: ROM and device pages read and write as the RAM beneath them, with no side effects
+    uint8_t memoryByteAt(uint16_t address) const { return _state.memory[address]; }
+    void setMemoryByteAt(uint16_t address, uint8_t value)
+    {
+        if (_history != nullptr)
+            journalMemoryWrite(address);
+        _state.memory[address] = value;
+        if (pageFlags[address >> 8] & (CodePage | CleanPage))
+            memoryChangedAt(address);
+        if (_memoryWrites.tracking)
+            _memoryWrites.add(address);
+    }
+    // an instruction's write, as the execution loops make it: ROM ignores it and a device page's device gets it
+    void writeDataByteAt(uint16_t address, uint8_t value)
+    {
+        if (_memoryWrites.tracking)
+            writeMemoryByte<UiObserver>(address, value);
+        else
+            writeMemoryByte<NullObserver>(address, value);
+    }
+    uint16_t memoryWordAt(uint16_t address) const
+    {
+        return _state.memory[address] | (_state.memory[static_cast<uint16_t>(address + 1)] << 8);
+    }
+    uint16_t memoryZPWordAt(uint8_t zpaddress) const
+    {
+        return _state.memory[zpaddress] | (_state.memory[static_cast<uint8_t>(zpaddress + 1)] << 8);
+    }
+    char *memoryCharPointer(uint16_t address) { return reinterpret_cast<char *>(_state.memory + address); }
+    char *memoryStrPointer(uint16_t address, uint8_t *maxLen = nullptr);
+
+    Instruction *instructions() { return reinterpret_cast<Instruction *>(_state.memory); }
+    const Instruction *instructionAt(uint16_t address) const { return reinterpret_cast<const Instruction *>(_state.memory + address); }
+
+    struct DecodedInstruction
+    {
+        uint16_t operand;       // Relative: the branch target; otherwise the operand bytes
+        uint16_t handlerIndex;  // the opcode byte, or `UndecodedHandler`
+        uint8_t bytes, cycles;
+    };
+    static constexpr uint16_t UndecodedHandler = InstructionSet::TotalInstructions;
+    // anything which writes code via `memory()` while a run is in progress must call this
+    void invalidateDecodedInstructions();
+
+    struct BasicBlock
+    {
+        uint16_t startAddress;
+        int endAddress;         // one past the last byte of the last instruction
+        uint32_t baseCycles;    // before taken-branch/page-crossing/internal JSR extras
+        std::vector<DecodedInstruction> instructions;
+        uint32_t hits;              // for `JitCompiler`
+        const void *compiledCode;
+    };
+    static constexpr int MaxBasicBlockInstructions = 32;
+    const BasicBlock &basicBlockAt(uint16_t address);
+
+    struct MemoryWrites
+    {
+        bool tracking = true;
+        int lowest, highest, last;
+
+        MemoryWrites() { clear(); }
+        void clear() { lowest = 0x10000; highest = last = -1; }
+        bool any() const { return highest >= 0; }
+        void add(uint16_t address)
+        {
+            if (address < lowest)
+                lowest = address;
+            if (address > highest)
+                highest = address;
+            last = address;
+        }
+    };
+    const MemoryWrites &memoryWrites() const { return _memoryWrites; }
+    void clearMemoryWrites() { _memoryWrites.clear(); }
+    // picks the observation policy each `step()`/`run...()` call is instantiated for
+    void setTrackingMemoryWrites(bool tracking) { _memoryWrites.tracking = tracking; }
+
+    // Observation policies for the execution loops
+    // `NullObserver` (TurboRun, headless) compiles memory writes to plain stores; `UiObserver` also records
+    // them in `memoryWrites()` for the memory view
+    // The `...PagesObserver`s, used only while there are watchpoints or devices, also send the reads which fall
+    // in a watched or device page to `readFlaggedPage()`; other reads stay plain loads
+    template<bool records, bool checks> struct ObserverPolicy
+    {
+        static constexpr bool recordsMemoryWrites = records;
+        static constexpr bool checksPages = checks;
+    };
+    using NullObserver = ObserverPolicy<false, false>;
+    using UiObserver = ObserverPolicy<true, false>;
+    using NullPagesObserver = ObserverPolicy<false, true>;
+    using UiPagesObserver = ObserverPolicy<true, true>;
+
+    // Memory map: a page table of 256 pages, each RAM (the default), ROM (writes are ignored) or a device's
+    // Reads and writes of a device page go to its `IMemoryDevice`, owned by the caller
+    void mapRam(uint8_t firstPage, uint8_t lastPage);
+    void mapRom(uint8_t firstPage, uint8_t lastPage);
+    void mapDevice(uint8_t firstPage, uint8_t lastPage, IMemoryDevice *device);
+    IMemoryDevice *deviceAt(uint16_t address) const { return pageDevices[address >> 8]; }
+    bool hasDevices() const { return devicePageCount != 0; }
+    // maps the core's own console/timer/file device (see `HostDevices`) at `page`
+    void mapHostDevices(uint8_t page = InstructionSet::__DEV_page >> 8);
+    // Banked memory: windows onto a backing store of banks, selected by `HostDevices`' BANK registers, see
+    // `BankedMemory`; none until given a layout
+    // Selecting a bank is not journaled as writes to the history, but save states (so its checkpoints) keep the banks
+    BankedMemory &bankedMemory() { return _bankedMemory; }
+    const BankedMemory &bankedMemory() const { return _bankedMemory; }
+
+    // Traps: a jump to an address in `TrapPage` which has a handler runs the handler instead of 6502 code,
+    // then returns to the caller as RTS would; `InstructionSet::InternalJSRs` are the core's own
+    // A host can add its own (and replace those) with `setTrap()`; an empty handler removes one
+    using TrapHandler = std::function<void(ProcessorCore &core)>;
+    void setTrap(uint16_t address, TrapHandler handler);
+    bool hasTrapAt(uint16_t address) const { return address >= TrapPage && traps[address - TrapPage].handler != nullptr; }
+
+    // Save states: the registers, counters and memory, to go back to with `restoreState()`, and the events, the
+    // interrupt lines and the host devices' registers and timers, so interrupts come again as they came before
+    // Each save shares the pages of memory not written since the save (or restore) before it, so only the first
+    // costs a full copy; the first write to each page after a save just clears its `CleanPage` flag
+    // Writes via `memory()` are not seen, so `startRun()` starts again with a full copy
+    struct SaveState
+    {
+        using Page = std::array<uint8_t, 0x100>;
+        uint8_t registers[offsetof(CpuState, memory)];  // all of `CpuState` before its memory
+        std::shared_ptr<const Page> pages[0x100];
+        std::shared_ptr<const BankedMemory::Image> banks;   // nullptr for none
+        std::vector<EventScheduler::ScheduledEvent> events;
+        uint32_t irqSources;
+        bool nmiPending;
+        bool waitingForInterrupt;
+        std::shared_ptr<const HostDevicesState> devices;    // nullptr for none mapped
+    };
+    std::shared_ptr<const SaveState> saveState();
+    // throws `ExecutionError` for a save state with host devices on a core with none mapped
+    void restoreState(const std::shared_ptr<const SaveState> &saveState);
+
+    // Execution history, for reverse execution; owned by the caller, nullptr for none
+    // While there is one it is told of every write with `UiObserver` and every `setMemoryByteAt()`, with the
+    // value overwritten, see `ExecutionHistory`
+    ExecutionHistory *history() const { return _history; }
+    void setHistory(ExecutionHistory *history) { _history = history; }
+    // the instruction count of the instruction executing now (or of the next one, between instructions)
+    uint64_t currentInstructionIndex() const
+    {
+        return _state.instructionCount + (executingBasicBlock != nullptr ? executingBlockInstruction : 0);
+    }
+
+    // Execution trace: the crash trace is a ring of the last `crashTraceSize()` records, for what led up to an
+    // `ExecutionError`; it has every instruction run a step at a time (`step()`, `runCycles()`, `runUntil()`), but
+    // only the first instruction of each basic block from `runBasicBlock()` and `run()`
+    // While there is a `TraceWriter` (owned by the caller) every instruction executed also goes to it, and all the
+    // loops go a step at a time
+    int crashTraceSize() const { return _crashTraceSize; }
+    // rounded up to a power of 2; 0 for none
+    void setCrashTraceSize(int records);
+    // oldest first, since `startRun()`
+    std::vector<TraceRecord> crashTrace() const;
+    // the record of the instruction about to be executed, as the trace would have it
+    TraceRecord traceRecord() const;
+    TraceWriter *traceWriter() const { return _traceWriter; }
+    void setTraceWriter(TraceWriter *writer) { _traceWriter = writer; }
+
+    enum WatchKinds : uint8_t
+    {
+        WatchRead = 0x01,
+        WatchWrite = 0x02,
+        WatchChange = 0x04,             // a write of a different value
+        WatchStackOverflow = 0x08,      // a push with the stack register at $00
+        WatchStackUnderflow = 0x10,     // a pull with the stack register at $ff
+    };
+    struct Watchpoint
+    {
+        uint16_t lowest, highest;       // inclusive
+        uint8_t kinds;
+    };
+    struct WatchHit
+    {
+        bool hit = false;
+        uint8_t kind;
+        uint16_t address;
+        uint8_t oldValue, newValue;
+    };
+    // Watchpoints, set while not running; execution stops after the instruction which hits one
+    // only instructions' data accesses are watched, not the host's via `memoryByteAt()`/`setMemoryByteAt()`
+    const std::vector<Watchpoint> &watchpoints() const { return _watchpoints; }
+    void setWatchpoints(const std::vector<Watchpoint> &watchpoints);
+    uint8_t stackWatches() const { return _stackWatches; }
+    void setStackWatches(uint8_t kinds) { _stackWatches = kinds & (WatchStackOverflow | WatchStackUnderflow); }
+    bool watching() const { return !_watchpoints.empty() || _stackWatches != 0; }
+    const WatchHit &watchHit() const { return _watchHit; }
+    void clearWatchHit() { _watchHit.hit = false; }
+
+    struct Profiling
+    {
+        bool on = false;
+        int granularityShift = 0;
+        uint16_t programCounterLow, programCounterHigh;
+        struct HitCycleCounts { int hits, cycles; };
+        HitCycleCounts *counts = NULL;
+
+        ~Profiling() { delete[] counts; counts = NULL; }
+        void setGranularityShift(int shift) { granularityShift = shift; }
+        int granularitySize() const { return 1 << granularityShift; }
+    };
+    Profiling &profiling() { return _profiling; }
+    void setProfilingRange(uint16_t lowest, uint16_t highest);
+    void startProfiling();
+
+    // Events and interrupts
+    // Devices schedule events at cycles of the run with `events()`; they run between instructions once due, the
+    // execution loops testing just the cycle count against the next one, as they test `stopped()`: after each
+    // instruction going a step at a time, otherwise after each basic block's control transfer (or, while there is a
+    // `history()`, after the instruction they fall due at, as a step at a time)
+    // IRQ is a level, asserted while any of its sources (a bit each) asserts it, and taken while InterruptDisable is
+    // clear, through $FFFE (`__JSR_brk_handler`) as BRK is, which goes on to the IRQV vector for want of the Break
+    // flag; NMI is taken once for each `triggerNmi()`, through the NMIV vector
+    // The events and interrupt lines start again with each run, and are part of a save state
+    EventScheduler &events() { return _events; }
+    uint32_t irqSources() const { return _irqSources; }
+    void setIrq(uint32_t source, bool asserted);
+    void triggerNmi();
+    // in `__JSR_wait_interrupt`, skipping the cycles to the next event
+    bool waitingForInterrupt() const { return _waitingForInterrupt; }
+
+    uint32_t elapsedCycles() const { return _state.elapsedCycles; }
+    uint32_t elapsedTimeMilliseconds() const;
+    uint64_t totalElapsedCycles() const { return _state.totalElapsedCycles(); }
+    uint64_t instructionCount() const { return _state.instructionCount; }
+
+    // Breakpoints, for run loops to test inline; owned by the caller (`Emulator`), nullptr for none
+    const BreakpointBitmap *breakpoints() const { return _breakpoints; }
+    void setBreakpoints(const BreakpointBitmap *breakpoints) { _breakpoints = breakpoints; }
+    bool hasBreakpoints() const { return _breakpoints != nullptr && !_breakpoints->empty(); }
+    bool breakpointAt(uint16_t address) const { return hasBreakpoints() && _breakpoints->contains(address); }
+    bool breakpointInRange(uint16_t lowest, int highest) const { return hasBreakpoints() && _breakpoints->containsInRange(lowest, highest); }
+    // Conditions on the breakpoints, by instruction address; replaceable while running
+    void setBreakpointConditions(std::shared_ptr<const BreakpointConditions> conditions);
+    // whether to break at `address`: there is a breakpoint there and its condition, if any, holds
+    bool breakpointHitAt(uint16_t address) const { return breakpointAt(address) && breakpointConditionHolds(address); }
+
+    bool stopped() const { return _stopped; }
+    void setStopped(bool stopped) { _stopped = stopped; }
+    void stop() { _stopped = true; }
+
+    void reset();
+    void startRun();
+    // starts a run again from a save state taken just after `startRun()` and restored: as that leaves the registers
+    // and stack, and keeps the decoded instructions of the pages the last run did not write
+    void restartRun();
+
+    void step();
+    uint64_t runCycles(uint64_t cycles);
+    uint64_t runUntil(uint16_t address);
+    int runBasicBlock();
+    uint64_t run();
+
+    // `run()` compiles basic blocks entered this many times to native code, where supported; 0 for never
+    int jitHitThreshold() const;
+    void setJitHitThreshold(int hitThreshold);
+
+private:
+    friend class BankedMemory;
+    friend class JitCompiler;
+
+    CpuState _state;
+    IProcessorCoreHost *_host;
+    enum PageFlags : uint8_t { CodePage = 0x01, WatchedPage = 0x02, RomPage = 0x04, DevicePage = 0x08, CleanPage = 0x10 };
+    uint8_t pageFlags[0x100];
+    IMemoryDevice *pageDevices[0x100];
+    int devicePageCount;
+    std::unique_ptr<HostDevices> hostDevices;
+    BankedMemory _bankedMemory;
+    struct Trap
+    {
+        TrapHandler handler;
+        bool returns;   // as RTS, when the handler has not set the program counter itself
+    };
+    Trap traps[0x100];
+    std::shared_ptr<const SaveState> lastSaveState;
+    std::unique_ptr<DecodedInstruction[]> decodedInstructions;
+    std::unordered_map<uint16_t, std::unique_ptr<BasicBlock>> basicBlocks;
+    std::vector<BasicBlock *> pageBasicBlocks[0x100];
+    const BasicBlock *executingBasicBlock;
+    int executingBlockInstruction;  // kept only with `UiObserver`, for `currentInstructionIndex()`
+    std::unique_ptr<BasicBlock> invalidatedExecutingBasicBlock;
+    std::unique_ptr<JitCompiler> _jit;
+    // while executing, N, Z, C and V are kept as the values they come from, see `LazyStatusFlagsScope`
+    LazyStatusFlags lazyFlags;
+    class LazyStatusFlagsScope;
+    MemoryWrites _memoryWrites;
+    const BreakpointBitmap *_breakpoints;
+    std::shared_ptr<const BreakpointConditions> _breakpointConditions;
+    std::vector<Watchpoint> _watchpoints;
+    uint8_t _stackWatches;
+    WatchHit _watchHit;
+    ExecutionHistory *_history;
+    Profiling _profiling;
+    std::unique_ptr<TraceRecord[]> crashTraceRecords;
+    uint64_t crashTraceNext;
+    uint32_t crashTraceMask;        // with no crash trace, 0: the one record is overwritten each time
+    int _crashTraceSize;
+    TraceWriter *_traceWriter;
+    std::atomic<bool> _stopped;     // may be set from another thread, to stop a run
+    EventScheduler _events;
+    int interruptEvent;             // scheduled for now while an interrupt is to be taken
+    uint32_t _irqSources;
+    bool nmiPending;
+    bool _waitingForInterrupt;
+    uint32_t currentInstructionCycles;
+    std::chrono::steady_clock::time_point elapsedTimeStart;
+
+    template<class Function> auto withObserver(Function &&function);
+    template<class Observer> uint8_t readMemoryByte(uint16_t address)
+    {
+        if constexpr (Observer::checksPages)
+            if (pageFlags[address >> 8] & (WatchedPage | DevicePage))
+                return readFlaggedPage(address);
+        return _state.memory[address];
+    }
+    template<class Observer> void writeMemoryByte(uint16_t address, uint8_t value)
+    {
+        if constexpr (Observer::recordsMemoryWrites)
+            if (_history != nullptr)
+                journalMemoryWrite(address);
+        // plain RAM costs the one test of its page's flags
+        if (pageFlags[address >> 8] == 0)
+            _state.memory[address] = value;
+        else
+            writeFlaggedPage(address, value, Observer::checksPages);
+        if constexpr (Observer::recordsMemoryWrites)
+            _memoryWrites.add(address);
+    }
+    void journalMemoryWrite(uint16_t address);
+    // into the crash trace, before an instruction, with the status flags packed
+    void traceInstruction(uint8_t statusFlags)
+    {
+        // built in registers and stored as two (little-endian) words, as byte stores could alias `_state` and cost reloading it
+        const uint16_t programCounter = _state.programCounter;
+        const uint64_t low = static_cast<uint32_t>(_state.totalElapsedCycles())
+                | static_cast<uint64_t>(programCounter) << 32 | static_cast<uint64_t>(memoryWordAt(programCounter + 1)) << 48;
+        const uint64_t high = _state.memory[programCounter]
+                | _state.accumulator << 8 | _state.xregister << 16 | static_cast<uint32_t>(_state.yregister) << 24
+                | static_cast<uint64_t>(statusFlags) << 32 | static_cast<uint64_t>(_state.stackRegister) << 40;
+        uint64_t *__restrict record = reinterpret_cast<uint64_t *>(&crashTraceRecords[crashTraceNext++ & crashTraceMask]);
+        record[0] = low;
+        record[1] = high;
+    }
+    void writeTrace();
+    bool eventsDue() const { return _state.totalElapsedCycles() >= _events.nextEventCycle(); }
+    void runDueEvents();
+    // after anything which may clear InterruptDisable, or raise an interrupt
+    void interruptMayBeTaken()
+    {
+        if ((_irqSources != 0 && !(_state.statusFlags & StatusFlags::InterruptDisable)) || nmiPending)
+            _events.schedule(interruptEvent, _state.totalElapsedCycles());
+    }
+    void takeInterrupt();
+    void enterInterrupt(uint16_t instructionAddress);
+    // profiling and a full trace need every instruction, so the loops which skip them go a step at a time instead
+    bool executesEachInstruction() const { return _profiling.on || _traceWriter != nullptr; }
+    uint8_t readFlaggedPage(uint16_t address);
+    void writeFlaggedPage(uint16_t address, uint8_t value, bool checkingWatchpoints);
+    // for a bank selected into a window
+    void memoryPagesChanged(uint8_t firstPage, uint8_t lastPage);
+    void memoryChangedAt(uint16_t address)
+    {
+        uint8_t &flags(pageFlags[address >> 8]);
+        flags &= ~CleanPage;
+        if (flags & CodePage)
+            invalidateDecodedInstructionsAt(address);
+    }
+    template<class Observer> void pushStackByte(uint8_t value)
+    {
+        if constexpr (Observer::checksPages)
+            if ((_stackWatches & WatchStackOverflow) && _state.stackRegister == 0x00)
+                watchHitAt(WatchStackOverflow, StackBottom, _state.memory[StackBottom], value);
+        writeMemoryByte<Observer>(StackBottom + _state.stackRegister, value);
+        _state.stackRegister--;
+    }
+    template<class Observer> uint8_t pullStackByte()
+    {
+        if constexpr (Observer::checksPages)
+            if ((_stackWatches & WatchStackUnderflow) && _state.stackRegister == 0xff)
+                watchHitAt(WatchStackUnderflow, StackBottom, _state.memory[StackBottom], _state.memory[StackBottom]);
+        _state.stackRegister++;
+        return readMemoryByte<Observer>(StackBottom + _state.stackRegister);
+    }
+    // whether a run loop instantiated for `Observer` should return, having hit a watchpoint
+    template<class Observer> bool stopsForWatchHit() const
+    {
+        if constexpr (Observer::checksPages)
+            return _watchHit.hit;
+        else
+            return false;
+    }
+    void checkWatchpoints(uint16_t address, uint8_t access, uint8_t oldValue, uint8_t newValue);
+    void watchHitAt(uint8_t kind, uint16_t address, uint8_t oldValue, uint8_t newValue);
+    bool breakpointConditionHolds(uint16_t address) const;
+    template<class Observer> void executeNextInstruction();
+    template<class Observer> int executeBasicBlock();
+    template<class Observer> void runThreaded();
+    static constexpr bool opcodeMayStopRun(uint8_t opcodeByte);
+    const DecodedInstruction &decodeInstruction(uint16_t address);
+    void invalidateDecodedInstructionsAt(uint16_t address);
+    BasicBlock &findBasicBlock(uint16_t address);
+    BasicBlock &buildBasicBlock(uint16_t address);
+    void removeBasicBlock(BasicBlock *block);
+    uint32_t basicBlockCycles(const BasicBlock &block, int executed) const;
+    using OpcodeHandler = void (ProcessorCore::*)(uint16_t operand);
+    static constexpr std::size_t TotalHandlers = InstructionSet::TotalInstructions + 1;
+    using OpcodeHandlers = std::array<OpcodeHandler, TotalHandlers>;
+    template<class Observer> static const OpcodeHandlers opcodeHandlers;
+    template<class Observer, std::size_t... opcodeBytes>
+    static constexpr auto makeOpcodeHandlers(std::index_sequence<opcodeBytes...>) -> OpcodeHandlers;
+    [[noreturn]] static void illegalOpcode(uint8_t opcodeByte);
+    [[noreturn]] static void unimplementedOperation(Operation operation);
+    template<uint8_t opcodeByte, class Observer> void executeOpcode(uint16_t operand);
+    template<class Observer> void decodeAndExecute(uint16_t operand);
+    template<AddressingMode mode> uint16_t argumentAddress(uint16_t operand) const;
+    template<Operation operation, AddressingMode mode, class Observer> void executeOperation(uint8_t argValue, uint16_t argAddress);
+
+    void allocateProfilingHitCounts();
+    void profilingHit(uint16_t programCounter, int instructionCycles);
+    void setNZStatusFlags(uint8_t value);
+    void setLazyNZStatusFlags(uint8_t value) { setLazyNZStatusFlags(lazyFlags, value); }
+    template<uint8_t flagBit> bool lazyStatusFlag() const { return lazyStatusFlagOf<flagBit>(lazyFlags); }
+    uint8_t lazyPackedStatusFlags() const { return packLazyStatusFlags(_state.statusFlags, lazyFlags); }
+    void packStatusFlags() { _state.statusFlags = lazyPackedStatusFlags(); }
+    void unpackStatusFlags() { lazyFlags = unpackLazyStatusFlags(_state.statusFlags); }
+    void branchTo(uint16_t instructionAddress);
+    void jumpTo(uint16_t instructionAddress);
+    void jumpToTrap(uint16_t instructionAddress);
+    void setInternalTraps();
+    void setMemoryLongAt(uint16_t address, uint32_t value);
+    void jsr_brk_handler();
+    void jsr_brk_default_handler();
+    void jsr_outch();
+    void jsr_get_time();
+    void jsr_get_time_ms();
+    void jsr_get_elapsed_time();
+    void jsr_clear_elapsed_time();
+    void jsr_process_events();
+    void jsr_inch(int timeout = -1, bool justWait = false);
+    void jsr_inkey();
+    void jsr_wait();
+    void jsr_open_file();
+    void jsr_close_file();
+    void jsr_rewind_file();
+    void jsr_read_file();
+    void jsr_outstr_fast();
+    void jsr_outstr_inline();
+    void jsr_get_elapsed_cycles();
+    void jsr_clear_elapsed_cycles();
+    void jsr_irq_default_handler();
+    void jsr_nmi_default_handler();
+    void jsr_wait_interrupt();
+};
+
+
+//
+// IProcessorCoreHost Class
+//
+// What the core needs from its surroundings for the internal JSRs (console and file I/O)
+// A core with no host discards output and reads '\0' as input
+//
+class IProcessorCoreHost
+{
+public:
+    virtual ~IProcessorCoreHost() = default;
+    virtual void sendMessage(const char *message, int len) = 0;
+    virtual void outputChar(char ch) = 0;
+    virtual void outputString(const char *str, int len) = 0;
+    virtual char inputChar(int timeout, bool justWait) = 0;
+    virtual void processEvents() = 0;
+    virtual void openFile(const char *filename) = 0;
+    virtual void closeFile() = 0;
+    virtual void rewindFile() = 0;
+    virtual bool readFile(char &ch) = 0;
+};
+
+
+//
+// IMemoryDevice Class
+//
+// A device mapped into the address space by `ProcessorCore::mapDevice()`
+// It sees the instructions' reads and writes of its pages, with the full address
+//
+class IMemoryDevice
+{
+public:
+    virtual ~IMemoryDevice() = default;
+    virtual uint8_t readByte(uint16_t address) = 0;
+    virtual void writeByte(uint16_t address, uint8_t value) = 0;
+};
+
+
+//
+// ExecutionError Class
+//
+class ExecutionError : public std::runtime_error
+{
+public:
+    ExecutionError(const std::string &msg);
+};
+
+#endif // PROCESSORCORE_H
@@ -1,9 +1,9 @@
-#include <QCoreApplication>
-#include <QDateTime>
-#include <QDeadlineTimer>
 #include <QDebug>
+#include <QEventLoop>
 #include <QTimer>
 
+#include <algorithm>
+
 #include "appsettings.h"
 #include "processormodel.h"
 
@@ -15,23 +15,41 @@
 ProcessorModel::ProcessorModel(QObject *parent)
     : QObject{parent}
 {
-    _memory = _memoryData;
-    std::memset(_memoryData, 0xa5, memorySize());
+    _core = new ProcessorCore(this);
+    _core->mapHostDevices();
+    history = new ExecutionHistory(_core);
     _memoryModel = new MemoryModel(this);
     resetModel();
-    _instructions = reinterpret_cast<Instruction *>(_memoryData);
     processorBreakpointProvider = nullptr;
-    _programCounter = 0;
+    _core->setProgramCounter(0);
+    notifiedState.programCounter = 0;
     _currentRunMode = NotRunning;
     _startNewRun = true;
     _stopRun = true;
     _isRunning = false;
+
+    runThread = new QThread(this);
+    runThreadContext = new QObject;
+    runThreadContext->moveToThread(runThread);
+    runThread->start();
+    displayedState = nullptr;
+    snapshotTimer = new QTimer(this);
+    snapshotTimer->setInterval(20);
+    connect(snapshotTimer, &QTimer::timeout, this, &ProcessorModel::showRunSnapshot);
+    publishEverySoOften = publishForVerticalSyncs = 0;
 }
 
 ProcessorModel::~ProcessorModel()
 {
+    // quitting the thread also quits any event loop `inputChar()` is waiting in
+    _core->stop();
+    runThread->quit();
+    runThread->wait();
+    delete runThreadContext;
     if (userFile.isOpen())
         userFile.close();
+    delete history;
+    delete _core;
 }
 
 void ProcessorModel::setProcessorBreakpointProvider(IProcessorBreakpointProvider *provider)
@@ -41,189 +59,194 @@ void ProcessorModel::setProcessorBreakpointProvider(IProcessorBreakpointProvider
 
 uint8_t ProcessorModel::accumulator() const
 {
-    return _accumulator;
+    return _core->accumulator();
 }
 
 void ProcessorModel::setAccumulator(uint8_t newAccumulator)
 {
-    _accumulator = newAccumulator;
-    if (suppressSignalsForSpeed())
-        haveChangedState.accumulator = true;
-    else
-        emit accumulatorChanged(_accumulator);
+    _core->setAccumulator(newAccumulator);
+    changedExternally();
+    if (!suppressSignalsForSpeed())
+        emit accumulatorChanged(notifiedState.accumulator = newAccumulator);
 }
 
 uint8_t ProcessorModel::xregister() const
 {
-    return _xregister;
+    return _core->xregister();
 }
 
 void ProcessorModel::setXregister(uint8_t newXregister)
 {
-    _xregister = newXregister;
-    if (suppressSignalsForSpeed())
-        haveChangedState.xregister = true;
-    else
-        emit xregisterChanged(_xregister);
+    _core->setXregister(newXregister);
+    changedExternally();
+    if (!suppressSignalsForSpeed())
+        emit xregisterChanged(notifiedState.xregister = newXregister);
 }
 
 uint8_t ProcessorModel::yregister() const
 {
-    return _yregister;
+    return _core->yregister();
 }
 
 void ProcessorModel::setYregister(uint8_t newYregister)
 {
-    _yregister = newYregister;
-    if (suppressSignalsForSpeed())
-        haveChangedState.yregister = true;
-    else
-        emit yregisterChanged(_yregister);
+    _core->setYregister(newYregister);
+    changedExternally();
+    if (!suppressSignalsForSpeed())
+        emit yregisterChanged(notifiedState.yregister = newYregister);
 }
 
 uint8_t ProcessorModel::stackRegister() const
 {
-    return _stackRegister;
+    return _core->stackRegister();
 }
 
 void ProcessorModel::setStackRegister(uint8_t newStackRegister)
 {
-    _stackRegister = newStackRegister;
-    if (suppressSignalsForSpeed())
-        haveChangedState.stackRegister = true;
-    else
-        emit stackRegisterChanged(_stackRegister);
+    _core->setStackRegister(newStackRegister);
+    changedExternally();
+    if (!suppressSignalsForSpeed())
+        emit stackRegisterChanged(notifiedState.stackRegister = newStackRegister);
 }
 
 uint8_t ProcessorModel::pullFromStack()
 {
-    setStackRegister(_stackRegister + 1);
-    return memoryByteAt(_stackBottom + _stackRegister);
+    setStackRegister(stackRegister() + 1);
+    return memoryByteAt(ProcessorCore::StackBottom + stackRegister());
 }
 
 void ProcessorModel::pushToStack(uint8_t value)
 {
-    setMemoryByteAt(_stackBottom + _stackRegister, value);
-    setStackRegister(_stackRegister - 1);
+    setMemoryByteAt(ProcessorCore::StackBottom + stackRegister(), value);
+    setStackRegister(stackRegister() - 1);
 }
 
 bool ProcessorModel::isStackAddress(uint16_t address)
 {
-    return address >= _stackBottom && address < _stackBottom + 0x0100;
+    return ProcessorCore::isStackAddress(address);
 }
 
 uint8_t ProcessorModel::statusFlags() const
 {
-    return _statusFlags;
+    return _core->statusFlags();
 }
 
 void ProcessorModel::setStatusFlags(uint8_t newStatusFlags)
 {
-    _statusFlags = newStatusFlags & ~StatusFlags::Break;
+    _core->setStatusFlags(newStatusFlags);
+    changedExternally();
 }
 
 uint8_t ProcessorModel::statusFlag(uint8_t flagBit) const
 {
-    return _statusFlags & flagBit;
+    return _core->statusFlag(flagBit);
 }
 
 void ProcessorModel::clearStatusFlag(uint8_t newFlagBit)
 {
-    _statusFlags &= ~(newFlagBit & ~StatusFlags::Break);
+    _core->clearStatusFlag(newFlagBit);
+    changedExternally();
 }
 
 void ProcessorModel::setStatusFlag(uint8_t newFlagBit)
 {
-    _statusFlags |= newFlagBit & ~StatusFlags::Break;
+    _core->setStatusFlag(newFlagBit);
+    changedExternally();
 }
 
 void ProcessorModel::setStatusFlag(uint8_t newFlagBit, bool on)
 {
-    if (on)
-        setStatusFlag(newFlagBit);
-    else
-        clearStatusFlag(newFlagBit);
+    _core->setStatusFlag(newFlagBit, on);
+    changedExternally();
 }
 
 uint8_t *ProcessorModel::memory()
 {
-    return _memory;
+    return _core->memory();
 }
 
 unsigned int ProcessorModel::memorySize() const
 {
-    return sizeof(_memoryData);
+    return _core->memorySize();
 }
 
 uint8_t ProcessorModel::memoryByteAt(uint16_t address) const
 {
-    return _memory[address];
+    return _core->memoryByteAt(address);
+}
+
+uint8_t ProcessorModel::displayedMemoryByteAt(uint16_t address) const
+{
+    // the GUI thread must not read the core's memory while the run thread is writing it
+    return displayedState != nullptr ? displayedState->memory[address] : _core->memoryByteAt(address);
 }
 
 void ProcessorModel::setMemoryByteAt(uint16_t address, uint8_t value)
 {
-    _memory[address] = value;
+    _core->setMemoryByteAt(address, value);
+    changedExternally();
     _memoryModel->memoryChanged(address);
 }
 
 uint16_t ProcessorModel::memoryWordAt(uint16_t address) const
 {
-    return _memory[address] | (_memory[static_cast<uint16_t>(address + 1)] << 8);
+    return _core->memoryWordAt(address);
 }
 
 uint16_t ProcessorModel::memoryZPWordAt(uint8_t zpaddress) const
 {
-    return _memory[zpaddress] | (_memory[static_cast<uint8_t>(zpaddress + 1)] << 8);
+    return _core->memoryZPWordAt(zpaddress);
 }
 
 char *ProcessorModel::memoryCharPointer(uint16_t address) const
 {
-    return reinterpret_cast<char *>(_memory + address);
+    return _core->memoryCharPointer(address);
 }
 
 char *ProcessorModel::memoryStrPointer(uint16_t address, uint8_t *maxLen /*= nullptr*/) const
 {
-    char *memoryAddress = memoryCharPointer(address);
-    if (maxLen != nullptr)
-    {
-        int len = std::strlen(memoryAddress);
-        *maxLen = len < 255 ? len : 254;
-    }
-    return memoryAddress;
+    return _core->memoryStrPointer(address, maxLen);
 }
 
 Instruction *ProcessorModel::instructions() const
 {
-    return _instructions;
+    return _core->instructions();
 }
 
 uint16_t ProcessorModel::programCounter() const
 {
-    return _programCounter;
+    return _core->programCounter();
 }
 
 void ProcessorModel::setProgramCounter(uint16_t newProgramCounter)
 {
-    _programCounter = newProgramCounter;
-    if (suppressSignalsForSpeed())
-        haveChangedState.programCounter = true;
-    else
+    _core->setProgramCounter(newProgramCounter);
+    changedExternally();
+    if (!suppressSignalsForSpeed())
     {
-        emit programCounterChanged(_programCounter);
-        emit currentInstructionAddressChanged(_programCounter);
+        notifiedState.programCounter = newProgramCounter;
+        emit programCounterChanged(newProgramCounter);
+        emit currentInstructionAddressChanged(newProgramCounter);
     }
 }
 
 void ProcessorModel::resetModel()
 {
-    _stackRegister = _stackInitial;
-    _statusFlags = (0x00 & ~StatusFlags::Break);
-    _accumulator = 5;
-    _xregister = 10;
-    _yregister = 15;
+    _core->reset();
+    const CpuState &state(_core->state());
+    notifiedState.stackRegister = state.stackRegister;
+    notifiedState.accumulator = state.accumulator;
+    notifiedState.xregister = state.xregister;
+    notifiedState.yregister = state.yregister;
+    notifiedState.statusFlags = state.statusFlags;
     emit modelReset();
-    setMemoryByteAt(Assembly::__VEC_BRKV, static_cast<uint8_t>(Assembly::__JSR_brk_default_handler));
-    setMemoryByteAt(Assembly::__VEC_BRKV + 1, static_cast<uint8_t>(Assembly::__JSR_brk_default_handler >> 8));
+    _core->clearMemoryWrites();
+    _memoryModel->memoryChanged(Assembly::__VEC_BRKV);
+    _memoryModel->memoryChanged(Assembly::__VEC_BRKV + 1);
+    _memoryModel->memoryChanged(Assembly::__VEC_IRQV);
+    _memoryModel->memoryChanged(Assembly::__VEC_IRQV + 1);
+    _memoryModel->memoryChanged(Assembly::__VEC_NMIV);
+    _memoryModel->memoryChanged(Assembly::__VEC_NMIV + 1);
     _memoryModel->clearLastMemoryChanged();
     haveChangedState.clear();
     haveChangedState.trackingMemoryChanged = true;
@@ -232,41 +255,12 @@ void ProcessorModel::resetModel()
 
 void ProcessorModel::setProfilingRange(uint16_t lowest, uint16_t highest)
 {
-    _profiling.programCounterLow = lowest;
-    _profiling.programCounterHigh = highest;
+    _core->setProfilingRange(lowest, highest);
 }
 
 void ProcessorModel::startProfiling()
 {
-    allocateProfilingHitCounts();
-    _profiling.on = _profiling.counts != NULL;
-}
-
-void ProcessorModel::allocateProfilingHitCounts()
-{
-    if (_profiling.counts != NULL)
-    {
-        delete[] _profiling.counts;
-        _profiling.counts = NULL;
-    }
-    if (_profiling.programCounterHigh == 0x0 || _profiling.programCounterLow == 0xffff)
-        return;
-    int size = _profiling.programCounterHigh - _profiling.programCounterLow;
-    size >>= _profiling.granularityShift;
-    size++;
-    Q_ASSERT(size > 0 && size < 0x8000);
-    _profiling.counts = new Profiling::HitCycleCounts[size];
-    std::memset(_profiling.counts, 0, size * sizeof(Profiling::HitCycleCounts));
-}
-
-void ProcessorModel::profilingHit(uint16_t programCounter, int instructionCycles)
-{
-    if (_profiling.counts == NULL || programCounter < _profiling.programCounterLow || programCounter >= _profiling.programCounterHigh)
-        return;
-    int index = programCounter - _profiling.programCounterLow;
-    index >>= _profiling.granularityShift;
-    _profiling.counts[index].hits++;
-    _profiling.counts[index].cycles += instructionCycles;
+    _core->startProfiling();
 }
 
 
@@ -311,20 +305,49 @@ void ProcessorModel::memoryChanged(const QModelIndex &topLeft, const QModelIndex
 
 }
 
+void ProcessorModel::notifyChangedState(bool catchingUp /*= false*/)
+{
+    notifyState(_core->state(), catchingUp);
+    notifyMemoryWrites(_core->memoryWrites());
+    _core->clearMemoryWrites();
+}
+
+void ProcessorModel::notifyState(const CpuState &state, bool catchingUp)
+{
+    // the core does not signal, so compare it against what was last notified
+    if (state.stackRegister != notifiedState.stackRegister)
+        emit stackRegisterChanged(notifiedState.stackRegister = state.stackRegister);
+    if (state.accumulator != notifiedState.accumulator)
+        emit accumulatorChanged(notifiedState.accumulator = state.accumulator);
+    if (state.xregister != notifiedState.xregister)
+        emit xregisterChanged(notifiedState.xregister = state.xregister);
+    if (state.yregister != notifiedState.yregister)
+        emit yregisterChanged(notifiedState.yregister = state.yregister);
+    if (state.statusFlags != notifiedState.statusFlags || !catchingUp)
+        emit statusFlagsChanged(notifiedState.statusFlags = state.statusFlags);
+    if (state.programCounter != notifiedState.programCounter || !catchingUp)
+    {
+        notifiedState.programCounter = state.programCounter;
+        if (!catchingUp)
+            emit programCounterChanged(state.programCounter);
+        emit currentInstructionAddressChanged(state.programCounter);
+    }
+}
+
+void ProcessorModel::notifyMemoryWrites(const ProcessorCore::MemoryWrites &memoryWrites)
+{
+    if (memoryWrites.any())
+        _memoryModel->memoryChanged(memoryWrites.lowest, memoryWrites.highest, memoryWrites.last);
+}
+
 void ProcessorModel::catchUpSuppressedSignals()
 {
-    if (haveChangedState.stackRegister)
-        emit stackRegisterChanged(_stackRegister);
-    if (haveChangedState.accumulator)
-        emit accumulatorChanged(_accumulator);
-    if (haveChangedState.xregister)
-        emit xregisterChanged(_xregister);
-    if (haveChangedState.yregister)
-        emit yregisterChanged(_yregister);
-    if (haveChangedState.statusFlags)
-        emit statusFlagsChanged(_statusFlags);
-    if (haveChangedState.programCounter)
-        emit currentInstructionAddressChanged(_programCounter);
+    notifyChangedState(true);
+    emitSuppressedMemoryChanged();
+}
+
+void ProcessorModel::emitSuppressedMemoryChanged()
+{
     HaveChangedState::MemoryChanged memoryChanged1(haveChangedState.memoryChangedForegroundOnly);
     if (memoryChanged1.bottomRightRow >= 0)
         emit _memoryModel->dataChanged(_memoryModel->index(memoryChanged1.topLeftRow, memoryChanged1.topLeftColumn),
@@ -341,7 +364,32 @@ void ProcessorModel::catchUpSuppressedSignals()
         emit _memoryModel->dataChanged(_memoryModel->index(memoryChanged2.topLeftRow, memoryChanged2.topLeftColumn),
                                        _memoryModel->index(memoryChanged2.bottomRightRow, memoryChanged2.bottomRightColumn),
                                        {Qt::DisplayRole, Qt::EditRole, Qt::ForegroundRole});
+    bool trackingMemoryChanged = haveChangedState.trackingMemoryChanged;
     haveChangedState.clear();
+    haveChangedState.trackingMemoryChanged = trackingMemoryChanged;
+}
+
+void ProcessorModel::publishRunSnapshot()
+{
+    // skipped while the GUI thread has yet to take the last one, the memory writes carrying over to the next
+    if (!runSnapshots.canPublish())
+        return;
+    ProcessorSnapshots::Snapshot &snapshot(runSnapshots.backBuffer());
+    snapshot.state = _core->state();
+    snapshot.memoryWrites = _core->memoryWrites();
+    _core->clearMemoryWrites();
+    runSnapshots.publish();
+}
+
+void ProcessorModel::showRunSnapshot()
+{
+    const ProcessorSnapshots::Snapshot *snapshot = runSnapshots.take();
+    if (snapshot == nullptr)
+        return;
+    displayedState = &snapshot->state;
+    notifyState(snapshot->state, true);
+    notifyMemoryWrites(snapshot->memoryWrites);
+    emitSuppressedMemoryChanged();
 }
 
 
@@ -366,6 +414,7 @@ bool ProcessorModel::stopRun() const
 
 void ProcessorModel::setStopRun(bool newStopRun)
 {
+    _core->setStopped(newStopRun);
     if (newStopRun != _stopRun)
     {
         _stopRun = newStopRun;
@@ -387,22 +436,31 @@ void ProcessorModel::setStartNewRun(bool newStartNewRun)
         setCurrentRunMode(NotRunning);
 }
 
+uint64_t ProcessorModel::runInstructionCount() const
+{
+    return _core->instructionCount();
+}
+
+uint64_t ProcessorModel::runCycleCount() const
+{
+    return _core->totalElapsedCycles();
+}
+
 const Instruction *ProcessorModel::nextInstructionToExecute(uint16_t address) const
 {
-    const uint8_t *nextAddress = reinterpret_cast<const uint8_t *>(_instructions) + address;
-    return reinterpret_cast<const Instruction *>(nextAddress);
+    return _core->instructionAt(address);
 }
 
 const Instruction *ProcessorModel::nextInstructionToExecute() const
 {
-    return nextInstructionToExecute(_programCounter);
+    return nextInstructionToExecute(programCounter());
 }
 
 
 void ProcessorModel::debugMessage(const QString &message) const
 {
     QString message2(message);
-    QString location(QString("[instruction $%1]").arg(_programCounter, 4, 16, QChar('0')));
+    QString location(QString("[instruction $%1]").arg(programCounter(), 4, 16, QChar('0')));
     message2 = location + " " + message2;
     qDebug() << message2;
     emit sendMessageToConsole(message2, Qt::red);
@@ -413,6 +471,35 @@ void ProcessorModel::executionErrorMessage(const QString &message) const
     debugMessage("Execution Error: " + message);
 }
 
+void ProcessorModel::crashTraceMessage() const
+{
+    const std::vector<TraceRecord> records(_core->crashTrace());
+    if (records.empty())
+        return;
+    TraceFormatter formatter(processorBreakpointProvider->traceSymbols());
+    emit sendMessageToConsole(QString("Last %1 traced instructions:").arg(records.size()));
+    for (const TraceRecord &record : records)
+        emit sendMessageToConsole(QString::fromStdString(formatter.format(record)));
+}
+
+void ProcessorModel::watchHitMessage(const ProcessorCore::WatchHit &watchHit) const
+{
+    QString message;
+    switch (watchHit.kind)
+    {
+    case ProcessorCore::WatchRead: message = "read of $%1 ($%2)"; break;
+    case ProcessorCore::WatchWrite: message = "write to $%1 ($%2 -> $%3)"; break;
+    case ProcessorCore::WatchChange: message = "change of $%1 ($%2 -> $%3)"; break;
+    case ProcessorCore::WatchStackOverflow: message = "stack overflow"; break;
+    case ProcessorCore::WatchStackUnderflow: message = "stack underflow"; break;
+    }
+    if (message.contains("%1"))
+        message = message.arg(watchHit.address, 4, 16, QChar('0')).arg(watchHit.oldValue, 2, 16, QChar('0'));
+    if (message.contains("%3"))
+        message = message.arg(watchHit.newValue, 2, 16, QChar('0'));
+    debugMessage("Watchpoint: " + message);
+}
+
 
 /*slot*/ void ProcessorModel::restart()
 {
@@ -421,6 +508,7 @@ void ProcessorModel::executionErrorMessage(const QString &message) const
 
     if (userFile.isOpen())
         userFile.close();
+    history->stopRecording();
     resetModel();
     setStopRun(false);
     setStartNewRun(true);
@@ -436,7 +524,8 @@ void ProcessorModel::executionErrorMessage(const QString &message) const
 
 /*slot*/ void ProcessorModel::stop()
 {
-    if (userFile.isOpen())
+    // while running, the run thread may be reading the file; `endRunInstructions()` closes it
+    if (!_isRunning && userFile.isOpen())
         userFile.close();
     setStopRun(true);
 }
@@ -478,16 +567,13 @@ void ProcessorModel::runInstructions(RunMode runMode)
         return;
     Q_ASSERT(runMode != NotRunning);
 
+    bool startedNewRun = false;
     bool suppressingSignalsForSpeed = false;
     try
     {
-        bool startedNewRun = false;
-        bool step = runMode == StepInto || runMode == StepOut || runMode == StepOver;
         if (runMode == Run || runMode == TurboRun || startNewRun() || stopRun())
         {
             restart();
-            elapsedTimer.start();
-            elapsedCycles = 0;
             setStartNewRun(false);
             startedNewRun = true;
             if (runMode == Continue)
@@ -501,793 +587,415 @@ void ProcessorModel::runInstructions(RunMode runMode)
 
         setCurrentRunMode(runMode);
 
+        // as at the start of the run, for `endRunInstructions()`: stopping it can change the run mode first
         suppressingSignalsForSpeed = suppressSignalsForSpeed();
         if (suppressingSignalsForSpeed && runMode == TurboRun)
             haveChangedState.trackingMemoryChanged = false;
+        // picks the core's `UiObserver` or `NullObserver` instantiation for the whole run
+        _core->setTrackingMemoryWrites(haveChangedState.trackingMemoryChanged);
 
         if (startedNewRun)
         {
-            setStackRegister(_stackInitial);
-            uint16_t returnAddress = Assembly::__JSR_terminate - 1;
-            pushToStack(static_cast<uint8_t>(returnAddress >> 8));
-            pushToStack(static_cast<uint8_t>(returnAddress));
-            clearStatusFlag(StatusFlags::InterruptDisable);
+            _core->startRun();
+            if (runMode != TurboRun && settings().historyCheckpoints() > 0)
+            {
+                history->setMaxCheckpoints(settings().historyCheckpoints());
+                history->startRecording(ExecutionHistory::FileState());
+            }
+            if (!suppressSignalsForSpeed())
+                notifyChangedState();
         }
+        if (runMode == TurboRun)
+            _core->setJitHitThreshold(settings().jitHitThreshold());
+    }
+    catch (const ExecutionError &e)
+    {
+        stop();
+        executionErrorMessage(QString(e.what()));
+        return;
+    }
 
-        setIsRunning(true);
-        QCoreApplication::processEvents();
-        QCoreApplication::processEvents();  // extra time, allows proper redraw
-
-        int stopAtInstructionAddress = -1;
-        bool keepGoing = true;
-        if (startedNewRun)
-            if (runMode == StepInto
-                || (runMode != TurboRun && processorBreakpointProvider->breakpointAt(_programCounter)))
-                keepGoing = false;
+    publishEverySoOften = settings().processEventsEverySoOften();
+    publishForVerticalSyncs = settings().processEventsForVerticalSyncs();
+    runExecutionError.clear();
+    // the run thread is not going yet, so there is a snapshot to show from the start
+    publishRunSnapshot();
+    showRunSnapshot();
+    snapshotTimer->start();
+    setIsRunning(true);
 
-        int instructionCount = 0;
-        const int processEventsEverySoOften = settings().processEventsEverySoOften();
-        const int processEventsForVerticalSyncs = settings().processEventsForVerticalSyncs();
-        QDeadlineTimer verticalSync(processEventsForVerticalSyncs);
+    QMetaObject::invokeMethod(runThreadContext, [this, runMode, startedNewRun, suppressingSignalsForSpeed]() {
+        executeRun(runMode, startedNewRun);
+        QMetaObject::invokeMethod(this, [this, suppressingSignalsForSpeed]() { endRunInstructions(suppressingSignalsForSpeed); }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
 
-        while (!stopRun() && keepGoing)
+void ProcessorModel::executeRun(RunMode runMode, bool startedNewRun)
+{
+    //
+    // EXECUTION PHASE
+    // on `runThread`: nothing here signals state changes, the GUI thread picks them up from `publishRunSnapshot()`
+    //
+    _core->clearWatchHit();
+    try
+    {
+        if (runMode == TurboRun)
+            _core->run();
+        else
         {
-            const Instruction *instruction(nextInstructionToExecute());
-            keepGoing = !step || stopAtInstructionAddress >= 0;
-            if (step && stopAtInstructionAddress < 0)
+            bool step = runMode == StepInto || runMode == StepOut || runMode == StepOver;
+            int stopAtInstructionAddress = -1;
+            bool keepGoing = true;
+            if (startedNewRun)
+                if (runMode == StepInto || _core->breakpointHitAt(programCounter()))
+                    keepGoing = false;
+            if (keepGoing && step)
             {
-                if (runMode == StepOver)
-                {
-                    uint16_t lastInstructionAddress = processorBreakpointProvider->lastInstructionAddressAtSameFileLineNumber(_programCounter);
-                    const Instruction *instruction2(nextInstructionToExecute(lastInstructionAddress));
-                    const InstructionInfo &instructionInfo(instruction2->getInstructionInfo());
-                    const Operation operation(instructionInfo.operation);
-                    if (operation == Operation::JSR)
-                    {
-                        stopAtInstructionAddress = lastInstructionAddress + instructionInfo.bytes;
-                        if (instruction->operand == InternalJSRs::__JSR_outstr_inline)
-                        {
-                            uint8_t maxLen;
-                            memoryStrPointer(stopAtInstructionAddress, &maxLen);
-                            stopAtInstructionAddress += maxLen + 1;
-                        }
-                        keepGoing = true;
-                    }
-                    else if (lastInstructionAddress > _programCounter)
-                    {
-                        stopAtInstructionAddress = lastInstructionAddress + instructionInfo.bytes;
-                        keepGoing = true;
-                    }
-                }
-                else if (runMode == StepOut)
+                // a statement which is not a call or a loop is just the one instruction
+                stopAtInstructionAddress = stepStopAddress(runMode);
+                if (stopAtInstructionAddress < 0)
                 {
-                    uint16_t rtsAddress = memoryWordAt(_stackBottom + static_cast<uint8_t>(_stackRegister + 1)) + 1;
-                    stopAtInstructionAddress = rtsAddress;
-                    keepGoing = true;
+                    _core->step();
+                    history->executed();
+                    keepGoing = false;
                 }
             }
 
-            runNextInstruction(*instruction);
-            instructionCount++;
-
-            if (runMode == TurboRun)
-                continue;
-
-            if (_programCounter == stopAtInstructionAddress || processorBreakpointProvider->breakpointAt(_programCounter))
-                keepGoing = false;
-
-            bool processEvents = false;
-            if (processEventsForVerticalSyncs != 0 && verticalSync.hasExpired())
+            RunSliceScheduler scheduler(publishForVerticalSyncs, publishEverySoOften);
+            while (!_core->stopped() && keepGoing)
             {
-                verticalSync.setRemainingTime(processEventsForVerticalSyncs);
-                processEvents = true;
+                // when not stepping, breakpoints are checked once per basic block instead of per instruction,
+                // and reaching one (or where the step stops, or a watchpoint) cuts the slice short
+                const int slice = scheduler.nextSlice();
+                int executed = 0;
+                do
+                {
+                    if (step)
+                    {
+                        _core->step();
+                        executed++;
+                    }
+                    else
+                        executed += runNextBasicBlock();
+                    history->executed();
+                    if (programCounter() == stopAtInstructionAddress || _core->breakpointHitAt(programCounter()) || _core->watchHit().hit)
+                        keepGoing = false;
+                } while (keepGoing && executed < slice && !_core->stopped());
+
+                if (scheduler.endSlice(executed))
+                    publishRunSnapshot();
             }
-            if (processEventsEverySoOften != 0 && instructionCount % processEventsEverySoOften == 0)
-                processEvents = true;
-            if (processEvents)
+        }
+    }
+    catch (const ExecutionError &e)
+    {
+        _core->stop();
+        runExecutionError = e.what();
+    }
+}
+
+int ProcessorModel::stepStopAddress(RunMode runMode) const
+{
+    const Instruction *instruction(nextInstructionToExecute());
+    if (runMode == StepOver)
+    {
+        uint16_t lastInstructionAddress = processorBreakpointProvider->lastInstructionAddressAtSameFileLineNumber(programCounter());
+        const Instruction *instruction2(nextInstructionToExecute(lastInstructionAddress));
+        const InstructionInfo &instructionInfo(instruction2->getInstructionInfo());
+        const Operation operation(instructionInfo.operation);
+        if (operation == Operation::JSR)
+        {
+            int stopAtInstructionAddress = lastInstructionAddress + instructionInfo.bytes;
+            if (instruction->operand == InternalJSRs::__JSR_outstr_inline)
             {
-                catchUpSuppressedSignals();
-                QCoreApplication::processEvents();
+                uint8_t maxLen;
+                memoryStrPointer(stopAtInstructionAddress, &maxLen);
+                stopAtInstructionAddress += maxLen + 1;
             }
+            return stopAtInstructionAddress;
         }
+        else if (lastInstructionAddress > programCounter())
+            return lastInstructionAddress + instructionInfo.bytes;
     }
-    catch (const ExecutionError &e)
+    else if (runMode == StepOut)
+        return memoryWordAt(ProcessorCore::StackBottom + static_cast<uint8_t>(stackRegister() + 1)) + 1;
+    return -1;
+}
+
+void ProcessorModel::endRunInstructions(bool suppressingSignalsForSpeed)
+{
+    // back on the GUI thread, with the run thread idle
+    snapshotTimer->stop();
+    showRunSnapshot();
+    displayedState = nullptr;
+
+    if (!runExecutionError.empty())
     {
         stop();
-        executionErrorMessage(QString(e.what()));
+        executionErrorMessage(QString::fromStdString(runExecutionError));
+        crashTraceMessage();
+    }
+    else if (_core->stopped() && !stopRun())
+        stop();
+    if (_core->watchHit().hit)
+    {
+        watchHitMessage(_core->watchHit());
+        _core->clearWatchHit();
     }
+    if (stopRun() && userFile.isOpen())
+        userFile.close();
 
     if (suppressingSignalsForSpeed)
     {
         catchUpSuppressedSignals();
         haveChangedState.trackingMemoryChanged = true;
     }
+    else
+        notifyChangedState();
+    _core->setTrackingMemoryWrites(true);
     setIsRunning(false);
+    emit runFinished();
 }
 
-void ProcessorModel::runNextInstruction(const Instruction &instruction)
-{
-    if (stopRun())
-        return;
-
-    //
-    // EXECUTION PHASE
-    //
-    executeNextInstruction(instruction);
-}
-
-
-void ProcessorModel::executeNextInstruction(const Instruction &instruction)
+int ProcessorModel::runNextBasicBlock()
 {
-    //
-    // EXECUTION PHASE
-    //
-
-    const InstructionInfo &instructionInfo(instruction.getInstructionInfo());
-    const Operation operation(instructionInfo.operation);
-    const AddressingMode mode(instructionInfo.addrMode);
-    const uint16_t operand(instruction.operand);
-    if (!instructionInfo.isValid())
-        throw ExecutionError(QString("Illegal opcode: %1 %2 %3")
-                                 .arg(instructionInfo.opcodeByte, 2, 16, QChar('0'))
-                                 .arg(Assembly::OperationValueToString(operation))
-                                 .arg(Assembly::AddressingModeValueToString(mode)));
-
-    uint8_t _argValue = -1;
-    uint16_t _argAddress = -1;
-    switch (mode)
+    // a breakpoint part way through the block means going an instruction at a time up to it
+    if (_core->hasBreakpoints())
     {
-    case AddressingMode::Implied:
-        break;
-    case AddressingMode::Accumulator:
-        _argValue = _accumulator;
-        break;
-    case AddressingMode::Immediate:
-        _argValue = operand;
-        break;
-    case AddressingMode::Relative:
-        _argAddress = _programCounter + 2 + static_cast<int8_t>(operand);
-        break;
-    case AddressingMode::Absolute:
-    case AddressingMode::AbsoluteX:
-    case AddressingMode::AbsoluteY:
-    case AddressingMode::ZeroPage:
-    case AddressingMode::ZeroPageX:
-    case AddressingMode::ZeroPageY:
-    case AddressingMode::Indirect:
-    case AddressingMode::IndexedIndirectX:
-    case AddressingMode::IndirectIndexedY:
-        _argAddress = operand;
-        switch (mode)
+        const ProcessorCore::BasicBlock &basicBlock(_core->basicBlockAt(programCounter()));
+        if (_core->breakpointInRange(basicBlock.startAddress + 1, basicBlock.endAddress))
         {
-        case AddressingMode::Absolute: break;
-        case AddressingMode::AbsoluteX: _argAddress += _xregister; break;
-        case AddressingMode::AbsoluteY: _argAddress += _yregister; break;
-        case AddressingMode::ZeroPage: _argAddress = static_cast<uint8_t>(_argAddress); break;
-        case AddressingMode::ZeroPageX: _argAddress = static_cast<uint8_t>(_argAddress + _xregister); break;
-        case AddressingMode::ZeroPageY: _argAddress = static_cast<uint8_t>(_argAddress + _yregister); break;
-        case AddressingMode::Indirect: _argAddress = memoryWordAt(_argAddress); break;
-        case AddressingMode::IndexedIndirectX: _argAddress = memoryZPWordAt(_argAddress + _xregister); break;
-        case AddressingMode::IndirectIndexedY: _argAddress = memoryZPWordAt(_argAddress) + _yregister; break;
-        default: break;
+            _core->step();
+            return 1;
         }
-        switch (operation)
-        {
-        case Operation::STA: case Operation::STX: case Operation::STY:
-        case Operation::JMP: case Operation::JSR:
-            break;
-        default:
-            _argValue = memoryByteAt(_argAddress);
-            break;
-        }
-        break;
-    default:
-        throw ExecutionError(QString("Unimplemented operand addressing mode: %1").arg(Assembly::AddressingModeValueToString(mode)));
     }
-
-    uint16_t instructionProgramCounter = _programCounter;
-    setProgramCounter(_programCounter + instructionInfo.bytes);
-    currentInstructionCycles = instructionInfo.cycles;
-
-    const uint8_t argValue{_argValue};
-    const uint16_t argAddress{_argAddress};
-    uint8_t tempValue8, origTempValue8;
-    uint16_t tempValue16;
-
-    if (mode == AddressingMode::AbsoluteX || mode == AddressingMode::AbsoluteY || mode == AddressingMode::IndirectIndexedY)
-        switch (operation)
-        {
-        case Operation::ADC: case Operation::AND: case Operation::CMP:
-        case Operation::EOR: case Operation::LDA: case Operation::LDX:
-        case Operation::LDY: case Operation::ORA: case Operation::SBC: {
-            uint16_t baseAddress = operand;
-            if (mode == AddressingMode::IndirectIndexedY)
-                baseAddress = memoryZPWordAt(baseAddress);
-            if ((argAddress & 0xff00) != (baseAddress & 0xff00))
-                elapsedCycles++;
-            break;
-        }
-        default: break;
-        }
-
-    // Operations ordered/grouped as per http://www.6502.org/users/obelisk/6502/instructions.html
-    switch (operation)
-    {
-    case Operation::LDA:
-        setAccumulator(argValue);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::LDX:
-        setXregister(argValue);
-        setNZStatusFlags(_xregister);
-        break;
-    case Operation::LDY:
-        setYregister(argValue);
-        setNZStatusFlags(_yregister);
-        break;
-    case Operation::STA:
-        setMemoryByteAt(argAddress, _accumulator);
-        break;
-    case Operation::STX:
-        setMemoryByteAt(argAddress, _xregister);
-        break;
-    case Operation::STY:
-        setMemoryByteAt(argAddress, _yregister);
-        break;
-
-    case Operation::TAX:
-        setXregister(_accumulator);
-        setNZStatusFlags(_xregister);
-        break;
-    case Operation::TAY:
-        setYregister(_accumulator);
-        setNZStatusFlags(_yregister);
-        break;
-    case Operation::TXA:
-        setAccumulator(_xregister);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::TYA:
-        setAccumulator(_yregister);
-        setNZStatusFlags(_accumulator);
-        break;
-
-    case Operation::TSX:
-        setXregister(_stackRegister);
-        setNZStatusFlags(_xregister);
-        break;
-    case Operation::TXS:
-        setStackRegister(_xregister);
-        break;
-    case Operation::PHA:
-        pushToStack(_accumulator);
-        break;
-    case Operation::PHP:
-        pushToStack(_statusFlags | StatusFlags::Break);
-        break;
-    case Operation::PLA:
-        setAccumulator(pullFromStack());
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::PLP:
-        setStatusFlags(pullFromStack());
-        break;
-
-    case Operation::AND:
-        setAccumulator(_accumulator & argValue);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::EOR:
-        setAccumulator(_accumulator ^ argValue);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::ORA:
-        setAccumulator(_accumulator | argValue);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::BIT:
-        setStatusFlag(StatusFlags::Zero, (_accumulator & argValue) == 0);
-        setStatusFlag(StatusFlags::Overflow, argValue & 0x40);
-        setStatusFlag(StatusFlags::Negative, argValue & 0x80);
-        break;
-
-    case Operation::ADC:
-        // sum = (A + M + C)
-        tempValue16 = _accumulator + argValue + statusFlag(StatusFlags::Carry);
-        // C = sum > 0xff
-        setStatusFlag(StatusFlags::Carry, tempValue16 > 0xff);
-        // V = (~(A ^ M) & (A ^ R) & 0x80) != 0;
-        setStatusFlag(StatusFlags::Overflow, ~(_accumulator ^ argValue) & (_accumulator ^ (tempValue16 & 0xff)) & 0x80);
-        tempValue8 = tempValue16;
-        setAccumulator(tempValue8);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::SBC:
-        // sum = (A + ~M + C)
-        tempValue16 = _accumulator + (argValue ^ 0xff) + statusFlag(StatusFlags::Carry);
-        // C = sum > 0xff
-        setStatusFlag(StatusFlags::Carry, tempValue16 > 0xff);
-        // V = ((A ^ M) & (A ^ R) & 0x80) != 0;
-        setStatusFlag(StatusFlags::Overflow, (_accumulator ^ argValue) & (_accumulator ^ (tempValue16 & 0xff)) & 0x80);
-        tempValue8 = tempValue16;
-        setAccumulator(tempValue8);
-        setNZStatusFlags(_accumulator);
-        break;
-    case Operation::CMP:
-        // (A - M)
-        tempValue16 = _accumulator - argValue;
-        setStatusFlag(StatusFlags::Carry, tempValue16 <= 0xff);
-        tempValue8 = tempValue16;
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::CPX:
-        // (X - M)
-        tempValue16 = _xregister - argValue;
-        setStatusFlag(StatusFlags::Carry, tempValue16 <= 0xff);
-        tempValue8 = tempValue16;
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::CPY:
-        // (Y - M)
-        tempValue16 = _yregister - argValue;
-        setStatusFlag(StatusFlags::Carry, tempValue16 <= 0xff);
-        tempValue8 = tempValue16;
-        setNZStatusFlags(tempValue8);
-        break;
-
-    case Operation::INC:
-        tempValue8 = argValue + 1;
-        setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::INX:
-        setXregister(_xregister + 1);
-        setNZStatusFlags(_xregister);
-        break;
-    case Operation::INY:
-        setYregister(_yregister + 1);
-        setNZStatusFlags(_yregister);
-        break;
-    case Operation::DEC:
-        tempValue8 = argValue - 1;
-        setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::DEX:
-        setXregister(_xregister - 1);
-        setNZStatusFlags(_xregister);
-        break;
-    case Operation::DEY:
-        setYregister(_yregister - 1);
-        setNZStatusFlags(_yregister);
-        break;
-
-    case Operation::ASL:
-        origTempValue8 = tempValue8 = (mode == AddressingMode::Accumulator) ? _accumulator : argValue;
-        tempValue8 <<= 1;
-        setStatusFlag(StatusFlags::Carry, origTempValue8 & 0x80);
-        if (mode == AddressingMode::Accumulator)
-            setAccumulator(tempValue8);
-        else
-            setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::LSR:
-        origTempValue8 = tempValue8 = (mode == AddressingMode::Accumulator) ? _accumulator : argValue;
-        tempValue8 >>= 1;
-        setStatusFlag(StatusFlags::Carry, origTempValue8 & 0x01);
-        if (mode == AddressingMode::Accumulator)
-            setAccumulator(tempValue8);
-        else
-            setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::ROL:
-        origTempValue8 = tempValue8 = (mode == AddressingMode::Accumulator) ? _accumulator : argValue;
-        tempValue8 <<= 1;
-        tempValue8 |= statusFlag(StatusFlags::Carry);
-        setStatusFlag(StatusFlags::Carry, origTempValue8 & 0x80);
-        if (mode == AddressingMode::Accumulator)
-            setAccumulator(tempValue8);
-        else
-            setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-    case Operation::ROR:
-        origTempValue8 = tempValue8 = (mode == AddressingMode::Accumulator) ? _accumulator : argValue;
-        tempValue8 >>= 1;
-        tempValue8 |= (statusFlag(StatusFlags::Carry) << 7);
-        setStatusFlag(StatusFlags::Carry, origTempValue8 & 0x01);
-        if (mode == AddressingMode::Accumulator)
-            setAccumulator(tempValue8);
-        else
-            setMemoryByteAt(argAddress, tempValue8);
-        setNZStatusFlags(tempValue8);
-        break;
-
-    case Operation::JMP:
-        jumpTo(argAddress);
-        break;
-    case Operation::JSR:
-        tempValue16 = _programCounter - 1;
-        pushToStack(static_cast<uint8_t>(tempValue16 >> 8));
-        pushToStack(static_cast<uint8_t>(tempValue16));
-        jumpTo(argAddress);
-        break;
-    case Operation::RTS:
-        tempValue16 = pullFromStack();
-        tempValue16 |= pullFromStack() << 8;
-        jumpTo(tempValue16 + 1);
-        break;
-
-    case Operation::BCC:
-        if (!statusFlag(StatusFlags::Carry))
-            branchTo(argAddress);
-        break;
-    case Operation::BCS:
-        if (statusFlag(StatusFlags::Carry))
-            branchTo(argAddress);
-        break;
-    case Operation::BEQ:
-        if (statusFlag(StatusFlags::Zero))
-            branchTo(argAddress);
-        break;
-    case Operation::BMI:
-        if (statusFlag(StatusFlags::Negative))
-            branchTo(argAddress);
-        break;
-    case Operation::BNE:
-        if (!statusFlag(StatusFlags::Zero))
-            branchTo(argAddress);
-        break;
-    case Operation::BPL:
-        if (!statusFlag(StatusFlags::Negative))
-            branchTo(argAddress);
-        break;
-    case Operation::BVC:
-        if (!statusFlag(StatusFlags::Overflow))
-            branchTo(argAddress);
-        break;
-    case Operation::BVS:
-        if (statusFlag(StatusFlags::Overflow))
-            branchTo(argAddress);
-        break;
-
-    case Operation::CLC:
-        clearStatusFlag(StatusFlags::Carry);
-        break;
-    case Operation::CLI:
-        clearStatusFlag(StatusFlags::InterruptDisable);
-        break;
-    case Operation::CLV:
-        clearStatusFlag(StatusFlags::Overflow);
-        break;
-    case Operation::SEC:
-        setStatusFlag(StatusFlags::Carry);
-        break;
-    case Operation::SEI:
-        setStatusFlag(StatusFlags::InterruptDisable);
-        break;
-
-    case Operation::BRK:
-        tempValue16 = _programCounter + 1;
-        pushToStack(static_cast<uint8_t>(tempValue16 >> 8));
-        pushToStack(static_cast<uint8_t>(tempValue16));
-        pushToStack(_statusFlags | StatusFlags::Break);
-        setStatusFlag(StatusFlags::InterruptDisable);
-        jumpTo(Assembly::__JSR_brk_handler);
-        break;
-    case Operation::NOP:
-        break;
-    case Operation::RTI:
-        setStatusFlags(pullFromStack());
-        tempValue16 = pullFromStack();
-        tempValue16 |= pullFromStack() << 8;
-        jumpTo(tempValue16);
-        break;
-
-    default:
-        throw ExecutionError(QString("Unimplemented operation: %1").arg(Assembly::OperationValueToString(operation)));
-    }
-
-    switch (operation)
-    {
-    case Operation::STA: case Operation::STX: case Operation::STY:
-    case Operation::TXS: case Operation::PHA: case Operation::PHP:
-    case Operation::JMP: case Operation::JSR: case Operation::RTS:
-    case Operation::BEQ: case Operation::BNE: case Operation::BMI: case Operation::BPL:
-    case Operation::BCS: case Operation::BCC: case Operation::BVS: case Operation::BVC:
-    case Operation::NOP:
-        break;
-    default:
-        if (suppressSignalsForSpeed())
-            haveChangedState.statusFlags = true;
-        else
-            emit statusFlagsChanged(_statusFlags);
-        break;
-    }
-
-    elapsedCycles += currentInstructionCycles;
-    if (_profiling.on)
-        profilingHit(instructionProgramCounter, currentInstructionCycles);
-
+    return _core->runBasicBlock();
 }
 
 
-void ProcessorModel::setNZStatusFlags(uint8_t value)
+/*override*/ void ProcessorModel::sendMessage(const char *message, int len)
 {
-    setStatusFlag(StatusFlags::Negative, value & 0x80);
-    setStatusFlag(StatusFlags::Zero, value == 0);
+    emit sendMessageToConsole(QString::fromLatin1(message, len));
 }
 
-void ProcessorModel::branchTo(uint16_t instructionAddress)
+/*override*/ void ProcessorModel::outputChar(char ch)
 {
-    currentInstructionCycles++;
-    if ((instructionAddress &0xff00) != (_programCounter & 0xff00))
-        currentInstructionCycles++;
-    jumpTo(instructionAddress);
+    emit sendCharToConsole(ch);
 }
 
-void ProcessorModel::jumpTo(uint16_t instructionAddress)
+/*override*/ void ProcessorModel::outputString(const char *str, int len)
 {
-    bool internal = true;
-    switch (instructionAddress)
-    {
-    case InternalJSRs::__JSR_terminate:
-        stop();
-        return;
-    case InternalJSRs::__JSR_brk_handler:
-        jsr_brk_handler();
-        return;
-    case InternalJSRs::__JSR_brk_default_handler:
-        jsr_brk_default_handler();
-        return;
+    emit sendStringToConsole(QString::fromLatin1(str, len));
+}
 
-    case InternalJSRs::__JSR_outch:
-        jsr_outch(); break;
-    case InternalJSRs::__JSR_get_time:
-        jsr_get_time(); break;
-    case InternalJSRs::__JSR_get_time_ms:
-        jsr_get_time_ms(); break;
-    case InternalJSRs::__JSR_get_elapsed_time:
-        jsr_get_elapsed_time(); break;
-    case InternalJSRs::__JSR_clear_elapsed_time:
-        jsr_clear_elapsed_time(); break;
-    case InternalJSRs::__JSR_process_events:
-        jsr_process_events(); break;
-    case InternalJSRs::__JSR_inch:
-        jsr_inch(); break;
-    case InternalJSRs::__JSR_inkey:
-        jsr_inkey(); break;
-    case InternalJSRs::__JSR_wait:
-        jsr_wait(); break;
-    case InternalJSRs::__JSR_open_file:
-        jsr_open_file(); break;
-    case InternalJSRs::__JSR_close_file:
-        jsr_close_file(); break;
-    case InternalJSRs::__JSR_rewind_file:
-        jsr_rewind_file(); break;
-    case InternalJSRs::__JSR_read_file:
-        jsr_read_file(); break;
-    case InternalJSRs::__JSR_outstr_fast:
-        jsr_outstr_fast(); break;
-    case InternalJSRs::__JSR_outstr_inline:
-        jsr_outstr_inline(); break;
-    case InternalJSRs::__JSR_get_elapsed_cycles:
-        jsr_get_elapsed_cycles(); break;
-    case InternalJSRs::__JSR_clear_elapsed_cycles:
-        jsr_clear_elapsed_cycles(); break;
-    default:
-        internal = false; break;
-    }
-    if (internal)
+/*override*/ char ProcessorModel::inputChar(int timeout, bool justWait)
+{
+    // on `runThread`, whose own event loop the GUI thread's signals are queued to
+    publishRunSnapshot();
+    char result = '\0';
+    QEventLoop loop;
+    if (!justWait)
+        QObject::connect(this, &ProcessorModel::receivedCharFromConsole,
+                         &loop, [&](char ch) { result = ch; loop.quit(); });
+    QObject::connect(this, &ProcessorModel::stopRunChanged,
+                     &loop, [&]() { result = '\0'; loop.quit(); });
+    QTimer timer;
+    if (timeout >= 0)
     {
-        const InstructionInfo *instructionInfo(Assembly::findInstructionInfo(Operation::RTS, AddressingMode::Implied));
-        currentInstructionCycles += instructionInfo->cycles;
-        uint16_t rtsAddress = (pullFromStack() | (pullFromStack() << 8)) + 1;
-        instructionAddress = rtsAddress;
-        if (!suppressSignalsForSpeed())
-            emit statusFlagsChanged(_statusFlags);
+        QObject::connect(&timer, &QTimer::timeout,
+                         &loop, [&]() { result = '\0'; loop.quit(); });
+        timer.setSingleShot(true);
+        timer.start(timeout * 10);
     }
-    setProgramCounter(instructionAddress);
+    // a stop made before the connections would otherwise go unnoticed
+    if (_core->stopped())
+        return '\0';
+    emit requestCharFromConsole();
+    loop.exec();
+    timer.stop();
+    emit endRequestCharFromConsole();
+    return result;
 }
 
-void ProcessorModel::jsr_brk_handler()
+bool ProcessorModel::hasSavedState() const
 {
-    setXregister(_stackRegister);
-    uint16_t address = _stackBottom + 2 + _xregister;
-    uint8_t flags = memoryByteAt(address);
-    uint8_t breakFlag = flags & StatusFlags::Break;
-    Q_UNUSED(breakFlag);
-
-    uint16_t instructionAddress = memoryWordAt(Assembly::__VEC_BRKV);
-    jumpTo(instructionAddress);
+    return savedState.core != nullptr;
 }
 
-void ProcessorModel::jsr_brk_default_handler()
+/*slot*/ void ProcessorModel::saveState()
 {
-    setStatusFlags(pullFromStack());
-    uint16_t rtiAddress = pullFromStack() | (pullFromStack() << 8);
-    uint8_t signatureByte = memoryByteAt(rtiAddress - 1);
-    Q_UNUSED(signatureByte);
-    uint8_t maxLen;
-    const char *memoryAddress = memoryStrPointer(rtiAddress, &maxLen);
-    QString message(QString::fromLatin1(memoryAddress, maxLen));
-    sendMessageToConsole(message);
+    if (_isRunning)
+        return;
 
-    stop();
+    savedState.core = _core->saveState();
+    savedState.userFileName = userFile.isOpen() ? userFile.fileName() : QString();
+    savedState.userFilePosition = userFile.isOpen() ? userFile.pos() : 0;
 }
 
-void ProcessorModel::jsr_outch()
+/*slot*/ void ProcessorModel::restoreState()
 {
-    emit sendCharToConsole(accumulator());
+    if (_isRunning || savedState.core == nullptr)
+        return;
+
+    _core->restoreState(savedState.core);
+    // the saved state need not be in the history, which starts again from it (and reopens the file from that)
+    if (history->recording())
+        history->startRecording(ExecutionHistory::FileState{ savedState.userFileName.toStdString(), !savedState.userFileName.isEmpty(), savedState.userFilePosition });
+    else
+        reopenUserFile(savedState.userFileName, savedState.userFilePosition);
+    notifyJumpedState();
 }
 
-void ProcessorModel::jsr_get_time()
+bool ProcessorModel::canStepBack() const
 {
-    uint16_t address = _accumulator | (_xregister << 8);
-    uint32_t seconds = static_cast<uint32_t>(time(NULL));
-    setMemoryByteAt(address, static_cast<uint8_t>(seconds));
-    setMemoryByteAt(address + 1, static_cast<uint8_t>(seconds >> 8));
-    setMemoryByteAt(address + 2, static_cast<uint8_t>(seconds >> 16));
-    setMemoryByteAt(address + 3, static_cast<uint8_t>(seconds >> 24));
+    return history->canGoBack();
 }
 
-void ProcessorModel::jsr_get_time_ms()
+/*slot*/ void ProcessorModel::stepBack()
 {
-    uint16_t address = _accumulator | (_xregister << 8);
-    uint32_t milliseconds = static_cast<uint32_t>(QDateTime::currentMSecsSinceEpoch());
-    setMemoryByteAt(address, static_cast<uint8_t>(milliseconds));
-    setMemoryByteAt(address + 1, static_cast<uint8_t>(milliseconds >> 8));
-    setMemoryByteAt(address + 2, static_cast<uint8_t>(milliseconds >> 16));
-    setMemoryByteAt(address + 3, static_cast<uint8_t>(milliseconds >> 24));
+    if (_isRunning || !history->stepBack())
+        return;
+    notifyJumpedState();
 }
 
-void ProcessorModel::jsr_get_elapsed_time()
+/*slot*/ void ProcessorModel::reverseContinue()
 {
-    uint16_t address = _accumulator | (_xregister << 8);
-    uint32_t milliseconds = static_cast<uint32_t>(elapsedTimer.elapsed());
-    setMemoryByteAt(address, static_cast<uint8_t>(milliseconds));
-    setMemoryByteAt(address + 1, static_cast<uint8_t>(milliseconds >> 8));
-    setMemoryByteAt(address + 2, static_cast<uint8_t>(milliseconds >> 16));
-    setMemoryByteAt(address + 3, static_cast<uint8_t>(milliseconds >> 24));
+    if (_isRunning || !history->reverseContinue())
+        return;
+    notifyJumpedState();
 }
 
-void ProcessorModel::jsr_clear_elapsed_time()
+/*slot*/ void ProcessorModel::goToLastWrite(uint16_t address)
 {
-    elapsedTimer.restart();
+    if (_isRunning)
+        return;
+    const ExecutionHistory::JournalWrite *write = history->lastWriteTo(address);
+    if (write == nullptr)
+    {
+        debugMessage(QString("No write to $%1 in the history").arg(address, 4, 16, QChar('0')));
+        return;
+    }
+    uint8_t oldValue = write->oldValue;
+    if (!history->travelTo(write->instruction))
+        return;
+    notifyJumpedState();
+    debugMessage(QString("Last write to $%1, over $%2").arg(address, 4, 16, QChar('0')).arg(oldValue, 2, 16, QChar('0')));
 }
 
-void ProcessorModel::jsr_process_events()
+void ProcessorModel::changedExternally()
 {
-    catchUpSuppressedSignals();
-    QCoreApplication::processEvents();
+    // registers or memory set by the user, between runs: the history goes on from the state as it now is
+    if (!_isRunning)
+        history->externalChange();
 }
 
-void ProcessorModel::jsr_inch(int timeout /*= -1*/, bool justWait /*= false*/)
+void ProcessorModel::reopenUserFile(const QString &fileName, qint64 position)
 {
-    catchUpSuppressedSignals();
-    char result = '\0';
-    QEventLoop loop;
-    if (!justWait)
-        QObject::connect(this, &ProcessorModel::receivedCharFromConsole,
-                         &loop, [&](char ch) { result = ch; loop.quit(); });
-    QObject::connect(this, &ProcessorModel::stopRunChanged,
-                     &loop, [&]() { result = '\0'; loop.quit(); });
-    QTimer timer;
-    if (timeout >= 0)
+    if (userFile.isOpen())
+        userFile.close();
+    if (!fileName.isEmpty())
     {
-        QObject::connect(&timer, &QTimer::timeout,
-                         &loop, [&]() { result = '\0'; loop.quit(); });
-        timer.setSingleShot(true);
-        timer.start(timeout * 10);
+        userFile.setFileName(fileName);
+        if (!userFile.open(QIODevice::ReadOnly | QIODevice::Text) || !userFile.seek(position))
+            executionErrorMessage(userFile.errorString());
     }
-    emit requestCharFromConsole();
-    loop.exec();
-    timer.stop();
-    emit endRequestCharFromConsole();
-    if (result == '\003' || result == '\033')  // Ctrl-C or Escape
-        stop();
-    setAccumulator(result);
-    setNZStatusFlags(_accumulator);
 }
 
-void ProcessorModel::jsr_inkey()
+void ProcessorModel::notifyJumpedState()
 {
-    uint16_t timeout = _accumulator | (_xregister << 8);
-    jsr_inch(timeout);
+    // after a restore or a travel back in the history: carry on from here with `Continue` or the steps
+    if (history->recording())
+    {
+        const ExecutionHistory::FileState &file(history->fileState());
+        reopenUserFile(file.open ? QString::fromStdString(file.name) : QString(), file.position);
+    }
+    setStartNewRun(false);
+    setStopRun(false);
+    if (_currentRunMode == NotRunning || _currentRunMode == TurboRun)
+        setCurrentRunMode(Continue);
+    notifyState(_core->state(), false);
+    _core->clearMemoryWrites();
+    _memoryModel->notifyAllDataChanged();
 }
 
-void ProcessorModel::jsr_wait()
+
+/*override*/ void ProcessorModel::processEvents()
 {
-    uint16_t timeout = _accumulator | (_xregister << 8);
-    jsr_inch(timeout, true);
+    // the GUI thread processes its own events; all the program can want is for the display to catch up
+    publishRunSnapshot();
 }
 
-void ProcessorModel::jsr_open_file()
+/*override*/ void ProcessorModel::openFile(const char *filename)
 {
-    uint16_t address = _accumulator | (_xregister << 8);
-    bool goodName = false;
-    char filename[256];
-    for (int i = 0; i < sizeof(filename) - 1; i++)
-    {
-        char ch = memoryByteAt(address + i);
-        filename[i] = ch;
-        if (ch == '\0')
-            goodName = true;
-        if (!std::isprint(ch))
-            break;
-    }
-    if (!goodName)
-        throw ExecutionError("Bad filename");
     if (userFile.isOpen())
         throw ExecutionError("File already open");
     userFile.setFileName(filename);
-    if (!userFile.open(QIODeviceBase::ReadOnly | QIODeviceBase::Text))
-        throw ExecutionError(userFile.errorString());
+    if (!userFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        throw ExecutionError(userFile.errorString().toStdString());
 }
 
-void ProcessorModel::jsr_close_file()
+/*override*/ void ProcessorModel::closeFile()
 {
     if (userFile.isOpen())
         userFile.close();
 }
 
-void ProcessorModel::jsr_rewind_file()
+/*override*/ void ProcessorModel::rewindFile()
 {
     if (userFile.isOpen())
         userFile.seek(0);
 }
 
-void ProcessorModel::jsr_read_file()
+/*override*/ bool ProcessorModel::readFile(char &ch)
 {
-    bool success = false;
-    if (userFile.isOpen())
-    {
-        char ch;
-        if (userFile.getChar(&ch))
-        {
-            setAccumulator(ch);
-            setNZStatusFlags(_accumulator);
-            success = true;
-        }
-    }
-    setStatusFlag(StatusFlags::Carry, !success);
+    return userFile.isOpen() && userFile.getChar(&ch);
 }
 
-void ProcessorModel::jsr_outstr_fast()
-{
-    uint16_t address = _accumulator | (_xregister << 8);
-    uint8_t maxLen;
-    const char *memoryAddress = memoryStrPointer(address, &maxLen);
-    QString str(QString::fromLatin1(memoryAddress, maxLen));
-    emit sendStringToConsole(str);
-}
 
-void ProcessorModel::jsr_outstr_inline()
+//
+// RunSliceScheduler Class
+//
+
+RunSliceScheduler::RunSliceScheduler(int _periodMilliseconds, int _everySoOften)
 {
-    uint16_t rtsAddress = (pullFromStack() | (pullFromStack() << 8)) + 1;
-    uint8_t maxLen;
-    const char *memoryAddress = memoryStrPointer(rtsAddress, &maxLen);
-    QString str(QString::fromLatin1(memoryAddress, maxLen));
-    emit sendStringToConsole(str);
-    rtsAddress += maxLen + 1 - 1;
-    pushToStack(static_cast<uint8_t>(rtsAddress >> 8));
-    pushToStack(static_cast<uint8_t>(rtsAddress));
+    periodMilliseconds = _periodMilliseconds;
+    everySoOften = _everySoOften;
+    period.setRemainingTime(periodMilliseconds);
+    // a modest guess, so that the first slice comes back soon with a measurement
+    instructionsPerSecond = 1000000.0;
+    instructionsToPublish = everySoOften;
 }
 
-void ProcessorModel::jsr_get_elapsed_cycles()
+int RunSliceScheduler::nextSlice()
 {
-    uint16_t address = _accumulator | (_xregister << 8);
-    setMemoryByteAt(address, static_cast<uint8_t>(elapsedCycles));
-    setMemoryByteAt(address + 1, static_cast<uint8_t>(elapsedCycles >> 8));
-    setMemoryByteAt(address + 2, static_cast<uint8_t>(elapsedCycles >> 16));
-    setMemoryByteAt(address + 3, static_cast<uint8_t>(elapsedCycles >> 24));
+    int slice = MaxSlice;
+    if (periodMilliseconds != 0)
+        slice = static_cast<int>(std::clamp(instructionsPerSecond * period.remainingTimeNSecs() / 1e9, double(MinSlice), double(MaxSlice)));
+    if (everySoOften != 0)
+        slice = std::min(slice, std::max(instructionsToPublish, 1));
+    sliceTimer.start();
+    return slice;
 }
 
-void ProcessorModel::jsr_clear_elapsed_cycles()
+bool RunSliceScheduler::endSlice(int executed)
 {
-    elapsedCycles = 0;
+    // slices cut short, or which waited on console input, still count: the average soon recovers
+    qint64 nsecs = sliceTimer.nsecsElapsed();
+    if (executed >= MinSlice && nsecs > 0)
+        instructionsPerSecond = 0.75 * instructionsPerSecond + 0.25 * (executed * 1e9 / nsecs);
+
+    bool publish = false;
+    if (periodMilliseconds != 0 && period.hasExpired())
+    {
+        period.setRemainingTime(periodMilliseconds);
+        publish = true;
+    }
+    if (everySoOften != 0 && (instructionsToPublish -= executed) <= 0)
+    {
+        instructionsToPublish = everySoOften;
+        publish = true;
+    }
+    return publish;
 }
 
 
@@ -1324,10 +1032,10 @@ QVariant MemoryModel::data(const QModelIndex &index, int role /*= Qt::DisplayRol
         return QVariant(Qt::AlignRight | Qt::AlignVCenter);
     case Qt::DisplayRole:
     case Qt::EditRole:
-        return processorModel->memoryByteAt(offset);
+        return processorModel->displayedMemoryByteAt(offset);
     case Qt::ForegroundRole:
         if (lastMemoryChangedAddress >= 0 && indexToAddress(index) == lastMemoryChangedAddress)
-            return QBrush(Qt::red);
+            return QVariant::fromValue(Qt::red);
         break;
     }
     return QVariant();
@@ -1354,6 +1062,8 @@ bool MemoryModel::setData(const QModelIndex &index, const QVariant &value, int r
     int offset = index.row() * columnCount(index) + index.column();
     if (offset < 0 || offset >= processorModel->memorySize())
         return false;
+    if (processorModel->isRunning())
+        return false;
     if (role == Qt::DisplayRole || role == Qt::EditRole)
     {
         bool ok;
@@ -1403,14 +1113,23 @@ void MemoryModel::memoryChanged(uint16_t address)
     processorModel->memoryChanged(index, index);
 }
 
-
-//
-// ExecutionError Class
-//
-
-ExecutionError::ExecutionError(const QString &msg)
-    : std::runtime_error(msg.toStdString())
+void MemoryModel::memoryChanged(uint16_t lowest, uint16_t highest, uint16_t last)
 {
-
+    if (lowest == highest)
+    {
+        memoryChanged(lowest);
+        return;
+    }
+    if (!processorModel->trackingMemoryChanged())
+        return;
+    if (lastMemoryChangedAddress != last)
+        clearLastMemoryChanged();
+    lastMemoryChangedAddress = last;
+    QModelIndex topLeft = addressToIndex(lowest), bottomRight = addressToIndex(highest);
+    if (topLeft.row() != bottomRight.row())
+    {
+        topLeft = index(topLeft.row(), 0);
+        bottomRight = index(bottomRight.row(), columnCount() - 1);
+    }
+    processorModel->memoryChanged(topLeft, bottomRight);
 }
-
@@ -2,13 +2,20 @@
 #define PROCESSORMODEL_H
 
 #include <QAbstractItemModel>
-#include <QBrush>
+#include <QDeadlineTimer>
 #include <QElapsedTimer>
 #include <QFile>
 #include <QMetaEnum>
 #include <QObject>
+#include <QThread>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
 
 #include "assembly.h"
+#include "executionhistory.h"
+#include "processorcore.h"
 
 using Operation = Assembly::Operation;
 using AddressingMode = Assembly::AddressingMode;
@@ -21,25 +28,80 @@ class MemoryModel;
 class IProcessorBreakpointProvider;
 
 //
-// ProcessorModel Class
+// ProcessorSnapshots Class
 //
-class ProcessorModel : public QObject
+// Double-buffered copies of the core's state, handed from the run thread to the GUI thread without locking
+// The run thread only fills a buffer once the GUI thread has taken the one published before it, so each side always
+// has a buffer of its own
+//
+class ProcessorSnapshots
 {
-    Q_OBJECT
 public:
-    enum StatusFlags : uint8_t
+    struct Snapshot
     {
-        Negative = 0x80,
-        Overflow = 0x40,
-        NotUsed = 0x20,
-        Break = 0x10,
-        Decimal = 0x08,
-        InterruptDisable = 0x04,
-        Zero = 0x02,
-        Carry = 0x01
+        CpuState state;
+        ProcessorCore::MemoryWrites memoryWrites;   // since the previous snapshot
     };
-    static_assert(Carry == 0x01, "StatusFlags::Carry must have a value of 0x01");
-    Q_FLAG(StatusFlags)
+
+    ProcessorSnapshots() : buffers(new Snapshot[2]), back(0), published(-1) {}
+
+    // run thread
+    bool canPublish() const { return published.load(std::memory_order_acquire) < 0; }
+    Snapshot &backBuffer() { return buffers[back]; }
+    void publish() { published.store(back, std::memory_order_release); back ^= 1; }
+
+    // GUI thread: the snapshot published since the last call, else nullptr; it stays valid until the next one is taken
+    const Snapshot *take()
+    {
+        int index = published.exchange(-1, std::memory_order_acq_rel);
+        return index >= 0 ? &buffers[index] : nullptr;
+    }
+
+private:
+    std::unique_ptr<Snapshot[]> buffers;
+    int back;
+    std::atomic<int> published;
+};
+
+
+//
+// RunSliceScheduler Class
+//
+// Splits a `Run`/`Continue`/step run into slices of instructions, with snapshots published only between them
+// Each slice is sized from the instructions per second measured so far to fill what is left of the current
+// `processEventsForVerticalSyncs` period, so the display keeps to that latency whatever the program runs at
+//
+class RunSliceScheduler
+{
+public:
+    RunSliceScheduler(int periodMilliseconds, int everySoOften);
+
+    int nextSlice();
+    bool endSlice(int executed);
+
+private:
+    static constexpr int MinSlice = 64, MaxSlice = 1 << 22;
+    int periodMilliseconds, everySoOften;
+    QDeadlineTimer period;
+    QElapsedTimer sliceTimer;
+    double instructionsPerSecond;
+    int instructionsToPublish;
+};
+
+
+//
+// ProcessorModel Class
+//
+// The Qt face of a `ProcessorCore`: runs it in the various `RunMode`s, provides its console/file I/O,
+// and turns its state changes into signals and `MemoryModel` updates
+// Runs execute on a thread of their own; while one is going the GUI shows `ProcessorSnapshots` published by it,
+// and a stop reaches it through the core's atomic stopped flag
+//
+class ProcessorModel : public QObject, public IProcessorCoreHost
+{
+    Q_OBJECT
+public:
+    using StatusFlags = ProcessorCore::StatusFlags;
     enum RunMode { NotRunning, TurboRun, Run, StepInto, StepOver, StepOut, Continue };
     Q_ENUM(RunMode)
 
@@ -48,6 +110,7 @@ public:
 
     void setProcessorBreakpointProvider(IProcessorBreakpointProvider *provider);
 
+    ProcessorCore *core() const { return _core; }
     MemoryModel *memoryModel() { return _memoryModel; }
 
     uint8_t accumulator() const;
@@ -75,6 +138,7 @@ public:
     uint8_t *memory();
     unsigned int memorySize() const;
     uint8_t memoryByteAt(uint16_t address) const;
+    uint8_t displayedMemoryByteAt(uint16_t address) const;
     void setMemoryByteAt(uint16_t address, uint8_t value);
     uint16_t memoryWordAt(uint16_t address) const;
     uint16_t memoryZPWordAt(uint8_t address) const;
@@ -86,19 +150,8 @@ public:
     uint16_t programCounter() const;
     void setProgramCounter(uint16_t newProgramCounter);
 
-    struct Profiling
-    {
-        bool on = false;
-        int granularityShift = 0;
-        uint16_t programCounterLow, programCounterHigh;
-        struct HitCycleCounts { int hits, cycles; };
-        HitCycleCounts *counts = NULL;
-
-        ~Profiling() { delete[] counts; counts = NULL; }
-        void setGranularityShift(int shift) { granularityShift = shift; }
-        int granularitySize() const { return 1 << granularityShift; }
-    };
-    Profiling &profiling() { return _profiling; }
+    using Profiling = ProcessorCore::Profiling;
+    Profiling &profiling() { return _core->profiling(); }
     void setProfilingRange(uint16_t lowest, uint16_t highest);
     void startProfiling();
 
@@ -116,9 +169,15 @@ public:
     bool startNewRun() const;
     void setStartNewRun(bool newStartNewRun);
 
+    uint64_t runInstructionCount() const;
+    uint64_t runCycleCount() const;
+
     const Instruction *nextInstructionToExecute(uint16_t address) const;
     const Instruction *nextInstructionToExecute() const;
 
+    bool hasSavedState() const;
+    bool canStepBack() const;
+
 public slots:
     void restart();
     void endRun();
@@ -129,9 +188,14 @@ public slots:
     void stepInto();
     void stepOver();
     void stepOut();
+    void saveState();
+    void restoreState();
+    void stepBack();
+    void reverseContinue();
+    void goToLastWrite(uint16_t address);
 
 signals:
-    void sendMessageToConsole(const QString &message, QBrush colour = Qt::transparent) const;
+    void sendMessageToConsole(const QString &message, Qt::GlobalColor colour = Qt::transparent) const;
     void sendStringToConsole(const QString &str) const;
     void sendCharToConsole(char ch) const;
     void requestCharFromConsole();
@@ -147,27 +211,36 @@ signals:
     void stackRegisterChanged(uint8_t stackRegister);
     void statusFlagsChanged(uint8_t statusFlags);
     void currentInstructionAddressChanged(uint16_t instructionAddress);
+    void runFinished();
+
+    // IProcessorCoreHost interface
+protected:
+    void sendMessage(const char *message, int len) override;
+    void outputChar(char ch) override;
+    void outputString(const char *str, int len) override;
+    char inputChar(int timeout, bool justWait) override;
+    void processEvents() override;
+    void openFile(const char *filename) override;
+    void closeFile() override;
+    void rewindFile() override;
+    bool readFile(char &ch) override;
 
 private:
-    uint8_t _memoryData[64 * 1024];
-    uint8_t *_memory;
+    ProcessorCore *_core;
     MemoryModel *_memoryModel;
-    static constexpr uint16_t _stackBottom = 0x0100;
-    static constexpr uint8_t _stackInitial = 0xfd;
-    uint8_t _stackRegister;
-    uint8_t _accumulator, _xregister, _yregister;
-    uint8_t _statusFlags;
-
-    Instruction *_instructions;
-    uint16_t _programCounter;
     const IProcessorBreakpointProvider *processorBreakpointProvider;
 
+    struct NotifiedState
+    {
+        uint8_t stackRegister;
+        uint8_t accumulator, xregister, yregister;
+        uint8_t statusFlags;
+        uint16_t programCounter;
+    };
+    NotifiedState notifiedState;
+
     struct HaveChangedState
     {
-        bool stackRegister;
-        bool accumulator, xregister, yregister;
-        bool statusFlags;
-        bool programCounter;
         struct MemoryChanged {
             int topLeftRow, topLeftColumn, bottomRightRow, bottomRightColumn;
             void clear()
@@ -180,7 +253,6 @@ private:
 
         void clear()
         {
-            stackRegister = accumulator = xregister = yregister = statusFlags = programCounter = false;
             memoryChanged.clear();
             memoryChangedForegroundOnly.clear();
             trackingMemoryChanged = true;
@@ -188,47 +260,51 @@ private:
     };
     HaveChangedState haveChangedState;
 
-    Profiling _profiling;
-
     bool _startNewRun, _stopRun, _isRunning;
     RunMode _currentRunMode = NotRunning;
 
+    QThread *runThread;
+    QObject *runThreadContext;      // lives in `runThread`, for invoking runs there
+    ProcessorSnapshots runSnapshots;
+    const CpuState *displayedState; // while running, the snapshot last taken by the GUI thread
+    QTimer *snapshotTimer;
+    int publishEverySoOften, publishForVerticalSyncs;
+    std::string runExecutionError;
+
     QFile userFile;
-    QElapsedTimer elapsedTimer;
-    uint32_t currentInstructionCycles, elapsedCycles;
+
+    // the checkpoint `restoreState()` goes back to, with where the program was in the user file
+    struct SavedState
+    {
+        std::shared_ptr<const ProcessorCore::SaveState> core;
+        QString userFileName;
+        qint64 userFilePosition;
+    };
+    SavedState savedState;
+    // records runs other than TurboRun, for `stepBack()` and the like; while recording it is the core's host, passing on to this
+    ExecutionHistory *history;
 
     void resetModel();
-    void allocateProfilingHitCounts();
-    void profilingHit(uint16_t programCounter, int instructionCycles);
     void setCurrentRunMode(RunMode newCurrentRunMode);
+    void notifyChangedState(bool catchingUp = false);
+    void notifyState(const CpuState &state, bool catchingUp);
+    void notifyMemoryWrites(const ProcessorCore::MemoryWrites &memoryWrites);
     void catchUpSuppressedSignals();
+    void emitSuppressedMemoryChanged();
+    void publishRunSnapshot();
+    void showRunSnapshot();
     void debugMessage(const QString &message) const;
     void executionErrorMessage(const QString &message) const;
+    void crashTraceMessage() const;
+    void watchHitMessage(const ProcessorCore::WatchHit &watchHit) const;
+    void changedExternally();
+    void reopenUserFile(const QString &fileName, qint64 position);
+    void notifyJumpedState();
     void runInstructions(RunMode runMode);
-    void runNextInstruction(const Instruction &instruction);
-    void executeNextInstruction(const Instruction &instruction);
-    void setNZStatusFlags(uint8_t value);
-    void branchTo(uint16_t instructionAddress);
-    void jumpTo(uint16_t instructionAddress);
-    void jsr_brk_handler();
-    void jsr_brk_default_handler();
-    void jsr_outch();
-    void jsr_get_time();
-    void jsr_get_time_ms();
-    void jsr_get_elapsed_time();
-    void jsr_clear_elapsed_time();
-    void jsr_process_events();
-    void jsr_inch(int timeout = -1, bool justWait = false);
-    void jsr_inkey();
-    void jsr_wait();
-    void jsr_open_file();
-    void jsr_close_file();
-    void jsr_rewind_file();
-    void jsr_read_file();
-    void jsr_outstr_fast();
-    void jsr_outstr_inline();
-    void jsr_get_elapsed_cycles();
-    void jsr_clear_elapsed_cycles();
+    void executeRun(RunMode runMode, bool startedNewRun);
+    int stepStopAddress(RunMode runMode) const;
+    void endRunInstructions(bool suppressingSignalsForSpeed);
+    int runNextBasicBlock();
 };
 
 
@@ -256,6 +332,7 @@ public:
     void notifyAllDataChanged();
     void clearLastMemoryChanged();
     void memoryChanged(uint16_t address);
+    void memoryChanged(uint16_t lowest, uint16_t highest, uint16_t last);
 
 private:
     ProcessorModel *processorModel;
@@ -263,16 +340,6 @@ private:
 };
 
 
-//
-// ExecutionError Class
-//
-class ExecutionError : public std::runtime_error
-{
-public:
-    ExecutionError(const QString &msg);
-};
-
-
 //
 // IProcessorBreakpointProvider Class
 //
@@ -280,8 +347,8 @@ class IProcessorBreakpointProvider
 {
 public:
     virtual ~IProcessorBreakpointProvider() = default;
-    virtual bool breakpointAt(uint16_t instructionAddress) const = 0;
     virtual uint16_t lastInstructionAddressAtSameFileLineNumber(uint16_t instructionAddress) const = 0;
+    virtual TraceFormatter::Symbols traceSymbols() const = 0;
 };
 
 #endif // PROCESSORMODEL_H
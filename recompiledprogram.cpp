@@ -0,0 +1,77 @@
+#include "recompiledprogram.h"
+
+//
+// RecompiledProgram Class
+//
+
+RecompiledProgram::RecompiledProgram(ProcessorCore *core)
+{
+    _core = core;
+    _codeModified = false;
+    std::memset(codeBytes, 0, sizeof(codeBytes));
+    originalCode.reset(new uint8_t[ProcessorCore::memorySize()]());
+    _interpretedInstructionCount = 0;
+}
+
+RecompiledProgram::~RecompiledProgram()
+{
+}
+
+uint64_t RecompiledProgram::run()
+{
+    uint64_t startInstructionCount = _core->instructionCount();
+    if (!_core->stopped())
+        runCode();
+    return _core->instructionCount() - startInstructionCount;
+}
+
+void RecompiledProgram::loadSegment(const Segment &segment)
+{
+    for (int i = 0; i < segment.length; i++)
+        _core->setMemoryByteAt(segment.address + i, segment.bytes[i]);
+}
+
+void RecompiledProgram::markCode(const CodeRange &range)
+{
+    // after `loadSegment()`, so that the code as recompiled is what is in memory now
+    for (int address = range.address; address < range.address + range.length; address++)
+    {
+        codeBytes[address >> 3] |= 1 << (address & 7);
+        originalCode[address] = _core->memoryByteAt(address);
+    }
+}
+
+void RecompiledProgram::interpretInstruction()
+{
+    // the interpreter's writes are tracked, to notice any which land on recompiled code
+    const bool tracking = _core->memoryWrites().tracking;
+    if (!tracking)
+    {
+        _core->clearMemoryWrites();
+        _core->setTrackingMemoryWrites(true);
+    }
+    try
+    {
+        _core->step();
+    }
+    catch (...)
+    {
+        _core->setTrackingMemoryWrites(tracking);
+        throw;
+    }
+    _interpretedInstructionCount++;
+
+    const ProcessorCore::MemoryWrites &writes(_core->memoryWrites());
+    if (writes.any() && !_codeModified)
+        for (int address = writes.lowest; address <= writes.highest; address++)
+            if (isCodeByte(address))
+            {
+                _codeModified = true;
+                break;
+            }
+    if (!tracking)
+    {
+        _core->setTrackingMemoryWrites(false);
+        _core->clearMemoryWrites();
+    }
+}
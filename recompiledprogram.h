@@ -0,0 +1,81 @@
+#ifndef RECOMPILEDPROGRAM_H
+#define RECOMPILEDPROGRAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "processorcore.h"
+
+//
+// RecompiledProgram Class
+//
+// Base class for the C++ programs emitted by `StaticRecompiler`
+// The generated subclass holds the assembled image, and one labelled block of C++ per recompiled basic block which
+// runs directly on the core's `CpuState`, keeping the interpreter's cycle and instruction counts
+// Whatever the generated code does not cover (internal JSRs, BRK, RTI, jumps to unknown addresses, code modified
+// since it was recompiled) is executed an instruction at a time by the core's interpreter
+//
+class RecompiledProgram
+{
+public:
+    struct Segment
+    {
+        uint16_t address;
+        uint16_t length;
+        const uint8_t *bytes;
+    };
+    struct CodeRange
+    {
+        uint16_t address;
+        uint16_t length;
+    };
+
+    explicit RecompiledProgram(ProcessorCore *core);
+    virtual ~RecompiledProgram();
+
+    ProcessorCore *core() const { return _core; }
+
+    virtual uint16_t entryAddress() const = 0;
+    virtual void load() = 0;
+    uint64_t run();
+
+    uint64_t interpretedInstructionCount() const { return _interpretedInstructionCount; }
+
+protected:
+    void loadSegment(const Segment &segment);
+    void markCode(const CodeRange &range);
+    virtual void runCode() = 0;
+    void interpretInstruction();
+
+    bool codeModified() const { return _codeModified; }
+    bool isCodeByte(uint16_t address) const { return codeBytes[address >> 3] & (1 << (address & 7)); }
+    bool blockUnchanged(uint16_t address, int length) const
+    {
+        return !_codeModified || std::memcmp(_core->memory() + address, originalCode.get() + address, length) == 0;
+    }
+    // returns whether the write landed on recompiled code, when the generated code must go back to the dispatcher
+    bool storeByte(uint16_t address, uint8_t value)
+    {
+        _core->writeDataByteAt(address, value);
+        if (!isCodeByte(address))
+            return false;
+        _codeModified = true;
+        return true;
+    }
+
+    static constexpr uint8_t nzFlags(uint8_t statusFlags, uint8_t value)
+    {
+        return (statusFlags & ~(ProcessorCore::Negative | ProcessorCore::Zero)) | ProcessorCore::nzStatusFlags(value);
+    }
+    static constexpr bool isInternalJSRAddress(uint16_t address) { return ProcessorCore::isInternalJSRAddress(address); }
+
+private:
+    ProcessorCore *_core;
+    bool _codeModified;
+    uint8_t codeBytes[0x10000 / 8];
+    std::unique_ptr<uint8_t[]> originalCode;
+    uint64_t _interpretedInstructionCount;
+};
+
+#endif // RECOMPILEDPROGRAM_H
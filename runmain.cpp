@@ -0,0 +1,98 @@
+#include "headlessrunner.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QLoggingCategory>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("6502run");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Assemble a 6502 source file and TurboRun it without the GUI.\n"
+                                     "Console output goes to stdout, console input comes from stdin (end of input stops the run).");
+    parser.addHelpOption();
+    QCommandLineOption includeOption({ "I", "include" }, "Add <directory> to the .include search path.", "directory");
+    parser.addOption(includeOption);
+    QCommandLineOption quietOption({ "q", "quiet" }, "Do not print run statistics.");
+    parser.addOption(quietOption);
+    QCommandLineOption recompileOption("recompile", "Do not run: write the program as C++ to <file>, to compile and link against 6502core.", "file");
+    parser.addOption(recompileOption);
+    QCommandLineOption traceOption("trace", "Write a binary trace of every instruction executed to <file>.", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption traceStartOption("trace-start", "Start the trace on reaching <address>, a label or number.", "address");
+    parser.addOption(traceStartOption);
+    QCommandLineOption traceStopOption("trace-stop", "Stop the trace on reaching <address>, a label or number.", "address");
+    parser.addOption(traceStopOption);
+    QCommandLineOption formatTraceOption("format-trace", "Do not run: print the trace in <file> as text, with the program's labels.", "file");
+    parser.addOption(formatTraceOption);
+    QCommandLineOption batchOption("batch", "Run the program many times over, in parallel, writing each run's results to <csv>.", "csv");
+    parser.addOption(batchOption);
+    QCommandLineOption inputOption("input", "For --batch: a run with <file> as its console input; for --lockstep: a lane with <file> in memory; may be repeated.", "file");
+    parser.addOption(inputOption);
+    QCommandLineOption runsOption("runs", "For --batch with no --input: the number of runs (default 1).", "count", "1");
+    parser.addOption(runsOption);
+    QCommandLineOption jobsOption({ "j", "jobs" }, "For --batch: the number of threads (default one per core).", "count", "0");
+    parser.addOption(jobsOption);
+    QCommandLineOption timeLimitOption("time-limit", "For --batch: stop each run after <seconds>.", "seconds", "0");
+    parser.addOption(timeLimitOption);
+    QCommandLineOption outputDirOption("output-dir", "For --batch: write each run's console output to <directory>/<run>.out.", "directory");
+    parser.addOption(outputDirOption);
+    QCommandLineOption fuzzOption("fuzz", "Fuzz the routine at <entry>, a label or address, up to its RTS, reporting the inputs which crash it.", "entry");
+    parser.addOption(fuzzOption);
+    QCommandLineOption fuzzInputOption("fuzz-input", "For --fuzz: where the input goes, console, file or memory:<address> (default console).", "target", "console");
+    parser.addOption(fuzzInputOption);
+    QCommandLineOption fuzzMaxLengthOption("fuzz-max-length", "For --fuzz: the longest input in bytes (default 64).", "bytes", "64");
+    parser.addOption(fuzzMaxLengthOption);
+    QCommandLineOption fuzzExecutionsOption("fuzz-executions", "For --fuzz: the number of executions (default 1000000).", "count", "1000000");
+    parser.addOption(fuzzExecutionsOption);
+    QCommandLineOption fuzzMaxCyclesOption("fuzz-max-cycles", "For --fuzz: an execution over <count> cycles is a runaway (default 1000000).", "count", "1000000");
+    parser.addOption(fuzzMaxCyclesOption);
+    QCommandLineOption fuzzSeedOption("fuzz-seed", "For --fuzz: start from the input in <file>; may be repeated.", "file");
+    parser.addOption(fuzzSeedOption);
+    QCommandLineOption fuzzCrashesOption("fuzz-crashes", "For --fuzz: write each crash's input to <directory>.", "directory");
+    parser.addOption(fuzzCrashesOption);
+    QCommandLineOption lockstepOption("lockstep", "Run the routine at <entry>, a label or address, up to its RTS, once for each --input, in lockstep lanes.", "entry");
+    parser.addOption(lockstepOption);
+    QCommandLineOption lockstepInputOption("lockstep-input", "For --lockstep: the address each lane's input goes to, a label or number (default 0).", "address", "0");
+    parser.addOption(lockstepInputOption);
+    QCommandLineOption lockstepCheckOption("lockstep-check", "For --lockstep: run each lane's input again alone, a step at a time, and fail if its registers, cycles or memory differ.");
+    parser.addOption(lockstepCheckOption);
+    parser.addPositionalArgument("file", "Source file to assemble and run.");
+    parser.process(a);
+
+    const QStringList args(parser.positionalArguments());
+    if (args.size() != 1)
+        parser.showHelp(2);
+
+    // messages are already sent to stderr via `sendMessageToConsole()`
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    HeadlessRunner runner;
+    if (!runner.assembleFile(args.at(0), parser.values(includeOption)))
+        return 2;
+    if (parser.isSet(recompileOption))
+        return runner.recompile(parser.value(recompileOption), args.at(0)) ? 0 : 2;
+    if (parser.isSet(formatTraceOption))
+        return runner.formatTrace(parser.value(formatTraceOption)) ? 0 : 2;
+    if (parser.isSet(batchOption))
+        return runner.batchRun(parser.value(batchOption), parser.values(inputOption), parser.value(runsOption).toInt(),
+                               parser.value(jobsOption).toInt(), parser.value(timeLimitOption).toDouble(),
+                               parser.value(outputDirOption)) ? 0 : 1;
+    if (parser.isSet(fuzzOption))
+        return runner.fuzz(parser.value(fuzzOption), parser.value(fuzzInputOption), parser.value(fuzzMaxLengthOption).toInt(),
+                           parser.value(fuzzExecutionsOption).toULongLong(), parser.value(fuzzMaxCyclesOption).toULongLong(),
+                           parser.values(fuzzSeedOption), parser.value(fuzzCrashesOption)) ? 0 : 1;
+    if (parser.isSet(lockstepOption))
+        return runner.lockstepRun(parser.value(lockstepOption), parser.value(lockstepInputOption), parser.values(inputOption),
+                                  parser.isSet(lockstepCheckOption)) ? 0 : 1;
+    if (parser.isSet(traceOption))
+        if (!runner.startTrace(parser.value(traceOption), parser.value(traceStartOption), parser.value(traceStopOption)))
+            return 2;
+    bool ok = runner.turboRun();
+    runner.endTrace();
+    if (!parser.isSet(quietOption))
+        runner.printRunStatistics();
+    return ok ? 0 : 1;
+}
@@ -13,6 +13,8 @@ SettingsDialog::SettingsDialog(QWidget *parent)
     ui->spnProcessEventsForVerticalSyncs->setValue(settings().processEventsForVerticalSyncs());
     ui->chkProfilingEnabled->setChecked(settings().profilingEnabled());
     ui->spnProfilingGranularityShift->setValue(settings().profilingGranularityShift());
+    ui->spnJitHitThreshold->setValue(settings().jitHitThreshold());
+    ui->spnHistoryCheckpoints->setValue(settings().historyCheckpoints());
 
     connect(this, &QDialog::accepted, this, &SettingsDialog::acceptSettings);
 }
@@ -29,4 +31,6 @@ SettingsDialog::~SettingsDialog()
     settings().setProcessEventsForVerticalSyncs(ui->spnProcessEventsForVerticalSyncs->value());
     settings().setProfilingEnabled(ui->chkProfilingEnabled->isChecked());
     settings().setProfilingGranularityShift(ui->spnProfilingGranularityShift->value());
+    settings().setJitHitThreshold(ui->spnJitHitThreshold->value());
+    settings().setHistoryCheckpoints(ui->spnHistoryCheckpoints->value());
 }
@@ -0,0 +1,550 @@
+#include <cctype>
+#include <cstdio>
+
+#include "processorcore.h"
+#include "staticrecompiler.h"
+
+using Operation = InstructionSet::Operation;
+using AddressingMode = InstructionSet::AddressingMode;
+using InstructionInfo = InstructionSet::InstructionInfo;
+
+static std::string format(const char *fmt, int value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), fmt, value);
+    return buf;
+}
+
+static std::string hex4(int value) { return format("0x%04x", value & 0xffff); }
+static std::string hex2(int value) { return format("0x%02x", value & 0xff); }
+
+static std::string blockLabel(int address) { return format("block_%04x", address); }
+
+static std::string account(int instructions, uint32_t cycles)
+{
+    if (instructions == 0)
+        return "";
+    return "s.elapsedCycles += " + std::to_string(cycles) + "; s.instructionCount += " + std::to_string(instructions) + "; ";
+}
+
+static bool operationEndsBlock(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::JMP: case Operation::JSR: case Operation::RTS: case Operation::RTI: case Operation::BRK:
+    case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+    case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool operationReadsArgument(Operation operation)
+{
+    switch (operation)
+    {
+    case Operation::STA: case Operation::STX: case Operation::STY:
+    case Operation::JMP: case Operation::JSR:
+        return false;
+    default:
+        return true;
+    }
+}
+
+
+//
+// StaticRecompiler Class
+//
+
+StaticRecompiler::StaticRecompiler(const uint8_t *memory, const std::vector<uint16_t> &instructionAddresses, uint16_t entryAddress)
+    : memory(memory, memory + ProcessorCore::memorySize()),
+      instructionStarts(ProcessorCore::memorySize(), false)
+{
+    _entryAddress = entryAddress;
+    _className = "Program";
+    findBlocks(instructionAddresses);
+}
+
+/*static*/ std::string StaticRecompiler::classNameFor(const std::string &name)
+{
+    std::string className;
+    bool upper = true;
+    for (char ch : name)
+        if (std::isalnum(static_cast<unsigned char>(ch)))
+        {
+            className += upper ? std::toupper(static_cast<unsigned char>(ch)) : ch;
+            upper = false;
+        }
+        else
+            upper = true;
+    if (className.empty() || std::isdigit(static_cast<unsigned char>(className[0])))
+        className.insert(0, "P");
+    return className + "Program";
+}
+
+bool StaticRecompiler::usesHostDevices() const
+{
+    // the devices' page, addressed directly or indexed from an address up to 255 below it
+    for (int address = 0; address < static_cast<int>(ProcessorCore::memorySize()); address++)
+    {
+        if (!instructionStarts[address])
+            continue;
+        if (staticTargetAt(address) == InstructionSet::__JSR_wait_interrupt)
+            return true;
+        const AddressingMode mode = instructionInfoAt(address).addrMode;
+        if (mode != AddressingMode::Absolute && mode != AddressingMode::AbsoluteX && mode != AddressingMode::AbsoluteY)
+            continue;
+        const int lowest = operandAt(address), highest = lowest + (mode != AddressingMode::Absolute ? 0xff : 0);
+        if (lowest <= (InstructionSet::__DEV_page | 0xff) && highest >= InstructionSet::__DEV_page)
+            return true;
+    }
+    return false;
+}
+
+const InstructionInfo &StaticRecompiler::instructionInfoAt(uint16_t address) const
+{
+    return InstructionSet::getInstructionInfo(memory[address]);
+}
+
+uint16_t StaticRecompiler::operandAt(uint16_t address) const
+{
+    switch (instructionInfoAt(address).bytes)
+    {
+    case 2: return memory[address + 1];
+    case 3: return memory[address + 1] | (memory[address + 2] << 8);
+    default: return 0;
+    }
+}
+
+int StaticRecompiler::staticTargetAt(uint16_t address) const
+{
+    const InstructionInfo &info(instructionInfoAt(address));
+    if (info.addrMode == AddressingMode::Relative)
+        return static_cast<uint16_t>(address + 2 + static_cast<int8_t>(operandAt(address)));
+    if ((info.operation == Operation::JMP || info.operation == Operation::JSR) && info.addrMode == AddressingMode::Absolute)
+        return operandAt(address);
+    return -1;
+}
+
+bool StaticRecompiler::isTranslatableAt(uint16_t address) const
+{
+    // these are left to the interpreter, as is any transfer straight to an internal JSR
+    const InstructionInfo &info(instructionInfoAt(address));
+    if (!info.isValid())
+        return false;
+    switch (info.operation)
+    {
+    case Operation::CLD: case Operation::SED: case Operation::BRK: case Operation::RTI:
+        return false;
+    default:
+        break;
+    }
+    int target = staticTargetAt(address);
+    return target < 0 || !ProcessorCore::isInternalJSRAddress(target);
+}
+
+void StaticRecompiler::findBlocks(const std::vector<uint16_t> &instructionAddresses)
+{
+    for (uint16_t address : instructionAddresses)
+        if (address + instructionInfoAt(address).bytes <= static_cast<int>(ProcessorCore::memorySize()))
+            instructionStarts[address] = true;
+
+    // a block starts wherever control can arrive other than by falling through from the previous instruction
+    std::vector<bool> leaders(ProcessorCore::memorySize(), false);
+    if (instructionStarts[_entryAddress])
+        leaders[_entryAddress] = true;
+    int previousEndAddress = -1;
+    bool previousEndsBlock = true;
+    for (int address = 0; address < static_cast<int>(ProcessorCore::memorySize()); address++)
+    {
+        if (!instructionStarts[address])
+            continue;
+        const InstructionInfo &info(instructionInfoAt(address));
+        if (address != previousEndAddress || previousEndsBlock)
+            leaders[address] = true;
+        int target = staticTargetAt(address);
+        if (target >= 0 && instructionStarts[target])
+            leaders[target] = true;
+        previousEndAddress = address + info.bytes;
+        previousEndsBlock = !isTranslatableAt(address) || operationEndsBlock(info.operation);
+    }
+
+    for (int address = 0; address < static_cast<int>(ProcessorCore::memorySize()); address++)
+    {
+        if (!leaders[address] || !isTranslatableAt(address))
+            continue;
+        Block block;
+        block.startAddress = address;
+        int nextAddress = address;
+        do
+        {
+            block.instructionAddresses.push_back(nextAddress);
+            const InstructionInfo &info(instructionInfoAt(nextAddress));
+            nextAddress += info.bytes;
+            if (operationEndsBlock(info.operation))
+                break;
+        } while (nextAddress < static_cast<int>(ProcessorCore::memorySize()) && instructionStarts[nextAddress]
+                 && !leaders[nextAddress] && isTranslatableAt(nextAddress));
+        block.endAddress = nextAddress;
+        blocks[block.startAddress] = block;
+    }
+}
+
+void StaticRecompiler::generate(std::ostream &out) const
+{
+    out << "// Generated by StaticRecompiler";
+    if (!_sourceName.empty())
+        out << " from " << _sourceName;
+    out << ": do not edit\n"
+        << "// Compile and link against 6502core; define RECOMPILED_PROGRAM_NO_MAIN to use " << _className << " from other code\n"
+        << "\n"
+        << "#include \"recompiledprogram.h\"\n"
+        << "\n"
+        << "class " << _className << " : public RecompiledProgram\n"
+        << "{\n"
+        << "public:\n"
+        << "    using RecompiledProgram::RecompiledProgram;\n"
+        << "\n"
+        << "    uint16_t entryAddress() const override { return " << hex4(_entryAddress) << "; }\n"
+        << "    void load() override;\n"
+        << "\n"
+        << "protected:\n"
+        << "    void runCode() override;\n"
+        << "};\n"
+        << "\n";
+
+    generateImage(out);
+
+    out << "void " << _className << "::runCode()\n"
+        << "{\n"
+        << "    CpuState &s(core()->state());\n"
+        << "    uint8_t *const mem = s.memory;\n"
+        << "    uint8_t a = s.accumulator, x = s.xregister, y = s.yregister, sp = s.stackRegister, p = s.statusFlags;\n"
+        << "    for (;;)\n"
+        << "    {\n"
+        << "        switch (s.programCounter)\n"
+        << "        {\n";
+    for (const auto &it : blocks)
+    {
+        const Block &block(it.second);
+        out << "        case " << hex4(block.startAddress) << ": if (blockUnchanged(" << hex4(block.startAddress) << ", "
+            << block.endAddress - block.startAddress << ")) goto " << blockLabel(block.startAddress) << "; break;\n";
+    }
+    out << "        }\n"
+        << "    interpret:\n"
+        << "        s.accumulator = a; s.xregister = x; s.yregister = y; s.stackRegister = sp; s.statusFlags = p;\n"
+        << "        interpretInstruction();\n"
+        << "        if (core()->stopped())\n"
+        << "            return;\n"
+        << "        a = s.accumulator; x = s.xregister; y = s.yregister; sp = s.stackRegister; p = s.statusFlags;\n"
+        << "        continue;\n";
+    for (const auto &it : blocks)
+        generateBlock(out, it.second);
+    out << "    }\n"
+        << "}\n"
+        << "\n";
+
+    out << "#ifndef RECOMPILED_PROGRAM_NO_MAIN\n"
+        << "#include <cstdio>\n"
+        << "#include <cstring>\n"
+        << "\n"
+        << "#include \"stdiocorehost.h\"\n"
+        << "\n"
+        << "int main(int argc, char *argv[])\n"
+        << "{\n"
+        << "    StdioCoreHost host;\n"
+        << "    ProcessorCore core(&host);\n"
+        << "    " << _className << " program(&core);\n"
+        << "    program.load();\n"
+        << "    core.setTrackingMemoryWrites(false);\n"
+        << "    core.setProgramCounter(program.entryAddress());\n"
+        << "    core.startRun();\n"
+        << "    bool ok = true;\n"
+        << "    try\n"
+        << "    {\n"
+        << "        program.run();\n"
+        << "    }\n"
+        << "    catch (const ExecutionError &e)\n"
+        << "    {\n"
+        << "        host.sendMessage(e.what(), std::strlen(e.what()));\n"
+        << "        ok = false;\n"
+        << "    }\n"
+        << "    std::fflush(stdout);\n"
+        << "    if (!(argc > 1 && std::strcmp(argv[1], \"-q\") == 0))\n"
+        << "        std::fprintf(stderr, \"Instructions: %llu\\nCycles: %llu\\nInterpreted instructions: %llu\\n\",\n"
+        << "                     static_cast<unsigned long long>(core.instructionCount()),\n"
+        << "                     static_cast<unsigned long long>(core.totalElapsedCycles()),\n"
+        << "                     static_cast<unsigned long long>(program.interpretedInstructionCount()));\n"
+        << "    return ok ? 0 : 1;\n"
+        << "}\n"
+        << "#endif\n";
+}
+
+void StaticRecompiler::generateImage(std::ostream &out) const
+{
+    // only what differs from a newly created core, in runs broken by more than a few unchanged bytes
+    ProcessorCore initial;
+    const uint8_t *initialMemory = initial.memory();
+    const int size = ProcessorCore::memorySize();
+    std::vector<std::pair<int, int>> segments;
+    for (int address = 0; address < size; address++)
+    {
+        if (memory[address] == initialMemory[address])
+            continue;
+        if (!segments.empty() && address - segments.back().second <= 8)
+            segments.back().second = address + 1;
+        else
+            segments.push_back({ address, address + 1 });
+    }
+
+    out << "namespace\n"
+        << "{\n";
+    for (const auto &segment : segments)
+    {
+        out << "const uint8_t segment_" << format("%04x", segment.first) << "[] =\n"
+            << "{";
+        for (int address = segment.first; address < segment.second; address++)
+            out << ((address - segment.first) % 16 == 0 ? "\n    " : " ") << hex2(memory[address]) << ",";
+        out << "\n};\n";
+    }
+    out << "\n"
+        << "const RecompiledProgram::Segment segments[] =\n"
+        << "{\n";
+    for (const auto &segment : segments)
+        out << "    { " << hex4(segment.first) << ", " << segment.second - segment.first << ", segment_" << format("%04x", segment.first) << " },\n";
+    out << "};\n"
+        << "\n"
+        << "const RecompiledProgram::CodeRange codeRanges[] =\n"
+        << "{\n";
+    for (const auto &it : blocks)
+        out << "    { " << hex4(it.second.startAddress) << ", " << it.second.endAddress - it.second.startAddress << " },\n";
+    out << "};\n"
+        << "}\n"
+        << "\n"
+        << "void " << _className << "::load()\n"
+        << "{\n"
+        << "    for (const Segment &segment : segments)\n"
+        << "        loadSegment(segment);\n"
+        << "    for (const CodeRange &range : codeRanges)\n"
+        << "        markCode(range);\n"
+        << "}\n"
+        << "\n";
+}
+
+std::string StaticRecompiler::jumpTo(int targetAddress) const
+{
+    targetAddress &= 0xffff;
+    std::string code;
+    if (blocks.count(targetAddress))
+        code += "if (!codeModified()) goto " + blockLabel(targetAddress) + "; ";
+    return code + "s.programCounter = " + hex4(targetAddress) + "; continue;";
+}
+
+void StaticRecompiler::generateBlock(std::ostream &out, const Block &block) const
+{
+    out << "\n"
+        << "    " << blockLabel(block.startAddress) << ":\n";
+    uint32_t cycles = 0;
+    for (int i = 0; i < static_cast<int>(block.instructionAddresses.size()); i++)
+    {
+        generateInstruction(out, block, i, cycles);
+        cycles += instructionInfoAt(block.instructionAddresses[i]).cycles;
+    }
+
+    const InstructionInfo &lastInfo(instructionInfoAt(block.instructionAddresses.back()));
+    if (operationEndsBlock(lastInfo.operation))
+        return;
+    const int count = block.instructionAddresses.size();
+    if (block.endAddress < static_cast<int>(ProcessorCore::memorySize()) && instructionStarts[block.endAddress]
+        && !isTranslatableAt(block.endAddress))
+        out << "        s.programCounter = " << hex4(block.endAddress) << "; " << account(count, cycles) << "goto interpret;\n";
+    else
+        out << "        " << account(count, cycles) << jumpTo(block.endAddress) << "\n";
+}
+
+void StaticRecompiler::generateInstruction(std::ostream &out, const Block &block, int index, uint32_t cyclesBefore) const
+{
+    const uint16_t address = block.instructionAddresses[index];
+    const InstructionInfo &info(instructionInfoAt(address));
+    const Operation operation = info.operation;
+    const AddressingMode mode = info.addrMode;
+    const uint16_t operand = operandAt(address);
+    const int nextAddress = address + info.bytes;
+    const uint32_t cyclesAfter = cyclesBefore + info.cycles;
+
+    const std::string exitBefore("{ s.programCounter = " + hex4(address) + "; " + account(index, cyclesBefore) + "goto interpret; }");
+    const std::string exitAfter("{ s.programCounter = " + hex4(nextAddress) + "; " + account(index + 1, cyclesAfter) + "continue; }");
+    std::vector<std::string> lines;
+    auto line = [&lines](const std::string &code) { lines.push_back(code); };
+    auto store = [&](const std::string &value) { line("if (storeByte(ea, " + value + ")) " + exitAfter); };
+    auto push = [&](const std::string &value) { line("if (storeByte(0x0100 + sp--, " + value + ")) " + exitAfter); };
+    auto setNZ = [&](const std::string &value) { line("p = nzFlags(p, " + value + ");"); };
+
+    switch (operation == Operation::JMP || operation == Operation::JSR ? AddressingMode::Implied : mode)
+    {
+    case AddressingMode::ZeroPage: case AddressingMode::Absolute:
+        line("const uint16_t ea = " + hex4(operand) + ";"); break;
+    case AddressingMode::ZeroPageX:
+        line("const uint16_t ea = static_cast<uint8_t>(" + hex2(operand) + " + x);"); break;
+    case AddressingMode::ZeroPageY:
+        line("const uint16_t ea = static_cast<uint8_t>(" + hex2(operand) + " + y);"); break;
+    case AddressingMode::AbsoluteX:
+        line("const uint16_t ea = " + hex4(operand) + " + x;"); break;
+    case AddressingMode::AbsoluteY:
+        line("const uint16_t ea = " + hex4(operand) + " + y;"); break;
+    case AddressingMode::IndexedIndirectX:
+        line("const uint8_t zp = " + hex2(operand) + " + x;");
+        line("const uint16_t ea = mem[zp] | (mem[static_cast<uint8_t>(zp + 1)] << 8);");
+        break;
+    case AddressingMode::IndirectIndexedY:
+        line("const uint16_t base = mem[" + hex2(operand) + "] | (mem[" + hex2(operand + 1) + "] << 8);");
+        line("const uint16_t ea = base + y;");
+        break;
+    default:
+        break;
+    }
+    if (operation == Operation::JMP && mode == AddressingMode::Indirect)
+        line("const uint16_t ea = mem[" + hex4(operand) + "] | (mem[" + hex4(operand + 1) + "] << 8);");
+    if (ProcessorCore::operationHasPageCrossPenalty(operation, mode))
+        line(std::string("s.elapsedCycles += (ea >> 8) != ") + (mode == AddressingMode::IndirectIndexedY ? "(base >> 8)" : hex2(operand >> 8)) + ";");
+    std::string value;
+    if (mode == AddressingMode::Immediate)
+        value = hex2(operand);
+    else if (mode == AddressingMode::Accumulator)
+        value = "a";
+    else if (mode != AddressingMode::Implied && mode != AddressingMode::Relative && mode != AddressingMode::Indirect
+             && operationReadsArgument(operation))
+    {
+        line("const uint8_t v = mem[ea];");
+        value = "v";
+    }
+
+    switch (operation)
+    {
+    case Operation::LDA: line("a = " + value + ";"); setNZ("a"); break;
+    case Operation::LDX: line("x = " + value + ";"); setNZ("x"); break;
+    case Operation::LDY: line("y = " + value + ";"); setNZ("y"); break;
+    case Operation::STA: store("a"); break;
+    case Operation::STX: store("x"); break;
+    case Operation::STY: store("y"); break;
+
+    case Operation::TAX: line("x = a;"); setNZ("x"); break;
+    case Operation::TAY: line("y = a;"); setNZ("y"); break;
+    case Operation::TXA: line("a = x;"); setNZ("a"); break;
+    case Operation::TYA: line("a = y;"); setNZ("a"); break;
+
+    case Operation::TSX: line("x = sp;"); setNZ("x"); break;
+    case Operation::TXS: line("sp = x;"); break;
+    case Operation::PHA: push("a"); break;
+    case Operation::PHP: push("p | ProcessorCore::Break"); break;
+    case Operation::PLA: line("a = mem[0x0100 + ++sp];"); setNZ("a"); break;
+    case Operation::PLP: line("p = mem[0x0100 + ++sp] & ~ProcessorCore::Break;"); break;
+
+    case Operation::AND: line("a &= " + value + ";"); setNZ("a"); break;
+    case Operation::EOR: line("a ^= " + value + ";"); setNZ("a"); break;
+    case Operation::ORA: line("a |= " + value + ";"); setNZ("a"); break;
+    case Operation::BIT:
+        line("p = (p & ~(ProcessorCore::Negative | ProcessorCore::Overflow | ProcessorCore::Zero)) | (" + value
+             + " & (ProcessorCore::Negative | ProcessorCore::Overflow)) | ((a & " + value + ") == 0 ? ProcessorCore::Zero : 0);");
+        break;
+
+    case Operation::ADC: case Operation::SBC: {
+        const std::string argValue(operation == Operation::ADC ? value : "(" + value + " ^ 0xff)");
+        line("const unsigned sum = a + " + argValue + " + (p & ProcessorCore::Carry);");
+        line("p = (p & ~(ProcessorCore::Carry | ProcessorCore::Overflow)) | (sum > 0xff ? ProcessorCore::Carry : 0)"
+             " | (~(a ^ " + argValue + ") & (a ^ sum) & 0x80 ? ProcessorCore::Overflow : 0);");
+        line("a = sum;");
+        setNZ("a");
+        break;
+    }
+    case Operation::CMP: case Operation::CPX: case Operation::CPY: {
+        const std::string reg(operation == Operation::CMP ? "a" : operation == Operation::CPX ? "x" : "y");
+        line("const uint16_t difference = " + reg + " - " + value + ";");
+        line("p = (p & ~ProcessorCore::Carry) | (difference <= 0xff ? ProcessorCore::Carry : 0);");
+        setNZ("static_cast<uint8_t>(difference)");
+        break;
+    }
+
+    case Operation::INC: case Operation::DEC:
+        line(std::string("const uint8_t result = v ") + (operation == Operation::INC ? "+" : "-") + " 1;");
+        setNZ("result");
+        store("result");
+        break;
+    case Operation::INX: line("x++;"); setNZ("x"); break;
+    case Operation::INY: line("y++;"); setNZ("y"); break;
+    case Operation::DEX: line("x--;"); setNZ("x"); break;
+    case Operation::DEY: line("y--;"); setNZ("y"); break;
+
+    case Operation::ASL: case Operation::LSR: case Operation::ROL: case Operation::ROR: {
+        const char *shifted = operation == Operation::ASL ? "const uint8_t result = " "%s << 1;"
+                              : operation == Operation::LSR ? "const uint8_t result = " "%s >> 1;"
+                              : operation == Operation::ROL ? "const uint8_t result = (%s << 1) | (p & ProcessorCore::Carry);"
+                              : "const uint8_t result = (%s >> 1) | ((p & ProcessorCore::Carry) << 7);";
+        char buf[128];
+        std::snprintf(buf, sizeof(buf), shifted, value.c_str());
+        line(buf);
+        line("p = (p & ~ProcessorCore::Carry) | ((" + value + (operation == Operation::ASL || operation == Operation::ROL ? " >> 7" : "") + ") & ProcessorCore::Carry);");
+        setNZ("result");
+        if (mode == AddressingMode::Accumulator)
+            line("a = result;");
+        else
+            store("result");
+        break;
+    }
+
+    case Operation::JMP:
+        if (mode == AddressingMode::Indirect)
+        {
+            line("if (isInternalJSRAddress(ea)) " + exitBefore);
+            line(account(index + 1, cyclesAfter) + "s.programCounter = ea; continue;");
+        }
+        else
+            line(account(index + 1, cyclesAfter) + jumpTo(operand));
+        break;
+    case Operation::JSR:
+        push(hex2((nextAddress - 1) >> 8));
+        push(hex2(nextAddress - 1));
+        line(account(index + 1, cyclesAfter) + jumpTo(operand));
+        break;
+    case Operation::RTS:
+        line("const uint16_t returnAddress = (mem[0x0100 + static_cast<uint8_t>(sp + 1)] | (mem[0x0100 + static_cast<uint8_t>(sp + 2)] << 8)) + 1;");
+        line("if (isInternalJSRAddress(returnAddress)) " + exitBefore);
+        line("sp += 2;");
+        line(account(index + 1, cyclesAfter) + "s.programCounter = returnAddress; continue;");
+        break;
+
+    case Operation::BCC: case Operation::BCS: case Operation::BEQ: case Operation::BMI:
+    case Operation::BNE: case Operation::BPL: case Operation::BVC: case Operation::BVS: {
+        const char *flag = (operation == Operation::BCC || operation == Operation::BCS) ? "ProcessorCore::Carry"
+                           : (operation == Operation::BEQ || operation == Operation::BNE) ? "ProcessorCore::Zero"
+                           : (operation == Operation::BMI || operation == Operation::BPL) ? "ProcessorCore::Negative"
+                           : "ProcessorCore::Overflow";
+        const bool branchIfSet = operation == Operation::BCS || operation == Operation::BEQ || operation == Operation::BMI || operation == Operation::BVS;
+        const int target = staticTargetAt(address);
+        const uint32_t takenCycles = cyclesAfter + 1 + ((target & 0xff00) != (nextAddress & 0xff00) ? 1 : 0);
+        line(std::string("if (") + (branchIfSet ? "" : "!") + "(p & " + flag + ")) { " + account(index + 1, takenCycles) + jumpTo(target) + " }");
+        line(account(index + 1, cyclesAfter) + jumpTo(nextAddress));
+        break;
+    }
+
+    case Operation::CLC: line("p &= ~ProcessorCore::Carry;"); break;
+    case Operation::CLI: line("p &= ~ProcessorCore::InterruptDisable;"); break;
+    case Operation::CLV: line("p &= ~ProcessorCore::Overflow;"); break;
+    case Operation::SEC: line("p |= ProcessorCore::Carry;"); break;
+    case Operation::SEI: line("p |= ProcessorCore::InterruptDisable;"); break;
+    case Operation::NOP: break;
+
+    default:
+        // not translatable, so never in a block
+        line(exitBefore);
+        break;
+    }
+
+    out << "        // " << format("$%04x", address) << " " << InstructionSet::operationName(operation) << " "
+        << InstructionSet::addressingModeName(mode) << "\n"
+        << "        {\n";
+    for (const std::string &code : lines)
+        out << "            " << code << "\n";
+    out << "        }\n";
+}
@@ -0,0 +1,70 @@
+#ifndef STATICRECOMPILER_H
+#define STATICRECOMPILER_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "instructionset.h"
+
+//
+// StaticRecompiler Class
+//
+// Ahead-of-time translation of an assembled program to C++: a `RecompiledProgram` subclass holding the memory image
+// and one labelled block per basic block, to be compiled and linked against 6502core
+// Every known instruction start (from `Assembler::instructionsCodeFileLineNumbers()`) is recompiled; blocks begin at
+// the entry address, at branch/JMP/JSR targets, and wherever straight-line code is interrupted
+// The generated code reads and writes memory directly and never tests for the core's events, and its `main()` maps no
+// host devices, so a program which `usesHostDevices()` is not for recompiling
+//
+class StaticRecompiler
+{
+public:
+    StaticRecompiler(const uint8_t *memory, const std::vector<uint16_t> &instructionAddresses, uint16_t entryAddress);
+
+    uint16_t entryAddress() const { return _entryAddress; }
+    const std::string &className() const { return _className; }
+    void setClassName(const std::string &className) { _className = className; }
+    const std::string &sourceName() const { return _sourceName; }
+    void setSourceName(const std::string &sourceName) { _sourceName = sourceName; }
+    static std::string classNameFor(const std::string &name);
+
+    int blockCount() const { return blocks.size(); }
+    // whether any instruction addresses the host devices' page (console, file, timer, interrupt and bank registers),
+    // or waits for an interrupt; an indirect address into the page is for the run alone to know
+    bool usesHostDevices() const;
+    void generate(std::ostream &out) const;
+
+private:
+    using Operation = InstructionSet::Operation;
+    using AddressingMode = InstructionSet::AddressingMode;
+    using InstructionInfo = InstructionSet::InstructionInfo;
+
+    struct Block
+    {
+        uint16_t startAddress;
+        int endAddress;     // one past the last byte of the last instruction
+        std::vector<uint16_t> instructionAddresses;
+    };
+
+    std::vector<uint8_t> memory;
+    std::vector<bool> instructionStarts;
+    uint16_t _entryAddress;
+    std::string _className;
+    std::string _sourceName;
+    std::map<uint16_t, Block> blocks;
+
+    const InstructionInfo &instructionInfoAt(uint16_t address) const;
+    uint16_t operandAt(uint16_t address) const;
+    int staticTargetAt(uint16_t address) const;
+    bool isTranslatableAt(uint16_t address) const;
+    void findBlocks(const std::vector<uint16_t> &instructionAddresses);
+    void generateImage(std::ostream &out) const;
+    void generateBlock(std::ostream &out, const Block &block) const;
+    void generateInstruction(std::ostream &out, const Block &block, int index, uint32_t cyclesBefore) const;
+    std::string jumpTo(int targetAddress) const;
+};
+
+#endif // STATICRECOMPILER_H
@@ -0,0 +1,98 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+#include "stdiocorehost.h"
+
+//
+// StdioCoreHost Class
+//
+
+StdioCoreHost::StdioCoreHost()
+{
+    userFile = nullptr;
+}
+
+StdioCoreHost::~StdioCoreHost()
+{
+    closeFile();
+}
+
+/*override*/ void StdioCoreHost::sendMessage(const char *message, int len)
+{
+    std::fflush(stdout);
+    std::fprintf(stderr, "%.*s\n", len, message);
+}
+
+/*override*/ void StdioCoreHost::outputChar(char ch)
+{
+    std::fputc(ch, stdout);
+}
+
+/*override*/ void StdioCoreHost::outputString(const char *str, int len)
+{
+    std::fwrite(str, 1, len, stdout);
+}
+
+/*override*/ char StdioCoreHost::inputChar(int timeout, bool justWait)
+{
+    std::fflush(stdout);
+    if (justWait)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        return '\0';
+    }
+#ifndef _WIN32
+    if (timeout >= 0)
+    {
+        pollfd stdinPoll = { 0, POLLIN, 0 };
+        if (poll(&stdinPoll, 1, timeout) <= 0)
+            return '\0';
+    }
+#endif
+    int ch = std::fgetc(stdin);
+    return ch != EOF ? static_cast<char>(ch) : '\003';
+}
+
+/*override*/ void StdioCoreHost::processEvents()
+{
+    std::fflush(stdout);
+}
+
+/*override*/ void StdioCoreHost::openFile(const char *filename)
+{
+    if (userFile != nullptr)
+        throw ExecutionError("File already open");
+    userFile = std::fopen(filename, "r");
+    if (userFile == nullptr)
+        throw ExecutionError(std::string(filename) + ": " + std::strerror(errno));
+}
+
+/*override*/ void StdioCoreHost::closeFile()
+{
+    if (userFile != nullptr)
+        std::fclose(userFile);
+    userFile = nullptr;
+}
+
+/*override*/ void StdioCoreHost::rewindFile()
+{
+    if (userFile != nullptr)
+        std::rewind(userFile);
+}
+
+/*override*/ bool StdioCoreHost::readFile(char &ch)
+{
+    if (userFile == nullptr)
+        return false;
+    int c = std::fgetc(userFile);
+    if (c == EOF)
+        return false;
+    ch = static_cast<char>(c);
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef STDIOCOREHOST_H
+#define STDIOCOREHOST_H
+
+#include <cstdio>
+
+#include "processorcore.h"
+
+//
+// StdioCoreHost Class
+//
+// A Qt-free `IProcessorCoreHost` for command-line tools
+// Console output goes to stdout and messages to stderr; console input comes from stdin, where end of input
+// reads as Ctrl-C and so stops the run
+//
+class StdioCoreHost : public IProcessorCoreHost
+{
+public:
+    StdioCoreHost();
+    ~StdioCoreHost();
+
+    void sendMessage(const char *message, int len) override;
+    void outputChar(char ch) override;
+    void outputString(const char *str, int len) override;
+    char inputChar(int timeout, bool justWait) override;
+    void processEvents() override;
+    void openFile(const char *filename) override;
+    void closeFile() override;
+    void rewindFile() override;
+    bool readFile(char &ch) override;
+
+private:
+    std::FILE *userFile;
+};
+
+#endif // STDIOCOREHOST_H
@@ -27,9 +27,8 @@ void SyntaxHighlighter::highlightBlock(const QString &text) /*override*/
     static const QRegularExpression labelDefinitionRegex("^\\s*([.@]?[a-z_]\\w*):", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression labelBranchJumpRegex = []{
         QStringList list;
-        QMetaEnum me = Assembly::OperationsMetaEnum();
         for (Assembly::Operation operation : Assembly::branchJumpOperations())
-            list.append(QRegularExpression::escape(me.valueToKey(operation)));
+            list.append(QRegularExpression::escape(Assembly::OperationValueToKey(operation)));
         QString pattern = QStringLiteral("\\b(?:") + list.join('|') + QStringLiteral(")\\b");
         pattern += QStringLiteral("\\s+([.@]?[a-z_]\\w*)(\\.[a-z_]\\w*)?");
         return QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
@@ -38,9 +37,8 @@ void SyntaxHighlighter::highlightBlock(const QString &text) /*override*/
     static const QRegularExpression macroCallRegex("([a-z_]\\w*)", QRegularExpression::CaseInsensitiveOption);
     static const QRegularExpression operationRegex = []{
         QStringList list;
-        QMetaEnum me = Assembly::OperationsMetaEnum();
-        for (int i = 0; i < me.keyCount(); ++i)
-            list.append(QRegularExpression::escape(me.valueToKey(i)));
+        for (int i = 0; i < Assembly::TotalOperations; ++i)
+            list.append(QRegularExpression::escape(Assembly::OperationValueToKey(static_cast<Assembly::Operation>(i))));
         QString pattern = QStringLiteral("\\b(?:") + list.join('|') + QStringLiteral(")\\b");
         return QRegularExpression(pattern, QRegularExpression::CaseInsensitiveOption);
     }();
@@ -0,0 +1,156 @@
+#include <algorithm>
+
+#include "tracediff.h"
+
+//
+// TraceDiff Class
+//
+
+TraceDiff::TraceDiff()
+{
+    _comparesCycles = false;
+    _instructionsCompared = 0;
+}
+
+bool TraceDiff::compare(TraceReader &first, TraceReader &second)
+{
+    _divergence = Divergence();
+    _instructionsCompared = 0;
+    TraceRecord firstRecord, secondRecord;
+    for (;;)
+    {
+        const bool firstRead = first.read(firstRecord), secondRead = second.read(secondRecord);
+        if (!firstRead && !secondRead)
+            return false;
+        uint16_t differences = 0;
+        if (!firstRead)
+        {
+            firstRecord = TraceRecord{};
+            differences |= FirstEnded;
+        }
+        if (!secondRead)
+        {
+            secondRecord = TraceRecord{};
+            differences |= SecondEnded;
+        }
+        if (differences == 0)
+            differences = recordDifferences(firstRecord, secondRecord);
+        if (diverged(differences, firstRecord, secondRecord))
+            return true;
+        _instructionsCompared++;
+    }
+}
+
+bool TraceDiff::compare(ProcessorCore &first, ProcessorCore &second, uint64_t maxInstructions)
+{
+    _divergence = Divergence();
+    _instructionsCompared = 0;
+    int address = firstMemoryDifference(first, second, 0, ProcessorCore::memorySize() - 1);
+    if (address >= 0)
+    {
+        diverged(Memory, first.traceRecord(), second.traceRecord());
+        _divergence.memoryAddress = address;
+        _divergence.firstValue = first.memoryByteAt(address);
+        _divergence.secondValue = second.memoryByteAt(address);
+        return true;
+    }
+
+    // each step's writes are what `memoryWrites()` tracks
+    const bool firstTracking = first.memoryWrites().tracking, secondTracking = second.memoryWrites().tracking;
+    first.setTrackingMemoryWrites(true);
+    second.setTrackingMemoryWrites(true);
+    auto step = [](ProcessorCore &core) {
+        core.clearMemoryWrites();
+        try
+        {
+            core.step();
+        }
+        catch (const ExecutionError &)
+        {
+            core.stop();
+            return false;
+        }
+        return true;
+    };
+
+    bool divergence = false;
+    while (!divergence && _instructionsCompared < maxInstructions && !(first.stopped() && second.stopped()))
+    {
+        const TraceRecord firstRecord(first.traceRecord()), secondRecord(second.traceRecord());
+        uint16_t differences = (first.stopped() ? FirstEnded : 0) | (second.stopped() ? SecondEnded : 0);
+        if (differences == 0)
+            differences = recordDifferences(firstRecord, secondRecord);
+        if (diverged(differences, firstRecord, secondRecord))
+        {
+            divergence = true;
+            break;
+        }
+
+        const bool firstStepped = step(first), secondStepped = step(second);
+        if (firstStepped != secondStepped)
+            divergence = diverged(firstStepped ? SecondEnded : FirstEnded, firstRecord, secondRecord);
+        else if (!firstStepped)
+            break;
+        else if (first.memoryWrites().any() || second.memoryWrites().any())
+        {
+            const int lowest = std::min(first.memoryWrites().lowest, second.memoryWrites().lowest);
+            const int highest = std::max(first.memoryWrites().highest, second.memoryWrites().highest);
+            address = firstMemoryDifference(first, second, lowest, highest);
+            if (address >= 0)
+            {
+                divergence = diverged(Memory, firstRecord, secondRecord);
+                _divergence.memoryAddress = address;
+                _divergence.firstValue = first.memoryByteAt(address);
+                _divergence.secondValue = second.memoryByteAt(address);
+            }
+        }
+        if (!divergence)
+            _instructionsCompared++;
+    }
+    first.setTrackingMemoryWrites(firstTracking);
+    second.setTrackingMemoryWrites(secondTracking);
+    return divergence;
+}
+
+uint16_t TraceDiff::recordDifferences(const TraceRecord &first, const TraceRecord &second) const
+{
+    uint16_t differences = 0;
+    if (first.programCounter != second.programCounter)
+        differences |= ProgramCounter;
+    // only as many operand bytes as the instruction has
+    const int operandBits = 8 * std::max(InstructionSet::getInstructionInfo(first.opcode).bytes - 1, 0);
+    const uint16_t operandMask = static_cast<uint16_t>((1u << operandBits) - 1);
+    if (first.opcode != second.opcode || ((first.operand ^ second.operand) & operandMask) != 0)
+        differences |= Instruction;
+    if (first.accumulator != second.accumulator)
+        differences |= Accumulator;
+    if (first.xregister != second.xregister)
+        differences |= XRegister;
+    if (first.yregister != second.yregister)
+        differences |= YRegister;
+    if (first.statusFlags != second.statusFlags)
+        differences |= StatusFlags;
+    if (first.stackRegister != second.stackRegister)
+        differences |= StackRegister;
+    if (_comparesCycles && first.cycles != second.cycles)
+        differences |= Cycles;
+    return differences;
+}
+
+bool TraceDiff::diverged(uint16_t differences, const TraceRecord &first, const TraceRecord &second)
+{
+    if (differences == 0)
+        return false;
+    _divergence.instruction = _instructionsCompared;
+    _divergence.differences = differences;
+    _divergence.first = first;
+    _divergence.second = second;
+    return true;
+}
+
+int TraceDiff::firstMemoryDifference(const ProcessorCore &first, const ProcessorCore &second, int lowest, int highest) const
+{
+    const uint8_t *const firstMemory = first.memory(), *const secondMemory = second.memory();
+    const auto mismatch = std::mismatch(firstMemory + lowest, firstMemory + highest + 1, secondMemory + lowest);
+    return mismatch.first != firstMemory + highest + 1 ? static_cast<int>(mismatch.first - firstMemory) : -1;
+}
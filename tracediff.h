@@ -0,0 +1,60 @@
+#ifndef TRACEDIFF_H
+#define TRACEDIFF_H
+
+#include <cstdint>
+
+#include "executiontrace.h"
+#include "processorcore.h"
+
+//
+// TraceDiff Class
+//
+// Finds the first instruction at which two runs diverge, compared a record at a time from two traces, or live from
+// two cores stepped in lockstep (each from wherever it is, say a restored save state)
+// Live, memory is compared too: all of it to start with, then each step what either core wrote
+// The cycle counts are compared only when `comparesCycles()`, as a routine rewritten to be faster is meant to differ
+//
+class TraceDiff
+{
+public:
+    enum Differences : uint16_t
+    {
+        ProgramCounter = 0x01, Instruction = 0x02,
+        Accumulator = 0x04, XRegister = 0x08, YRegister = 0x10, StatusFlags = 0x20, StackRegister = 0x40,
+        Cycles = 0x80, Memory = 0x100,
+        FirstEnded = 0x200, SecondEnded = 0x400,    // the run ended, or threw an `ExecutionError`, before the other
+    };
+    struct Divergence
+    {
+        uint64_t instruction = 0;       // how many instructions were the same before it
+        uint16_t differences = 0;
+        TraceRecord first{}, second{};  // each run's record of the instruction, before it is executed; live, with
+                                        // `Memory` they are the records of the instruction which wrote
+        int memoryAddress = -1;         // live, with `Memory`, the lowest address which differs
+        uint8_t firstValue = 0, secondValue = 0;
+    };
+
+    TraceDiff();
+
+    bool comparesCycles() const { return _comparesCycles; }
+    void setComparesCycles(bool compare) { _comparesCycles = compare; }
+
+    // these return true on finding a divergence, false for none
+    bool compare(TraceReader &first, TraceReader &second);
+    // at most `maxInstructions` instructions, stopping at the end of both runs
+    bool compare(ProcessorCore &first, ProcessorCore &second, uint64_t maxInstructions);
+
+    const Divergence &divergence() const { return _divergence; }
+    uint64_t instructionsCompared() const { return _instructionsCompared; }
+
+private:
+    bool _comparesCycles;
+    Divergence _divergence;
+    uint64_t _instructionsCompared;
+
+    uint16_t recordDifferences(const TraceRecord &first, const TraceRecord &second) const;
+    bool diverged(uint16_t differences, const TraceRecord &first, const TraceRecord &second);
+    int firstMemoryDifference(const ProcessorCore &first, const ProcessorCore &second, int lowest, int highest) const;
+};
+
+#endif // TRACEDIFF_H
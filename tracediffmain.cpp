@@ -0,0 +1,158 @@
+#include "headlessrunner.h"
+#include "tracediff.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QLoggingCategory>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+//
+// QuietHost Class
+//
+// The live runs' host: their output is dropped, and console input reads as end of input, which stops them
+//
+class QuietHost : public IProcessorCoreHost
+{
+public:
+    void sendMessage(const char *, int) override {}
+    void outputChar(char) override {}
+    void outputString(const char *, int) override {}
+    char inputChar(int, bool) override { return '\003'; }
+    void processEvents() override {}
+    void openFile(const char *) override {}
+    void closeFile() override {}
+    void rewindFile() override {}
+    bool readFile(char &) override { return false; }
+};
+
+static QString sourceLocation(const HeadlessRunner *runner, uint16_t address)
+{
+    if (runner == nullptr)
+        return QString();
+    QString filename;
+    int lineNumber = -1;
+    runner->emulator()->mapInstructionAddressToFileLineNumber(address, filename, lineNumber);
+    if (lineNumber < 0)
+        return QString();
+    return QString("%1:%2").arg(QFileInfo(filename).fileName()).arg(lineNumber + 1);
+}
+
+static void printRecord(const char *name, const HeadlessRunner *runner, const TraceRecord &record, bool ended)
+{
+    if (ended)
+    {
+        std::printf("  %-7s (ended)\n", name);
+        return;
+    }
+    const TraceFormatter formatter(runner != nullptr ? runner->emulator()->traceSymbols() : TraceFormatter::Symbols());
+    std::printf("  %-7s %s  %s\n", name, formatter.format(record).c_str(), qPrintable(sourceLocation(runner, record.programCounter)));
+}
+
+static void printDivergence(const TraceDiff &diff, const HeadlessRunner *firstRunner, const HeadlessRunner *secondRunner)
+{
+    const TraceDiff::Divergence &divergence(diff.divergence());
+    static const struct { TraceDiff::Differences difference; const char *name; } names[] =
+    {
+        { TraceDiff::ProgramCounter, "PC" }, { TraceDiff::Instruction, "instruction" },
+        { TraceDiff::Accumulator, "A" }, { TraceDiff::XRegister, "X" }, { TraceDiff::YRegister, "Y" },
+        { TraceDiff::StatusFlags, "P" }, { TraceDiff::StackRegister, "S" }, { TraceDiff::Cycles, "cycles" },
+        { TraceDiff::Memory, "memory" }, { TraceDiff::FirstEnded, "first ended" }, { TraceDiff::SecondEnded, "second ended" },
+    };
+    QStringList differences;
+    for (const auto &name : names)
+        if (divergence.differences & name.difference)
+            differences.append(name.name);
+    std::printf("First divergence after %llu instructions the same: %s\n",
+                static_cast<unsigned long long>(divergence.instruction), qPrintable(differences.join(", ")));
+    printRecord("first:", firstRunner, divergence.first, divergence.differences & TraceDiff::FirstEnded);
+    printRecord("second:", secondRunner, divergence.second, divergence.differences & TraceDiff::SecondEnded);
+    if (divergence.memoryAddress >= 0)
+        std::printf("  memory $%04X: $%02X in the first, $%02X in the second\n",
+                    divergence.memoryAddress, divergence.firstValue, divergence.secondValue);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("6502tracediff");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Find the first instruction at which two runs diverge in registers or memory.\n"
+                                     "Compares two trace files written by 6502run --trace, or with --live runs two programs in lockstep.");
+    parser.addHelpOption();
+    QCommandLineOption includeOption({ "I", "include" }, "Add <directory> to the .include search path.", "directory");
+    parser.addOption(includeOption);
+    QCommandLineOption liveOption("live", "Assemble and run the two source files, comparing registers and memory.");
+    parser.addOption(liveOption);
+    QCommandLineOption sourceOption("source", "For trace files: the program's source file, for labels and line numbers.", "file");
+    parser.addOption(sourceOption);
+    QCommandLineOption cyclesOption("cycles", "Compare the cycle counts too.");
+    parser.addOption(cyclesOption);
+    QCommandLineOption maxInstructionsOption("max-instructions", "For --live: stop comparing after <count> instructions (default 100000000).", "count", "100000000");
+    parser.addOption(maxInstructionsOption);
+    parser.addPositionalArgument("first", "First trace file, or source file with --live.");
+    parser.addPositionalArgument("second", "Second trace file, or source file with --live.");
+    parser.process(a);
+
+    const QStringList args(parser.positionalArguments());
+    if (args.size() != 2)
+        parser.showHelp(2);
+
+    // messages are already sent to stderr via `sendMessageToConsole()`
+    QLoggingCategory::setFilterRules("*.debug=false");
+
+    TraceDiff diff;
+    diff.setComparesCycles(parser.isSet(cyclesOption));
+    std::unique_ptr<HeadlessRunner> firstRunner, secondRunner;
+    bool diverged;
+    if (parser.isSet(liveOption))
+    {
+        firstRunner.reset(new HeadlessRunner);
+        secondRunner.reset(new HeadlessRunner);
+        if (!firstRunner->assembleFile(args.at(0), parser.values(includeOption))
+            || !secondRunner->assembleFile(args.at(1), parser.values(includeOption)))
+            return 2;
+        QuietHost host;
+        for (HeadlessRunner *runner : { firstRunner.get(), secondRunner.get() })
+        {
+            runner->processorModel()->restart();
+            runner->processorModel()->setProgramCounter(runner->emulator()->runStartAddress());
+            runner->processorModel()->core()->setHost(&host);
+            runner->processorModel()->core()->startRun();
+        }
+        bool ok;
+        const qulonglong maxInstructions = parser.value(maxInstructionsOption).toULongLong(&ok);
+        if (!ok)
+            parser.showHelp(2);
+        diverged = diff.compare(*firstRunner->processorModel()->core(), *secondRunner->processorModel()->core(), maxInstructions);
+    }
+    else
+    {
+        if (parser.isSet(sourceOption))
+        {
+            firstRunner.reset(new HeadlessRunner);
+            if (!firstRunner->assembleFile(parser.value(sourceOption), parser.values(includeOption)))
+                return 2;
+        }
+        std::ifstream firstIn(args.at(0).toStdString(), std::ios::binary), secondIn(args.at(1).toStdString(), std::ios::binary);
+        TraceReader first(firstIn), second(secondIn);
+        for (int i = 0; i < 2; i++)
+            if (!(i == 0 ? first : second).valid())
+            {
+                std::fprintf(stderr, "%s: Not a trace file\n", qPrintable(args.at(i)));
+                return 2;
+            }
+        diverged = diff.compare(first, second);
+    }
+
+    const HeadlessRunner *secondSource = secondRunner != nullptr ? secondRunner.get() : firstRunner.get();
+    if (diverged)
+        printDivergence(diff, firstRunner.get(), secondSource);
+    else
+        std::printf("No divergence in %llu instructions\n", static_cast<unsigned long long>(diff.instructionsCompared()));
+    return diverged ? 1 : 0;
+}